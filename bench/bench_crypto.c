@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/include/crypto.h"
+
+#define DEFAULT_BENCH_SIZE_MB 16
+#define DEFAULT_PARALLEL_SIZE_MB 128
+#define BENCH_PASSWORD "benchmark"
+#define SMALL_PAYLOAD_SIZE 4096
+#define SMALL_PAYLOAD_ROUNDS 200
+
+/**
+ * @brief Devuelve el tiempo monotónico actual en segundos.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Mide el throughput de cifrado y descifrado para un algoritmo y modo.
+ *
+ * @param data  Datos de entrada.
+ * @param size  Tamaño de los datos en bytes.
+ * @param alg   Algoritmo de encriptación.
+ * @param mode  Modo de encriptación.
+ */
+static void bench_cipher(const uint8_t *data, size_t size, EncryptionAlgorithm alg, EncryptionMode mode, const char *name) {
+    size_t encrypted_size = 0;
+    size_t decrypted_size = 0;
+
+    double start = now_seconds();
+    uint8_t *encrypted = crypto_encrypt(data, size, alg, mode, BENCH_PASSWORD, &encrypted_size);
+    double encrypt_time = now_seconds() - start;
+    if (encrypted == NULL) {
+        printf("%-22s  error al cifrar\n", name);
+        return;
+    }
+
+    start = now_seconds();
+    uint8_t *decrypted = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), alg, mode, (const uint8_t *) BENCH_PASSWORD, &decrypted_size);
+    double decrypt_time = now_seconds() - start;
+
+    double mb = (double) size / (1024.0 * 1024.0);
+    printf("%-22s  encrypt %9.1f MB/s   decrypt %9.1f MB/s\n", name, mb / encrypt_time, mb / decrypt_time);
+
+    free(decrypted);
+    free(encrypted);
+}
+
+/**
+ * @brief Compara el descifrado serial contra el paralelo por segmentos en CBC y ECB.
+ */
+static void bench_parallel_decrypt(const uint8_t *data, size_t size, EncryptionAlgorithm alg, EncryptionMode mode, const char *name) {
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = crypto_encrypt(data, size, alg, mode, BENCH_PASSWORD, &encrypted_size);
+    if (encrypted == NULL) {
+        printf("%-22s  error al cifrar\n", name);
+        return;
+    }
+
+    double mb = (double) size / (1024.0 * 1024.0);
+    size_t thread_counts[] = {1, 0};
+    double times[2];
+    for (int i = 0; i < 2; i++) {
+        size_t decrypted_size = 0;
+        crypto_set_max_threads(thread_counts[i]);
+        double start = now_seconds();
+        uint8_t *decrypted = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), alg, mode, (const uint8_t *) BENCH_PASSWORD, &decrypted_size);
+        times[i] = now_seconds() - start;
+        free(decrypted);
+    }
+    crypto_set_max_threads(0);
+
+    printf("%-22s  1 thread %9.1f MB/s   all CPUs %9.1f MB/s   speedup %.2fx\n",
+           name, mb / times[0], mb / times[1], times[0] / times[1]);
+    free(encrypted);
+}
+
+/**
+ * @brief Mide operaciones por segundo con payloads chicos, donde pesa el costo fijo por llamada.
+ */
+static void bench_small_payloads(const uint8_t *data, EncryptionAlgorithm alg, EncryptionMode mode, const char *name) {
+    double start = now_seconds();
+    for (int i = 0; i < SMALL_PAYLOAD_ROUNDS; i++) {
+        size_t encrypted_size = 0;
+        size_t decrypted_size = 0;
+        uint8_t *encrypted = crypto_encrypt(data, SMALL_PAYLOAD_SIZE, alg, mode, BENCH_PASSWORD, &encrypted_size);
+        if (encrypted == NULL) {
+            printf("%-22s  error al cifrar\n", name);
+            return;
+        }
+        free(crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), alg, mode, (const uint8_t *) BENCH_PASSWORD, &decrypted_size));
+        free(encrypted);
+    }
+    double elapsed = now_seconds() - start;
+    printf("%-22s  %9.1f ida y vuelta/s\n", name, SMALL_PAYLOAD_ROUNDS / elapsed);
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_BENCH_SIZE_MB;
+    size_t parallel_mb = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_PARALLEL_SIZE_MB;
+    if (size_mb == 0 || parallel_mb == 0) {
+        fprintf(stderr, "Usage: %s [size_mb] [parallel_size_mb]\n", argv[0]);
+        return 1;
+    }
+    set_log_level(NONE);
+    crypto_init();
+
+    size_t size = (size_mb > parallel_mb ? size_mb : parallel_mb) * 1024 * 1024;
+    uint8_t *data = malloc(size);
+    if (data == NULL) {
+        fprintf(stderr, "Could not allocate %zu MB.\n", size_mb);
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t) (i * 31 + 7);
+    }
+
+    printf("Crypto benchmark: %zu MB por operación (incluye PBKDF2)\n\n", size_mb);
+
+    struct { EncryptionAlgorithm alg; EncryptionMode mode; const char *name; } cases[] = {
+            {ENC_AES128, ENC_MODE_ECB,    "aes128-ecb"},
+            {ENC_AES128, ENC_MODE_CBC,    "aes128-cbc"},
+            {ENC_AES128, ENC_MODE_OFB,    "aes128-ofb"},
+            {ENC_AES128, ENC_MODE_CFB1,   "aes128-cfb1 (cfb)"},
+            {ENC_AES128, ENC_MODE_CFB8,   "aes128-cfb8"},
+            {ENC_AES128, ENC_MODE_CFB128, "aes128-cfb128"},
+            {ENC_AES128, ENC_MODE_CTR,    "aes128-ctr"},
+            {ENC_AES128, ENC_MODE_GCM,    "aes128-gcm"},
+            {ENC_AES256, ENC_MODE_CFB1,   "aes256-cfb1 (cfb)"},
+            {ENC_AES256, ENC_MODE_CFB128, "aes256-cfb128"},
+            {ENC_AES256, ENC_MODE_GCM,    "aes256-gcm"},
+            {ENC_3DES,   ENC_MODE_CFB8,   "3des-cfb8 (cfb)"},
+            {ENC_3DES,   ENC_MODE_CFB128, "3des-cfb64"},
+            {ENC_CHACHA20, ENC_MODE_NONE, "chacha20-poly1305"},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        bench_cipher(data, size_mb * 1024 * 1024, cases[i].alg, cases[i].mode, cases[i].name);
+    }
+
+    printf("\nDescifrado paralelo: %zu MB\n\n", parallel_mb);
+    bench_parallel_decrypt(data, parallel_mb * 1024 * 1024, ENC_AES128, ENC_MODE_CBC, "aes128-cbc");
+    bench_parallel_decrypt(data, parallel_mb * 1024 * 1024, ENC_AES256, ENC_MODE_CBC, "aes256-cbc");
+    bench_parallel_decrypt(data, parallel_mb * 1024 * 1024, ENC_AES128, ENC_MODE_ECB, "aes128-ecb");
+    bench_parallel_decrypt(data, parallel_mb * 1024 * 1024, ENC_3DES, ENC_MODE_CBC, "3des-cbc");
+    bench_parallel_decrypt(data, parallel_mb * 1024 * 1024, ENC_AES128, ENC_MODE_CTR, "aes128-ctr");
+
+    printf("\nPayloads de %d bytes (contexto y ciphers reutilizados)\n\n", SMALL_PAYLOAD_SIZE);
+    bench_small_payloads(data, ENC_AES128, ENC_MODE_CBC, "aes128-cbc");
+    bench_small_payloads(data, ENC_AES256, ENC_MODE_GCM, "aes256-gcm");
+    bench_small_payloads(data, ENC_CHACHA20, ENC_MODE_NONE, "chacha20-poly1305");
+
+    crypto_cleanup();
+    free(data);
+    return 0;
+}
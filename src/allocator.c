@@ -0,0 +1,265 @@
+#include "./include/allocator.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+#define ARENA_BLOCK_HEADER ARENA_ALIGNMENT                 // Keeps the size of each block
+#define ARENA_DEDICATED_LIMIT (ARENA_CHUNK_SIZE / 2)        // Larger blocks get their own chunk
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t capacity;    // Usable bytes after the chunk header
+    size_t used;
+    bool dedicated;     // Holds a single large block
+};
+
+#define ARENA_CHUNK_HEADER ARENA_ALIGN(sizeof(ArenaChunk))
+
+static __thread const Allocator *current_allocator = NULL;
+
+// One spare chunk per thread, kept between arenas. Thread-specific so it is freed when the thread exits.
+static pthread_key_t spare_chunk_key;
+static pthread_once_t spare_chunk_once = PTHREAD_ONCE_INIT;
+
+static void spare_chunk_init(void) {
+    pthread_key_create(&spare_chunk_key, free);
+}
+
+static uint8_t *chunk_data(ArenaChunk *chunk) {
+    return (uint8_t *) chunk + ARENA_CHUNK_HEADER;
+}
+
+static size_t block_size(const void *ptr) {
+    return *(const size_t *) ((const uint8_t *) ptr - ARENA_BLOCK_HEADER);
+}
+
+/**
+ * @brief Bytes a block of `size` takes in a chunk, header included.
+ */
+static size_t block_span(size_t size) {
+    return ARENA_BLOCK_HEADER + ARENA_ALIGN(size > 0 ? size : 1);
+}
+
+static void *parent_allocate(const Arena *arena, size_t size) {
+    return arena->parent != NULL ? arena->parent->allocate(size, arena->parent->user_data) : malloc(size);
+}
+
+static void parent_release(const Arena *arena, void *ptr) {
+    if (arena->parent != NULL) {
+        arena->parent->release(ptr, arena->parent->user_data);
+    } else {
+        free(ptr);
+    }
+}
+
+static ArenaChunk *new_chunk(Arena *arena, size_t capacity, bool dedicated) {
+    ArenaChunk *chunk = NULL;
+    if (!dedicated && arena->parent == NULL) {
+        pthread_once(&spare_chunk_once, spare_chunk_init);
+        chunk = pthread_getspecific(spare_chunk_key);
+        pthread_setspecific(spare_chunk_key, NULL);
+    }
+    if (chunk == NULL) {
+        chunk = parent_allocate(arena, ARENA_CHUNK_HEADER + capacity);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->capacity = capacity;
+    }
+    chunk->used = 0;
+    chunk->dedicated = dedicated;
+
+    // The current chunk stays first so small blocks keep filling it
+    ArenaChunk *head = arena->chunks;
+    if (dedicated && head != NULL) {
+        chunk->next = head->next;
+        head->next = chunk;
+    } else {
+        chunk->next = head;
+        arena->chunks = chunk;
+    }
+    return chunk;
+}
+
+/**
+ * @brief Find the chunk that holds `ptr`, and the one before it in the list.
+ */
+static ArenaChunk *find_chunk(const Arena *arena, const void *ptr, ArenaChunk **previous) {
+    *previous = NULL;
+    for (ArenaChunk *chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        const uint8_t *data = chunk_data(chunk);
+        if ((const uint8_t *) ptr >= data && (const uint8_t *) ptr < data + chunk->capacity) {
+            return chunk;
+        }
+        *previous = chunk;
+    }
+    return NULL;
+}
+
+static void *arena_allocate(size_t size, void *user_data) {
+    Arena *arena = user_data;
+    if (size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    size_t needed = block_span(size);
+
+    ArenaChunk *chunk = arena->chunks;
+    if (needed > ARENA_DEDICATED_LIMIT) {
+        chunk = new_chunk(arena, needed, true);
+    } else if (chunk == NULL || chunk->dedicated || chunk->capacity - chunk->used < needed) {
+        chunk = new_chunk(arena, ARENA_CHUNK_SIZE, false);
+    }
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    uint8_t *block = chunk_data(chunk) + chunk->used;
+    *(size_t *) block = size;
+    chunk->used += needed;
+    return block + ARENA_BLOCK_HEADER;
+}
+
+static void arena_release(void *ptr, void *user_data) {
+    Arena *arena = user_data;
+    if (ptr == NULL) {
+        return;
+    }
+    ArenaChunk *previous = NULL;
+    ArenaChunk *chunk = find_chunk(arena, ptr, &previous);
+    if (chunk == NULL) {
+        // Allocated before the arena was in scope
+        parent_release(arena, ptr);
+        return;
+    }
+
+    if (chunk->dedicated) {
+        if (previous != NULL) {
+            previous->next = chunk->next;
+        } else {
+            arena->chunks = chunk->next;
+        }
+        parent_release(arena, chunk);
+        return;
+    }
+    // Only the last block of a chunk can be given back before the arena is destroyed
+    size_t start = (size_t) ((uint8_t *) ptr - chunk_data(chunk)) - ARENA_BLOCK_HEADER;
+    if (start + block_span(block_size(ptr)) == chunk->used) {
+        chunk->used = start;
+    }
+}
+
+static void *arena_reallocate(void *ptr, size_t size, void *user_data) {
+    Arena *arena = user_data;
+    if (ptr == NULL) {
+        return arena_allocate(size, arena);
+    }
+    ArenaChunk *previous = NULL;
+    ArenaChunk *chunk = find_chunk(arena, ptr, &previous);
+    if (chunk == NULL) {
+        if (arena->parent == NULL) {
+            return realloc(ptr, size);
+        }
+        return arena->parent->reallocate != NULL ? arena->parent->reallocate(ptr, size, arena->parent->user_data) : NULL;
+    }
+
+    // The last block of the current chunk grows in place
+    size_t old_size = block_size(ptr);
+    size_t start = (size_t) ((uint8_t *) ptr - chunk_data(chunk)) - ARENA_BLOCK_HEADER;
+    if (!chunk->dedicated && chunk == arena->chunks && start + block_span(old_size) == chunk->used
+        && size <= ARENA_DEDICATED_LIMIT && start + block_span(size) <= chunk->capacity) {
+        *(size_t *) (chunk_data(chunk) + start) = size;
+        chunk->used = start + block_span(size);
+        return ptr;
+    }
+
+    void *moved = arena_allocate(size, arena);
+    if (moved == NULL) {
+        return NULL;
+    }
+    memcpy(moved, ptr, old_size < size ? old_size : size);
+    arena_release(ptr, arena);
+    return moved;
+}
+
+void *mem_alloc(size_t size) {
+    const Allocator *allocator = current_allocator;
+    return allocator != NULL ? allocator->allocate(size, allocator->user_data) : malloc(size);
+}
+
+void *mem_calloc(size_t count, size_t size) {
+    const Allocator *allocator = current_allocator;
+    if (allocator == NULL) {
+        return calloc(count, size);
+    }
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = allocator->allocate(count * size, allocator->user_data);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+    const Allocator *allocator = current_allocator;
+    if (allocator == NULL) {
+        return realloc(ptr, size);
+    }
+    return allocator->reallocate != NULL ? allocator->reallocate(ptr, size, allocator->user_data) : NULL;
+}
+
+void mem_free(void *ptr) {
+    const Allocator *allocator = current_allocator;
+    if (allocator == NULL) {
+        free(ptr);
+    } else if (ptr != NULL) {
+        allocator->release(ptr, allocator->user_data);
+    }
+}
+
+char *mem_strdup(const char *string) {
+    size_t length = strlen(string) + 1;
+    char *copy = mem_alloc(length);
+    if (copy != NULL) {
+        memcpy(copy, string, length);
+    }
+    return copy;
+}
+
+void allocator_scope_enter(const Allocator *allocator, const Allocator **saved) {
+    *saved = current_allocator;
+    current_allocator = allocator;
+}
+
+void allocator_scope_exit(const Allocator *saved) {
+    current_allocator = saved;
+}
+
+void arena_init(Arena *arena, const Allocator *parent) {
+    arena->allocator.allocate = arena_allocate;
+    arena->allocator.reallocate = arena_reallocate;
+    arena->allocator.release = arena_release;
+    arena->allocator.user_data = arena;
+    arena->parent = parent;
+    arena->chunks = NULL;
+}
+
+void arena_destroy(Arena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        bool keep = !chunk->dedicated && arena->parent == NULL;
+        if (keep) {
+            pthread_once(&spare_chunk_once, spare_chunk_init);
+            keep = pthread_getspecific(spare_chunk_key) == NULL && pthread_setspecific(spare_chunk_key, chunk) == 0;
+        }
+        if (!keep) {
+            parent_release(arena, chunk);
+        }
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
@@ -0,0 +1,355 @@
+#include "./include/analysis.h"
+#include <math.h>
+
+#define RS_LANES 8                      // Groups classified per vector
+#define RS_FLUSH_BLOCKS INT16_MAX       // Vectors counted before the 16-bit counters are flushed
+#define GAMMA_EPSILON 1e-12
+#define GAMMA_TINY 1e-300
+
+typedef int16_t Lanes __attribute__((vector_size(RS_LANES * sizeof(int16_t))));
+
+static const char *channel_names[] = {"blue", "green", "red"};
+
+/**
+ * @brief The counts of one row segment, merged once every task finished.
+ */
+typedef struct {
+    BMPImage *bmp;
+    size_t first_row;
+    size_t end_row;
+    uint64_t histograms[3][256];
+    uint64_t groups;                    // Per channel
+    uint64_t regular[3][4];
+    uint64_t singular[3][4];
+    bool failed;
+} AnalysisSegment;
+
+static inline Lanes abs_lanes(Lanes x) {
+    Lanes sign = x >> 15;
+    return (x ^ sign) - sign;
+}
+
+// The "negative" LSB flip of RS analysis: -1 <-> 0, 1 <-> 2, ..., 255 <-> 256
+static inline Lanes flip_negative(Lanes x) {
+    return ((x + 1) ^ 1) - 1;
+}
+
+static inline Lanes smoothness(Lanes a, Lanes b, Lanes c, Lanes d) {
+    return abs_lanes(b - a) + abs_lanes(c - b) + abs_lanes(d - c);
+}
+
+/**
+ * @brief Classify the groups of a row with the mask [0 1 1 0], on the samples as they are and with every LSB flipped.
+ *
+ * @param positions Sample k of every group in positions[k], padded to a multiple of RS_LANES.
+ */
+static void count_rs_groups(int16_t *const positions[4], size_t groups, uint64_t regular[4], uint64_t singular[4]) {
+    Lanes index = {0, 1, 2, 3, 4, 5, 6, 7};
+    Lanes counts[8] = {0};
+    size_t blocks = 0;
+    for (size_t group = 0; group < groups; group += RS_LANES) {
+        // Lanes past the last group are padding and count nothing
+        Lanes valid = index < (Lanes) {0} + (int16_t) (groups - group < RS_LANES ? groups - group : RS_LANES);
+        Lanes a, b, c, d;
+        memcpy(&a, positions[0] + group, sizeof(Lanes));
+        memcpy(&b, positions[1] + group, sizeof(Lanes));
+        memcpy(&c, positions[2] + group, sizeof(Lanes));
+        memcpy(&d, positions[3] + group, sizeof(Lanes));
+
+        Lanes flipped_a = a ^ 1, flipped_b = b ^ 1, flipped_c = c ^ 1, flipped_d = d ^ 1;
+        Lanes original = smoothness(a, b, c, d);
+        Lanes flipped = smoothness(flipped_a, flipped_b, flipped_c, flipped_d);
+        Lanes with_mask[4] = {
+                smoothness(a, flipped_b, flipped_c, d),
+                smoothness(a, flip_negative(b), flip_negative(c), d),
+                smoothness(flipped_a, b, c, flipped_d),
+                smoothness(flipped_a, flip_negative(flipped_b), flip_negative(flipped_c), flipped_d)
+        };
+        for (size_t mask = 0; mask < 4; mask++) {
+            Lanes reference = mask < 2 ? original : flipped;
+            // Comparisons give -1 where true
+            counts[mask] -= (with_mask[mask] > reference) & valid;
+            counts[4 + mask] -= (with_mask[mask] < reference) & valid;
+        }
+
+        if (++blocks == RS_FLUSH_BLOCKS || group + RS_LANES >= groups) {
+            for (size_t mask = 0; mask < 4; mask++) {
+                for (size_t lane = 0; lane < RS_LANES; lane++) {
+                    regular[mask] += (uint16_t) counts[mask][lane];
+                    singular[mask] += (uint16_t) counts[4 + mask][lane];
+                }
+            }
+            memset(counts, 0, sizeof(counts));
+            blocks = 0;
+        }
+    }
+}
+
+static void flush_histograms(uint32_t tables[3][2][256], uint64_t histograms[3][256]) {
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t value = 0; value < 256; value++) {
+            histograms[channel][value] += (uint64_t) tables[channel][0][value] + tables[channel][1][value];
+        }
+    }
+    memset(tables, 0, 3 * 2 * 256 * sizeof(uint32_t));
+}
+
+/**
+ * @brief Count the histograms and RS groups of the rows of a segment.
+ */
+static void segment_task(void *arg) {
+    AnalysisSegment *segment = arg;
+    BMPImage *bmp = segment->bmp;
+    size_t row_components = bmp->width * 3;
+    if (!bmp_load_rows(bmp, segment->first_row * row_components, segment->end_row * row_components)) {
+        segment->failed = true;
+        return;
+    }
+
+    size_t groups = bmp->width / 4;
+    size_t stride = (groups + RS_LANES - 1) / RS_LANES * RS_LANES;
+    int16_t *samples = calloc(3 * 4 * (stride > 0 ? stride : 1), sizeof(int16_t));
+    uint32_t (*tables)[2][256] = calloc(3, sizeof(*tables));
+    if (samples == NULL || tables == NULL) {
+        LOG(ERROR, "Could not allocate the analysis of rows %zu to %zu.", segment->first_row, segment->end_row - 1)
+        free(samples);
+        free(tables);
+        segment->failed = true;
+        return;
+    }
+    int16_t *positions[3][4];
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t k = 0; k < 4; k++) {
+            positions[channel][k] = samples + (channel * 4 + k) * stride;
+        }
+    }
+
+    size_t grouped = groups * 4;
+    size_t pending = 0;
+    for (size_t row = segment->first_row; row < segment->end_row; row++) {
+        // The 32-bit tables must not overflow on very wide images
+        if (pending + bmp->width > UINT32_MAX) {
+            flush_histograms(tables, segment->histograms);
+            pending = 0;
+        }
+        pending += bmp->width;
+
+        // Only the width * 3 pixel bytes are read: the padding is never counted
+        const uint8_t *pixels = bmp_row(bmp, row);
+        for (size_t x = 0; x < grouped; x++) {
+            for (size_t channel = 0; channel < 3; channel++) {
+                uint8_t value = pixels[x * 3 + channel];
+                tables[channel][x & 1][value]++;
+                positions[channel][x & 3][x >> 2] = value;
+            }
+        }
+        for (size_t x = grouped; x < bmp->width; x++) {
+            for (size_t channel = 0; channel < 3; channel++) {
+                tables[channel][x & 1][pixels[x * 3 + channel]]++;
+            }
+        }
+        for (size_t channel = 0; channel < 3; channel++) {
+            count_rs_groups(positions[channel], groups, segment->regular[channel], segment->singular[channel]);
+        }
+    }
+    flush_histograms(tables, segment->histograms);
+    segment->groups = groups * (segment->end_row - segment->first_row);
+    free(samples);
+    free(tables);
+}
+
+/**
+ * @brief Regularized upper incomplete gamma function Q(a, x), by its series or its continued fraction.
+ */
+static double upper_gamma(double a, double x) {
+    if (x <= 0) {
+        return 1;
+    }
+    double scale = exp(-x + a * log(x) - lgamma(a));
+    if (x < a + 1) {
+        double term = 1 / a, sum = term;
+        for (double n = a + 1; n < a + 1000 && fabs(term) > fabs(sum) * GAMMA_EPSILON; n++) {
+            term *= x / n;
+            sum += term;
+        }
+        return fmax(0, 1 - sum * scale);
+    }
+    // Modified Lentz's method
+    double b = x + 1 - a, c = 1 / GAMMA_TINY, d = 1 / b, fraction = d;
+    for (int i = 1; i < 1000; i++) {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        d = fabs(d) < GAMMA_TINY ? GAMMA_TINY : d;
+        c = b + an / c;
+        c = fabs(c) < GAMMA_TINY ? GAMMA_TINY : c;
+        d = 1 / d;
+        fraction *= d * c;
+        if (fabs(d * c - 1) < GAMMA_EPSILON) {
+            break;
+        }
+    }
+    return fmin(1, fraction * scale);
+}
+
+/**
+ * @brief Pair-of-values chi-square statistic of a histogram, and its p-value.
+ */
+static double chi_square(const uint64_t histogram[256], size_t *degrees, double *p) {
+    double statistic = 0;
+    size_t pairs = 0;
+    for (size_t k = 0; k < 256; k += 2) {
+        double expected = (double) (histogram[k] + histogram[k + 1]) / 2;
+        if (expected < ANALYSIS_CHI_SQUARE_MIN) {
+            continue;
+        }
+        double difference = (double) histogram[k] - expected;
+        statistic += difference * difference / expected;
+        pairs++;
+    }
+    *degrees = pairs > 0 ? pairs - 1 : 0;
+    *p = *degrees > 0 ? upper_gamma((double) *degrees / 2, statistic / 2) : 0;
+    return statistic;
+}
+
+/**
+ * @brief Solve the RS equation for the share of flipped LSBs and turn it into an embedding rate.
+ */
+static double rs_rate(const ChannelAnalysis *channel) {
+    if (channel->groups == 0) {
+        return NAN;
+    }
+    double difference[4];
+    for (size_t mask = 0; mask < 4; mask++) {
+        difference[mask] = ((double) channel->regular[mask] - (double) channel->singular[mask]) / (double) channel->groups;
+    }
+    double d0 = difference[0], negative_d0 = difference[1], d1 = difference[2], negative_d1 = difference[3];
+    double a = 2 * (d1 + d0), b = negative_d0 - negative_d1 - d1 - 3 * d0, c = d0 - negative_d0;
+
+    double root;
+    if (fabs(a) < GAMMA_EPSILON) {
+        root = fabs(b) > GAMMA_EPSILON ? -c / b : 0;
+    } else {
+        double discriminant = sqrt(fmax(0, b * b - 4 * a * c));
+        double first = (-b + discriminant) / (2 * a), second = (-b - discriminant) / (2 * a);
+        root = fabs(first) < fabs(second) ? first : second;
+    }
+    double rate = root / (root - 0.5);
+    return isnan(rate) ? rate : fmin(1, fmax(0, rate));
+}
+
+/**
+ * @brief Merge the segments of one channel and compute its estimates.
+ */
+static void finish_channel(const AnalysisSegment *segments, size_t count, size_t width, size_t channel_index,
+                           ChannelAnalysis *channel) {
+    memset(channel, 0, sizeof(ChannelAnalysis));
+    uint64_t samples = 0, embedded = 0;
+    for (size_t s = 0; s < count; s++) {
+        const AnalysisSegment *segment = &segments[s];
+        for (size_t value = 0; value < 256; value++) {
+            channel->histogram[value] += segment->histograms[channel_index][value];
+        }
+        for (size_t mask = 0; mask < 4; mask++) {
+            channel->regular[mask] += segment->regular[channel_index][mask];
+            channel->singular[mask] += segment->singular[channel_index][mask];
+        }
+        channel->groups += segment->groups;
+        samples += (uint64_t) (segment->end_row - segment->first_row) * width;
+
+        // The payload is written from the first sample, so it reaches the last prefix whose pairs are even.
+        // Short prefixes of a payload can dip by chance, but once clean samples follow p falls and stays low.
+        // Prefixes with a single pair to compare (a flat area) decide nothing
+        size_t degrees;
+        double p;
+        chi_square(channel->histogram, &degrees, &p);
+        if (degrees > 0 && p >= ANALYSIS_CHI_SQUARE_THRESHOLD) {
+            embedded = samples;
+        }
+    }
+    channel->chi_square = chi_square(channel->histogram, &channel->degrees, &channel->chi_square_p);
+    channel->chi_square_rate = samples > 0 ? (double) embedded / (double) samples : 0;
+    channel->rs_rate = rs_rate(channel);
+}
+
+bool analyze_image(BMPImage *bmp, ThreadPool *pool, ImageAnalysis *analysis) {
+    if (bmp == NULL || analysis == NULL || bmp->width == 0 || bmp->height == 0) {
+        LOG(ERROR, "Nothing to analyze.")
+        return false;
+    }
+    double start = get_time_ms();
+    size_t count = bmp->height < ANALYSIS_SEGMENTS ? bmp->height : ANALYSIS_SEGMENTS;
+    AnalysisSegment *segments = calloc(count, sizeof(AnalysisSegment));
+    if (segments == NULL) {
+        LOG(ERROR, "Could not allocate the analysis.")
+        return false;
+    }
+
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t s = 0; s < count; s++) {
+        segments[s].bmp = bmp;
+        segments[s].first_row = bmp->height * s / count;
+        segments[s].end_row = bmp->height * (s + 1) / count;
+        if (pool == NULL || !thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, segment_task, &segments[s])) {
+            segment_task(&segments[s]);
+        }
+    }
+    if (pool != NULL) {
+        thread_pool_wait(pool, &group);
+    }
+
+    bool ok = true;
+    for (size_t s = 0; s < count; s++) {
+        ok = ok && !segments[s].failed;
+    }
+    if (ok) {
+        for (size_t channel = 0; channel < 3; channel++) {
+            finish_channel(segments, count, bmp->width, channel, &analysis->channels[channel]);
+        }
+        analysis->samples = bmp->width * bmp->height;
+        analysis->elapsed_ms = get_time_ms() - start;
+        LOG(INFO, "[Analysis] %zux%zu analyzed in %.1f ms.", bmp->width, bmp->height, analysis->elapsed_ms)
+    }
+    free(segments);
+    return ok;
+}
+
+int run_analysis(const char *path, const char *report_path, const AnalysisSettings *settings) {
+    AnalysisSettings defaults = {0, false};
+    settings = settings != NULL ? settings : &defaults;
+    BMPImage *bmp = new_bmp_file_lazy(path);
+    if (bmp == NULL) {
+        return -1;
+    }
+    ThreadPool *pool = settings->workers != 1 ? thread_pool_create(settings->workers, settings->pin_cpus) : NULL;
+    ImageAnalysis analysis;
+    bool analyzed = analyze_image(bmp, pool, &analysis);
+    thread_pool_destroy(pool);
+    size_t width = bmp->width, height = bmp->height;
+    free_bmp(bmp);
+    if (!analyzed) {
+        return -1;
+    }
+    FILE *report = report_path != NULL ? fopen(report_path, "w") : stdout;
+    if (report == NULL) {
+        LOG(ERROR, "Could not open the report %s.", report_path)
+        return -1;
+    }
+
+    fprintf(report, "# channel\tchi2\tdf\tp\tchi2_rate\trs_rate\n");
+    for (size_t i = 0; i < 3; i++) {
+        const ChannelAnalysis *channel = &analysis.channels[i];
+        fprintf(report, "%s\t%.2f\t%zu\t%.4f\t%.3f\t", channel_names[i], channel->chi_square, channel->degrees,
+                channel->chi_square_p, channel->chi_square_rate);
+        if (isnan(channel->rs_rate)) {
+            fprintf(report, "-\n");
+        } else {
+            fprintf(report, "%.3f\n", channel->rs_rate);
+        }
+    }
+    fprintf(report, "# %zux%zu, %zu samples per channel in %.1f ms\n", width, height, analysis.samples, analysis.elapsed_ms);
+    if (report != stdout) {
+        fclose(report);
+    }
+    return 0;
+}
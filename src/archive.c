@@ -0,0 +1,590 @@
+#include "./include/archive.h"
+#include "./include/compression.h"
+#include "./include/crypto.h"
+#include "./include/stego_bmp.h"
+#include "./include/utils.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define ARCHIVE_MAX_SIZE UINT32_MAX    // The archive is the data of a package, whose size field has 32 bits
+
+/**
+ * @brief One member of an archive job and what its worker did with it.
+ */
+typedef struct {
+    const char *directory;
+    ArchiveEntry entry;
+    CompressionAlgorithm compression;
+    uint8_t *stored;            // Bytes to store, when building
+    // Where the worker reads the member when extracting: the archive in memory, or the carrier
+    const uint8_t *archive;
+    const char *carrier_path;
+    StegAlgorithm steg_algorithm;
+    double steg_ms;
+    double write_ms;
+    JobStatus status;
+} ArchiveMember;
+
+static uint32_t file_crc(const uint8_t *data, size_t size) {
+    return (uint32_t) crc32(crc32(0L, Z_NULL, 0), data, (uInt) size);
+}
+
+/**
+ * @brief Whether a member name is a plain file name, which cannot escape the output directory.
+ */
+static bool valid_member_name(const char *name, size_t length) {
+    if (length == 0 || length > ARCHIVE_NAME_MAX || memchr(name, '/', length) != NULL || memchr(name, '\0', length) != NULL) {
+        return false;
+    }
+    return !(length == 1 && name[0] == '.') && !(length == 2 && name[0] == '.' && name[1] == '.');
+}
+
+/**
+ * @brief Join a directory and a file name. The result is freed with mem_free.
+ */
+static char* join_path(const char *directory, const char *name) {
+    size_t length = strlen(directory) + 1 + strlen(name) + 1;
+    char *path = mem_alloc(length);
+    if (path != NULL) {
+        snprintf(path, length, "%s/%s", directory, name);
+    }
+    return path;
+}
+
+/**
+ * @brief Run `task` for every member on the pool, or here without one, and wait for all of them.
+ *
+ * @return JobStatus The first error of a member, in index order, or JOB_OK.
+ */
+static JobStatus run_members(ThreadPool *pool, ArchiveMember *members, size_t count, ThreadPoolTask task) {
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t i = 0; i < count; i++) {
+        if (pool == NULL || !thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, task, &members[i])) {
+            task(&members[i]);
+        }
+    }
+    if (pool != NULL) {
+        thread_pool_wait(pool, &group);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (members[i].status != JOB_OK) {
+            return members[i].status;
+        }
+    }
+    return JOB_OK;
+}
+
+static void read_member_task(void *arg) {
+    ArchiveMember *member = arg;
+    char *path = join_path(member->directory, member->entry.name);
+    FILE *file = path != NULL ? fopen(path, "rb") : NULL;
+    if (file == NULL) {
+        LOG(ERROR, "Could not open %s/%s.", member->directory, member->entry.name)
+        member->status = JOB_ERROR_INPUT;
+        mem_free(path);
+        return;
+    }
+    size_t size = get_file_size(file);
+    uint8_t *data = size <= ARCHIVE_MAX_SIZE ? mem_alloc(size > 0 ? size : 1) : NULL;
+    bool read = data != NULL && fread(data, 1, size, file) == size;
+    fclose(file);
+    mem_free(path);
+    if (!read) {
+        LOG(ERROR, "Could not read %s/%s.", member->directory, member->entry.name)
+        mem_free(data);
+        member->status = JOB_ERROR_INPUT;
+        return;
+    }
+
+    member->entry.size = (uint32_t) size;
+    member->entry.crc = file_crc(data, size);
+    member->entry.stored_size = (uint32_t) size;
+    member->stored = data;
+    if (member->compression != COMPRESSION_NONE && size > 0) {
+        size_t compressed_size = 0;
+        uint8_t *compressed = compress_buffer(data, size, member->compression, &compressed_size);
+        if (compressed != NULL) {
+            mem_free(data);
+            member->stored = compressed;
+            member->entry.stored_size = (uint32_t) compressed_size;
+            member->entry.flags |= ARCHIVE_FLAG_COMPRESSED | (member->compression == COMPRESSION_ZSTD ? ARCHIVE_FLAG_ZSTD : 0);
+        }
+    }
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const ArchiveMember *) a)->entry.name, ((const ArchiveMember *) b)->entry.name);
+}
+
+/**
+ * @brief List the regular files of a directory. Returns NULL (with *count 0) on error.
+ */
+static ArchiveMember* list_directory(const char *directory, size_t *count) {
+    *count = 0;
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        LOG(ERROR, "Could not open the directory %s.", directory)
+        return NULL;
+    }
+    size_t capacity = 16;
+    ArchiveMember *members = calloc(capacity, sizeof(ArchiveMember));
+    struct dirent *dirent;
+    while (members != NULL && (dirent = readdir(dir)) != NULL) {
+        size_t length = strlen(dirent->d_name);
+        char *path = join_path(directory, dirent->d_name);
+        struct stat info;
+        bool regular = path != NULL && stat(path, &info) == 0 && S_ISREG(info.st_mode);
+        mem_free(path);
+        if (!regular) {
+            continue;
+        }
+        if (!valid_member_name(dirent->d_name, length) || *count == ARCHIVE_MAX_MEMBERS) {
+            LOG(ERROR, "Cannot archive %s: names are limited to %d bytes and archives to %d files.", dirent->d_name,
+                ARCHIVE_NAME_MAX, ARCHIVE_MAX_MEMBERS)
+            free(members);
+            members = NULL;
+            break;
+        }
+        if (*count == capacity) {
+            ArchiveMember *grown = realloc(members, capacity * 2 * sizeof(ArchiveMember));
+            if (grown == NULL) {
+                free(members);
+                members = NULL;
+                break;
+            }
+            memset(grown + capacity, 0, capacity * sizeof(ArchiveMember));
+            members = grown;
+            capacity *= 2;
+        }
+        memcpy(members[*count].entry.name, dirent->d_name, length + 1);
+        (*count)++;
+    }
+    closedir(dir);
+    if (members == NULL) {
+        *count = 0;
+        return NULL;
+    }
+    qsort(members, *count, sizeof(ArchiveMember), compare_entries);
+    return members;
+}
+
+uint8_t* archive_build(const char *directory, CompressionAlgorithm compression, ThreadPool *pool, size_t *size) {
+    size_t count = 0;
+    ArchiveMember *members = directory != NULL && size != NULL ? list_directory(directory, &count) : NULL;
+    if (members == NULL) {
+        return NULL;
+    }
+    if (count == 0) {
+        LOG(ERROR, "The directory %s has no files to archive.", directory)
+        free(members);
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        members[i].directory = directory;
+        members[i].compression = compression;
+        members[i].status = JOB_OK;
+    }
+
+    uint8_t *archive = NULL;
+    if (run_members(pool, members, count, read_member_task) == JOB_OK) {
+        size_t index_size = 0;
+        uint64_t total = ARCHIVE_HEADER_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            index_size += ARCHIVE_ENTRY_SIZE + strlen(members[i].entry.name);
+            total += ARCHIVE_ENTRY_SIZE + strlen(members[i].entry.name) + members[i].entry.stored_size;
+        }
+        archive = total <= ARCHIVE_MAX_SIZE ? mem_calloc(total, 1) : NULL;
+        if (archive == NULL) {
+            LOG(ERROR, "The archive of %s (%llu bytes) does not fit in a package.", directory, (unsigned long long) total)
+        } else {
+            memcpy(archive, ARCHIVE_MAGIC, strlen(ARCHIVE_MAGIC));
+            archive[4] = ARCHIVE_VERSION;
+            store_be16(archive + 6, (uint16_t) count);
+            store_be32(archive + 8, (uint32_t) index_size);
+
+            uint8_t *entry = archive + ARCHIVE_HEADER_SIZE;
+            size_t offset = ARCHIVE_HEADER_SIZE + index_size;
+            for (size_t i = 0; i < count; i++) {
+                ArchiveEntry *member = &members[i].entry;
+                size_t name_length = strlen(member->name);
+                member->offset = (uint32_t) offset;
+                store_be32(entry, member->offset);
+                store_be32(entry + 4, member->stored_size);
+                store_be32(entry + 8, member->size);
+                store_be32(entry + 12, member->crc);
+                entry[16] = member->flags;
+                entry[17] = (uint8_t) name_length;
+                memcpy(entry + ARCHIVE_ENTRY_SIZE, member->name, name_length);
+                entry += ARCHIVE_ENTRY_SIZE + name_length;
+                memcpy(archive + offset, members[i].stored, member->stored_size);
+                offset += member->stored_size;
+                LOG(DEBUG, "[Archive] %s: %u bytes, %u stored.", member->name, member->size, member->stored_size)
+            }
+            *size = offset;
+            LOG(INFO, "[Archive] %zu files of %s in %zu bytes.", count, directory, offset)
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        mem_free(members[i].stored);
+    }
+    free(members);
+    return archive;
+}
+
+bool archive_parse_header(const uint8_t *header, size_t *count, size_t *index_size) {
+    if (header == NULL || memcmp(header, ARCHIVE_MAGIC, strlen(ARCHIVE_MAGIC)) != 0 || header[4] != ARCHIVE_VERSION) {
+        LOG(ERROR, "The hidden file is not an archive.")
+        return false;
+    }
+    *count = load_be16(header + 6);
+    *index_size = load_be32(header + 8);
+    return *count > 0 && *index_size >= *count * ARCHIVE_ENTRY_SIZE;
+}
+
+ArchiveEntry* archive_parse_index(const uint8_t *index, size_t index_size, size_t count, size_t archive_size) {
+    ArchiveEntry *entries = index != NULL && count > 0 ? mem_calloc(count, sizeof(ArchiveEntry)) : NULL;
+    if (entries == NULL) {
+        return NULL;
+    }
+    size_t position = 0;
+    size_t data_start = ARCHIVE_HEADER_SIZE + index_size;
+    for (size_t i = 0; i < count; i++) {
+        if (index_size - position < ARCHIVE_ENTRY_SIZE || index_size - position - ARCHIVE_ENTRY_SIZE < index[position + 17]) {
+            LOG(ERROR, "The archive index is truncated.")
+            mem_free(entries);
+            return NULL;
+        }
+        const uint8_t *entry = index + position;
+        ArchiveEntry *member = &entries[i];
+        member->offset = load_be32(entry);
+        member->stored_size = load_be32(entry + 4);
+        member->size = load_be32(entry + 8);
+        member->crc = load_be32(entry + 12);
+        member->flags = entry[16];
+        size_t name_length = entry[17];
+        memcpy(member->name, entry + ARCHIVE_ENTRY_SIZE, name_length);
+        member->name[name_length] = '\0';
+        position += ARCHIVE_ENTRY_SIZE + name_length;
+
+        bool inside = member->offset >= data_start && member->offset <= archive_size &&
+                      member->stored_size <= archive_size - member->offset;
+        bool sized = (member->flags & ARCHIVE_FLAG_COMPRESSED) != 0 || member->stored_size == member->size;
+        if (!inside || !sized || !valid_member_name((const char *) entry + ARCHIVE_ENTRY_SIZE, name_length)) {
+            LOG(ERROR, "Invalid archive member %zu.", i)
+            mem_free(entries);
+            return NULL;
+        }
+    }
+    return entries;
+}
+
+/**
+ * @brief Read bytes [start, start + length) of an archive hidden in a carrier, loading only the rows that hold them.
+ */
+static uint8_t* read_hidden_bytes(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t length, size_t *archive_size) {
+    FilePackage *package = extract_data_range(bmp, steg_alg, start, length, archive_size);
+    if (package == NULL || package->size != length) {
+        LOG(ERROR, "The archive in the carrier is truncated.")
+        free_file_package(package);
+        return NULL;
+    }
+    uint8_t *data = package->data;
+    package->data = NULL;
+    free_file_package(package);
+    return data;
+}
+
+static void extract_member_task(void *arg) {
+    ArchiveMember *member = arg;
+    const ArchiveEntry *entry = &member->entry;
+    double start = get_time_ms();
+
+    // Compressed members are replaced by the file, so they are always a copy
+    FilePackage stored = {entry->stored_size, NULL, NULL, COMPRESSION_NONE};
+    bool copied = true;
+    if (member->archive != NULL && (entry->flags & ARCHIVE_FLAG_COMPRESSED) == 0) {
+        stored.data = (uint8_t *) member->archive + entry->offset;
+        copied = false;
+    } else if (member->archive != NULL) {
+        stored.data = mem_alloc(entry->stored_size > 0 ? entry->stored_size : 1);
+        if (stored.data != NULL) {
+            memcpy(stored.data, member->archive + entry->offset, entry->stored_size);
+        }
+    } else if (entry->stored_size > 0) {
+        // Every worker reads through its own view of the carrier
+        BMPImage *bmp = new_bmp_file_lazy(member->carrier_path);
+        stored.data = bmp != NULL ? read_hidden_bytes(bmp, member->steg_algorithm, entry->offset, entry->stored_size, NULL) : NULL;
+        free_bmp(bmp);
+    } else {
+        stored.data = mem_alloc(1);
+    }
+    bool valid = stored.data != NULL;
+    if (valid && (entry->flags & ARCHIVE_FLAG_COMPRESSED) != 0) {
+        stored.compression = (entry->flags & ARCHIVE_FLAG_ZSTD) != 0 ? COMPRESSION_ZSTD : COMPRESSION_DEFLATE;
+        valid = decompress_file_package(&stored);
+    }
+    valid = valid && stored.size == entry->size && file_crc(stored.data, stored.size) == entry->crc;
+    member->steg_ms = get_time_ms() - start;
+    if (!valid) {
+        LOG(ERROR, "Archive member %s is corrupted.", entry->name)
+        member->status = JOB_ERROR_STEG;
+    } else {
+        start = get_time_ms();
+        char *path = join_path(member->directory, entry->name);
+        FILE *file = path != NULL ? fopen(path, "wb") : NULL;
+        bool written = file != NULL && fwrite(stored.data, 1, stored.size, file) == stored.size;
+        written = file != NULL && fclose(file) == 0 && written;
+        if (!written) {
+            LOG(ERROR, "Error writing %s.", path != NULL ? path : entry->name)
+            if (path != NULL) {
+                remove(path);
+            }
+            member->status = JOB_ERROR_OUTPUT;
+        } else {
+            LOG(INFO, "[Archive] Extracted %s (%u bytes).", path, entry->size)
+        }
+        mem_free(path);
+        member->write_ms = get_time_ms() - start;
+    }
+    if (copied) {
+        mem_free(stored.data);
+    }
+}
+
+static JobStatus embed_archive(const ProgramOptions *options, ThreadPool *pool, JobResult *result) {
+    double start = get_time_ms();
+    size_t archive_size = 0;
+    uint8_t *archive = archive_build(options->input_file, options->compression, pool, &archive_size);
+    if (archive == NULL) {
+        return JOB_ERROR_INPUT;
+    }
+    size_t size = 0;
+    uint8_t *stream = embed_data_from_buffer(archive, archive_size, ARCHIVE_EXTENSION, &size);
+    mem_free(archive);
+    BMPImage *bmp = stream != NULL ? new_bmp_file(options->input_bmp_file) : NULL;
+    result->load_ms = get_time_ms() - start;
+    if (stream == NULL) {
+        return JOB_ERROR_INPUT;
+    }
+    if (bmp == NULL) {
+        LOG(ERROR, "Error loading the BMP file.")
+        mem_free(stream);
+        return JOB_ERROR_CARRIER;
+    }
+    result->payload_bytes = size;
+
+    if (options->encryption_algo != ENC_NONE) {
+        start = get_time_ms();
+        size_t encrypted_size = 0;
+        uint8_t *encrypted = crypto_encrypt_with_kdf(stream, size, options->encryption_algo, options->encryption_mode,
+                                                     options->password, &options->kdf, &encrypted_size);
+        result->crypto_ms = get_time_ms() - start;
+        mem_free(stream);
+        if (encrypted == NULL) {
+            LOG(ERROR, "Error encrypting the data.")
+            free_bmp(bmp);
+            return JOB_ERROR_CRYPTO;
+        }
+        stream = encrypted;
+        size = encrypted_size;
+    }
+    result->stored_bytes = size;
+
+    start = get_time_ms();
+    bool embedded = embed(bmp, stream, size, options->steg_algorithm);
+    result->steg_ms = get_time_ms() - start;
+    mem_free(stream);
+    JobStatus status = JOB_OK;
+    if (!embedded) {
+        LOG(ERROR, "Error embedding the archive.")
+        status = JOB_ERROR_STEG;
+    } else {
+        start = get_time_ms();
+        if (save_bmp_file(options->output_file, bmp) != 0) {
+            LOG(ERROR, "Error saving the BMP file.")
+            status = JOB_ERROR_OUTPUT;
+        }
+        result->write_ms = get_time_ms() - start;
+    }
+    free_bmp(bmp);
+    return status;
+}
+
+/**
+ * @brief Extract and decrypt the whole archive: encrypted data cannot be read in pieces.
+ */
+static JobStatus load_encrypted_archive(const ProgramOptions *options, FilePackage **package, JobResult *result) {
+    double start = get_time_ms();
+    BMPImage *bmp = new_bmp_file(options->input_bmp_file);
+    result->load_ms = get_time_ms() - start;
+    if (bmp == NULL) {
+        LOG(ERROR, "Error loading the BMP file.")
+        return JOB_ERROR_CARRIER;
+    }
+    start = get_time_ms();
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = extract_encrypted_data(bmp, options->steg_algorithm, &encrypted_size);
+    result->steg_ms = get_time_ms() - start;
+    free_bmp(bmp);
+    if (encrypted == NULL) {
+        LOG(ERROR, "Error extracting the encrypted data.")
+        return JOB_ERROR_STEG;
+    }
+    result->stored_bytes = encrypted_size;
+
+    start = get_time_ms();
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = crypto_decrypt(encrypted, encrypted_size, options->encryption_algo, options->encryption_mode,
+                                        (const uint8_t *) options->password, &decrypted_size);
+    result->crypto_ms = get_time_ms() - start;
+    mem_free(encrypted);
+    *package = decrypted != NULL ? new_file_package_from_buffer(decrypted, decrypted_size) : NULL;
+    mem_free(decrypted);
+    if (*package == NULL) {
+        LOG(ERROR, "Error decrypting the extracted data.")
+        return JOB_ERROR_CRYPTO;
+    }
+    return JOB_OK;
+}
+
+/**
+ * @brief Keep only the members listed in `selection` (comma-separated), in index order.
+ */
+static JobStatus select_members(const ArchiveEntry *entries, size_t count, const char *selection, ArchiveMember *members,
+                                size_t *selected) {
+    *selected = 0;
+    if (selection == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            members[(*selected)++].entry = entries[i];
+        }
+        return JOB_OK;
+    }
+    char *list = strdup(selection);
+    if (list == NULL) {
+        return JOB_ERROR_ARGUMENTS;
+    }
+    bool *wanted = calloc(count, sizeof(bool));
+    JobStatus status = wanted != NULL ? JOB_OK : JOB_ERROR_ARGUMENTS;
+    char *saveptr = NULL;
+    for (char *name = strtok_r(list, ",", &saveptr); status == JOB_OK && name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+        size_t i = 0;
+        while (i < count && strcmp(entries[i].name, name) != 0) {
+            i++;
+        }
+        if (i == count) {
+            LOG(ERROR, "The archive has no member %s.", name)
+            status = JOB_ERROR_ARGUMENTS;
+        } else {
+            wanted[i] = true;
+        }
+    }
+    for (size_t i = 0; status == JOB_OK && i < count; i++) {
+        if (wanted[i]) {
+            members[(*selected)++].entry = entries[i];
+        }
+    }
+    free(wanted);
+    free(list);
+    return status;
+}
+
+static JobStatus extract_archive(const ProgramOptions *options, ThreadPool *pool, JobResult *result) {
+    FilePackage *package = NULL;
+    BMPImage *bmp = NULL;
+    uint8_t *header = NULL;
+    uint8_t *index = NULL;
+    size_t archive_size = 0;
+    JobStatus status = JOB_OK;
+
+    if (options->encryption_algo != ENC_NONE) {
+        status = load_encrypted_archive(options, &package, result);
+        if (status == JOB_OK && package->size >= ARCHIVE_HEADER_SIZE) {
+            archive_size = package->size;
+            header = package->data;
+        }
+    } else {
+        // Only the header and the index are read here; the workers read their members
+        double start = get_time_ms();
+        bmp = new_bmp_file_lazy(options->input_bmp_file);
+        result->load_ms = get_time_ms() - start;
+        status = bmp != NULL ? JOB_OK : JOB_ERROR_CARRIER;
+        header = bmp != NULL ? read_hidden_bytes(bmp, options->steg_algorithm, 0, ARCHIVE_HEADER_SIZE, &archive_size) : NULL;
+    }
+
+    size_t count = 0;
+    size_t index_size = 0;
+    if (status == JOB_OK && (header == NULL || !archive_parse_header(header, &count, &index_size) ||
+                             index_size > archive_size - ARCHIVE_HEADER_SIZE)) {
+        LOG(ERROR, "%s does not hold an archive.", options->input_bmp_file)
+        status = JOB_ERROR_STEG;
+    }
+    ArchiveEntry *entries = NULL;
+    if (status == JOB_OK) {
+        index = package != NULL ? package->data + ARCHIVE_HEADER_SIZE
+                                : read_hidden_bytes(bmp, options->steg_algorithm, ARCHIVE_HEADER_SIZE, index_size, NULL);
+        entries = index != NULL ? archive_parse_index(index, index_size, count, archive_size) : NULL;
+        status = entries != NULL ? JOB_OK : JOB_ERROR_STEG;
+    }
+    if (bmp != NULL) {
+        mem_free(header);
+        mem_free(index);
+        free_bmp(bmp);
+    }
+
+    ArchiveMember *members = NULL;
+    size_t selected = 0;
+    if (status == JOB_OK) {
+        members = calloc(count, sizeof(ArchiveMember));
+        status = members != NULL ? select_members(entries, count, options->members, members, &selected) : JOB_ERROR_STEG;
+    }
+    if (status == JOB_OK && mkdir(options->output_file, 0755) != 0 && errno != EEXIST) {
+        LOG(ERROR, "Could not create the directory %s.", options->output_file)
+        status = JOB_ERROR_OUTPUT;
+    }
+    if (status == JOB_OK) {
+        LOG(INFO, "[Archive] Extracting %zu of %zu members.", selected, count)
+        for (size_t i = 0; i < selected; i++) {
+            members[i].directory = options->output_file;
+            members[i].archive = package != NULL ? package->data : NULL;
+            members[i].carrier_path = options->input_bmp_file;
+            members[i].steg_algorithm = options->steg_algorithm;
+            members[i].status = JOB_OK;
+            result->payload_bytes += members[i].entry.size;
+        }
+        status = run_members(pool, members, selected, extract_member_task);
+
+        // Members were extracted in parallel, so the slowest one sets the stage time
+        for (size_t i = 0; i < selected; i++) {
+            result->steg_ms = members[i].steg_ms > result->steg_ms ? members[i].steg_ms : result->steg_ms;
+            result->write_ms = members[i].write_ms > result->write_ms ? members[i].write_ms : result->write_ms;
+        }
+    }
+    free(members);
+    mem_free(entries);
+    free_file_package(package);
+    return status;
+}
+
+JobStatus run_archive_job(const ProgramOptions *options, JobResult *result) {
+    JobResult job_result;
+    memset(&job_result, 0, sizeof(JobResult));
+    double start = get_time_ms();
+    job_result.status = JOB_ERROR_ARGUMENTS;
+
+    if (options == NULL || !options->archive || (options->mode != MODE_EMBED && options->mode != MODE_EXTRACT)) {
+        LOG(ERROR, "Invalid archive job.")
+    } else {
+        ThreadPool *pool = options->jobs != 1 ? thread_pool_create(options->jobs, options->pin_cpus) : NULL;
+        job_result.status = options->mode == MODE_EMBED ? embed_archive(options, pool, &job_result)
+                                                        : extract_archive(options, pool, &job_result);
+        thread_pool_destroy(pool);
+    }
+
+    job_result.total_ms = get_time_ms() - start;
+    if (result != NULL) {
+        *result = job_result;
+    }
+    return job_result.status;
+}
@@ -1,5 +1,9 @@
 
 #include "./include/arguments.h"
+#include "./include/checksum.h"
+#include "./include/compression.h"
+#include "./include/crypto.h"
+#include <errno.h>
 
 /**
  * Functon to parse strings to enums
@@ -8,6 +12,23 @@ OperationMode parse_operation_mode(const char *str);
 StegAlgorithm parse_steg_algorithm(const char *str);
 EncryptionAlgorithm parse_encryption_algorithm(const char *str);
 EncryptionMode parse_encryption_mode(const char *str);
+KdfAlgorithm parse_kdf_algorithm(const char *str);
+CompressionAlgorithm parse_compression_algorithm(const char *str);
+
+/**
+ * @brief Parse a strictly positive decimal number. Returns 1 on success, 0 otherwise.
+ */
+static int parse_positive_number(const char *str, uint64_t max, uint64_t *value);
+
+/**
+ * @brief Largest value accepted for a KDF option: the limits of crypto_kdf_valid, one parameter at a time.
+ */
+static uint64_t kdf_parameter_max(int opt);
+
+/**
+ * @brief Parse a `-range start:len` value (len strictly positive). Returns 1 on success, 0 otherwise.
+ */
+static int parse_range(const char *str, size_t *start, size_t *length);
 
 /**
  * Functions to convert enums to strings
@@ -45,11 +66,33 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
     options->input_bmp_file = NULL;
     options->output_file = NULL;
     options->steg_algorithm = STEG_NONE;
+    options->steg_auto = false;
     options->encryption_algo = ENC_NONE;
     options->encryption_mode = ENC_MODE_NONE;
     options->password[0] = '\0';
+    memset(&options->kdf, 0, sizeof(KdfParams));
+    options->kdf_target_ms = DEFAULT_KDF_TARGET_MS;
+    options->batch_file = NULL;
+    options->scan_directory = NULL;
+    options->report_file = NULL;
+    options->jobs = 0;
+    options->pin_cpus = false;
+    options->pipeline = false;
+    options->socket_path = NULL;
+    options->stripe = false;
+    options->compression = COMPRESSION_NONE;
+    options->archive = false;
+    options->members = NULL;
+    options->checksum = false;
+    options->verify_all = false;
+    options->range = false;
+    options->range_start = 0;
+    options->range_length = 0;
+    options->stream = false;
+    options->describe = false;
 
     int opt;
+    uint64_t number = 0;
     int option_index = 0;
 
     // Options definition
@@ -64,6 +107,32 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
             {"m",          required_argument, NULL,  'm' },
             {"pass",       required_argument, NULL,  'P' },
             {"loglevel",   required_argument, NULL,  'l' },
+            {"kdf",        required_argument, NULL,  'k' },
+            {"kdf-iter",   required_argument, NULL,  'I' },
+            {"kdf-n",      required_argument, NULL,  'N' },
+            {"kdf-r",      required_argument, NULL,  'R' },
+            {"kdf-p",      required_argument, NULL,  'Q' },
+            {"kdf-bench",  no_argument,       NULL,  'b' },
+            {"kdf-target", required_argument, NULL,  'T' },
+            {"batch",      required_argument, NULL,  'B' },
+            {"report",     required_argument, NULL,  'r' },
+            {"jobs",       required_argument, NULL,  'j' },
+            {"pin",        no_argument,       NULL,  'c' },
+            {"pipeline",   no_argument,       NULL,  'S' },
+            {"serve",      required_argument, NULL,  'D' },
+            {"connect",    required_argument, NULL,  'C' },
+            {"stripe",     no_argument,       NULL,  'Z' },
+            {"range",      required_argument, NULL,  'g' },
+            {"compress",   required_argument, NULL,  'z' },
+            {"archive",    no_argument,       NULL,  'A' },
+            {"member",     required_argument, NULL,  'M' },
+            {"checksum",   no_argument,       NULL,  'K' },
+            {"verify-all", no_argument,       NULL,  'V' },
+            {"stream",     no_argument,       NULL,  'W' },
+            {"describe",   no_argument,       NULL,  'H' },
+            {"peek",       no_argument,       NULL,  'E' },
+            {"scan",       required_argument, NULL,  'F' },
+            {"analyze",    no_argument,       NULL,  'Y' },
             {NULL,            0,                 NULL,   0  }
     };
 
@@ -96,7 +165,8 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
                 LOG(DEBUG, "[arguments] Output BMP file: %s", options->output_file)
                 break;
             case 's':
-                options->steg_algorithm = parse_steg_algorithm(optarg);
+                options->steg_auto = strcmp(optarg, "auto") == 0;
+                options->steg_algorithm = options->steg_auto ? STEG_NONE : parse_steg_algorithm(optarg);
                 LOG(DEBUG, "[arguments] Steganography algorithm: %s", optarg)
                 break;
             case 'a':
@@ -119,6 +189,145 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
             case 'l':
                 // Skip log level argument. Already parsed.
                 break;
+            case 'k':
+                options->kdf.algorithm = parse_kdf_algorithm(optarg);
+                if (options->kdf.algorithm == KDF_NONE) {
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                LOG(DEBUG, "[arguments] Key derivation function: %s", optarg)
+                break;
+            case 'I':
+            case 'N':
+            case 'R':
+            case 'Q':
+                // The same limits extraction applies to a container header, so nothing is embedded that cannot be read back
+                if (!parse_positive_number(optarg, kdf_parameter_max(opt), &number)) {
+                    LOG(ERROR, "Invalid KDF parameter: %s.", optarg)
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                if (opt == 'I') {
+                    options->kdf.iterations = (uint32_t) number;
+                } else if (opt == 'N') {
+                    options->kdf.scrypt_n = number;
+                } else if (opt == 'R') {
+                    options->kdf.scrypt_r = (uint32_t) number;
+                } else {
+                    options->kdf.scrypt_p = (uint32_t) number;
+                }
+                LOG(DEBUG, "[arguments] KDF parameter: %s", optarg)
+                break;
+            case 'b':
+                options->mode = MODE_KDF_BENCH;
+                LOG(DEBUG, "[arguments] KDF benchmark mode: %s", operation_mode_to_string(options->mode))
+                break;
+            case 'T':
+                if (!parse_positive_number(optarg, 60000, &number)) {
+                    LOG(ERROR, "Invalid KDF target latency: %s.", optarg)
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                options->kdf_target_ms = (double) number;
+                LOG(DEBUG, "[arguments] KDF target latency: %s ms", optarg)
+                break;
+            case 'B':
+                options->mode = MODE_BATCH;
+                options->batch_file = optarg;
+                LOG(DEBUG, "[arguments] Batch manifest: %s", options->batch_file)
+                break;
+            case 'r':
+                options->report_file = optarg;
+                LOG(DEBUG, "[arguments] Batch report: %s", options->report_file)
+                break;
+            case 'j':
+                if (!parse_positive_number(optarg, MAX_JOBS, &number)) {
+                    LOG(ERROR, "Invalid number of jobs: %s.", optarg)
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                options->jobs = (size_t) number;
+                LOG(DEBUG, "[arguments] Worker threads: %s", optarg)
+                break;
+            case 'c':
+                options->pin_cpus = true;
+                LOG(DEBUG, "[arguments] Pinning worker threads to CPUs.")
+                break;
+            case 'S':
+                options->pipeline = true;
+                LOG(DEBUG, "[arguments] Pipelined batch stages.")
+                break;
+            case 'D':
+                options->mode = MODE_SERVE;
+                options->socket_path = optarg;
+                LOG(DEBUG, "[arguments] Daemon socket: %s", options->socket_path)
+                break;
+            case 'C':
+                options->socket_path = optarg;
+                LOG(DEBUG, "[arguments] Sending the job to the daemon at %s", options->socket_path)
+                break;
+            case 'Z':
+                options->stripe = true;
+                LOG(DEBUG, "[arguments] Striping the payload over several carriers.")
+                break;
+            case 'z':
+                options->compression = parse_compression_algorithm(optarg);
+                if (options->compression == COMPRESSION_NONE) {
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                if (!compression_available(options->compression)) {
+                    LOG(ERROR, "This build does not support %s compression.", optarg)
+                    return 0;
+                }
+                LOG(DEBUG, "[arguments] Compression: %s", optarg)
+                break;
+            case 'A':
+                options->archive = true;
+                LOG(DEBUG, "[arguments] Archive of a directory.")
+                break;
+            case 'M':
+                options->members = optarg;
+                LOG(DEBUG, "[arguments] Archive members: %s", optarg)
+                break;
+            case 'K':
+                options->checksum = true;
+                LOG(DEBUG, "[arguments] Checksummed chunks.")
+                break;
+            case 'V':
+                options->verify_all = true;
+                LOG(DEBUG, "[arguments] Verifying every chunk.")
+                break;
+            case 'W':
+                options->stream = true;
+                LOG(DEBUG, "[arguments] Streaming the payload.")
+                break;
+            case 'H':
+                options->describe = true;
+                LOG(DEBUG, "[arguments] Writing a descriptor.")
+                break;
+            case 'E':
+                options->mode = MODE_PEEK;
+                LOG(DEBUG, "[arguments] Peek mode: %s", operation_mode_to_string(options->mode))
+                break;
+            case 'F':
+                options->mode = MODE_SCAN;
+                options->scan_directory = optarg;
+                LOG(DEBUG, "[arguments] Scanning directory: %s", options->scan_directory)
+                break;
+            case 'Y':
+                options->mode = MODE_ANALYZE;
+                LOG(DEBUG, "[arguments] Analyze mode: %s", operation_mode_to_string(options->mode))
+                break;
+            case 'g':
+                if (!parse_range(optarg, &options->range_start, &options->range_length)) {
+                    LOG(ERROR, "Invalid range: %s. Expected start:length.", optarg)
+                    print_usage(argv[0]);
+                    return 0;
+                }
+                options->range = true;
+                LOG(DEBUG, "[arguments] Extracting %zu bytes from byte %zu.", options->range_length, options->range_start)
+                break;
             default:
                 print_usage(argv[0]);
                 return 0;
@@ -126,11 +335,47 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
     }
     LOG(DEBUG, "[arguments] Parsed command line arguments successfully.")
 
-    // Validated required arguments
+    // The KDF benchmark and the daemon do not need any file, batch jobs are validated line by line and a scan only reads
+    if (options->mode == MODE_KDF_BENCH || options->mode == MODE_BATCH || options->mode == MODE_SERVE || options->mode == MODE_SCAN) {
+        LOG(DEBUG, "[arguments] All validations passed.")
+        return 1;
+    }
+
+    // -analyze only reads the carrier, whatever it hides
+    if (options->mode == MODE_ANALYZE) {
+        if (options->input_bmp_file == NULL || options->stripe || options->stream || options->archive || options->range) {
+            LOG(ERROR, "-analyze needs a single carrier with -p and cannot be combined with -stripe, -stream, -archive or -range.")
+            print_usage(argv[0]);
+            return 0;
+        }
+        LOG(DEBUG, "[arguments] All validations passed.")
+        return 1;
+    }
+
+    if (options->steg_auto && (options->mode != MODE_EXTRACT || options->stripe || options->stream)) {
+        LOG(ERROR, "-steg auto can only be used when extracting from a single carrier without -stream.")
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    // -peek only reads the carrier
+    if (options->mode == MODE_PEEK) {
+        if (options->input_bmp_file == NULL || options->stripe || options->stream || options->archive || options->range) {
+            LOG(ERROR, "-peek needs a single carrier with -p and cannot be combined with -stripe, -stream, -archive or -range.")
+            print_usage(argv[0]);
+            return 0;
+        }
+        LOG(DEBUG, "[arguments] All validations passed.")
+        return 1;
+    }
+
+    // Validated required arguments. A single carrier being extracted may leave -steg out: the job reads
+    // it from the carrier's descriptor, or detects it with -steg auto
+    bool steg_from_carrier = options->mode == MODE_EXTRACT && !options->stripe && !options->stream && !options->archive;
     if( options->mode == MODE_NONE ||
         options->input_bmp_file == NULL ||
         options->output_file == NULL ||
-        options->steg_algorithm == STEG_NONE)
+        (options->steg_algorithm == STEG_NONE && !steg_from_carrier))
     {
         LOG(ERROR, "Missing required arguments.")
         print_usage(argv[0]);
@@ -144,11 +389,101 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
         return 0;
     }
 
+    if (options->range && (options->mode != MODE_EXTRACT || options->stripe)) {
+        LOG(ERROR, "-range can only be used when extracting from a single carrier.")
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    if (options->archive && (options->stripe || options->range)) {
+        LOG(ERROR, "-archive cannot be combined with -stripe or -range.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->members != NULL && (!options->archive || options->mode != MODE_EXTRACT)) {
+        LOG(ERROR, "-member can only be used when extracting an archive.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->checksum && options->archive) {
+        LOG(ERROR, "-checksum cannot be combined with -archive: archive members carry their own CRC.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->describe && (options->stream || options->stripe || options->archive)) {
+        LOG(ERROR, "-describe cannot be combined with -stream, -stripe or -archive.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->stream && options->steg_algorithm != STEG_LSB1 && options->steg_algorithm != STEG_LSB4) {
+        LOG(ERROR, "-stream only supports LSB1 and LSB4.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->stream && (strlen(options->password) > 0 || options->compression != COMPRESSION_NONE || options->checksum ||
+                            options->range || options->stripe || options->archive)) {
+        LOG(ERROR, "-stream stores the file as it is: it cannot be combined with -pass, -compress, -checksum, -range, -stripe or -archive.")
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    // KDF parameters without -kdf select the function they belong to
+    int scrypt_params = options->kdf.scrypt_n != 0 || options->kdf.scrypt_r != 0 || options->kdf.scrypt_p != 0;
+    if (options->kdf.algorithm == KDF_NONE && (scrypt_params || options->kdf.iterations != 0)) {
+        options->kdf.algorithm = scrypt_params ? KDF_SCRYPT : KDF_PBKDF2_SHA256;
+    }
+    if ((options->kdf.algorithm == KDF_SCRYPT && options->kdf.iterations != 0) ||
+        ((options->kdf.algorithm == KDF_PBKDF2_SHA256 || options->kdf.algorithm == KDF_PBKDF2_SHA512) && scrypt_params)) {
+        LOG(ERROR, "KDF parameters do not match the selected function: %s.", kdf_algorithm_to_string(options->kdf.algorithm))
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->kdf.scrypt_n != 0 && (options->kdf.scrypt_n < 2 || (options->kdf.scrypt_n & (options->kdf.scrypt_n - 1)) != 0)) {
+        LOG(ERROR, "-kdf-n must be a power of two greater than 1.")
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->kdf.algorithm != KDF_NONE && !crypto_kdf_valid(&options->kdf)) {
+        LOG(ERROR, "-kdf-r * -kdf-p must be below %d.", CRYPTO_SCRYPT_MAX_RP)
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->mode == MODE_EXTRACT && options->compression != COMPRESSION_NONE) {
+        LOG(WARNING, "[arguments] Compressed payloads are detected when extracting. Ignoring -compress.")
+        options->compression = COMPRESSION_NONE;
+    }
+    if (options->mode == MODE_EXTRACT && options->checksum) {
+        LOG(WARNING, "[arguments] Checksummed payloads are detected when extracting. Ignoring -checksum.")
+        options->checksum = false;
+    }
+    if (options->mode == MODE_EXTRACT && options->describe) {
+        LOG(WARNING, "[arguments] Descriptors are read when -steg is not given. Ignoring -describe.")
+        options->describe = false;
+    }
+    if (options->mode == MODE_EMBED && options->verify_all) {
+        LOG(WARNING, "[arguments] -verify-all only applies when extracting. Ignoring it.")
+        options->verify_all = false;
+    }
+    if (options->mode == MODE_EXTRACT && options->kdf.algorithm != KDF_NONE) {
+        LOG(WARNING, "[arguments] KDF options are read from the encrypted header when extracting. Ignoring them.")
+        memset(&options->kdf, 0, sizeof(KdfParams));
+    }
+
     // If not password passed, set algorithm and mode to none
     if(strlen(options->password) == 0) {
         options->encryption_algo = ENC_NONE;
         options->encryption_mode = ENC_MODE_NONE;
+        memset(&options->kdf, 0, sizeof(KdfParams));
         LOG(WARNING, "[arguments] No password passed. Setting encryption algorithm and mode to none.")
+    }else if (options->encryption_algo == ENC_CHACHA20) {
+        // ChaCha20 is only used as ChaCha20-Poly1305, so the mode is implicit
+        if (options->encryption_mode != ENC_MODE_NONE) {
+            LOG(WARNING, "[arguments] chacha20 does not take an encryption mode. Ignoring: %s", encryption_mode_to_string(options->encryption_mode))
+        }
+        options->encryption_mode = ENC_MODE_NONE;
+    }else if (steg_from_carrier && options->steg_algorithm == STEG_NONE && !options->steg_auto) {
+        // The descriptor of the carrier gives the cipher and mode that were not
+        LOG(DEBUG, "[arguments] Encryption options left to the descriptor.")
     }else{
         // Set default values for encryption algorithm and mode, and log level
         if (options->encryption_algo == ENC_NONE) {
@@ -159,6 +494,11 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options) {
             options->encryption_mode = DEFAULT_ENCRYPTION_MODE;
             LOG(WARNING, "[arguments] No encryption mode specified. Using default: %s", encryption_mode_to_string(DEFAULT_ENCRYPTION_MODE))
         }
+        if ((options->encryption_mode == ENC_MODE_GCM || options->encryption_mode == ENC_MODE_CTR) && options->encryption_algo == ENC_3DES) {
+            LOG(ERROR, "%s mode requires an AES encryption algorithm.", encryption_mode_to_string(options->encryption_mode))
+            print_usage(argv[0]);
+            return 0;
+        }
     }
 
     LOG(DEBUG, "[arguments] All validations passed.")
@@ -197,6 +537,36 @@ void log_program_options(const ProgramOptions *options) {
     LOG(INFO, "\t |-> Steganography algorithm: %s", steg_algorithm_to_string(options->steg_algorithm))
     LOG(DEBUG, "\t |-> Encryption algorithm: %s", encryption_algorithm_to_string(options->encryption_algo))
     LOG(DEBUG, "\t |-> Encryption mode: %s", encryption_mode_to_string(options->encryption_mode))
+    if (options->kdf.algorithm != KDF_NONE) {
+        LOG(DEBUG, "\t |-> Key derivation function: %s", kdf_algorithm_to_string(options->kdf.algorithm))
+    }
+    if (options->jobs != 0) {
+        LOG(DEBUG, "\t |-> Worker threads: %zu%s", options->jobs, options->pin_cpus ? " (pinned)" : "")
+    }
+    if (options->stripe) {
+        LOG(INFO, "\t |-> Striped over several carriers")
+    }
+    if (options->compression != COMPRESSION_NONE) {
+        LOG(INFO, "\t |-> Compression: %s", compression_algorithm_to_string(options->compression))
+    }
+    if (options->checksum) {
+        LOG(INFO, "\t |-> Checksummed chunks of %d bytes", CHECKSUM_CHUNK_SIZE)
+    }
+    if (options->verify_all) {
+        LOG(INFO, "\t |-> Verifying every chunk")
+    }
+    if (options->archive) {
+        LOG(INFO, "\t |-> Archive%s%s", options->members != NULL ? " members: " : "", options->members != NULL ? options->members : "")
+    }
+    if (options->range) {
+        LOG(INFO, "\t |-> Range: %zu bytes from byte %zu", options->range_length, options->range_start)
+    }
+    if (options->stream) {
+        LOG(INFO, "\t |-> Streamed one window of rows at a time")
+    }
+    if (options->describe) {
+        LOG(INFO, "\t |-> Descriptor in the last rows of the carrier")
+    }
 
     if (strlen(options->password) > 0) {
         LOG(INFO, "\t |-> Password: %s", options->password)
@@ -240,12 +610,59 @@ void print_usage(const char *program_name) {
     printf("  -extract                Extraer información de un archivo BMP.\n");
     printf("  -p <bitmapfile>         Archivo BMP portador.\n");
     printf("  -out <file>             Archivo de salida obtenido.\n");
-    printf("  -steg <LSB1|LSB4|LSBI>  Algoritmo de esteganografía.\n");
+    printf("  -steg <LSB1|LSB4|LSBI|auto>\n");
+    printf("                          Algoritmo de esteganografía. auto lo detecta leyendo solo el campo de tamaño.\n");
     printf("\nOpcionales:\n");
-    printf("  -a <aes128 | aes192 | aes256 | 3des>      Algoritmo de encriptación. Default: %s\n", encryption_algorithm_to_string(DEFAULT_ENCRYPTION_ALGO));
-    printf("  -m <ecb | cfb | ofb | cbc>                Modo de encriptación. Default: %s\n", encryption_mode_to_string(DEFAULT_ENCRYPTION_MODE));
-    printf("  -pass <password>                          Contraseña para la encriptación.\n");
-    printf("  -loglevel <DEBUG | INFO | ERROR | FATAL>  Nivel de log. Default: %s\n", log_level_to_string(DEFAULT_LOG_LEVEL));
+    printf("  -a <aes128 | aes192 | aes256 | 3des | chacha20>  Algoritmo de encriptación. Default: %s\n", encryption_algorithm_to_string(DEFAULT_ENCRYPTION_ALGO));
+    printf("  -m <ecb | cfb | cfb1 | cfb8 | cfb128 | ofb | cbc | ctr | gcm>\n");
+    printf("                                                   Modo de encriptación. Default: %s\n", encryption_mode_to_string(DEFAULT_ENCRYPTION_MODE));
+    printf("                                                   cfb = cfb1 con AES y cfb8 con 3DES (compatible con imágenes existentes).\n");
+    printf("  -pass <password>                                 Contraseña para la encriptación.\n");
+    printf("  -loglevel <DEBUG | INFO | ERROR | FATAL>         Nivel de log. Default: %s\n", log_level_to_string(DEFAULT_LOG_LEVEL));
+    printf("  -compress <deflate | zstd>                       Comprime el archivo antes de ocultarlo (zstd si se compiló con libzstd).\n");
+    printf("                                                   Al extraer se detecta solo.\n");
+    printf("  -checksum                                        Divide el archivo en bloques de 64 KB con un CRC32C cada uno; al extraer se detecta solo\n");
+    printf("                                                   y se informa qué bytes están dañados.\n");
+    printf("  -verify-all                                      Al extraer, verifica todos los bloques en lugar de detenerse en el primero dañado.\n");
+    printf("\nDerivación de clave (solo al ocultar, la extracción la lee del encabezado):\n");
+    printf("  -kdf <pbkdf2 | pbkdf2-sha512 | scrypt>           KDF explícito. Usa el contenedor versionado con sal aleatoria.\n");
+    printf("  -kdf-iter <n>                                    Iteraciones de PBKDF2 (hasta %d).\n", CRYPTO_KDF_MAX_ITERATIONS);
+    printf("  -kdf-n <n> -kdf-r <r> -kdf-p <p>                 Parámetros de scrypt (N potencia de 2 hasta 2^%d, r * p < %d).\n", CRYPTO_SCRYPT_MAX_LOG_N, CRYPTO_SCRYPT_MAX_RP);
+    printf("\nProcesamiento por lotes:\n");
+    printf("  -batch <manifest.tsv>                            Ejecuta un trabajo embed/extract por línea del manifiesto.\n");
+    printf("  -report <file.tsv>                               Reporte por trabajo (estado, tiempos, bytes). Default: stdout\n");
+    printf("  -jobs <n>                                        Threads de trabajo; los trabajos grandes se dividen en fragmentos. Default: uno por CPU\n");
+    printf("  -pin                                             Fija cada thread de trabajo a una CPU.\n");
+    printf("  -pipeline                                        Ejecuta los lotes por etapas (lectura, cifrado, ocultamiento, escritura) con -jobs threads por etapa.\n");
+    printf("                                                   Los payloads LSB1/LSB4 grandes se reparten como sin -pipeline; los portadores no se guardan en caché.\n");
+    printf("\nVarios portadores:\n");
+    printf("  -stripe                                          Reparte el archivo entre los portadores de -p (separados por comas) según su capacidad.\n");
+    printf("                                                   Al ocultar, -out lista una salida por portador; al extraer, los portadores pueden ir en cualquier orden.\n");
+    printf("\nArchivos múltiples:\n");
+    printf("  -archive                                         Oculta todos los archivos del directorio -in en un portador; al extraer, -out es el directorio destino.\n");
+    printf("  -member <nombre[,nombre...]>                     Extrae solo esos archivos del archivo múltiple, leyendo del portador solo el índice y sus filas.\n");
+    printf("\nExtracción parcial:\n");
+    printf("  -range <inicio:largo>                            Extrae solo esos bytes del archivo oculto, leyendo del portador solo las filas que los guardan.\n");
+    printf("                                                   Con contraseña se descifra todo y se recorta.\n");
+    printf("\nDescriptor:\n");
+    printf("  -describe                                        Guarda en las últimas filas del portador el algoritmo, el cifrado y la compresión usados,\n");
+    printf("                                                   para extraer sin -steg ni -a/-m (con -pass si está cifrado).\n");
+    printf("\nInspección:\n");
+    printf("  -peek                                            Muestra el algoritmo, el tamaño y la extensión de lo oculto en -p sin extraerlo.\n");
+    printf("                                                   Sin -steg prueba LSB1, LSB4 y LSBI.\n");
+    printf("  -scan <directorio>                               Revisa todos los archivos del árbol y lista los BMP que probablemente ocultan algo,\n");
+    printf("                                                   los más probables primero (usa -jobs, -pin y -report).\n");
+    printf("  -analyze                                         Estima por canal qué parte de los LSB de -p fue reemplazada (chi-cuadrado y RS),\n");
+    printf("                                                   para auditar qué tan detectable es un portador (usa -jobs, -pin y -report).\n");
+    printf("\nArchivos grandes:\n");
+    printf("  -stream                                          Lee y escribe el portador por ventanas de filas, sin cargar la imagen ni el archivo en memoria.\n");
+    printf("                                                   Archivos de más de 4 GB usan un encabezado de 64 bits. Solo LSB1 y LSB4, sin -pass, -compress ni -checksum.\n");
+    printf("\nServicio local:\n");
+    printf("  -serve <socket>                                  Atiende trabajos embed/extract en un socket Unix (usa -jobs y -pin).\n");
+    printf("  -connect <socket>                                Envía el trabajo embed/extract al servicio en lugar de ejecutarlo.\n");
+    printf("\nCalibración del KDF:\n");
+    printf("  -kdf-bench                                       Mide los KDF y recomienda parámetros.\n");
+    printf("  -kdf-target <ms>                                 Latencia objetivo por derivación. Default: %d\n", DEFAULT_KDF_TARGET_MS);
     printf("\n");
 }
 
@@ -282,6 +699,8 @@ EncryptionAlgorithm parse_encryption_algorithm(const char *str) {
         return ENC_AES256;
     } else if (strcmp(str, "3des") == 0) {
         return ENC_3DES;
+    } else if (strcmp(str, "chacha20") == 0) {
+        return ENC_CHACHA20;
     } else {
         LOG(ERROR, "Invalid encryption algorithm: %s.", str)
         return ENC_NONE;
@@ -293,20 +712,99 @@ EncryptionMode parse_encryption_mode(const char *str) {
         return ENC_MODE_ECB;
     } else if (strcmp(str, "cfb") == 0) {
         return ENC_MODE_CFB;
+    } else if (strcmp(str, "cfb1") == 0) {
+        return ENC_MODE_CFB1;
+    } else if (strcmp(str, "cfb8") == 0) {
+        return ENC_MODE_CFB8;
+    } else if (strcmp(str, "cfb128") == 0) {
+        return ENC_MODE_CFB128;
     } else if (strcmp(str, "ofb") == 0) {
         return ENC_MODE_OFB;
     } else if (strcmp(str, "cbc") == 0) {
         return ENC_MODE_CBC;
+    } else if (strcmp(str, "gcm") == 0) {
+        return ENC_MODE_GCM;
+    } else if (strcmp(str, "ctr") == 0) {
+        return ENC_MODE_CTR;
     } else {
         LOG(ERROR, "Invalid encryption mode: %s.", str)
         return ENC_MODE_NONE;
     }
 }
 
+KdfAlgorithm parse_kdf_algorithm(const char *str) {
+    if (strcmp(str, "pbkdf2") == 0 || strcmp(str, "pbkdf2-sha256") == 0) {
+        return KDF_PBKDF2_SHA256;
+    } else if (strcmp(str, "pbkdf2-sha512") == 0) {
+        return KDF_PBKDF2_SHA512;
+    } else if (strcmp(str, "scrypt") == 0) {
+        return KDF_SCRYPT;
+    } else {
+        LOG(ERROR, "Invalid key derivation function: %s.", str)
+        return KDF_NONE;
+    }
+}
+
+CompressionAlgorithm parse_compression_algorithm(const char *str) {
+    if (strcmp(str, "deflate") == 0 || strcmp(str, "zlib") == 0) {
+        return COMPRESSION_DEFLATE;
+    } else if (strcmp(str, "zstd") == 0) {
+        return COMPRESSION_ZSTD;
+    } else {
+        LOG(ERROR, "Invalid compression algorithm: %s.", str)
+        return COMPRESSION_NONE;
+    }
+}
+
+static int parse_positive_number(const char *str, uint64_t max, uint64_t *value) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || str[0] == '-' || parsed == 0 || parsed > max) {
+        return 0;
+    }
+    *value = parsed;
+    return 1;
+}
+
+static uint64_t kdf_parameter_max(int opt) {
+    switch (opt) {
+        case 'I': return CRYPTO_KDF_MAX_ITERATIONS;
+        case 'N': return (uint64_t) 1 << CRYPTO_SCRYPT_MAX_LOG_N;
+        default: return CRYPTO_SCRYPT_MAX_RP - 1;
+    }
+}
+
+static int parse_range(const char *str, size_t *start, size_t *length) {
+    const char *separator = strchr(str, ':');
+    if (separator == NULL || separator == str || str[0] == '-') {
+        return 0;
+    }
+    char *end = NULL;
+    errno = 0;
+    unsigned long long parsed_start = strtoull(str, &end, 10);
+    if (errno != 0 || end != separator || parsed_start > SIZE_MAX) {
+        return 0;
+    }
+    uint64_t parsed_length = 0;
+    if (!parse_positive_number(separator + 1, SIZE_MAX, &parsed_length)) {
+        return 0;
+    }
+    *start = (size_t) parsed_start;
+    *length = (size_t) parsed_length;
+    return 1;
+}
+
 const char* operation_mode_to_string(OperationMode mode) {
     switch (mode) {
         case MODE_EMBED: return "embed";
         case MODE_EXTRACT: return "extract";
+        case MODE_KDF_BENCH: return "kdf-bench";
+        case MODE_BATCH: return "batch";
+        case MODE_SERVE: return "serve";
+        case MODE_PEEK: return "peek";
+        case MODE_SCAN: return "scan";
+        case MODE_ANALYZE: return "analyze";
         default: return "UNKNOWN";
     }
 }
@@ -326,6 +824,7 @@ const char* encryption_algorithm_to_string(EncryptionAlgorithm alg) {
         case ENC_AES192: return "aes192";
         case ENC_AES256: return "aes256";
         case ENC_3DES: return "3des";
+        case ENC_CHACHA20: return "chacha20";
         default: return "UNKNOWN";
     }
 }
@@ -336,6 +835,20 @@ const char* encryption_mode_to_string(EncryptionMode mode) {
         case ENC_MODE_CFB: return "cfb";
         case ENC_MODE_OFB: return "ofb";
         case ENC_MODE_CBC: return "cbc";
+        case ENC_MODE_GCM: return "gcm";
+        case ENC_MODE_CFB1: return "cfb1";
+        case ENC_MODE_CFB8: return "cfb8";
+        case ENC_MODE_CFB128: return "cfb128";
+        case ENC_MODE_CTR: return "ctr";
+        default: return "UNKNOWN";
+    }
+}
+
+const char* kdf_algorithm_to_string(KdfAlgorithm kdf) {
+    switch (kdf) {
+        case KDF_PBKDF2_SHA256: return "pbkdf2";
+        case KDF_PBKDF2_SHA512: return "pbkdf2-sha512";
+        case KDF_SCRYPT: return "scrypt";
         default: return "UNKNOWN";
     }
 }
@@ -0,0 +1,844 @@
+#include "./include/batch.h"
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "./include/bounded_queue.h"
+#include "./include/crypto.h"
+#include "./include/pixel_pool.h"
+#include "./include/thread_pool.h"
+
+#define PATH_TABLE_INITIAL_CAPACITY 64   // Initial slots of the path table (grows at 70% load)
+#define BATCH_QUEUE_DEPTH 4              // Jobs that can wait between two pipeline stages
+#define NO_JOB ((size_t) -1)
+
+// Column names used when the manifest has no header line
+static const char *default_columns[] = {"mode", "in", "p", "out", "steg", "a", "m", "pass"};
+
+/**
+ * @brief Split a line in place on tabs. Returns the number of fields.
+ */
+static size_t split_fields(char *line, char **fields, size_t max_fields) {
+    size_t count = 0;
+    char *cursor = line;
+    while (count < max_fields) {
+        fields[count++] = cursor;
+        char *tab = strchr(cursor, '\t');
+        if (tab == NULL) {
+            break;
+        }
+        *tab = '\0';
+        cursor = tab + 1;
+    }
+    return count;
+}
+
+/**
+ * @brief Remove the trailing newline (and carriage return) of a line.
+ */
+static void trim_line(char *line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        line[--len] = '\0';
+    }
+}
+
+/**
+ * @brief Build the argument vector for a manifest line and parse it with the CLI rules.
+ *
+ * The option strings ("-in", "-p", ...) are written to `option_names`, which must outlive `options`.
+ *
+ * @return int 1 if the line describes a valid embed or extract job, 0 otherwise.
+ */
+static int parse_manifest_line(char **columns, size_t column_count, char **fields, size_t field_count,
+                               char option_names[][32], ProgramOptions *options) {
+    char *argv[2 * BATCH_MAX_COLUMNS + 1];
+    int argc = 0;
+    argv[argc++] = "stegobmp";
+
+    for (size_t i = 0; i < field_count && i < column_count; i++) {
+        if (fields[i][0] == '\0' || strcmp(fields[i], "-") == 0) {
+            continue;
+        }
+        if (strcmp(columns[i], "mode") == 0) {
+            // The mode column holds the flag itself: embed -> -embed
+            snprintf(option_names[i], 32, "-%s", fields[i]);
+            argv[argc++] = option_names[i];
+        } else {
+            snprintf(option_names[i], 32, "-%s", columns[i]);
+            argv[argc++] = option_names[i];
+            argv[argc++] = fields[i];
+        }
+    }
+
+    // parse_arguments resets the log level when -loglevel is absent, keep the one of the batch run
+    LogLevel saved_level = log_level;
+    optind = 1;
+    int ok = parse_arguments(argc, argv, options);
+    set_log_level(saved_level);
+
+    if (ok && options->mode != MODE_EMBED && options->mode != MODE_EXTRACT) {
+        LOG(ERROR, "[Batch] Manifest lines must be embed or extract jobs.")
+        return 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief One manifest line. The options point into `line` and `option_names`.
+ */
+typedef struct BatchJob {
+    size_t line_number;
+    char *line;
+    char option_names[BATCH_MAX_COLUMNS][32];
+    ProgramOptions options;
+    bool valid;
+    JobResult result;
+    JobState state;             // Pipeline mode: the job while it moves between stages
+    struct BatchRun *run;
+    size_t waiting;             // Unfinished jobs that must run before this one (guarded by the run lock)
+    size_t *dependents;         // Jobs waiting for this one
+    size_t dependent_count;
+    size_t dependent_capacity;
+} BatchJob;
+
+typedef struct BatchRun {
+    BatchJob *jobs;
+    size_t count;
+    ThreadPool *pool;
+    TaskGroup group;
+    JobCarrierCache *caches;    // One per worker, so a worker keeps reusing the carrier of its previous job
+    bool *cache_busy;           // A worker waiting for its chunks may run another job, which must not touch the cache
+    pthread_mutex_t lock;
+    pthread_cond_t job_done;    // Pipeline mode: the loader waits on it for the jobs a line depends on
+    size_t crypto_threads;      // Crypto thread limit of the threads running jobs (crypto_set_max_threads)
+} BatchRun;
+
+struct Pipeline;
+
+/**
+ * @brief One stage of the pipeline: its threads take jobs from `input` and pass them to `output`.
+ */
+typedef struct {
+    struct Pipeline *pipeline;
+    JobStage stage;
+    size_t threads;
+    BoundedQueue *input;        // NULL for the load stage, which walks the manifest
+    BoundedQueue *output;       // NULL for the write stage, which completes the jobs
+    size_t next_threads;        // Threads of the next stage; each one stops on its own end marker
+    atomic_size_t running;      // Threads of this stage that have not finished
+    pthread_mutex_t lock;       // Guards the counters below
+    size_t jobs;
+    double busy_ms;             // Time spent running the stage
+    double input_wait_ms;       // Time waiting for work (or, in the load stage, for the lines a job depends on)
+    double output_wait_ms;      // Time blocked on a full output queue
+    size_t depth_sum;           // Input queue depth seen before each pop
+    size_t depth_samples;
+    size_t depth_max;
+} PipelineStage;
+
+typedef struct Pipeline {
+    BatchRun *run;
+    PipelineStage stages[JOB_STAGE_COUNT];
+} Pipeline;
+
+/**
+ * @brief Jobs that touched a path so far: the last writer and the readers since then.
+ */
+typedef struct {
+    char *key;
+    size_t writer;
+    size_t *readers;
+    size_t reader_count;
+    size_t reader_capacity;
+} PathEntry;
+
+typedef struct {
+    PathEntry *entries;
+    size_t capacity;
+    size_t count;
+} PathTable;
+
+static bool append_index(size_t **items, size_t *count, size_t *capacity, size_t value) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 4;
+        size_t *grown = realloc(*items, new_capacity * sizeof(size_t));
+        if (grown == NULL) {
+            return false;
+        }
+        *items = grown;
+        *capacity = new_capacity;
+    }
+    (*items)[(*count)++] = value;
+    return true;
+}
+
+static size_t hash_path(const char *key) {
+    size_t hash = 14695981039346656037ULL;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (unsigned char) *key) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Find the entry of a path, adding an empty one if it is not in the table.
+ */
+static PathEntry* path_table_get(PathTable *table, const char *key) {
+    if ((table->count + 1) * 10 > table->capacity * 7) {
+        size_t capacity = table->capacity ? table->capacity * 2 : PATH_TABLE_INITIAL_CAPACITY;
+        PathEntry *entries = calloc(capacity, sizeof(PathEntry));
+        if (entries == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->entries[i].key == NULL) {
+                continue;
+            }
+            size_t slot = hash_path(table->entries[i].key) % capacity;
+            while (entries[slot].key != NULL) {
+                slot = (slot + 1) % capacity;
+            }
+            entries[slot] = table->entries[i];
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    size_t slot = hash_path(key) % table->capacity;
+    while (table->entries[slot].key != NULL) {
+        if (strcmp(table->entries[slot].key, key) == 0) {
+            return &table->entries[slot];
+        }
+        slot = (slot + 1) % table->capacity;
+    }
+    PathEntry *entry = &table->entries[slot];
+    entry->key = strdup(key);
+    if (entry->key == NULL) {
+        return NULL;
+    }
+    entry->writer = NO_JOB;
+    table->count++;
+    return entry;
+}
+
+static void free_path_table(PathTable *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].key);
+        free(table->entries[i].readers);
+    }
+    free(table->entries);
+}
+
+/**
+ * @brief Fill the table keys of a path: the path itself and the path without its extension.
+ *
+ * Extract jobs write `out` plus the extension stored in the carrier, so `out` must match `out.txt`.
+ * Keying every path by both forms may order a few independent jobs, but never misses a conflict.
+ *
+ * @return size_t Number of keys (1 or 2).
+ */
+static size_t path_keys(const char *path, char keys[2][PATH_MAX]) {
+    snprintf(keys[0], PATH_MAX, "%s", path);
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (dot == NULL || dot == path || (slash != NULL && dot < slash)) {
+        return 1;
+    }
+    snprintf(keys[1], PATH_MAX, "%.*s", (int) (dot - path), path);
+    return 2;
+}
+
+static bool add_dependency(BatchJob *jobs, size_t before, size_t after) {
+    if (before == NO_JOB || before == after) {
+        return true;
+    }
+    jobs[after].waiting++;
+    return append_index(&jobs[before].dependents, &jobs[before].dependent_count, &jobs[before].dependent_capacity, after);
+}
+
+/**
+ * @brief Order the jobs that share files: a job runs after the earlier jobs that write what it
+ * reads or writes, and after the earlier jobs that read what it writes. Everything else may run
+ * in any order.
+ */
+static bool build_dependencies(BatchJob *jobs, size_t count) {
+    PathTable table = {0};
+    bool ok = true;
+    char keys[2][PATH_MAX];
+
+    for (size_t i = 0; i < count && ok; i++) {
+        if (!jobs[i].valid) {
+            continue;
+        }
+        const char *reads[] = {jobs[i].options.input_bmp_file, jobs[i].options.input_file};
+        size_t read_count = sizeof(reads) / sizeof(reads[0]);
+
+        // Read after write
+        for (size_t r = 0; r < read_count && ok; r++) {
+            size_t key_count = reads[r] != NULL ? path_keys(reads[r], keys) : 0;
+            for (size_t k = 0; k < key_count && ok; k++) {
+                PathEntry *entry = path_table_get(&table, keys[k]);
+                ok = entry != NULL && add_dependency(jobs, entry->writer, i);
+            }
+        }
+
+        // Write after write and write after read
+        size_t key_count = path_keys(jobs[i].options.output_file, keys);
+        for (size_t k = 0; k < key_count && ok; k++) {
+            PathEntry *entry = path_table_get(&table, keys[k]);
+            ok = entry != NULL && add_dependency(jobs, entry->writer, i);
+            for (size_t j = 0; ok && j < entry->reader_count; j++) {
+                ok = add_dependency(jobs, entry->readers[j], i);
+            }
+            if (ok) {
+                entry->writer = i;
+                entry->reader_count = 0;
+            }
+        }
+
+        for (size_t r = 0; r < read_count && ok; r++) {
+            key_count = reads[r] != NULL ? path_keys(reads[r], keys) : 0;
+            for (size_t k = 0; k < key_count && ok; k++) {
+                PathEntry *entry = path_table_get(&table, keys[k]);
+                ok = entry != NULL && append_index(&entry->readers, &entry->reader_count, &entry->reader_capacity, i);
+            }
+        }
+    }
+
+    free_path_table(&table);
+    if (!ok) {
+        LOG(ERROR, "Memory allocation failed for the batch job dependencies.")
+    }
+    return ok;
+}
+
+static void run_job_task(void *arg);
+
+/**
+ * @brief Queue jobs in reverse order, so a worker pops them (LIFO) in manifest order.
+ */
+static void submit_jobs(BatchRun *run, const size_t *indices, size_t count, bool spread) {
+    size_t workers = thread_pool_size(run->pool);
+    for (size_t i = count; i-- > 0;) {
+        // Contiguous blocks per worker keep consecutive jobs (often on the same carrier) together
+        size_t worker = spread ? i * workers / count : THREAD_POOL_ANY_WORKER;
+        if (!thread_pool_submit(run->pool, worker, &run->group, run_job_task, &run->jobs[indices[i]])) {
+            run_job_task(&run->jobs[indices[i]]);
+        }
+    }
+}
+
+static void run_job_task(void *arg) {
+    BatchJob *job = arg;
+    BatchRun *run = job->run;
+
+    size_t worker = thread_pool_current_worker(run->pool);
+    JobCarrierCache *cache = NULL;
+    if (worker != THREAD_POOL_ANY_WORKER && !run->cache_busy[worker]) {
+        cache = &run->caches[worker];
+        run->cache_busy[worker] = true;
+    }
+    size_t crypto_threads = crypto_set_max_threads(run->crypto_threads);
+    run_stego_job(&job->options, cache, run->pool, &job->result);
+    crypto_set_max_threads(crypto_threads);
+    memset(job->options.password, 0, sizeof(job->options.password));
+    if (cache != NULL) {
+        run->cache_busy[worker] = false;
+    }
+
+    // Release the jobs that were waiting for this one; they go to this worker's deque
+    size_t ready_stack[16];
+    size_t *ready = job->dependent_count <= 16 ? ready_stack : malloc(job->dependent_count * sizeof(size_t));
+    size_t ready_count = 0;
+    pthread_mutex_lock(&run->lock);
+    for (size_t i = 0; i < job->dependent_count; i++) {
+        BatchJob *dependent = &run->jobs[job->dependents[i]];
+        if (--dependent->waiting == 0) {
+            if (ready != NULL) {
+                ready[ready_count++] = job->dependents[i];
+            } else {
+                pthread_mutex_unlock(&run->lock);
+                run_job_task(dependent);
+                pthread_mutex_lock(&run->lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&run->lock);
+    submit_jobs(run, ready, ready_count, false);
+    if (ready != ready_stack) {
+        free(ready);
+    }
+}
+
+/**
+ * @brief Ask the kernel to start reading a file that the loader will need next.
+ */
+static void readahead_file(const char *path) {
+#ifdef POSIX_FADV_WILLNEED
+    if (path == NULL) {
+        return;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;     // It may be the output of a job that has not run yet
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#else
+    (void) path;
+#endif
+}
+
+static void record_stage(PipelineStage *stage, double busy_ms, double input_wait_ms, double output_wait_ms, size_t depth, bool counted) {
+    pthread_mutex_lock(&stage->lock);
+    if (counted) {
+        stage->jobs++;
+        stage->busy_ms += busy_ms;
+        stage->depth_sum += depth;
+        stage->depth_samples++;
+        if (depth > stage->depth_max) {
+            stage->depth_max = depth;
+        }
+    }
+    stage->input_wait_ms += input_wait_ms;
+    stage->output_wait_ms += output_wait_ms;
+    pthread_mutex_unlock(&stage->lock);
+}
+
+/**
+ * @brief The last thread of a stage to finish sends one end marker (NULL) per thread of the next stage.
+ */
+static void finish_stage(PipelineStage *stage) {
+    if (atomic_fetch_sub(&stage->running, 1) == 1 && stage->output != NULL) {
+        for (size_t i = 0; i < stage->next_threads; i++) {
+            bounded_queue_push(stage->output, NULL);
+        }
+    }
+}
+
+/**
+ * @brief Free what the job still holds, keep its result and release the lines waiting for it.
+ */
+static void complete_pipeline_job(BatchRun *run, BatchJob *job) {
+    job_state_release(&job->state);
+    job->result = job->state.result;
+    memset(job->options.password, 0, sizeof(job->options.password));
+
+    pthread_mutex_lock(&run->lock);
+    for (size_t i = 0; i < job->dependent_count; i++) {
+        run->jobs[job->dependents[i]].waiting--;
+    }
+    pthread_cond_broadcast(&run->job_done);
+    pthread_mutex_unlock(&run->lock);
+}
+
+/**
+ * @brief Load stage: walks the manifest in order, so a line only waits for earlier lines.
+ */
+static void *load_stage_main(void *arg) {
+    PipelineStage *stage = arg;
+    BatchRun *run = stage->pipeline->run;
+    crypto_set_max_threads(run->crypto_threads);
+
+    size_t next = 0;
+    for (size_t i = 0; i < run->count; i++) {
+        BatchJob *job = &run->jobs[i];
+        if (!job->valid) {
+            continue;
+        }
+
+        // Warm the page cache with the files of the next job while this one loads
+        for (next = next > i ? next : i + 1; next < run->count && !run->jobs[next].valid; next++);
+        if (next < run->count) {
+            readahead_file(run->jobs[next].options.input_bmp_file);
+            readahead_file(run->jobs[next].options.input_file);
+        }
+
+        // Wait for the earlier lines that write the files of this one
+        double wait_start = get_time_ms();
+        pthread_mutex_lock(&run->lock);
+        while (job->waiting > 0) {
+            pthread_cond_wait(&run->job_done, &run->lock);
+        }
+        pthread_mutex_unlock(&run->lock);
+        double input_wait_ms = get_time_ms() - wait_start;
+
+        double start = get_time_ms();
+        job_state_init(&job->state, &job->options);
+        run_job_stage(&job->state, JOB_STAGE_LOAD, NULL, run->pool);
+        double busy_ms = get_time_ms() - start;
+
+        double output_wait_ms = bounded_queue_push(stage->output, job);
+        record_stage(stage, busy_ms, input_wait_ms, output_wait_ms, 0, true);
+    }
+    finish_stage(stage);
+    return NULL;
+}
+
+static void *pipeline_stage_main(void *arg) {
+    PipelineStage *stage = arg;
+    BatchRun *run = stage->pipeline->run;
+    crypto_set_max_threads(run->crypto_threads);
+
+    for (;;) {
+        size_t depth = bounded_queue_size(stage->input);
+        void *item = NULL;
+        double input_wait_ms = bounded_queue_pop(stage->input, &item);
+        if (item == NULL) {
+            record_stage(stage, 0, input_wait_ms, 0, 0, false);
+            break;
+        }
+        BatchJob *job = item;
+
+        double start = get_time_ms();
+        run_job_stage(&job->state, stage->stage, NULL, run->pool);
+        if (stage->output == NULL) {
+            complete_pipeline_job(run, job);
+        }
+        double busy_ms = get_time_ms() - start;
+
+        double output_wait_ms = stage->output != NULL ? bounded_queue_push(stage->output, job) : 0;
+        record_stage(stage, busy_ms, input_wait_ms, output_wait_ms, depth, true);
+    }
+    finish_stage(stage);
+    return NULL;
+}
+
+static void free_pipeline(Pipeline *pipeline) {
+    for (size_t i = 0; i < JOB_STAGE_COUNT; i++) {
+        bounded_queue_destroy(pipeline->stages[i].input);
+        pthread_mutex_destroy(&pipeline->stages[i].lock);
+    }
+}
+
+/**
+ * @brief Run the jobs through load -> extract -> crypto -> embed -> write, one group of threads per
+ * stage connected by bounded queues, so disk and CPU work of different jobs overlap.
+ *
+ * The load and write stages use one thread each; the CPU stages use `workers` threads each. Large
+ * LSB1/LSB4 payloads are split over a pool of `workers` threads, as outside the pipeline. Carriers
+ * are not cached: several jobs are in flight between the load and write stages, and a cache lends
+ * its carrier to one job at a time.
+ */
+static bool run_pipeline(BatchRun *run, size_t workers, bool pin_cpus, Pipeline *pipeline) {
+    memset(pipeline, 0, sizeof(Pipeline));
+    pipeline->run = run;
+    bool ok = true;
+    if (workers > 1) {
+        run->pool = thread_pool_create(workers, pin_cpus);
+        if (run->pool == NULL) {
+            LOG(WARNING, "[Batch] Could not create the chunk pool: large payloads run on their stage thread.")
+        }
+    }
+    for (size_t i = 0; i < JOB_STAGE_COUNT; i++) {
+        PipelineStage *stage = &pipeline->stages[i];
+        stage->pipeline = pipeline;
+        stage->stage = (JobStage) i;
+        stage->threads = (i == JOB_STAGE_LOAD || i == JOB_STAGE_WRITE) ? 1 : workers;
+        pthread_mutex_init(&stage->lock, NULL);
+        if (i > 0) {
+            stage->input = bounded_queue_create(BATCH_QUEUE_DEPTH);
+            ok = ok && stage->input != NULL;
+            pipeline->stages[i - 1].output = stage->input;
+        }
+    }
+    size_t total_threads = 2 + (JOB_STAGE_COUNT - 2) * workers;
+    // Every stage thread may hold a carrier
+    pixel_pool_set_workers(total_threads);
+    pthread_t *threads = ok ? calloc(total_threads, sizeof(pthread_t)) : NULL;
+    if (threads == NULL) {
+        LOG(ERROR, "Memory allocation failed for the batch pipeline.")
+        free_pipeline(pipeline);
+        thread_pool_destroy(run->pool);
+        run->pool = NULL;
+        return false;
+    }
+
+    // Start from the write stage, so every stage knows how many end markers the next one needs
+    size_t started = 0;
+    size_t i = JOB_STAGE_COUNT;
+    while (i-- > 0) {
+        PipelineStage *stage = &pipeline->stages[i];
+        stage->next_threads = i + 1 < JOB_STAGE_COUNT ? pipeline->stages[i + 1].threads : 0;
+        size_t requested = stage->threads;
+        stage->threads = 0;
+        atomic_init(&stage->running, requested);
+        for (size_t t = 0; t < requested; t++) {
+            if (pthread_create(&threads[started], NULL, i == JOB_STAGE_LOAD ? load_stage_main : pipeline_stage_main, stage) == 0) {
+                started++;
+                stage->threads++;
+            }
+        }
+        if (stage->threads < requested) {
+            // Threads that did not start count as already finished
+            for (size_t t = stage->threads; t < requested; t++) {
+                finish_stage(stage);
+            }
+            if (stage->threads == 0) {
+                LOG(ERROR, "[Batch] Could not start the %s stage.", job_stage_to_string(stage->stage))
+                ok = false;
+                break;
+            }
+        }
+    }
+    if (!ok && i + 1 < JOB_STAGE_COUNT) {
+        // Stop the stages that did start
+        for (size_t t = 0; t < pipeline->stages[i + 1].threads; t++) {
+            bounded_queue_push(pipeline->stages[i + 1].input, NULL);
+        }
+    }
+
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    free_pipeline(pipeline);
+    thread_pool_destroy(run->pool);
+    run->pool = NULL;
+    return ok;
+}
+
+/**
+ * @brief Append the per-stage counters to the report, as comment lines after the jobs.
+ */
+static void write_stage_report(FILE *report, const Pipeline *pipeline, double wall_ms) {
+    fprintf(report, "# stage\tthreads\tjobs\tbusy_ms\tutilization\tinput_wait_ms\toutput_wait_ms\tqueue_capacity\tqueue_avg\tqueue_max\n");
+    const PipelineStage *busiest = NULL;
+    double busiest_utilization = -1;
+    for (size_t i = 0; i < JOB_STAGE_COUNT; i++) {
+        const PipelineStage *stage = &pipeline->stages[i];
+        double utilization = wall_ms > 0 && stage->threads > 0 ? stage->busy_ms / (wall_ms * (double) stage->threads) : 0;
+        if (utilization > busiest_utilization) {
+            busiest_utilization = utilization;
+            busiest = stage;
+        }
+        fprintf(report, "# %s\t%zu\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\t", job_stage_to_string(stage->stage), stage->threads, stage->jobs,
+                stage->busy_ms, utilization, stage->input_wait_ms, stage->output_wait_ms);
+        if (i == JOB_STAGE_LOAD) {
+            fprintf(report, "-\t-\t-\n");
+        } else {
+            fprintf(report, "%d\t%.2f\t%zu\n", BATCH_QUEUE_DEPTH, stage->depth_samples ? (double) stage->depth_sum / (double) stage->depth_samples : 0.0, stage->depth_max);
+        }
+    }
+    if (busiest != NULL) {
+        LOG(INFO, "[Batch] Busiest stage: %s (%.0f%% utilization).", job_stage_to_string(busiest->stage), busiest_utilization * 100)
+    }
+}
+
+static void write_report_line(FILE *report, size_t line_number, const ProgramOptions *options, const JobResult *result) {
+    fprintf(report, "%zu\t%s\t%s\t%s\t%s\t%zu\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+            line_number,
+            options->mode == MODE_EMBED ? "embed" : (options->mode == MODE_EXTRACT ? "extract" : "-"),
+            job_status_to_string(result->status),
+            options->input_bmp_file ? options->input_bmp_file : "-",
+            options->output_file ? options->output_file : "-",
+            result->payload_bytes, result->stored_bytes,
+            result->load_ms, result->crypto_ms, result->steg_ms, result->write_ms, result->total_ms);
+}
+
+/**
+ * @brief Read every job of the manifest. Invalid lines are kept (not valid) so they appear in the report.
+ *
+ * @return bool false if memory ran out.
+ */
+static bool read_manifest(FILE *manifest, BatchJob **jobs_out, size_t *count_out) {
+    char *columns[BATCH_MAX_COLUMNS];
+    size_t column_count = sizeof(default_columns) / sizeof(default_columns[0]);
+    memcpy(columns, default_columns, sizeof(default_columns));
+    char *header = NULL;
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    size_t line_number = 0;
+    BatchJob *jobs = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool ok = true;
+
+    while (ok && getline(&line, &line_capacity, manifest) != -1) {
+        line_number++;
+        trim_line(line);
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        if (header == NULL && count == 0 && strncmp(line, "mode\t", 5) == 0) {
+            header = strdup(line);
+            if (header == NULL) {
+                LOG(ERROR, "Memory allocation failed for the manifest header.")
+                ok = false;
+                break;
+            }
+            column_count = split_fields(header, columns, BATCH_MAX_COLUMNS);
+            continue;
+        }
+
+        if (count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 16;
+            BatchJob *grown = realloc(jobs, new_capacity * sizeof(BatchJob));
+            if (grown == NULL) {
+                LOG(ERROR, "Memory allocation failed for the batch jobs.")
+                ok = false;
+                break;
+            }
+            jobs = grown;
+            capacity = new_capacity;
+        }
+        BatchJob *job = &jobs[count];
+        memset(job, 0, sizeof(BatchJob));
+        job->line_number = line_number;
+        job->result.status = JOB_ERROR_ARGUMENTS;
+        job->line = strdup(line);
+        if (job->line == NULL) {
+            LOG(ERROR, "Memory allocation failed for a manifest line.")
+            ok = false;
+            break;
+        }
+        count++;
+
+        char *fields[BATCH_MAX_COLUMNS];
+        size_t field_count = split_fields(job->line, fields, BATCH_MAX_COLUMNS);
+        if (field_count > column_count) {
+            LOG(WARNING, "[Batch] Line %zu has more fields than columns. Ignoring the extra fields.", line_number)
+        }
+        job->valid = parse_manifest_line(columns, column_count, fields, field_count, job->option_names, &job->options);
+        if (!job->valid) {
+            LOG(ERROR, "[Batch] Invalid job at line %zu.", line_number)
+        }
+    }
+
+    free(line);
+    free(header);
+    *jobs_out = jobs;
+    *count_out = count;
+    return ok;
+}
+
+static void free_jobs(BatchJob *jobs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        memset(jobs[i].options.password, 0, sizeof(jobs[i].options.password));
+        free(jobs[i].line);
+        free(jobs[i].dependents);
+    }
+    free(jobs);
+}
+
+/**
+ * @brief Run the jobs on the work-stealing pool. Jobs without pending dependencies start right away;
+ * the others are queued by the job they wait for.
+ */
+static bool run_on_pool(BatchRun *run, size_t workers, bool pin_cpus) {
+    size_t *ready = malloc((run->count ? run->count : 1) * sizeof(size_t));
+    run->pool = ready != NULL ? thread_pool_create(workers, pin_cpus) : NULL;
+    run->caches = run->pool != NULL ? calloc(thread_pool_size(run->pool), sizeof(JobCarrierCache)) : NULL;
+    run->cache_busy = run->pool != NULL ? calloc(thread_pool_size(run->pool), sizeof(bool)) : NULL;
+    bool ok = run->caches != NULL && run->cache_busy != NULL;
+
+    if (ok) {
+        size_t ready_count = 0;
+        for (size_t i = 0; i < run->count; i++) {
+            if (run->jobs[i].valid && run->jobs[i].waiting == 0) {
+                ready[ready_count++] = i;
+            }
+        }
+        submit_jobs(run, ready, ready_count, true);
+        thread_pool_wait(run->pool, &run->group);
+
+        size_t worker_count = thread_pool_size(run->pool);
+        ThreadPoolWorkerStats *stats = calloc(worker_count, sizeof(ThreadPoolWorkerStats));
+        thread_pool_stats(run->pool, stats);
+        for (size_t i = 0; stats != NULL && i < worker_count; i++) {
+            LOG(DEBUG, "[Batch] Worker %zu: %zu tasks, %zu stolen.", i, stats[i].executed, stats[i].stolen)
+        }
+        free(stats);
+        for (size_t i = 0; i < worker_count; i++) {
+            clear_job_carrier_cache(&run->caches[i]);
+        }
+    }
+
+    free(run->caches);
+    free(run->cache_busy);
+    thread_pool_destroy(run->pool);
+    free(ready);
+    run->caches = NULL;
+    run->cache_busy = NULL;
+    run->pool = NULL;
+    return ok;
+}
+
+int run_batch(const char *manifest_path, const char *report_path, const BatchSettings *settings) {
+    BatchSettings defaults = {0};
+    if (settings == NULL) {
+        settings = &defaults;
+    }
+
+    FILE *manifest = fopen(manifest_path, "r");
+    if (manifest == NULL) {
+        LOG(ERROR, "Could not open the manifest %s.", manifest_path)
+        return -1;
+    }
+    FILE *report = report_path ? fopen(report_path, "w") : stdout;
+    if (report == NULL) {
+        LOG(ERROR, "Could not open the report %s.", report_path)
+        fclose(manifest);
+        return -1;
+    }
+    fprintf(report, "line\tmode\tstatus\tcarrier\toutput\tpayload_bytes\tstored_bytes\tload_ms\tcrypto_ms\tsteg_ms\twrite_ms\ttotal_ms\n");
+
+    double start = get_time_ms();
+    BatchRun run = {.group = THREAD_POOL_GROUP_INIT};
+    bool ok = read_manifest(manifest, &run.jobs, &run.count) && build_dependencies(run.jobs, run.count);
+    fclose(manifest);
+    for (size_t i = 0; i < run.count; i++) {
+        run.jobs[i].run = &run;
+    }
+
+    size_t workers = settings->workers ? settings->workers : thread_pool_default_size();
+    Pipeline pipeline;
+    if (ok) {
+        pthread_mutex_init(&run.lock, NULL);
+        pthread_cond_init(&run.job_done, NULL);
+
+        // The workers already keep every CPU busy, so the crypto module does not start its own threads
+        run.crypto_threads = workers > 1 ? 1 : 0;
+        pixel_pool_set_workers(workers);
+        ok = settings->pipeline ? run_pipeline(&run, workers, settings->pin_cpus, &pipeline) : run_on_pool(&run, workers, settings->pin_cpus);
+        pixel_pool_set_workers(1);
+
+        pthread_cond_destroy(&run.job_done);
+        pthread_mutex_destroy(&run.lock);
+    }
+    if (!ok) {
+        LOG(ERROR, "[Batch] Could not run the batch jobs.")
+    }
+    double wall_ms = get_time_ms() - start;
+
+    // The report follows the manifest order, whatever order the jobs ran in
+    size_t failed = 0;
+    for (size_t i = 0; i < run.count; i++) {
+        if (!ok && run.jobs[i].valid) {
+            run.jobs[i].result.status = JOB_ERROR_ARGUMENTS;
+        }
+        if (run.jobs[i].result.status != JOB_OK) {
+            failed++;
+        }
+        write_report_line(report, run.jobs[i].line_number, &run.jobs[i].options, &run.jobs[i].result);
+    }
+    if (ok && settings->pipeline) {
+        write_stage_report(report, &pipeline, wall_ms);
+    }
+    LOG(INFO, "[Batch] %zu jobs, %zu ok, %zu failed in %.1f ms on %zu workers%s.", run.count, run.count - failed, failed,
+        wall_ms, workers, settings->pipeline ? " per stage" : "")
+
+    free_jobs(run.jobs, run.count);
+    if (report != stdout) {
+        fclose(report);
+    } else {
+        fflush(report);
+    }
+    return ok ? (int) failed : -1;
+}
@@ -1,4 +1,8 @@
 #include "./include/bmp_image.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define BMP_SIGNATURE_OFFSET 0          // Offset for BMP signature ("BM")
 #define BMP_SIGNATURE_SIZE 2            // Size of the BMP signature
@@ -14,6 +18,126 @@
 #define BMP_DIB_HEADER_SIZE_V3 40       // DIB header size for V3 format
 
 
+static size_t bmp_row_size(const BMPImage *bmp) {
+    return (bmp->width * 3 + 3) & ~(size_t) 3;  // Rows are padded to a multiple of 4 bytes
+}
+
+/**
+ * @brief Calls `write` with the pixel data of `bmp` in as few contiguous runs as possible.
+ *
+ * For a copy-on-write image, consecutive clean rows are contiguous in the shared pixels and
+ * consecutive dirty rows in their private block, so an image with a few dirty rows is written in a
+ * handful of runs straight from where the rows live.
+ */
+static bool for_each_data_run(const BMPImage *bmp, bool (*write)(const uint8_t *run, size_t size, void *ctx), void *ctx) {
+    if (bmp->rows == NULL) {
+        return write(bmp->data, bmp->data_size, ctx);
+    }
+    size_t row_size = bmp_row_size(bmp);
+    const uint8_t *run = bmp->rows[0];
+    size_t run_size = row_size;
+    for (size_t row = 1; row < bmp->height; row++) {
+        if (bmp->rows[row] == run + run_size) {
+            run_size += row_size;
+            continue;
+        }
+        if (!write(run, run_size, ctx)) {
+            return false;
+        }
+        run = bmp->rows[row];
+        run_size = row_size;
+    }
+    // Bytes after the last row are never written, so they always come from the shared pixels
+    size_t pixel_bytes = bmp->height * row_size;
+    if (!write(run, run_size, ctx)) {
+        return false;
+    }
+    return pixel_bytes == bmp->data_size || write(bmp->shared->pixels + pixel_bytes, bmp->data_size - pixel_bytes, ctx);
+}
+
+static bool write_run_to_buffer(const uint8_t *run, size_t size, void *ctx) {
+    uint8_t **cursor = ctx;
+    memcpy(*cursor, run, size);
+    *cursor += size;
+    return true;
+}
+
+static bool write_run_to_file(const uint8_t *run, size_t size, void *ctx) {
+    return fwrite(run, sizeof(unsigned char), size, (FILE *) ctx) == size;
+}
+
+/**
+ * @brief Reads a little-endian field of the header. Fields are not aligned, so they are not read through casts.
+ */
+static uint32_t header_field(const BMPImage *bmp, size_t offset, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = size; i > 0; i--) {
+        value = value << 8 | bmp->header[offset + i - 1];
+    }
+    return value;
+}
+
+bool bmp_parse_header(BMPImage *bmp) {
+    // Check the BMP signature ("BM")
+    if (strncmp((char *)bmp->header + BMP_SIGNATURE_OFFSET, BMP_SIGNATURE, BMP_SIGNATURE_SIZE) != 0) {
+        LOG(ERROR, "Invalid BMP file signature.")
+        return false;
+    }
+
+    // Verify the size of the DIB header is 40 bytes (V3 only)
+    uint32_t dib_header_size = header_field(bmp, BMP_DIB_HEADER_SIZE_OFFSET, 4);
+    if (dib_header_size != BMP_DIB_HEADER_SIZE_V3) {
+        LOG(ERROR, "Unsupported BMP header size: %u bytes. Only BMP V3 with 40-byte DIB headers are supported.", dib_header_size)
+        return false;
+    }
+
+    // Check if the image is 24 bits per pixel
+    uint32_t bits_per_pixel = header_field(bmp, BMP_BITS_PER_PIXEL_OFFSET, 2);
+    if (bits_per_pixel != BMP_24_BITS) {
+        LOG(ERROR, "Unsupported BMP format: Only 24-bit BMP files are supported. Found %u bits per pixel.", bits_per_pixel)
+        return false;
+    }
+
+    // Check if the image has no compression
+    uint32_t compression = header_field(bmp, BMP_COMPRESSION_OFFSET, 4);
+    if (compression != BMP_COMPRESSION_NONE) {
+        LOG(ERROR, "Unsupported BMP format: Compression is not supported. Compression type found: %u.", compression)
+        return false;
+    }
+
+    // Read the width and height of the image from the BMP header (signed; top-down images are not supported)
+    int32_t width = (int32_t) header_field(bmp, BMP_WIDTH_OFFSET, 4);
+    int32_t height = (int32_t) header_field(bmp, BMP_HEIGHT_OFFSET, 4);
+    if (width <= 0 || height <= 0) {
+        LOG(ERROR, "Invalid BMP dimensions: width = %d, height = %d.", width, height)
+        return false;
+    }
+    bmp->width = (size_t) width;
+    bmp->height = (size_t) height;
+    LOG(INFO, "[BMP] dimensions: width = %zu, height = %zu.", bmp->width, bmp->height)
+
+    if (bmp->height > SIZE_MAX / bmp_row_size(bmp)) {
+        LOG(ERROR, "BMP dimensions too large: width = %zu, height = %zu.", bmp->width, bmp->height)
+        return false;
+    }
+
+    // The image size field is 32 bits, so images of 4 GB or more store 0 (allowed for uncompressed
+    // images) or a truncated value. In both cases the size is the one of the rows
+    size_t pixel_bytes = bmp_row_size(bmp) * bmp->height;
+    uint32_t data_size = header_field(bmp, BMP_IMAGE_SIZE_OFFSET, 4);
+    if (data_size == 0 || pixel_bytes > UINT32_MAX) {
+        bmp->data_size = pixel_bytes;
+    } else if (data_size < pixel_bytes) {
+        // Rows are read and written whole, so a shorter size would put them past the end of the buffer
+        LOG(ERROR, "Invalid BMP data size: %u bytes for %zu bytes of rows.", data_size, pixel_bytes)
+        return false;
+    } else {
+        bmp->data_size = data_size;
+    }
+    LOG(INFO, "[BMP] data size: %zu bytes.", bmp->data_size)
+    return true;
+}
+
 BMPImage *new_bmp_file(const char *file_path) {
     // Check if the file path is valid
     if (file_path == NULL) {
@@ -29,100 +153,290 @@ BMPImage *new_bmp_file(const char *file_path) {
     }
 
     // Allocate memory for the BMPImage structure
-    BMPImage *bmp = (BMPImage *)malloc(sizeof(BMPImage));
+    BMPImage *bmp = (BMPImage *)mem_calloc(1, sizeof(BMPImage));
     if (bmp == NULL) {
         LOG(ERROR, "Could not allocate memory for BMPImage.")
         fclose(file);
         return NULL;
     }
 
-    // Read the BMP header (54 bytes)
+    // Read and validate the BMP header (54 bytes)
     if (fread(bmp->header, sizeof(unsigned char), BMP_HEADER_SIZE, file) != BMP_HEADER_SIZE) {
         LOG(ERROR, "Could not read BMP header.")
         fclose(file);
-        free(bmp);
+        mem_free(bmp);
         return NULL;
     }
-
-    // Check the BMP signature ("BM")
-    if (strncmp((char *)bmp->header + BMP_SIGNATURE_OFFSET, BMP_SIGNATURE, BMP_SIGNATURE_SIZE) != 0) {
-        LOG(ERROR, "Invalid BMP file signature.")
+    if (!bmp_parse_header(bmp)) {
         fclose(file);
-        free(bmp);
+        mem_free(bmp);
         return NULL;
     }
 
-    // Verify the size of the DIB header is 40 bytes (V3 only)
-    int dib_header_size = *(int *)&bmp->header[BMP_DIB_HEADER_SIZE_OFFSET];
-    if (dib_header_size != BMP_DIB_HEADER_SIZE_V3) {
-        LOG(ERROR, "Unsupported BMP header size: %d bytes. Only BMP V3 with 40-byte DIB headers are supported.", dib_header_size)
+    // Allocate memory for the pixel data
+    bmp->data = pixel_buffer_acquire(bmp->data_size);
+    if (bmp->data == NULL) {
+        LOG(ERROR, "Could not allocate memory for BMP data.")
         fclose(file);
-        free(bmp);
+        mem_free(bmp);
         return NULL;
     }
 
-    // Check if the image is 24 bits per pixel
-    short bits_per_pixel = *(short *)&bmp->header[BMP_BITS_PER_PIXEL_OFFSET];
-    if (bits_per_pixel != BMP_24_BITS) {
-        LOG(ERROR, "Unsupported BMP format: Only 24-bit BMP files are supported. Found %d bits per pixel.", bits_per_pixel)
+    // Read the pixel data from the BMP file
+    if (fread(bmp->data, sizeof(unsigned char), bmp->data_size, file) != bmp->data_size) {
+        LOG(ERROR, "Could not read BMP pixel data.")
         fclose(file);
-        free(bmp);
+        pixel_buffer_release(bmp->data);
+        mem_free(bmp);
         return NULL;
     }
 
-    // Check if the image has no compression
-    int compression = *(int *)&bmp->header[BMP_COMPRESSION_OFFSET];
-    if (compression != BMP_COMPRESSION_NONE) {
-        LOG(ERROR, "Unsupported BMP format: Compression is not supported. Compression type found: %d.", compression)
-        fclose(file);
-        free(bmp);
+    fclose(file);
+    LOG(INFO, "[BMP] file read successfully: %s.", file_path)
+    return bmp;
+}
+
+BMPImage *new_bmp_from_buffer(const uint8_t *buffer, size_t size) {
+    if (buffer == NULL || size < BMP_HEADER_SIZE) {
+        LOG(ERROR, "Invalid BMP buffer.")
         return NULL;
     }
 
-    // Read the width and height of the image from the BMP header
-    bmp->width = *(int *)&bmp->header[BMP_WIDTH_OFFSET];
-    bmp->height = *(int *)&bmp->header[BMP_HEIGHT_OFFSET];
-    if (bmp->width <= 0 || bmp->height <= 0) {
-        LOG(ERROR, "Invalid BMP dimensions: width = %lu, height = %lu.", bmp->width, bmp->height)
-        fclose(file);
-        free(bmp);
+    BMPImage *bmp = (BMPImage *)mem_calloc(1, sizeof(BMPImage));
+    if (bmp == NULL) {
+        LOG(ERROR, "Could not allocate memory for BMPImage.")
         return NULL;
     }
-    LOG(INFO, "[BMP] dimensions: width = %lu, height = %lu.", bmp->width, bmp->height)
-
-    // Read the size of the pixel data from the BMP header
-    bmp->data_size = *(int *)&bmp->header[BMP_IMAGE_SIZE_OFFSET];
-    if (bmp->data_size <= 0) {
-        LOG(ERROR, "Invalid BMP data size: %lu bytes.", bmp->data_size)
-        fclose(file);
-        free(bmp);
+    memcpy(bmp->header, buffer, BMP_HEADER_SIZE);
+    if (!bmp_parse_header(bmp)) {
+        mem_free(bmp);
+        return NULL;
+    }
+    if (bmp->data_size > size - BMP_HEADER_SIZE) {
+        LOG(ERROR, "BMP buffer too small: %zu bytes of pixel data expected.", bmp->data_size)
+        mem_free(bmp);
         return NULL;
     }
-    LOG(INFO, "[BMP] data size: %lu bytes.", bmp->data_size)
 
-    // Allocate memory for the pixel data
-    bmp->data = (unsigned char *)malloc(bmp->data_size);
+    bmp->data = pixel_buffer_acquire(bmp->data_size);
     if (bmp->data == NULL) {
         LOG(ERROR, "Could not allocate memory for BMP data.")
-        fclose(file);
-        free(bmp);
+        mem_free(bmp);
         return NULL;
     }
+    memcpy(bmp->data, buffer + BMP_HEADER_SIZE, bmp->data_size);
+    return bmp;
+}
 
-    // Read the pixel data from the BMP file
-    if (fread(bmp->data, sizeof(unsigned char), bmp->data_size, file) != bmp->data_size) {
-        LOG(ERROR, "Could not read BMP pixel data.")
-        fclose(file);
-        free(bmp->data);
-        free(bmp);
+/**
+ * @brief Reads exactly `size` bytes at `offset`, retrying short reads.
+ */
+static bool read_at(int fd, uint8_t *buffer, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t count = pread(fd, buffer, size, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        buffer += count;
+        size -= (size_t) count;
+        offset += count;
+    }
+    return true;
+}
+
+bool bmp_probe(int fd, BMPImage *bmp) {
+    off_t start = fd >= 0 && bmp != NULL ? lseek(fd, 0, SEEK_CUR) : -1;
+    if (start < 0) {
+        LOG(ERROR, "Invalid BMP file descriptor.")
+        return false;
+    }
+    memset(bmp, 0, sizeof(BMPImage));
+    // Files that are not bitmaps at all are common when probing, so they are not reported as errors
+    if (!read_at(fd, bmp->header, BMP_HEADER_SIZE, start) || bmp->header[0] != 'B' || bmp->header[1] != 'M') {
+        LOG(DEBUG, "[BMP] Not a BMP file.")
+        return false;
+    }
+    if (!bmp_parse_header(bmp)) {
+        return false;
+    }
+
+    // Fail now rather than on the first row past the end of the file
+    struct stat info;
+    off_t data_offset = start + BMP_HEADER_SIZE;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < data_offset || (size_t) (info.st_size - data_offset) < bmp->data_size) {
+        LOG(DEBUG, "[BMP] The file is shorter than its pixel data.")
+        return false;
+    }
+    bmp->source_fd = -1;
+    bmp->source_offset = data_offset;
+    return true;
+}
+
+/**
+ * @brief Number of private blocks of a copy-on-write or sparse image.
+ */
+static size_t private_block_count(const BMPImage *bmp) {
+    return (bmp->height + bmp->block_rows - 1) / bmp->block_rows;
+}
+
+/**
+ * @brief Bytes of rows in private block `block`: the last one may hold fewer rows.
+ */
+static size_t private_block_size(const BMPImage *bmp, size_t block) {
+    size_t rows = bmp->height - block * bmp->block_rows;
+    return (rows < bmp->block_rows ? rows : bmp->block_rows) * bmp_row_size(bmp);
+}
+
+/**
+ * @brief Where row `row` of a copy-on-write or sparse image lives in its private block, allocating its private block the first time.
+ *
+ * @return uint8_t* The row in its block, or NULL if the block could not be allocated.
+ */
+static uint8_t *private_row(BMPImage *bmp, size_t row) {
+    size_t block = row / bmp->block_rows;
+    if (bmp->private_blocks[block] == NULL) {
+        bmp->private_blocks[block] = pixel_buffer_acquire(private_block_size(bmp, block));
+        if (bmp->private_blocks[block] == NULL) {
+            LOG(ERROR, "Could not allocate memory for BMP rows.")
+            return NULL;
+        }
+    }
+    return bmp->private_blocks[block] + (row % bmp->block_rows) * bmp_row_size(bmp);
+}
+
+BMPImage *new_bmp_lazy(int fd) {
+    BMPImage *bmp = (BMPImage *)mem_calloc(1, sizeof(BMPImage));
+    if (bmp == NULL) {
+        LOG(ERROR, "Could not allocate memory for BMPImage.")
+        return NULL;
+    }
+    if (!bmp_probe(fd, bmp)) {
+        LOG(ERROR, "Could not read a valid BMP header and pixel data.")
+        mem_free(bmp);
         return NULL;
     }
 
-    fclose(file);
-    LOG(INFO, "[BMP] file read successfully: %s.", file_path)
+    // The buffer is only written where rows are loaded, so the rest of it is never touched
+    bmp->data = pixel_buffer_acquire(bmp->data_size);
+    bmp->loaded_rows = calloc(bmp->height, sizeof(bool));
+    if (bmp->data == NULL || bmp->loaded_rows == NULL || (bmp->source_fd = dup(fd)) < 0) {
+        LOG(ERROR, "Could not allocate memory for BMP data.")
+        free_bmp(bmp);
+        return NULL;
+    }
     return bmp;
 }
 
+BMPImage *new_bmp_sparse(int fd) {
+    BMPImage *bmp = (BMPImage *)mem_calloc(1, sizeof(BMPImage));
+    if (bmp == NULL) {
+        LOG(ERROR, "Could not allocate memory for BMPImage.")
+        return NULL;
+    }
+    if (!bmp_probe(fd, bmp)) {
+        LOG(ERROR, "Could not read a valid BMP header and pixel data.")
+        mem_free(bmp);
+        return NULL;
+    }
+
+    // Every row starts unloaded, without a block; `data` is the first block, which peeking always reads
+    size_t row_size = bmp_row_size(bmp);
+    bmp->block_rows = row_size < BMP_PRIVATE_BLOCK_SIZE ? BMP_PRIVATE_BLOCK_SIZE / row_size : 1;
+    bmp->rows = calloc(bmp->height, sizeof(unsigned char *));
+    bmp->private_blocks = calloc(private_block_count(bmp), sizeof(unsigned char *));
+    bmp->loaded_rows = calloc(bmp->height, sizeof(bool));
+    if (bmp->rows == NULL || bmp->private_blocks == NULL || bmp->loaded_rows == NULL || private_row(bmp, 0) == NULL
+        || (bmp->source_fd = dup(fd)) < 0) {
+        LOG(ERROR, "Could not allocate memory for BMP data.")
+        free_bmp(bmp);
+        return NULL;
+    }
+    bmp->data = bmp->private_blocks[0];
+    return bmp;
+}
+
+BMPImage *new_bmp_file_lazy(const char *file_path) {
+    if (file_path == NULL) {
+        LOG(ERROR, "Invalid file path.")
+        return NULL;
+    }
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR, "Could not open BMP file %s.", file_path)
+        return NULL;
+    }
+    BMPImage *bmp = new_bmp_lazy(fd);
+    close(fd);
+    return bmp;
+}
+
+bool bmp_load_rows(BMPImage *bmp, size_t first_component, size_t end_component) {
+    if (bmp == NULL) {
+        return false;
+    }
+    size_t row_components = bmp->width * 3;
+    if (end_component > row_components * bmp->height) {
+        LOG(ERROR, "Load range [%zu, %zu) outside the image.", first_component, end_component)
+        return false;
+    }
+    if (bmp->loaded_rows == NULL || first_component >= end_component) {
+        return true;
+    }
+
+    // Consecutive missing rows are contiguous in the file, so each run is a single read
+    size_t row_size = bmp_row_size(bmp);
+    size_t last_row = (end_component - 1) / row_components;
+    size_t row = first_component / row_components;
+    while (row <= last_row) {
+        if (bmp->loaded_rows[row]) {
+            row++;
+            continue;
+        }
+        // The rows of a sparse image are only contiguous within their block
+        bool sparse = bmp->rows != NULL;
+        size_t run_limit = sparse ? (row / bmp->block_rows + 1) * bmp->block_rows : last_row + 1;
+        uint8_t *target = sparse ? private_row(bmp, row) : bmp->data + row * row_size;
+        if (target == NULL) {
+            return false;
+        }
+        size_t run_end = row;
+        while (run_end <= last_row && run_end < run_limit && !bmp->loaded_rows[run_end]) {
+            if (sparse) {
+                bmp->rows[run_end] = target + (run_end - row) * row_size;
+            }
+            bmp->loaded_rows[run_end++] = true;
+        }
+        if (!read_at(bmp->source_fd, target, (run_end - row) * row_size, bmp->source_offset + (off_t) (row * row_size))) {
+            LOG(ERROR, "Could not read BMP rows %zu to %zu.", row, run_end - 1)
+            memset(bmp->loaded_rows + row, 0, run_end - row);
+            return false;
+        }
+        LOG(DEBUG, "[BMP] loaded rows %zu to %zu.", row, run_end - 1)
+        row = run_end;
+    }
+    return true;
+}
+
+uint8_t* bmp_to_buffer(const BMPImage *bmp, size_t *size) {
+    if (bmp == NULL || bmp->data == NULL || size == NULL) {
+        LOG(ERROR, "Invalid BMP image.")
+        return NULL;
+    }
+    uint8_t *buffer = mem_alloc(BMP_HEADER_SIZE + bmp->data_size);
+    if (buffer == NULL) {
+        LOG(ERROR, "Could not allocate memory for the BMP buffer.")
+        return NULL;
+    }
+    memcpy(buffer, bmp->header, BMP_HEADER_SIZE);
+    uint8_t *cursor = buffer + BMP_HEADER_SIZE;
+    for_each_data_run(bmp, write_run_to_buffer, &cursor);
+    *size = BMP_HEADER_SIZE + bmp->data_size;
+    return buffer;
+}
+
 int save_bmp_file(const char *output_file, BMPImage *bmp) {
 
     if (output_file == NULL || bmp == NULL) {
@@ -144,7 +458,7 @@ int save_bmp_file(const char *output_file, BMPImage *bmp) {
     }
 
     // Write the pixel data
-    if (fwrite(bmp->data, sizeof(unsigned char), bmp->data_size, file) != bmp->data_size) {
+    if (!for_each_data_run(bmp, write_run_to_file, file)) {
         LOG(ERROR, "Could not write BMP pixel data to file %s.", output_file)
         fclose(file);
         return -1;
@@ -156,24 +470,129 @@ int save_bmp_file(const char *output_file, BMPImage *bmp) {
 }
 
 
+static void release_pixel_store(PixelStore *store) {
+    if (store != NULL && atomic_fetch_sub(&store->references, 1) == 1) {
+        pixel_buffer_release(store->pixels);
+        free(store);
+    }
+}
+
 void free_bmp(BMPImage *bmp) {
     if (bmp != NULL) {
-        if (bmp->data != NULL) {
-            free(bmp->data);
-            bmp->data = NULL;
+        // A copy-on-write image only reads `data`: the shared pixels belong to the store. In a sparse
+        // image it is the first private block
+        if (bmp->data != NULL && bmp->private_blocks == NULL) {
+            pixel_buffer_release(bmp->data);
         }
-        free(bmp);
+        bmp->data = NULL;
+        if (bmp->private_blocks != NULL) {
+            for (size_t block = 0; block < private_block_count(bmp); block++) {
+                pixel_buffer_release(bmp->private_blocks[block]);
+            }
+            free(bmp->private_blocks);
+        }
+        release_pixel_store(bmp->shared);
+        free(bmp->rows);
+        free(bmp->dirty_rows);
+        if (bmp->loaded_rows != NULL) {
+            free(bmp->loaded_rows);
+            if (bmp->source_fd >= 0) {
+                close(bmp->source_fd);
+            }
+        }
+        mem_free(bmp);
     }
 }
 
+/**
+ * @brief Allocates the row tables of a copy-on-write image, with every row read from `store`.
+ *
+ * The tables belong to the store rather than to the allocator scope the image was created in (the
+ * source of copy_bmp may come from another one), so they use malloc.
+ */
+static bool init_shared_rows(BMPImage *bmp, PixelStore *store) {
+    size_t row_size = bmp_row_size(bmp);
+    bmp->block_rows = row_size < BMP_PRIVATE_BLOCK_SIZE ? BMP_PRIVATE_BLOCK_SIZE / row_size : 1;
+    bmp->rows = malloc(bmp->height * sizeof(unsigned char *));
+    bmp->dirty_rows = calloc(bmp->height, sizeof(bool));
+    bmp->private_blocks = calloc(private_block_count(bmp), sizeof(unsigned char *));
+    if (bmp->rows == NULL || bmp->dirty_rows == NULL || bmp->private_blocks == NULL) {
+        free(bmp->rows);
+        free(bmp->dirty_rows);
+        free(bmp->private_blocks);
+        bmp->rows = NULL;
+        bmp->dirty_rows = NULL;
+        bmp->private_blocks = NULL;
+        return false;
+    }
+    for (size_t row = 0; row < bmp->height; row++) {
+        bmp->rows[row] = store->pixels + row * row_size;
+    }
+    bmp->dirty_row_count = 0;
+    return true;
+}
+
+/**
+ * @brief Moves the pixels of a regular image to a new shared store. Its rows are read from there too.
+ */
+static bool share_pixels(BMPImage *bmp) {
+    if (bmp->shared != NULL) {
+        return true;
+    }
+    if (bmp->height > bmp->data_size / bmp_row_size(bmp)) {
+        LOG(DEBUG, "[BMP] data size %zu is too small for %zu rows, copying the pixels.", bmp->data_size, bmp->height)
+        return false;
+    }
+    PixelStore *store = malloc(sizeof(PixelStore));
+    if (store == NULL) {
+        return false;
+    }
+    store->pixels = bmp->data;
+    atomic_init(&store->references, 1);
+    if (!init_shared_rows(bmp, store)) {
+        free(store);
+        return false;
+    }
+    bmp->shared = store;
+    return true;
+}
+
+/**
+ * @brief Copies every pixel of `bmp` into a new regular image.
+ */
+static BMPImage* deep_copy_bmp(BMPImage *bmp) {
+    BMPImage* new_bmp = mem_calloc(1, sizeof(BMPImage));
+    if (new_bmp == NULL) {
+        LOG(ERROR, "No se pudo asignar memoria para el nuevo BMPImage.")
+        return NULL;
+    }
+    memcpy(new_bmp->header, bmp->header, BMP_HEADER_SIZE);
+    new_bmp->width = bmp->width;
+    new_bmp->height = bmp->height;
+    new_bmp->data_size = bmp->data_size;
+
+    new_bmp->data = pixel_buffer_acquire(bmp->data_size);
+    if (new_bmp->data == NULL) {
+        LOG(ERROR, "No se pudo asignar memoria para los datos de BMP.")
+        mem_free(new_bmp);
+        return NULL;
+    }
+    uint8_t *cursor = new_bmp->data;
+    for_each_data_run(bmp, write_run_to_buffer, &cursor);
+    return new_bmp;
+}
+
 BMPImage* copy_bmp(BMPImage *bmp) {
     if (bmp == NULL) {
         LOG(ERROR, "copy_bmp recibió un puntero NULL.")
         return NULL;
     }
+    if (bmp->data == NULL || !share_pixels(bmp)) {
+        return deep_copy_bmp(bmp);
+    }
 
     // Asignar memoria para el nuevo BMPImage
-    BMPImage* new_bmp = malloc(sizeof(BMPImage));
+    BMPImage* new_bmp = mem_calloc(1, sizeof(BMPImage));
     if (new_bmp == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para el nuevo BMPImage.")
         return NULL;
@@ -187,18 +606,118 @@ BMPImage* copy_bmp(BMPImage *bmp) {
     new_bmp->height = bmp->height;
     new_bmp->data_size = bmp->data_size;
 
-    // Asignar y copiar los datos de píxeles
-    new_bmp->data = malloc(bmp->data_size);
-    if (new_bmp->data == NULL) {
+    // Compartir los píxeles; solo se copian las filas que el original ya modificó
+    if (!init_shared_rows(new_bmp, bmp->shared)) {
         LOG(ERROR, "No se pudo asignar memoria para los datos de BMP.")
-        free(new_bmp);
+        free_bmp(new_bmp);
         return NULL;
     }
-    memcpy(new_bmp->data, bmp->data, bmp->data_size);
-
+    atomic_fetch_add(&bmp->shared->references, 1);
+    new_bmp->shared = bmp->shared;
+    new_bmp->data = bmp->shared->pixels;
+    size_t row_size = bmp_row_size(bmp);
+    for (size_t row = 0; row < bmp->height && new_bmp->dirty_row_count < bmp->dirty_row_count; row++) {
+        if (bmp->dirty_rows[row]) {
+            uint8_t *copied_row = private_row(new_bmp, row);
+            if (copied_row == NULL) {
+                free_bmp(new_bmp);
+                return NULL;
+            }
+            memcpy(copied_row, bmp->rows[row], row_size);
+            new_bmp->rows[row] = copied_row;
+            new_bmp->dirty_rows[row] = true;
+            new_bmp->dirty_row_count++;
+        }
+    }
     return new_bmp;
 }
 
+bool bmp_prepare_write(BMPImage *bmp, size_t first_component, size_t end_component) {
+    if (bmp == NULL) {
+        return false;
+    }
+    size_t row_components = bmp->width * 3;
+    if (end_component > row_components * bmp->height) {
+        LOG(ERROR, "Write range [%zu, %zu) outside the image.", first_component, end_component)
+        return false;
+    }
+    if (bmp->shared == NULL || first_component >= end_component) {
+        return true;
+    }
+
+    size_t row_size = bmp_row_size(bmp);
+    for (size_t row = first_component / row_components; row <= (end_component - 1) / row_components; row++) {
+        if (!bmp->dirty_rows[row]) {
+            // Rows keep their order inside a block, so consecutive dirty rows stay contiguous
+            uint8_t *written_row = private_row(bmp, row);
+            if (written_row == NULL) {
+                return false;
+            }
+            memcpy(written_row, bmp->shared->pixels + row * row_size, row_size);
+            bmp->rows[row] = written_row;
+            bmp->dirty_rows[row] = true;
+            bmp->dirty_row_count++;
+        }
+    }
+    return true;
+}
+
+size_t bmp_discard_changes(BMPImage *bmp) {
+    if (bmp == NULL || bmp->shared == NULL) {
+        return 0;
+    }
+    size_t row_size = bmp_row_size(bmp);
+    size_t restored = bmp->dirty_row_count;
+    for (size_t row = 0; row < bmp->height && bmp->dirty_row_count > 0; row++) {
+        if (bmp->dirty_rows[row]) {
+            bmp->rows[row] = bmp->shared->pixels + row * row_size;
+            bmp->dirty_rows[row] = false;
+            bmp->dirty_row_count--;
+        }
+    }
+    return restored;
+}
+
+size_t bmp_private_bytes(const BMPImage *bmp) {
+    if (bmp == NULL || bmp->data == NULL) {
+        return 0;
+    }
+    if (bmp->private_blocks == NULL) {
+        return bmp->data_size;
+    }
+    size_t bytes = 0;
+    for (size_t block = 0; block < private_block_count(bmp); block++) {
+        bytes += bmp->private_blocks[block] != NULL ? private_block_size(bmp, block) : 0;
+    }
+    return bytes;
+}
+
+const uint8_t *bmp_row(const BMPImage *bmp, size_t row) {
+    return bmp->rows != NULL ? bmp->rows[row] : bmp->data + row * bmp_row_size(bmp);
+}
+
+size_t bmp_diff_rows(const BMPImage *a, const BMPImage *b, bool *changed) {
+    if (a == NULL || b == NULL || a->width != b->width || a->height != b->height) {
+        LOG(ERROR, "Only images with the same dimensions can be compared.")
+        return SIZE_MAX;
+    }
+    // Rows that neither copy wrote still point to the same shared pixels
+    bool same_store = a->shared != NULL && a->shared == b->shared;
+    size_t row_bytes = a->width * 3;
+    size_t count = 0;
+    for (size_t row = 0; row < a->height; row++) {
+        bool differs = false;
+        if (!same_store || a->dirty_rows[row] || b->dirty_rows[row]) {
+            differs = memcmp(bmp_row(a, row), bmp_row(b, row), row_bytes) != 0;
+        }
+        if (changed != NULL) {
+            changed[row] = differs;
+        }
+        count += differs;
+    }
+    return count;
+}
+
 Component get_component_by_index(const BMPImage *bmp, size_t index) {
     Component result = {NULL, INVALID_COLOR};
 
@@ -207,7 +726,6 @@ Component get_component_by_index(const BMPImage *bmp, size_t index) {
         return result;
     }
 
-    size_t row_size = (bmp->width * 3 + 3) & ~3;  // Tamaño de la fila con padding
     size_t total_components = bmp->width * bmp->height * 3;
 
     if (index >= total_components) {
@@ -219,7 +737,7 @@ Component get_component_by_index(const BMPImage *bmp, size_t index) {
     size_t offset_in_row = index % (bmp->width * 3);    // Desplazamiento en la fila
 
     // Obtener el puntero al componente en los datos de BMP
-    result.component_ptr = &bmp->data[pixel_row * row_size + offset_in_row];
+    result.component_ptr = (uint8_t *) &bmp_row(bmp, pixel_row)[offset_in_row];
 
     // Determinar el tipo de color basándonos en la posición relativa (offset en el píxel)
     result.color = offset_in_row % 3;
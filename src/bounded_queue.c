@@ -0,0 +1,148 @@
+#include "./include/bounded_queue.h"
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include "./include/utils.h"
+
+#define QUEUE_CACHE_LINE 64         // Keeps the producer and consumer positions on different cache lines
+#define QUEUE_SPIN_ATTEMPTS 64      // Retries with sched_yield before sleeping
+#define QUEUE_MAX_SLEEP_US 1000     // Upper bound of the backoff sleep
+
+typedef struct {
+    atomic_size_t sequence;
+    void *item;
+} QueueCell;
+
+struct BoundedQueue {
+    QueueCell *cells;
+    size_t mask;
+    alignas(QUEUE_CACHE_LINE) atomic_size_t enqueue_pos;
+    alignas(QUEUE_CACHE_LINE) atomic_size_t dequeue_pos;
+};
+
+BoundedQueue* bounded_queue_create(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    BoundedQueue *queue = aligned_alloc(QUEUE_CACHE_LINE, (sizeof(BoundedQueue) + QUEUE_CACHE_LINE - 1) / QUEUE_CACHE_LINE * QUEUE_CACHE_LINE);
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->cells = malloc(size * sizeof(QueueCell));
+    if (queue->cells == NULL) {
+        free(queue);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].item = NULL;
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    return queue;
+}
+
+void bounded_queue_destroy(BoundedQueue *queue) {
+    if (queue == NULL) {
+        return;
+    }
+    free(queue->cells);
+    free(queue);
+}
+
+bool bounded_queue_try_push(BoundedQueue *queue, void *item) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        QueueCell *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            // The slot is free for this lap: claim the position
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                cell->item = item;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // The slot still holds the item of the previous lap
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+bool bounded_queue_try_pop(BoundedQueue *queue, void **item) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        QueueCell *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                *item = cell->item;
+                // Free the slot for the producer of the next lap
+                atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Wait a little longer on each failed attempt: yield first, then sleep up to QUEUE_MAX_SLEEP_US.
+ */
+static void backoff(unsigned *attempt) {
+    if (*attempt < QUEUE_SPIN_ATTEMPTS) {
+        sched_yield();
+    } else {
+        unsigned exponent = *attempt - QUEUE_SPIN_ATTEMPTS;
+        long sleep_us = exponent < 10 ? 1L << exponent : QUEUE_MAX_SLEEP_US;
+        struct timespec delay = {0, (sleep_us < QUEUE_MAX_SLEEP_US ? sleep_us : QUEUE_MAX_SLEEP_US) * 1000};
+        nanosleep(&delay, NULL);
+    }
+    (*attempt)++;
+}
+
+double bounded_queue_push(BoundedQueue *queue, void *item) {
+    if (bounded_queue_try_push(queue, item)) {
+        return 0;
+    }
+    double start = get_time_ms();
+    unsigned attempt = 0;
+    while (!bounded_queue_try_push(queue, item)) {
+        backoff(&attempt);
+    }
+    return get_time_ms() - start;
+}
+
+double bounded_queue_pop(BoundedQueue *queue, void **item) {
+    if (bounded_queue_try_pop(queue, item)) {
+        return 0;
+    }
+    double start = get_time_ms();
+    unsigned attempt = 0;
+    while (!bounded_queue_try_pop(queue, item)) {
+        backoff(&attempt);
+    }
+    return get_time_ms() - start;
+}
+
+size_t bounded_queue_size(const BoundedQueue *queue) {
+    size_t enqueued = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    size_t dequeued = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+size_t bounded_queue_capacity(const BoundedQueue *queue) {
+    return queue->mask + 1;
+}
@@ -0,0 +1,306 @@
+#include "./include/checksum.h"
+#include "./include/utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM 1
+#endif
+
+#define CRC32C_POLYNOMIAL 0x82F63B78u  // Castagnoli, reflected
+#define CHECKSUM_TASK_CHUNKS 16         // Chunks verified by each pool task
+
+typedef uint32_t (*Crc32cFunction)(uint32_t crc, const uint8_t *data, size_t size);
+
+static uint32_t crc_tables[8][256];
+static Crc32cFunction crc_function = NULL;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Verification of the chunks of one package, shared by its pool tasks.
+ */
+typedef struct {
+    const uint8_t *table;       // CRC of every chunk
+    const uint8_t *file;
+    size_t file_size;
+    size_t chunk_size;
+    size_t chunks;
+    bool stop_at_first;
+    bool *damaged;              // One entry per chunk
+    atomic_size_t first_damaged;
+    atomic_size_t checked;
+} ChunkVerification;
+
+typedef struct {
+    ChunkVerification *verification;
+    size_t first;
+    size_t end;
+} ChunkTask;
+
+/**
+ * @brief Slicing-by-8: eight bytes per step through eight 256-entry tables.
+ */
+uint32_t crc32c_portable(uint32_t crc, const uint8_t *data, size_t size) {
+    while (size >= 8) {
+        uint32_t low = crc ^ ((uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24);
+        crc = crc_tables[7][low & 0xFF] ^ crc_tables[6][(low >> 8) & 0xFF] ^ crc_tables[5][(low >> 16) & 0xFF] ^
+              crc_tables[4][low >> 24] ^ crc_tables[3][data[4]] ^ crc_tables[2][data[5]] ^ crc_tables[1][data[6]] ^
+              crc_tables[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = crc_tables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *data, size_t size) {
+    uint64_t wide = crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = (uint32_t) wide;
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_ARM
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *data, size_t size) {
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        crc_tables[0][i] = crc;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t previous = crc_tables[t - 1][i];
+            crc_tables[t][i] = (previous >> 8) ^ crc_tables[0][previous & 0xFF];
+        }
+    }
+    crc_function = crc32c_portable;
+#ifdef CRC32C_X86
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_function = crc32c_sse42;
+    }
+#elif defined(CRC32C_ARM)
+    crc_function = crc32c_armv8;
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const uint8_t *data, size_t size) {
+    pthread_once(&crc_once, crc_init);
+    return ~crc_function(~crc, data, size);
+}
+
+size_t checksum_overhead(size_t chunk_size, size_t file_size) {
+    size_t chunks = chunk_size > 0 ? (file_size + chunk_size - 1) / chunk_size : 0;
+    return CHECKSUM_HEADER_SIZE + chunks * sizeof(uint32_t);
+}
+
+bool checksum_package(uint8_t **package, size_t *size, size_t chunk_size) {
+    chunk_size = chunk_size == 0 ? CHECKSUM_CHUNK_SIZE : chunk_size;
+    if (package == NULL || *package == NULL || size == NULL || *size < sizeof(uint32_t) || chunk_size > CHECKSUM_MAX_CHUNK_SIZE) {
+        LOG(ERROR, "Invalid package to checksum.")
+        return false;
+    }
+    // A compressed package keeps its header, so the chunks hold the compressed data
+    const uint8_t *source = *package;
+    uint64_t stored_size = 0;
+    CompressionAlgorithm compression;
+    size_t header_size = parse_package_header(source, *size, &stored_size, &compression);
+    if (header_size == 0 || header_size + stored_size > *size) {
+        LOG(ERROR, "Invalid package to checksum.")
+        return false;
+    }
+    size_t file_size = (size_t) stored_size;
+    size_t extension_size = *size - header_size - file_size;
+    size_t overhead = checksum_overhead(chunk_size, file_size);
+    size_t data_size = overhead + file_size;
+    if (data_size > UINT32_MAX) {
+        LOG(ERROR, "The file is too large for a chunked package.")
+        return false;
+    }
+    uint8_t *chunked = mem_alloc(header_size + data_size + extension_size);
+    if (chunked == NULL) {
+        LOG(ERROR, "Memory allocation failed for the chunked package.")
+        return false;
+    }
+
+    uint8_t *header = chunked + write_package_header(chunked, data_size, header_size == PACKAGE_LARGE_HEADER_SIZE, compression);
+    memcpy(header, CHECKSUM_MAGIC, strlen(CHECKSUM_MAGIC));
+    header[4] = CHECKSUM_VERSION;
+    memset(header + 5, 0, 3);
+    store_be32(header + 8, (uint32_t) chunk_size);
+    store_be32(header + 12, (uint32_t) file_size);
+    const uint8_t *file = source + header_size;
+    uint8_t *table = header + CHECKSUM_HEADER_SIZE;
+    for (size_t offset = 0; offset < file_size; offset += chunk_size, table += sizeof(uint32_t)) {
+        size_t length = file_size - offset < chunk_size ? file_size - offset : chunk_size;
+        store_be32(table, crc32c(0, file + offset, length));
+    }
+    memcpy(header + overhead, file, file_size + extension_size);
+    LOG(INFO, "Split the payload in %zu checksummed chunks of %zu bytes.", (overhead - CHECKSUM_HEADER_SIZE) / sizeof(uint32_t), chunk_size)
+
+    mem_free(*package);
+    *package = chunked;
+    *size = header_size + data_size + extension_size;
+    return true;
+}
+
+bool checksum_parse_header(const uint8_t *header, size_t *chunk_size, size_t *file_size) {
+    if (header == NULL || memcmp(header, CHECKSUM_MAGIC, strlen(CHECKSUM_MAGIC)) != 0 || header[4] != CHECKSUM_VERSION ||
+        header[5] != 0 || header[6] != 0 || header[7] != 0) {
+        return false;
+    }
+    *chunk_size = load_be32(header + 8);
+    *file_size = load_be32(header + 12);
+    return *chunk_size > 0 && *chunk_size <= CHECKSUM_MAX_CHUNK_SIZE;
+}
+
+bool package_is_checksummed(const FilePackage *package) {
+    size_t chunk_size, file_size;
+    return package != NULL && package->data != NULL && package->size >= CHECKSUM_HEADER_SIZE &&
+           checksum_parse_header(package->data, &chunk_size, &file_size);
+}
+
+static void verify_chunks_task(void *arg) {
+    ChunkTask *task = arg;
+    ChunkVerification *verification = task->verification;
+    for (size_t i = task->first; i < task->end; i++) {
+        // Chunks after a damaged one are not needed to find the first
+        if (verification->stop_at_first && i > atomic_load(&verification->first_damaged)) {
+            return;
+        }
+        size_t offset = i * verification->chunk_size;
+        size_t length = verification->file_size - offset < verification->chunk_size ? verification->file_size - offset : verification->chunk_size;
+        atomic_fetch_add(&verification->checked, 1);
+        if (crc32c(0, verification->file + offset, length) == load_be32(verification->table + i * sizeof(uint32_t))) {
+            continue;
+        }
+        verification->damaged[i] = true;
+        size_t first = atomic_load(&verification->first_damaged);
+        while (i < first && !atomic_compare_exchange_weak(&verification->first_damaged, &first, i)) {
+        }
+    }
+}
+
+/**
+ * @brief Log the damaged chunks, joining consecutive ones in a single range.
+ */
+static void log_damaged_ranges(const ChunkVerification *verification) {
+    for (size_t i = 0; i < verification->chunks; i++) {
+        if (!verification->damaged[i]) {
+            continue;
+        }
+        size_t end = i;
+        while (end + 1 < verification->chunks && verification->damaged[end + 1]) {
+            end++;
+        }
+        size_t last = (end + 1) * verification->chunk_size;
+        LOG(ERROR, "Damaged bytes [%zu, %zu) of the hidden file.", i * verification->chunk_size,
+            last < verification->file_size ? last : verification->file_size)
+        i = end;
+    }
+}
+
+bool verify_file_package(FilePackage *package, ThreadPool *pool, bool stop_at_first, ChecksumReport *report) {
+    size_t chunk_size = 0, file_size = 0;
+    if (!package_is_checksummed(package) || !checksum_parse_header(package->data, &chunk_size, &file_size)) {
+        LOG(ERROR, "The package is not chunked.")
+        return false;
+    }
+    size_t overhead = checksum_overhead(chunk_size, file_size);
+    if (package->size != overhead + file_size) {
+        LOG(ERROR, "The chunked package is truncated: %u bytes instead of %zu.", package->size, overhead + file_size)
+        return false;
+    }
+
+    ChunkVerification verification = {
+            .table = package->data + CHECKSUM_HEADER_SIZE,
+            .file = package->data + overhead,
+            .file_size = file_size,
+            .chunk_size = chunk_size,
+            .chunks = (overhead - CHECKSUM_HEADER_SIZE) / sizeof(uint32_t),
+            .stop_at_first = stop_at_first,
+            .damaged = NULL
+    };
+    atomic_init(&verification.first_damaged, SIZE_MAX);
+    atomic_init(&verification.checked, 0);
+    size_t task_count = (verification.chunks + CHECKSUM_TASK_CHUNKS - 1) / CHECKSUM_TASK_CHUNKS;
+    verification.damaged = calloc(verification.chunks + 1, sizeof(bool));
+    ChunkTask *tasks = calloc(task_count + 1, sizeof(ChunkTask));
+    if (verification.damaged == NULL || tasks == NULL) {
+        LOG(ERROR, "Memory allocation failed for the chunk verification.")
+        free(verification.damaged);
+        free(tasks);
+        return false;
+    }
+
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t t = 0; t < task_count; t++) {
+        tasks[t].verification = &verification;
+        tasks[t].first = t * CHECKSUM_TASK_CHUNKS;
+        tasks[t].end = tasks[t].first + CHECKSUM_TASK_CHUNKS < verification.chunks ? tasks[t].first + CHECKSUM_TASK_CHUNKS : verification.chunks;
+        if (pool == NULL || task_count == 1 || !thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, verify_chunks_task, &tasks[t])) {
+            verify_chunks_task(&tasks[t]);
+        }
+    }
+    if (pool != NULL) {
+        thread_pool_wait(pool, &group);
+    }
+
+    size_t damaged = 0;
+    for (size_t i = 0; i < verification.chunks; i++) {
+        damaged += verification.damaged[i];
+    }
+    size_t first_damaged = atomic_load(&verification.first_damaged);
+    if (report != NULL) {
+        report->chunks = verification.chunks;
+        report->checked = atomic_load(&verification.checked);
+        report->damaged = damaged;
+        report->first_damaged = first_damaged == SIZE_MAX ? SIZE_MAX : first_damaged * chunk_size;
+    }
+    if (damaged > 0) {
+        log_damaged_ranges(&verification);
+        if (stop_at_first) {
+            LOG(ERROR, "Stopped at the first damaged chunk; later chunks may be damaged too.")
+        }
+    } else {
+        LOG(DEBUG, "Verified %zu chunks of %zu bytes.", verification.chunks, chunk_size)
+        memmove(package->data, package->data + overhead, file_size);
+        package->size = (uint32_t) file_size;
+    }
+    free(verification.damaged);
+    free(tasks);
+    return damaged == 0;
+}
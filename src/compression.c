@@ -0,0 +1,324 @@
+#include "./include/compression.h"
+#include "./include/utils.h"
+#include <openssl/crypto.h>
+#include <zlib.h>
+#ifdef STEGOBMP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESSION_CHUNK (64 * 1024)   // Decompressed bytes produced per step
+#define ZSTD_LEVEL 3
+
+/**
+ * @brief Receives the decompressed file one piece at a time.
+ */
+typedef bool (*ChunkSink)(const uint8_t *chunk, size_t size, void *ctx);
+
+bool compression_available(CompressionAlgorithm algorithm) {
+    switch (algorithm) {
+        case COMPRESSION_DEFLATE: return true;
+#ifdef STEGOBMP_HAVE_ZSTD
+        case COMPRESSION_ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+static size_t compress_bound(CompressionAlgorithm algorithm, size_t size) {
+    (void) algorithm;
+#ifdef STEGOBMP_HAVE_ZSTD
+    if (algorithm == COMPRESSION_ZSTD) {
+        return ZSTD_compressBound(size);
+    }
+#endif
+    return compressBound((uLong) size);
+}
+
+/**
+ * @brief Compress `input` into `output`, which holds `*output_size` bytes. Sets the compressed size.
+ */
+static bool compress_data(CompressionAlgorithm algorithm, const uint8_t *input, size_t input_size, uint8_t *output, size_t *output_size) {
+    (void) algorithm;
+#ifdef STEGOBMP_HAVE_ZSTD
+    if (algorithm == COMPRESSION_ZSTD) {
+        size_t result = ZSTD_compress(output, *output_size, input, input_size, ZSTD_LEVEL);
+        if (ZSTD_isError(result)) {
+            LOG(ERROR, "zstd compression failed: %s.", ZSTD_getErrorName(result))
+            return false;
+        }
+        *output_size = result;
+        return true;
+    }
+#endif
+    uLongf compressed_size = (uLongf) *output_size;
+    int result = compress2(output, &compressed_size, input, (uLong) input_size, Z_DEFAULT_COMPRESSION);
+    if (result != Z_OK) {
+        LOG(ERROR, "Deflate compression failed: %d.", result)
+        return false;
+    }
+    *output_size = compressed_size;
+    return true;
+}
+
+static bool inflate_to_sink(const uint8_t *input, size_t input_size, uint64_t expected, ChunkSink sink, void *ctx) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        LOG(ERROR, "Could not initialize the deflate decompressor.")
+        return false;
+    }
+    uint8_t chunk[COMPRESSION_CHUNK];
+    stream.next_in = (Bytef *) input;
+    stream.avail_in = (uInt) input_size;
+    uint64_t total = 0;
+    int result = Z_OK;
+    bool ok = true;
+    while (ok && result != Z_STREAM_END) {
+        stream.next_out = chunk;
+        stream.avail_out = sizeof(chunk);
+        result = inflate(&stream, Z_NO_FLUSH);
+        size_t produced = sizeof(chunk) - stream.avail_out;
+        total += produced;
+        // Z_BUF_ERROR means no progress was possible: the stream is truncated
+        ok = (result == Z_OK || result == Z_STREAM_END) && total <= expected && sink(chunk, produced, ctx);
+    }
+    inflateEnd(&stream);
+    return ok && total == expected && stream.avail_in == 0;
+}
+
+#ifdef STEGOBMP_HAVE_ZSTD
+static bool zstd_to_sink(const uint8_t *input, size_t input_size, uint64_t expected, ChunkSink sink, void *ctx) {
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (stream == NULL || ZSTD_isError(ZSTD_initDStream(stream))) {
+        LOG(ERROR, "Could not initialize the zstd decompressor.")
+        ZSTD_freeDStream(stream);
+        return false;
+    }
+    uint8_t chunk[COMPRESSION_CHUNK];
+    ZSTD_inBuffer in = {input, input_size, 0};
+    uint64_t total = 0;
+    size_t result = 1;
+    bool ok = true;
+    while (ok && result != 0) {
+        ZSTD_outBuffer out = {chunk, sizeof(chunk), 0};
+        result = ZSTD_decompressStream(stream, &out, &in);
+        total += out.pos;
+        // Without input left, a frame that still expects data is truncated
+        ok = !ZSTD_isError(result) && total <= expected && sink(chunk, out.pos, ctx) &&
+             (result == 0 || in.pos < in.size || out.pos == out.size);
+    }
+    ZSTD_freeDStream(stream);
+    return ok && total == expected && in.pos == in.size;
+}
+#endif
+
+/**
+ * @brief Read the codec of a compressed package, from its header, and the original size, from its data.
+ */
+static bool parse_header(const FilePackage *package, CompressionAlgorithm *algorithm, uint64_t *original_size) {
+    if (package == NULL || package->compression == COMPRESSION_NONE || package->data == NULL ||
+        package->size < COMPRESSION_SIZE_FIELD) {
+        return false;
+    }
+    *algorithm = package->compression;
+    *original_size = load_be64(package->data);
+    return true;
+}
+
+/**
+ * @brief Decompress the data of a package, passing the original file to `sink` piece by piece.
+ */
+static bool decompress_to_sink(const FilePackage *package, ChunkSink sink, void *ctx) {
+    CompressionAlgorithm algorithm = COMPRESSION_NONE;
+    uint64_t original_size = 0;
+    if (!parse_header(package, &algorithm, &original_size)) {
+        LOG(ERROR, "The package is not compressed.")
+        return false;
+    }
+    if (!compression_available(algorithm)) {
+        LOG(ERROR, "The package was compressed with %s, which this build does not support.", compression_algorithm_to_string(algorithm))
+        return false;
+    }
+    const uint8_t *input = package->data + COMPRESSION_SIZE_FIELD;
+    size_t input_size = package->size - COMPRESSION_SIZE_FIELD;
+    bool ok = false;
+#ifdef STEGOBMP_HAVE_ZSTD
+    if (algorithm == COMPRESSION_ZSTD) {
+        ok = zstd_to_sink(input, input_size, original_size, sink, ctx);
+    } else
+#endif
+    {
+        ok = inflate_to_sink(input, input_size, original_size, sink, ctx);
+    }
+    if (!ok) {
+        LOG(ERROR, "The compressed data is corrupted.")
+    }
+    return ok;
+}
+
+/**
+ * @brief Write the original size and the compressed data to `output`, which holds
+ * COMPRESSION_SIZE_FIELD + compress_bound bytes. Returns the bytes written, or 0 on error.
+ */
+static size_t compress_to(const uint8_t *data, size_t size, CompressionAlgorithm algorithm, uint8_t *output) {
+    size_t capacity = compress_bound(algorithm, size);
+    if (!compress_data(algorithm, data, size, output + COMPRESSION_SIZE_FIELD, &capacity)) {
+        return 0;
+    }
+    store_be64(output, size);
+    return COMPRESSION_SIZE_FIELD + capacity;
+}
+
+uint8_t* compress_buffer(const uint8_t *data, size_t size, CompressionAlgorithm algorithm, size_t *compressed_size) {
+    *compressed_size = 0;
+    if (data == NULL || !compression_available(algorithm)) {
+        LOG(ERROR, "Compression %s is not available in this build.", compression_algorithm_to_string(algorithm))
+        return NULL;
+    }
+    uint8_t *compressed = mem_alloc(COMPRESSION_SIZE_FIELD + compress_bound(algorithm, size));
+    if (compressed == NULL) {
+        LOG(ERROR, "Memory allocation failed for the compressed data.")
+        return NULL;
+    }
+    size_t written = compress_to(data, size, algorithm, compressed);
+    if (written == 0 || written >= size) {
+        mem_free(compressed);
+        return NULL;
+    }
+    *compressed_size = written;
+    return compressed;
+}
+
+bool compress_package(uint8_t **package, size_t *size, CompressionAlgorithm algorithm) {
+    if (package == NULL || *package == NULL || size == NULL || *size < sizeof(uint32_t)) {
+        LOG(ERROR, "Invalid package to compress.")
+        return false;
+    }
+    if (!compression_available(algorithm)) {
+        LOG(ERROR, "Compression %s is not available in this build.", compression_algorithm_to_string(algorithm))
+        return false;
+    }
+    // Only a plain package can be compressed: its header is then replaced by the compressed one
+    const uint8_t *source = *package;
+    uint64_t data_size = 0;
+    size_t header_size = parse_package_header(source, *size, &data_size, NULL);
+    if (header_size != PACKAGE_SIZE_FIELD || header_size + data_size > *size) {
+        LOG(ERROR, "Invalid package to compress.")
+        return false;
+    }
+    const uint8_t *extension = source + header_size + data_size;
+    size_t extension_size = *size - header_size - (size_t) data_size;
+
+    uint8_t *compressed = mem_alloc(PACKAGE_LARGE_HEADER_SIZE + COMPRESSION_SIZE_FIELD + compress_bound(algorithm, data_size) + extension_size);
+    if (compressed == NULL) {
+        LOG(ERROR, "Memory allocation failed for the compressed package.")
+        return false;
+    }
+    size_t compressed_data_size = compress_to(source + header_size, data_size, algorithm, compressed + PACKAGE_LARGE_HEADER_SIZE);
+    if (compressed_data_size == 0) {
+        mem_free(compressed);
+        return false;
+    }
+    // The compressed header is larger, so it has to pay for itself too
+    if (compressed_data_size + PACKAGE_LARGE_HEADER_SIZE >= data_size + header_size) {
+        LOG(INFO, "Compression does not reduce the payload (%zu bytes), storing it as is.", (size_t) data_size)
+        mem_free(compressed);
+        return true;
+    }
+
+    write_package_header(compressed, compressed_data_size, false, algorithm);
+    memcpy(compressed + PACKAGE_LARGE_HEADER_SIZE + compressed_data_size, extension, extension_size);
+    LOG(INFO, "Compressed the payload with %s: %zu -> %zu bytes.", compression_algorithm_to_string(algorithm), (size_t) data_size, compressed_data_size)
+
+    // The raw file may be sensitive
+    OPENSSL_cleanse(*package, *size);
+    mem_free(*package);
+    *package = compressed;
+    *size = PACKAGE_LARGE_HEADER_SIZE + compressed_data_size + extension_size;
+    return true;
+}
+
+bool package_is_compressed(const FilePackage *package) {
+    return package != NULL && package->compression != COMPRESSION_NONE;
+}
+
+typedef struct {
+    uint8_t *buffer;
+    size_t used;
+} BufferSink;
+
+static bool write_to_buffer(const uint8_t *chunk, size_t size, void *ctx) {
+    BufferSink *sink = ctx;
+    memcpy(sink->buffer + sink->used, chunk, size);
+    sink->used += size;
+    return true;
+}
+
+bool decompress_file_package(FilePackage *package) {
+    CompressionAlgorithm algorithm;
+    uint64_t original_size = 0;
+    if (!parse_header(package, &algorithm, &original_size) || original_size > UINT32_MAX) {
+        LOG(ERROR, "Invalid compressed package.")
+        return false;
+    }
+    // decompress_to_sink never produces more than original_size bytes; +1 so an empty file is not a malloc(0)
+    BufferSink sink = {mem_alloc((size_t) original_size + 1), 0};
+    if (sink.buffer == NULL) {
+        LOG(ERROR, "Memory allocation failed for the decompressed file.")
+        return false;
+    }
+    if (!decompress_to_sink(package, write_to_buffer, &sink)) {
+        mem_free(sink.buffer);
+        return false;
+    }
+    mem_free(package->data);
+    package->data = sink.buffer;
+    package->size = (uint32_t) original_size;
+    package->compression = COMPRESSION_NONE;
+    return true;
+}
+
+static bool write_to_file(const uint8_t *chunk, size_t size, void *ctx) {
+    return fwrite(chunk, 1, size, (FILE *) ctx) == size;
+}
+
+int create_file_from_compressed_package(const char *file_name, const FilePackage *package) {
+    if (file_name == NULL || package == NULL || package->extension == NULL) {
+        LOG(ERROR, "Invalid filename or FilePackage.")
+        return -1;
+    }
+    size_t full_name_length = strlen(file_name) + strlen((const char *) package->extension) + 1;
+    char *full_name = mem_alloc(full_name_length);
+    if (full_name == NULL) {
+        LOG(ERROR, "Could not allocate memory for the full filename.")
+        return -1;
+    }
+    snprintf(full_name, full_name_length, "%s%s", file_name, package->extension);
+
+    FILE *file = fopen(full_name, "wb");
+    if (file == NULL) {
+        LOG(ERROR, "Could not open file %s for writing.", full_name)
+        mem_free(full_name);
+        return -1;
+    }
+    bool ok = decompress_to_sink(package, write_to_file, file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        // Do not leave a truncated file behind
+        LOG(ERROR, "Error writing the decompressed file %s.", full_name)
+        remove(full_name);
+    } else {
+        LOG(INFO, "[File] Successfully created file %s from %u compressed bytes.", full_name, package->size)
+    }
+    mem_free(full_name);
+    return ok ? 1 : -1;
+}
+
+const char* compression_algorithm_to_string(CompressionAlgorithm algorithm) {
+    switch (algorithm) {
+        case COMPRESSION_NONE: return "none";
+        case COMPRESSION_DEFLATE: return "deflate";
+        case COMPRESSION_ZSTD: return "zstd";
+        default: return "UNKNOWN";
+    }
+}
@@ -1,25 +1,50 @@
 #include "crypto.h"
+#include <pthread.h>
+#include <openssl/sha.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 
+#define CRYPTO_MAX_UPDATE_SIZE (1 << 30)    // Máximo de bytes por llamada a EVP_*Update (usa int)
 
 /**
- * @brief Obtiene el cipher de OpenSSL correspondiente al algoritmo y modo especificados.
+ * @brief Cantidad máxima de threads para el procesamiento paralelo del thread actual. 0 = cantidad de CPUs disponibles.
+ *
+ * Es por thread para que los trabajos que corren a la vez (por ejemplo en -batch) fijen cada uno la suya.
+ */
+static __thread size_t crypto_max_threads = 0;
+
+
+/**
+ * @brief Obtiene el cipher integrado de OpenSSL correspondiente al algoritmo y modo especificados.
+ *
+ * Solo se usa para construir la tabla de ciphers precargados; el resto del módulo usa determine_cipher.
  *
  * @param encryption Algoritmo de encriptación.
  * @param mode       Modo de encriptación.
  * @return const EVP_CIPHER* Cipher de OpenSSL correspondiente, o NULL si no se encuentra.
  */
-const EVP_CIPHER* determine_cipher(EncryptionAlgorithm encryption, EncryptionMode mode) {
+static const EVP_CIPHER* builtin_cipher(EncryptionAlgorithm encryption, EncryptionMode mode) {
     switch (encryption) {
         case ENC_AES128:
             switch (mode) {
                 case ENC_MODE_ECB:
                     return EVP_aes_128_ecb();
-                case ENC_MODE_CFB:
+                case ENC_MODE_CFB:      // Alias histórico: CFB de 1 bit
+                case ENC_MODE_CFB1:
                     return EVP_aes_128_cfb1();
+                case ENC_MODE_CFB8:
+                    return EVP_aes_128_cfb8();
+                case ENC_MODE_CFB128:
+                    return EVP_aes_128_cfb128();
                 case ENC_MODE_OFB:
                     return EVP_aes_128_ofb();
                 case ENC_MODE_CBC:
                     return EVP_aes_128_cbc();
+                case ENC_MODE_GCM:
+                    return EVP_aes_128_gcm();
+                case ENC_MODE_CTR:
+                    return EVP_aes_128_ctr();
                 default:
                     return NULL;
             }
@@ -27,12 +52,21 @@ const EVP_CIPHER* determine_cipher(EncryptionAlgorithm encryption, EncryptionMod
             switch (mode) {
                 case ENC_MODE_ECB:
                     return EVP_aes_192_ecb();
-                case ENC_MODE_CFB:
+                case ENC_MODE_CFB:      // Alias histórico: CFB de 1 bit
+                case ENC_MODE_CFB1:
                     return EVP_aes_192_cfb1();
+                case ENC_MODE_CFB8:
+                    return EVP_aes_192_cfb8();
+                case ENC_MODE_CFB128:
+                    return EVP_aes_192_cfb128();
                 case ENC_MODE_OFB:
                     return EVP_aes_192_ofb();
                 case ENC_MODE_CBC:
                     return EVP_aes_192_cbc();
+                case ENC_MODE_GCM:
+                    return EVP_aes_192_gcm();
+                case ENC_MODE_CTR:
+                    return EVP_aes_192_ctr();
                 default:
                     return NULL;
             }
@@ -40,12 +74,21 @@ const EVP_CIPHER* determine_cipher(EncryptionAlgorithm encryption, EncryptionMod
             switch (mode) {
                 case ENC_MODE_ECB:
                     return EVP_aes_256_ecb();
-                case ENC_MODE_CFB:
+                case ENC_MODE_CFB:      // Alias histórico: CFB de 1 bit
+                case ENC_MODE_CFB1:
                     return EVP_aes_256_cfb1();
+                case ENC_MODE_CFB8:
+                    return EVP_aes_256_cfb8();
+                case ENC_MODE_CFB128:
+                    return EVP_aes_256_cfb128();
                 case ENC_MODE_OFB:
                     return EVP_aes_256_ofb();
                 case ENC_MODE_CBC:
                     return EVP_aes_256_cbc();
+                case ENC_MODE_GCM:
+                    return EVP_aes_256_gcm();
+                case ENC_MODE_CTR:
+                    return EVP_aes_256_ctr();
                 default:
                     return NULL;
             }
@@ -53,121 +96,1270 @@ const EVP_CIPHER* determine_cipher(EncryptionAlgorithm encryption, EncryptionMod
             switch (mode) {
                 case ENC_MODE_ECB:
                     return EVP_des_ede3_ecb();
-                case ENC_MODE_CFB:
+                case ENC_MODE_CFB:      // Alias histórico: CFB de 8 bits
+                case ENC_MODE_CFB8:
                     return EVP_des_ede3_cfb8();
+                case ENC_MODE_CFB1:
+                    return EVP_des_ede3_cfb1();
+                case ENC_MODE_CFB128:   // CFB de bloque completo (64 bits en 3DES)
+                    return EVP_des_ede3_cfb64();
                 case ENC_MODE_OFB:
-                    LOG(INFO, "[Crypto] Using DES OFB mode.")
                     return EVP_des_ede3_ofb();
                 case ENC_MODE_CBC:
                     return EVP_des_ede3_cbc();
                 default:
                     return NULL;
             }
+        case ENC_CHACHA20:
+            // ChaCha20 solo se usa en su construcción autenticada, el modo es implícito.
+            return EVP_chacha20_poly1305();
         case ENC_NONE:
         default:
             return NULL;
     }
 }
 
-uint8_t* crypto_encrypt(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const char *password, size_t *encrypted_size) {
-    if (!data || size == 0 || !password || !encrypted_size) {
-        LOG(ERROR, "Invalid arguments to crypto_encrypt.")
+/*********************************************
+ ****  CIPHERS PRECARGADOS Y CONTEXTOS POR THREAD  ****
+ *********************************************/
+#define CRYPTO_ALGORITHM_COUNT (ENC_CHACHA20 + 1)      // Cantidad de valores de EncryptionAlgorithm
+#define CRYPTO_MODE_COUNT (ENC_MODE_CTR + 1)           // Cantidad de valores de EncryptionMode
+#define CRYPTO_KEY_MATERIAL_SIZE (EVP_MAX_KEY_LENGTH + EVP_MAX_IV_LENGTH)
+
+/**
+ * @brief Tabla de ciphers resueltos una sola vez. En OpenSSL 3 cada entrada se obtiene con
+ * EVP_CIPHER_fetch, evitando la búsqueda implícita del proveedor en cada EVP_*Init_ex.
+ */
+static const EVP_CIPHER *cipher_table[CRYPTO_ALGORITHM_COUNT][CRYPTO_MODE_COUNT];
+static EVP_CIPHER *fetched_ciphers[CRYPTO_ALGORITHM_COUNT][CRYPTO_MODE_COUNT];
+static bool ciphers_released = false;
+
+static pthread_once_t crypto_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_state_key;
+
+/**
+ * @brief Estado reutilizable de cada thread: un contexto de cifrado que se reinicia con
+ * EVP_CIPHER_CTX_reset entre operaciones y un buffer para la clave e IV derivados,
+ * bloqueado en memoria (mlock) para que no termine en swap.
+ */
+typedef struct {
+    EVP_CIPHER_CTX *ctx;
+    unsigned char *key_material;
+    bool locked;
+} CryptoThreadState;
+
+static void free_thread_state(void *arg) {
+    CryptoThreadState *state = (CryptoThreadState *) arg;
+    if (!state) {
+        return;
+    }
+    EVP_CIPHER_CTX_free(state->ctx);
+    if (state->key_material) {
+        OPENSSL_cleanse(state->key_material, CRYPTO_KEY_MATERIAL_SIZE);
+        if (state->locked) {
+            munlock(state->key_material, CRYPTO_KEY_MATERIAL_SIZE);
+        }
+        free(state->key_material);
+    }
+    free(state);
+}
+
+static void crypto_init_once(void) {
+    pthread_key_create(&thread_state_key, free_thread_state);
+
+    for (int algorithm = 0; algorithm < CRYPTO_ALGORITHM_COUNT; algorithm++) {
+        for (int mode = 0; mode < CRYPTO_MODE_COUNT; mode++) {
+            const EVP_CIPHER *builtin = builtin_cipher((EncryptionAlgorithm) algorithm, (EncryptionMode) mode);
+            cipher_table[algorithm][mode] = builtin;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            if (builtin) {
+                fetched_ciphers[algorithm][mode] = EVP_CIPHER_fetch(NULL, EVP_CIPHER_get0_name(builtin), NULL);
+                if (fetched_ciphers[algorithm][mode]) {
+                    cipher_table[algorithm][mode] = fetched_ciphers[algorithm][mode];
+                }
+            }
+#endif
+        }
+    }
+    LOG(DEBUG, "[Crypto] Tabla de ciphers precargada.")
+}
+
+void crypto_init(void) {
+    pthread_once(&crypto_once, crypto_init_once);
+}
+
+void crypto_cleanup(void) {
+    crypto_init();
+
+    CryptoThreadState *state = pthread_getspecific(thread_state_key);
+    pthread_setspecific(thread_state_key, NULL);
+    free_thread_state(state);
+    crypto_set_key_cache(0);
+
+    // Las consultas posteriores vuelven a los ciphers integrados
+    ciphers_released = true;
+    for (int algorithm = 0; algorithm < CRYPTO_ALGORITHM_COUNT; algorithm++) {
+        for (int mode = 0; mode < CRYPTO_MODE_COUNT; mode++) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            EVP_CIPHER_free(fetched_ciphers[algorithm][mode]);
+#endif
+            fetched_ciphers[algorithm][mode] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Obtiene el cipher de OpenSSL correspondiente al algoritmo y modo especificados.
+ *
+ * @param encryption Algoritmo de encriptación.
+ * @param mode       Modo de encriptación.
+ * @return const EVP_CIPHER* Cipher de OpenSSL correspondiente, o NULL si no se encuentra.
+ */
+const EVP_CIPHER* determine_cipher(EncryptionAlgorithm encryption, EncryptionMode mode) {
+    if ((int) encryption < 0 || encryption >= CRYPTO_ALGORITHM_COUNT || (int) mode < 0 || mode >= CRYPTO_MODE_COUNT) {
         return NULL;
     }
+    crypto_init();
+    if (ciphers_released) {
+        return builtin_cipher(encryption, mode);
+    }
+    return cipher_table[encryption][mode];
+}
+
+/**
+ * @brief Devuelve el estado del thread actual, creándolo en el primer uso.
+ */
+static CryptoThreadState* thread_state(void) {
+    crypto_init();
+
+    CryptoThreadState *state = pthread_getspecific(thread_state_key);
+    if (state) {
+        return state;
+    }
+
+    state = calloc(1, sizeof(CryptoThreadState));
+    if (!state) {
+        LOG(ERROR, "Memory allocation failed for crypto thread state.")
+        return NULL;
+    }
+    state->ctx = EVP_CIPHER_CTX_new();
+    state->key_material = calloc(1, CRYPTO_KEY_MATERIAL_SIZE);
+    if (!state->ctx || !state->key_material) {
+        LOG(ERROR, "Failed to create EVP_CIPHER_CTX.")
+        free_thread_state(state);
+        return NULL;
+    }
+    // Si el límite de memoria bloqueable no lo permite se sigue sin mlock
+    state->locked = mlock(state->key_material, CRYPTO_KEY_MATERIAL_SIZE) == 0;
+    if (!state->locked) {
+        LOG(DEBUG, "[Crypto] No se pudo bloquear en memoria el buffer de claves.")
+    }
+
+    pthread_setspecific(thread_state_key, state);
+    return state;
+}
+
+/**
+ * @brief Devuelve el contexto de cifrado del thread actual, reiniciado y listo para un EVP_*Init_ex.
+ */
+static EVP_CIPHER_CTX* thread_cipher_ctx(void) {
+    CryptoThreadState *state = thread_state();
+    if (!state || EVP_CIPHER_CTX_reset(state->ctx) != 1) {
+        return NULL;
+    }
+    return state->ctx;
+}
+
+/**
+ * @brief Devuelve el buffer de CRYPTO_KEY_MATERIAL_SIZE bytes para la clave e IV del thread actual.
+ */
+static unsigned char* thread_key_material(void) {
+    CryptoThreadState *state = thread_state();
+    return state ? state->key_material : NULL;
+}
+
+/**
+ * @brief Borra la clave derivada y el key schedule del contexto del thread actual al terminar una operación.
+ */
+static void release_thread_state(void) {
+    CryptoThreadState *state = pthread_getspecific(thread_state_key);
+    if (state) {
+        EVP_CIPHER_CTX_reset(state->ctx);
+        OPENSSL_cleanse(state->key_material, CRYPTO_KEY_MATERIAL_SIZE);
+    }
+}
+
+bool crypto_is_aead(EncryptionAlgorithm encryption, EncryptionMode mode) {
+    if (encryption == ENC_CHACHA20) {
+        return true;
+    }
+    return mode == ENC_MODE_GCM && (encryption == ENC_AES128 || encryption == ENC_AES192 || encryption == ENC_AES256);
+}
+
+/*************************
+ ****  DERIVACIÓN DE CLAVES  ****
+ *************************/
+void crypto_kdf_defaults(KdfParams *kdf) {
+    if (kdf->algorithm == KDF_NONE) {
+        kdf->algorithm = KDF_PBKDF2_SHA256;
+    }
+    if (kdf->algorithm == KDF_SCRYPT) {
+        kdf->iterations = 0;
+        kdf->scrypt_n = kdf->scrypt_n ? kdf->scrypt_n : CRYPTO_SCRYPT_N;
+        kdf->scrypt_r = kdf->scrypt_r ? kdf->scrypt_r : CRYPTO_SCRYPT_R;
+        kdf->scrypt_p = kdf->scrypt_p ? kdf->scrypt_p : CRYPTO_SCRYPT_P;
+    } else {
+        kdf->iterations = kdf->iterations ? kdf->iterations : CRYPTO_KDF_ITERATIONS;
+        kdf->scrypt_n = 0;
+        kdf->scrypt_r = 0;
+        kdf->scrypt_p = 0;
+    }
+}
+
+bool crypto_kdf_valid(const KdfParams *kdf) {
+    KdfParams params = *kdf;
+    crypto_kdf_defaults(&params);
+    switch (params.algorithm) {
+        case KDF_PBKDF2_SHA256:
+        case KDF_PBKDF2_SHA512:
+            return params.iterations <= CRYPTO_KDF_MAX_ITERATIONS;
+        case KDF_SCRYPT:
+            return params.scrypt_n >= 2 && params.scrypt_n <= ((uint64_t) 1 << CRYPTO_SCRYPT_MAX_LOG_N)
+                    && (params.scrypt_n & (params.scrypt_n - 1)) == 0
+                    && (uint64_t) params.scrypt_r * params.scrypt_p < CRYPTO_SCRYPT_MAX_RP;
+        default:
+            return false;
+    }
+}
+
+bool crypto_kdf_available(KdfAlgorithm algorithm) {
+    switch (algorithm) {
+        case KDF_PBKDF2_SHA256:
+        case KDF_PBKDF2_SHA512:
+            return true;
+        case KDF_SCRYPT:
+#ifndef OPENSSL_NO_SCRYPT
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+/*********************************************
+ ****  CACHE DE CLAVES DERIVADAS  ****
+ *********************************************/
+
+/**
+ * @brief Entrada del cache: se identifica por un SHA-256 de los parámetros, la sal y la contraseña,
+ * así que la contraseña no queda guardada en el cache.
+ */
+typedef struct {
+    bool used;
+    uint8_t id[SHA256_DIGEST_LENGTH];
+    size_t out_len;
+    uint8_t key[CRYPTO_KEY_MATERIAL_SIZE];
+    uint64_t last_use;      // Para reemplazar la entrada usada hace más tiempo
+} KeyCacheEntry;
+
+static pthread_mutex_t key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static KeyCacheEntry *key_cache = NULL;
+static size_t key_cache_size = 0;
+static bool key_cache_locked = false;
+static uint64_t key_cache_clock = 0;
+static size_t key_cache_hits = 0;
+static size_t key_cache_misses = 0;
+
+void crypto_set_key_cache(size_t entries) {
+    pthread_mutex_lock(&key_cache_lock);
+    if (key_cache) {
+        OPENSSL_cleanse(key_cache, key_cache_size * sizeof(KeyCacheEntry));
+        if (key_cache_locked) {
+            munlock(key_cache, key_cache_size * sizeof(KeyCacheEntry));
+        }
+        free(key_cache);
+    }
+    key_cache = entries > 0 ? calloc(entries, sizeof(KeyCacheEntry)) : NULL;
+    key_cache_size = key_cache ? entries : 0;
+    key_cache_locked = key_cache && mlock(key_cache, entries * sizeof(KeyCacheEntry)) == 0;
+    key_cache_hits = 0;
+    key_cache_misses = 0;
+    pthread_mutex_unlock(&key_cache_lock);
+
+    if (entries > 0 && !key_cache) {
+        LOG(ERROR, "No se pudo reservar memoria para el cache de claves.")
+    }
+}
+
+void crypto_key_cache_stats(size_t *hits, size_t *misses) {
+    pthread_mutex_lock(&key_cache_lock);
+    if (hits) {
+        *hits = key_cache_hits;
+    }
+    if (misses) {
+        *misses = key_cache_misses;
+    }
+    pthread_mutex_unlock(&key_cache_lock);
+}
+
+/**
+ * @brief Calcula el identificador de una derivación: SHA-256 del KDF, sus parámetros, la sal, el largo pedido y la contraseña.
+ */
+static bool key_cache_id(const KdfParams *kdf, const char *password, const uint8_t *salt, size_t salt_len, size_t out_len, uint8_t *id) {
+    uint8_t params[29];
+    params[0] = (uint8_t) kdf->algorithm;
+    store_be32(params + 1, kdf->iterations);
+    store_be32(params + 5, (uint32_t) (kdf->scrypt_n >> 32));
+    store_be32(params + 9, (uint32_t) kdf->scrypt_n);
+    store_be32(params + 13, kdf->scrypt_r);
+    store_be32(params + 17, kdf->scrypt_p);
+    store_be32(params + 21, (uint32_t) salt_len);
+    store_be32(params + 25, (uint32_t) out_len);
+
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    bool ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+              EVP_DigestUpdate(ctx, params, sizeof(params)) &&
+              EVP_DigestUpdate(ctx, salt, salt_len) &&
+              EVP_DigestUpdate(ctx, password, strlen(password)) &&
+              EVP_DigestFinal_ex(ctx, id, NULL);
+    EVP_MD_CTX_free(ctx);
+    return ok;
+}
+
+static bool key_cache_enabled(void) {
+    pthread_mutex_lock(&key_cache_lock);
+    bool enabled = key_cache_size > 0;
+    pthread_mutex_unlock(&key_cache_lock);
+    return enabled;
+}
+
+static bool key_cache_lookup(const uint8_t *id, uint8_t *out, size_t out_len) {
+    bool found = false;
+    pthread_mutex_lock(&key_cache_lock);
+    for (size_t i = 0; i < key_cache_size && !found; i++) {
+        KeyCacheEntry *entry = &key_cache[i];
+        if (entry->used && entry->out_len == out_len && CRYPTO_memcmp(entry->id, id, SHA256_DIGEST_LENGTH) == 0) {
+            memcpy(out, entry->key, out_len);
+            entry->last_use = ++key_cache_clock;
+            found = true;
+        }
+    }
+    if (key_cache_size > 0) {
+        if (found) {
+            key_cache_hits++;
+        } else {
+            key_cache_misses++;
+        }
+    }
+    pthread_mutex_unlock(&key_cache_lock);
+    return found;
+}
+
+static void key_cache_store(const uint8_t *id, const uint8_t *key, size_t out_len) {
+    pthread_mutex_lock(&key_cache_lock);
+    KeyCacheEntry *oldest = NULL;
+    for (size_t i = 0; i < key_cache_size; i++) {
+        if (!key_cache[i].used || oldest == NULL || key_cache[i].last_use < oldest->last_use) {
+            oldest = &key_cache[i];
+            if (!oldest->used) {
+                break;
+            }
+        }
+    }
+    if (oldest) {
+        oldest->used = true;
+        memcpy(oldest->id, id, SHA256_DIGEST_LENGTH);
+        memcpy(oldest->key, key, out_len);
+        oldest->out_len = out_len;
+        oldest->last_use = ++key_cache_clock;
+    }
+    pthread_mutex_unlock(&key_cache_lock);
+}
+
+static bool kdf_derive_uncached(const KdfParams *kdf, const char *password, const uint8_t *salt, size_t salt_len, uint8_t *out, size_t out_len) {
+    switch (kdf->algorithm) {
+        case KDF_PBKDF2_SHA256:
+        case KDF_PBKDF2_SHA512: {
+            const EVP_MD *digest = kdf->algorithm == KDF_PBKDF2_SHA512 ? EVP_sha512() : EVP_sha256();
+            if (!PKCS5_PBKDF2_HMAC(password, (int) strlen(password), salt, (int) salt_len, (int) kdf->iterations, digest, (int) out_len, out)) {
+                LOG(ERROR, "PKCS5_PBKDF2_HMAC failed.")
+                return false;
+            }
+            return true;
+        }
+        case KDF_SCRYPT: {
+#ifndef OPENSSL_NO_SCRYPT
+            // Memoria que usa scrypt (128 * r * (N + p + 2)) más un margen, para no chocar con el límite por defecto
+            uint64_t max_memory = 128ULL * kdf->scrypt_r * (kdf->scrypt_n + kdf->scrypt_p + 2) + 1024 * 1024;
+            if (!EVP_PBE_scrypt(password, strlen(password), salt, salt_len, kdf->scrypt_n, kdf->scrypt_r, kdf->scrypt_p, max_memory, out, out_len)) {
+                LOG(ERROR, "EVP_PBE_scrypt failed.")
+                return false;
+            }
+            return true;
+#else
+            LOG(ERROR, "scrypt is not available in this OpenSSL build.")
+            return false;
+#endif
+        }
+        default:
+            LOG(ERROR, "Unsupported key derivation function.")
+            return false;
+    }
+}
+
+bool crypto_kdf_derive(const KdfParams *kdf, const char *password, const uint8_t *salt, size_t salt_len, uint8_t *out, size_t out_len) {
+    uint8_t id[SHA256_DIGEST_LENGTH];
+    bool cached = out_len <= CRYPTO_KEY_MATERIAL_SIZE && key_cache_enabled() && key_cache_id(kdf, password, salt, salt_len, out_len, id);
+    if (cached && key_cache_lookup(id, out, out_len)) {
+        return true;
+    }
+    if (!kdf_derive_uncached(kdf, password, salt, salt_len, out, out_len)) {
+        return false;
+    }
+    if (cached) {
+        key_cache_store(id, out, out_len);
+    }
+    return true;
+}
+
+/**
+ * @brief Serializa los parámetros del KDF para el encabezado del contenedor.
+ *
+ * @return size_t Cantidad de bytes escritos en `out` (máximo 9).
+ */
+static size_t encode_kdf_params(const KdfParams *kdf, uint8_t *out) {
+    if (kdf->algorithm == KDF_SCRYPT) {
+        uint8_t log_n = 0;
+        while (((uint64_t) 1 << log_n) < kdf->scrypt_n) {
+            log_n++;
+        }
+        out[0] = log_n;
+        store_be32(out + 1, kdf->scrypt_r);
+        store_be32(out + 5, kdf->scrypt_p);
+        return 9;
+    }
+    store_be32(out, kdf->iterations);
+    return 4;
+}
+
+/**
+ * @brief Lee y valida los parámetros del KDF de un encabezado. Rechaza costos fuera de rango
+ * para que un encabezado manipulado no pueda forzar una derivación excesiva.
+ */
+static bool decode_kdf_params(uint8_t id, const uint8_t *params, size_t len, KdfParams *kdf) {
+    memset(kdf, 0, sizeof(KdfParams));
+    kdf->algorithm = (KdfAlgorithm) id;
+    switch (kdf->algorithm) {
+        case KDF_PBKDF2_SHA256:
+        case KDF_PBKDF2_SHA512:
+            if (len != 4) {
+                return false;
+            }
+            kdf->iterations = load_be32(params);
+            return kdf->iterations > 0 && crypto_kdf_valid(kdf);
+        case KDF_SCRYPT:
+            if (len != 9 || params[0] < 1 || params[0] > CRYPTO_SCRYPT_MAX_LOG_N) {
+                return false;
+            }
+            kdf->scrypt_n = (uint64_t) 1 << params[0];
+            kdf->scrypt_r = load_be32(params + 1);
+            kdf->scrypt_p = load_be32(params + 5);
+            return kdf->scrypt_r > 0 && kdf->scrypt_p > 0 && crypto_kdf_valid(kdf);
+        default:
+            return false;
+    }
+}
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double) (end.tv_sec - start->tv_sec) * 1e3 + (double) (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+double crypto_kdf_time(const KdfParams *kdf) {
+    uint8_t salt[CRYPTO_SALT_SIZE] = {0};
+    uint8_t key[32];
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool ok = kdf_derive_uncached(kdf, "kdf-benchmark", salt, sizeof(salt), key, sizeof(key));
+    double ms = elapsed_ms(&start);
+    OPENSSL_cleanse(key, sizeof(key));
+    return ok ? ms : -1.0;
+}
+
+bool crypto_kdf_calibrate(KdfAlgorithm algorithm, double target_ms, KdfParams *kdf, double *measured_ms) {
+    if (!crypto_kdf_available(algorithm) || target_ms <= 0) {
+        return false;
+    }
+    memset(kdf, 0, sizeof(KdfParams));
+    kdf->algorithm = algorithm;
+    crypto_kdf_defaults(kdf);
+
+    if (algorithm == KDF_SCRYPT) {
+        // Se duplica N desde 2^10 y se queda con el mayor que no supera el objetivo
+        KdfParams candidate = *kdf;
+        double best_ms = -1.0;
+        for (int log_n = 10; log_n <= CRYPTO_SCRYPT_MAX_LOG_N - 2; log_n++) {
+            candidate.scrypt_n = (uint64_t) 1 << log_n;
+            double ms = crypto_kdf_time(&candidate);
+            if (ms < 0) {
+                break;
+            }
+            if (best_ms >= 0 && ms > target_ms) {
+                break;
+            }
+            *kdf = candidate;
+            best_ms = ms;
+        }
+        *measured_ms = best_ms;
+        return best_ms >= 0;
+    }
+
+    // PBKDF2 es lineal en las iteraciones: se mide con una cantidad que tarde lo suficiente y se escala
+    double ms = 0;
+    while ((ms = crypto_kdf_time(kdf)) >= 0 && ms < 50.0 && kdf->iterations < CRYPTO_KDF_MAX_ITERATIONS / 2) {
+        kdf->iterations *= 2;
+    }
+    if (ms <= 0) {
+        return false;
+    }
+    double iterations = (double) kdf->iterations * target_ms / ms;
+    iterations = iterations < 1000 ? 1000 : iterations;
+    iterations = iterations > CRYPTO_KDF_MAX_ITERATIONS ? CRYPTO_KDF_MAX_ITERATIONS : iterations;
+    kdf->iterations = ((uint32_t) iterations / 1000) * 1000;
+    *measured_ms = crypto_kdf_time(kdf);
+    return *measured_ms >= 0;
+}
+
+/**
+ * @brief Vista sobre un contenedor cifrado versionado ya validado. Los punteros apuntan al buffer original.
+ */
+typedef struct {
+    uint8_t version;
+    EncryptionAlgorithm encryption;
+    EncryptionMode mode;
+    KdfParams kdf;                  // Leído del encabezado (v2) o implícito (v1)
+    const uint8_t *salt;
+    size_t salt_len;
+    const uint8_t *nonce;
+    size_t nonce_len;
+    const uint8_t *tag;
+    size_t tag_len;
+    size_t aad_len;                 // Bytes del encabezado autenticados como AAD (todo lo previo al tag)
+    const uint8_t *ciphertext;
+    size_t ciphertext_len;
+} CryptoContainer;
+
+static bool ctr_crypt(const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, uint64_t first_block, const uint8_t *input, size_t size, uint8_t *output);
+
+/**
+ * @brief Valida y descompone el encabezado de un contenedor cifrado versionado.
+ *
+ * No registra nada: también se usa para sondear datos que pueden ser un payload legacy.
+ *
+ * @param data      Puntero a los datos cifrados (sin el campo de tamaño).
+ * @param size      Tamaño de los datos en bytes.
+ * @param container Estructura donde se almacenan los campos del encabezado.
+ * @return bool     true si el encabezado es válido, false en caso contrario.
+ */
+static bool parse_container(const uint8_t *data, size_t size, CryptoContainer *container) {
+    size_t index = 0;
+
+    if (size < CRYPTO_CONTAINER_MAGIC_SIZE + 3 || memcmp(data, CRYPTO_CONTAINER_MAGIC, CRYPTO_CONTAINER_MAGIC_SIZE) != 0) {
+        return false;
+    }
+    index += CRYPTO_CONTAINER_MAGIC_SIZE;
+
+    container->version = data[index++];
+    if (container->version != CRYPTO_CONTAINER_VERSION && container->version != CRYPTO_CONTAINER_VERSION_V1) {
+        return false;
+    }
+    container->encryption = (EncryptionAlgorithm) data[index++];
+    container->mode = (EncryptionMode) data[index++];
+
+    if (container->version == CRYPTO_CONTAINER_VERSION_V1) {
+        // v1: PBKDF2-SHA256 con las iteraciones por defecto
+        memset(&container->kdf, 0, sizeof(KdfParams));
+        crypto_kdf_defaults(&container->kdf);
+    } else {
+        if (size - index < 2) {
+            return false;
+        }
+        uint8_t kdf_id = data[index++];
+        size_t params_len = data[index++];
+        if (size - index < params_len || !decode_kdf_params(kdf_id, &data[index], params_len, &container->kdf)) {
+            return false;
+        }
+        index += params_len;
+    }
+
+    // Campos de longitud variable: salt, nonce y tag
+    const uint8_t **fields[] = {&container->salt, &container->nonce, &container->tag};
+    size_t *lengths[] = {&container->salt_len, &container->nonce_len, &container->tag_len};
+    for (int i = 0; i < 3; i++) {
+        if (index >= size) {
+            return false;
+        }
+        *lengths[i] = data[index++];
+        if (i == 2) {
+            container->aad_len = index;
+        }
+        if (size - index < *lengths[i]) {
+            return false;
+        }
+        *fields[i] = &data[index];
+        index += *lengths[i];
+    }
+
+    container->ciphertext = &data[index];
+    container->ciphertext_len = size - index;
+    return true;
+}
+
+/**
+ * @brief Comprueba que el algoritmo, el modo y las longitudes del encabezado sean los que escribe container_encrypt.
+ */
+static bool container_header_valid(const CryptoContainer *container) {
+    bool aead = crypto_is_aead(container->encryption, container->mode);
+    const EVP_CIPHER *cipher = determine_cipher(container->encryption, container->mode);
+    if (!cipher || (container->version == CRYPTO_CONTAINER_VERSION_V1 && !aead)) {
+        return false;
+    }
+    if (aead) {
+        return container->tag_len == CRYPTO_AEAD_TAG_SIZE && container->nonce_len != 0;
+    }
+    return container->tag_len == 0 && container->nonce_len == (size_t) EVP_CIPHER_iv_length(cipher);
+}
+
+/**
+ * @brief Sondea si `data` empieza con un encabezado de contenedor completo y coherente, sin registrar nada.
+ */
+static bool probe_container(const uint8_t *data, size_t size, CryptoContainer *container) {
+    return data != NULL && parse_container(data, size, container) && container_header_valid(container);
+}
+
+bool crypto_is_container(const uint8_t *data, size_t size) {
+    CryptoContainer container;
+    return probe_container(data, size, &container);
+}
+
+/**
+ * @brief EVP_CipherUpdate sobre `size` bytes, en llamadas de hasta CRYPTO_MAX_UPDATE_SIZE.
+ *
+ * Con `output` NULL los bytes se agregan como AAD. En `written` queda la cantidad de bytes escritos.
+ */
+static bool cipher_update(EVP_CIPHER_CTX *ctx, uint8_t *output, const uint8_t *input, size_t size, size_t *written) {
+    *written = 0;
+    size_t done = 0;
+    int len = 0;
+    while (done < size) {
+        size_t chunk = size - done > CRYPTO_MAX_UPDATE_SIZE ? CRYPTO_MAX_UPDATE_SIZE : size - done;
+        if (EVP_CipherUpdate(ctx, output != NULL ? output + *written : NULL, &len, input + done, (int) chunk) != 1) {
+            return false;
+        }
+        done += chunk;
+        *written += (size_t) len;
+    }
+    return true;
+}
+
+/**
+ * @brief Cifra o descifra sin autenticación con el contexto del thread (modos legacy dentro del contenedor).
+ *
+ * A diferencia del formato legacy se usa padding PKCS#7, así que el texto plano recuperado tiene el
+ * tamaño exacto. CTR se procesa en paralelo por segmentos.
+ *
+ * @return bool true si la operación fue exitosa; `output_len` recibe los bytes escritos.
+ */
+static bool container_stream_crypt(const EVP_CIPHER *cipher, EncryptionMode mode, const unsigned char *key, const unsigned char *iv, bool encrypt, const uint8_t *input, size_t size, uint8_t *output, size_t *output_len) {
+    if (mode == ENC_MODE_CTR) {
+        *output_len = size;
+        return ctr_crypt(cipher, key, iv, 0, input, size, output);
+    }
+
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    if (!ctx || EVP_CipherInit_ex(ctx, cipher, NULL, key, iv, encrypt ? 1 : 0) != 1) {
+        return false;
+    }
 
+    size_t written = 0;
+    int len = 0;
+    if (!cipher_update(ctx, output, input, size, &written) || EVP_CipherFinal_ex(ctx, output + written, &len) != 1) {
+        return false;
+    }
+    *output_len = written + len;
+    return true;
+}
+
+/**
+ * @brief Cifra datos y los serializa en el contenedor versionado.
+ *
+ * La clave se deriva con el KDF indicado sobre una sal aleatoria, y el nonce (o el IV en los modos
+ * legacy) es aleatorio; el KDF, sus parámetros, la sal, el nonce y el tag quedan en el encabezado.
+ * El resultado lleva el tamaño del contenedor al principio, igual que el formato legacy.
+ */
+static uint8_t* container_encrypt(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const char *password, const KdfParams *kdf, size_t *encrypted_size) {
     const EVP_CIPHER *cipher = determine_cipher(encryption, mode);
     if (!cipher) {
         LOG(ERROR, "Unsupported encryption algorithm or mode.")
         return NULL;
     }
 
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        LOG(ERROR, "Failed to create EVP_CIPHER_CTX.");
+    bool aead = crypto_is_aead(encryption, mode);
+    size_t nonce_size = aead ? CRYPTO_AEAD_NONCE_SIZE : (size_t) EVP_CIPHER_iv_length(cipher);
+    size_t tag_size = aead ? CRYPTO_AEAD_TAG_SIZE : 0;
+    uint8_t kdf_params[9];
+    size_t kdf_params_size = encode_kdf_params(kdf, kdf_params);
+
+    size_t header_size = CRYPTO_CONTAINER_MAGIC_SIZE + 3 + 2 + kdf_params_size + 1 + CRYPTO_SALT_SIZE + 1 + nonce_size + 1 + tag_size;
+    size_t max_container_size = header_size + size + EVP_CIPHER_block_size(cipher);
+    if (max_container_size > UINT32_MAX) {
+        LOG(ERROR, "Datos demasiado grandes para el contenedor cifrado.")
+        return NULL;
+    }
+
+    uint8_t *output = mem_alloc(sizeof(uint32_t) + max_container_size);
+    if (!output) {
+        LOG(ERROR, "Memory allocation failed for container.")
+        return NULL;
+    }
+
+    // Encabezado: magic, versión, algoritmo, modo, KDF, sal, nonce y espacio para el tag
+    uint8_t *header = output + sizeof(uint32_t);
+    size_t index = 0;
+    memcpy(header, CRYPTO_CONTAINER_MAGIC, CRYPTO_CONTAINER_MAGIC_SIZE);
+    index += CRYPTO_CONTAINER_MAGIC_SIZE;
+    header[index++] = CRYPTO_CONTAINER_VERSION;
+    header[index++] = (uint8_t) encryption;
+    header[index++] = (uint8_t) mode;
+    header[index++] = (uint8_t) kdf->algorithm;
+    header[index++] = (uint8_t) kdf_params_size;
+    memcpy(&header[index], kdf_params, kdf_params_size);
+    index += kdf_params_size;
+
+    header[index++] = CRYPTO_SALT_SIZE;
+    uint8_t *salt = &header[index];
+    index += CRYPTO_SALT_SIZE;
+    header[index++] = (uint8_t) nonce_size;
+    uint8_t *nonce = &header[index];
+    index += nonce_size;
+    header[index++] = (uint8_t) tag_size;
+    size_t aad_len = index;
+    uint8_t *tag = &header[index];
+    uint8_t *ciphertext = header + header_size;
+
+    if (RAND_bytes(salt, CRYPTO_SALT_SIZE) != 1 || (nonce_size > 0 && RAND_bytes(nonce, (int) nonce_size) != 1)) {
+        LOG(ERROR, "RAND_bytes failed.")
+        mem_free(output);
+        return NULL;
+    }
+
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    unsigned char *key = thread_key_material();
+    int key_len = EVP_CIPHER_key_length(cipher);
+    if (!ctx || !key || !crypto_kdf_derive(kdf, password, salt, CRYPTO_SALT_SIZE, key, key_len)) {
+        release_thread_state();
+        mem_free(output);
+        return NULL;
+    }
+
+    size_t ciphertext_len = 0;
+    bool ok;
+    if (aead) {
+        size_t aad_written = 0;
+        int final_len = 0;
+        ok = EVP_EncryptInit_ex(ctx, cipher, NULL, NULL, NULL) == 1
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, (int) nonce_size, NULL) == 1
+                && EVP_EncryptInit_ex(ctx, NULL, NULL, key, nonce) == 1
+                && cipher_update(ctx, NULL, header, aad_len, &aad_written)
+                && cipher_update(ctx, ciphertext, data, size, &ciphertext_len)
+                && EVP_EncryptFinal_ex(ctx, ciphertext + ciphertext_len, &final_len) == 1
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, (int) tag_size, tag) == 1;
+        ciphertext_len += (size_t) final_len;
+    } else {
+        ok = container_stream_crypt(cipher, mode, key, nonce, true, data, size, ciphertext, &ciphertext_len);
+    }
+
+    release_thread_state();
+    if (!ok) {
+        LOG(ERROR, "Container encryption failed.")
         ERR_print_errors_fp(stderr);
+        mem_free(output);
+        return NULL;
+    }
+
+    // Tamaño del contenedor al principio, con la misma endianess que el formato legacy
+    uint32_t container_size = (uint32_t) (header_size + ciphertext_len);
+    memcpy(output, &container_size, sizeof(uint32_t));
+    adjust_data_endianness(output);
+
+    *encrypted_size = sizeof(uint32_t) + container_size;
+    LOG(DEBUG, "[Crypto] Contenedor cifrado creado: %u bytes.", container_size)
+    return output;
+}
+
+/**
+ * @brief Verifica y descifra un contenedor versionado.
+ *
+ * El algoritmo, el modo y el KDF se toman del encabezado. En los modos AEAD, si la contraseña es
+ * incorrecta o los datos fueron alterados, la verificación del tag falla y se devuelve NULL.
+ */
+static uint8_t* container_decrypt(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const uint8_t *password, size_t *decrypted_size) {
+    CryptoContainer container;
+    if (!parse_container(data, size, &container)) {
+        LOG(ERROR, "Contenedor cifrado inválido.")
+        return NULL;
+    }
+
+    if (container.encryption != encryption || (encryption != ENC_CHACHA20 && container.mode != mode)) {
+        LOG(WARNING, "[Crypto] El contenedor fue cifrado con otro algoritmo o modo. Se usa el del encabezado.")
     }
 
-    // Generar clave e IV usando PBKDF2
+    if (!container_header_valid(&container)) {
+        LOG(ERROR, "Encabezado del contenedor cifrado inválido.")
+        return NULL;
+    }
+    bool aead = crypto_is_aead(container.encryption, container.mode);
+    const EVP_CIPHER *cipher = determine_cipher(container.encryption, container.mode);
+    if (!crypto_kdf_available(container.kdf.algorithm)) {
+        LOG(ERROR, "El KDF del contenedor no está disponible en esta versión de OpenSSL.")
+        return NULL;
+    }
+
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    unsigned char *key = thread_key_material();
     int key_len = EVP_CIPHER_key_length(cipher);
-    int iv_len = EVP_CIPHER_iv_length(cipher);
-    int total_len = key_len + iv_len;
-    unsigned char *key_iv = malloc(total_len);
-    if (!key_iv) {
-        LOG(ERROR, "Memory allocation failed for key_iv.")
-        EVP_CIPHER_CTX_free(ctx);
+    if (!ctx || !key || !crypto_kdf_derive(&container.kdf, (const char *) password, container.salt, container.salt_len, key, key_len)) {
+        release_thread_state();
+        return NULL;
+    }
+
+    // +1 para no pedir malloc(0) con un mensaje vacío
+    uint8_t *plaintext = mem_alloc(container.ciphertext_len + 1);
+    if (!plaintext) {
+        LOG(ERROR, "Memory allocation failed for plaintext.")
+        release_thread_state();
         return NULL;
     }
 
-    // Sal (salt) fija de 8 bytes (puedes mejorar esto usando una sal aleatoria)
+    size_t plaintext_len = 0;
+    bool ok;
+    if (aead) {
+        size_t aad_written = 0;
+        int final_len = 0;
+        ok = EVP_DecryptInit_ex(ctx, cipher, NULL, NULL, NULL) == 1
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, (int) container.nonce_len, NULL) == 1
+                && EVP_DecryptInit_ex(ctx, NULL, NULL, key, container.nonce) == 1
+                && cipher_update(ctx, NULL, data, container.aad_len, &aad_written)
+                && cipher_update(ctx, plaintext, container.ciphertext, container.ciphertext_len, &plaintext_len)
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, (int) container.tag_len, (void *) container.tag) == 1
+                && EVP_DecryptFinal_ex(ctx, plaintext + plaintext_len, &final_len) == 1;
+        plaintext_len += (size_t) final_len;
+    } else {
+        ok = container_stream_crypt(cipher, container.mode, key, container.nonce, false, container.ciphertext, container.ciphertext_len, plaintext, &plaintext_len);
+    }
+
+    release_thread_state();
+    if (!ok) {
+        if (aead) {
+            LOG(ERROR, "Falló la autenticación del contenedor cifrado: contraseña incorrecta o datos alterados.")
+        } else {
+            LOG(ERROR, "Falló el descifrado del contenedor: contraseña incorrecta o datos dañados.")
+        }
+        OPENSSL_cleanse(plaintext, container.ciphertext_len);
+        mem_free(plaintext);
+        return NULL;
+    }
+
+    *decrypted_size = plaintext_len;
+    return plaintext;
+}
+
+/*************************************
+ ****  CIFRADO PARALELO POR SEGMENTOS ****
+ *************************************/
+size_t crypto_set_max_threads(size_t threads) {
+    size_t previous = crypto_max_threads;
+    crypto_max_threads = threads;
+    return previous;
+}
+
+/**
+ * @brief Segmento de datos a cifrar o descifrar de forma independiente.
+ */
+typedef struct {
+    const EVP_CIPHER *cipher;
+    const unsigned char *key;
+    unsigned char iv[EVP_MAX_IV_LENGTH];    // CBC: último bloque del segmento anterior. CTR: contador del primer bloque.
+    bool encrypt;
+    const uint8_t *input;
+    uint8_t *output;
+    size_t size;
+    bool is_last;                           // Solo el último segmento finaliza la operación
+    bool ok;
+} CipherSegment;
+
+static void *process_segment(void *arg) {
+    CipherSegment *segment = (CipherSegment *) arg;
+    segment->ok = false;
+
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    if (!ctx || EVP_CipherInit_ex(ctx, segment->cipher, NULL, segment->key, segment->iv, segment->encrypt ? 1 : 0) != 1) {
+        return NULL;
+    }
+    // Igual que el descifrado serial: sin padding, la salida tiene el mismo tamaño que la entrada
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+    size_t done = 0;
+    int len = 0;
+    while (done < segment->size) {
+        size_t chunk = segment->size - done;
+        if (chunk > CRYPTO_MAX_UPDATE_SIZE) {
+            chunk = CRYPTO_MAX_UPDATE_SIZE;
+        }
+        if (EVP_CipherUpdate(ctx, segment->output + done, &len, segment->input + done, (int) chunk) != 1) {
+            EVP_CIPHER_CTX_reset(ctx);
+            return NULL;
+        }
+        done += len;
+    }
+    bool ok = !segment->is_last || EVP_CipherFinal_ex(ctx, segment->output + done, &len) == 1;
+
+    EVP_CIPHER_CTX_reset(ctx);
+    segment->ok = ok;
+    return NULL;
+}
+
+/**
+ * @brief Calcula cuántos segmentos usar para procesar `size` bytes en paralelo, o 1 si no conviene paralelizar.
+ */
+static size_t parallel_segment_count(size_t size) {
+    if (size < CRYPTO_PARALLEL_MIN_SIZE) {
+        return 1;
+    }
+
+    size_t threads = crypto_max_threads;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t) cpus : 1;
+    }
+    size_t max_segments = size / (CRYPTO_PARALLEL_MIN_SIZE / 2);
+    return threads < max_segments ? threads : max_segments;
+}
+
+/**
+ * @brief Procesa los segmentos, uno por thread. El primero se procesa en el thread actual.
+ *
+ * @return bool true si todos los segmentos se procesaron correctamente.
+ */
+static bool run_segments(CipherSegment *segments, size_t count) {
+    pthread_t *threads = mem_calloc(count, sizeof(pthread_t));
+    bool *started = mem_calloc(count, sizeof(bool));
+    if (!threads || !started) {
+        LOG(ERROR, "Memory allocation failed for parallel cipher threads.")
+        mem_free(threads);
+        mem_free(started);
+        return false;
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, process_segment, &segments[i]) == 0;
+        if (!started[i]) {
+            process_segment(&segments[i]);
+        }
+    }
+    process_segment(&segments[0]);
+
+    bool ok = segments[0].ok;
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        ok = ok && segments[i].ok;
+    }
+    LOG(DEBUG, "[Crypto] Procesamiento paralelo en %zu segmentos.", count)
+
+    mem_free(threads);
+    mem_free(started);
+    return ok;
+}
+
+/**
+ * @brief Descifra CBC o ECB dividiendo el ciphertext en segmentos alineados a bloque, uno por thread.
+ *
+ * En CBC cada bloque de texto plano depende solo de su bloque de ciphertext y del anterior,
+ * así que cada segmento se inicializa con el último bloque del segmento previo como IV.
+ * El resultado es idéntico al descifrado serial.
+ *
+ * @return bool true si todos los segmentos se descifraron correctamente.
+ */
+static bool parallel_block_decrypt(const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, const uint8_t *input, size_t size, uint8_t *output, size_t count) {
+    size_t block_size = EVP_CIPHER_block_size(cipher);
+    size_t iv_len = EVP_CIPHER_iv_length(cipher);
+    size_t blocks_per_segment = (size / block_size) / count;
+
+    CipherSegment *segments = mem_calloc(count, sizeof(CipherSegment));
+    if (!segments) {
+        LOG(ERROR, "Memory allocation failed for parallel decryption.")
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i * blocks_per_segment * block_size;
+        size_t end = (i == count - 1) ? size : start + blocks_per_segment * block_size;
+        segments[i] = (CipherSegment) {
+                .cipher = cipher,
+                .key = key,
+                .encrypt = false,
+                .input = input + start,
+                .output = output + start,
+                .size = end - start,
+                .is_last = (i == count - 1),
+        };
+        if (iv_len > 0) {
+            memcpy(segments[i].iv, (i == 0) ? iv : input + start - block_size, iv_len);
+        }
+    }
+
+    bool ok = run_segments(segments, count);
+    mem_free(segments);
+    return ok;
+}
+
+/**
+ * @brief Suma `blocks` al contador CTR de 128 bits big-endian, igual que lo incrementa OpenSSL.
+ */
+static void ctr_counter_add(const unsigned char *iv, uint64_t blocks, unsigned char *counter) {
+    memcpy(counter, iv, CRYPTO_CTR_BLOCK_SIZE);
+    for (int i = CRYPTO_CTR_BLOCK_SIZE - 1; i >= 0 && blocks > 0; i--) {
+        uint64_t sum = (uint64_t) counter[i] + (blocks & 0xFF);
+        counter[i] = (unsigned char) sum;
+        blocks = (blocks >> 8) + (sum >> 8);
+    }
+}
+
+/**
+ * @brief Cifra o descifra en modo CTR empezando en el bloque `first_block` del keystream.
+ *
+ * Como el keystream es direccionable, cada segmento calcula su contador directamente y se
+ * procesa en su propio thread, tanto al cifrar como al descifrar.
+ *
+ * @return bool true si la operación fue exitosa.
+ */
+static bool ctr_crypt(const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *iv, uint64_t first_block, const uint8_t *input, size_t size, uint8_t *output) {
+    size_t count = parallel_segment_count(size);
+    size_t blocks_per_segment = ((size + CRYPTO_CTR_BLOCK_SIZE - 1) / CRYPTO_CTR_BLOCK_SIZE) / count;
+
+    CipherSegment *segments = mem_calloc(count, sizeof(CipherSegment));
+    if (!segments) {
+        LOG(ERROR, "Memory allocation failed for CTR segments.")
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i * blocks_per_segment * CRYPTO_CTR_BLOCK_SIZE;
+        size_t end = (i == count - 1) ? size : start + blocks_per_segment * CRYPTO_CTR_BLOCK_SIZE;
+        segments[i] = (CipherSegment) {
+                .cipher = cipher,
+                .key = key,
+                .encrypt = true,    // CTR es simétrico
+                .input = input + start,
+                .output = output + start,
+                .size = end - start,
+                .is_last = (i == count - 1),
+        };
+        ctr_counter_add(iv, first_block + i * blocks_per_segment, segments[i].iv);
+    }
+
+    bool ok = run_segments(segments, count);
+    mem_free(segments);
+    return ok;
+}
+
+/**
+ * @brief Deriva la clave y el IV legacy (PBKDF2-SHA256 con sal fija) para el cipher indicado.
+ *
+ * @param cipher   Cipher de OpenSSL.
+ * @param password Contraseña.
+ * @param key_iv   Buffer de al menos key_length + iv_length bytes.
+ * @return bool    true si la derivación fue exitosa.
+ */
+static bool derive_legacy_key_iv(const EVP_CIPHER *cipher, const char *password, unsigned char *key_iv) {
+    int total_len = EVP_CIPHER_key_length(cipher) + EVP_CIPHER_iv_length(cipher);
     unsigned char salt[8] = {0};
-    if (!PKCS5_PBKDF2_HMAC((const char *)password, strlen((const char *)password), salt, sizeof(salt), 10000, EVP_sha256(), total_len, key_iv)) {
-        //handle_openssl_error("PKCS5_PBKDF2_HMAC failed.");
-        LOG(ERROR, "PKCS5_PBKDF2_HMAC failed.")
+    KdfParams kdf = {.algorithm = KDF_PBKDF2_SHA256, .iterations = CRYPTO_KDF_ITERATIONS};
+    return crypto_kdf_derive(&kdf, password, salt, sizeof(salt), key_iv, total_len);
+}
+
+uint8_t* crypto_decrypt_range(const uint8_t *header, size_t header_size, const uint8_t *encrypted_slice, size_t slice_size, size_t stream_offset, EncryptionAlgorithm encryption, EncryptionMode mode, const uint8_t *password) {
+    if (!encrypted_slice || slice_size == 0 || !password) {
+        LOG(ERROR, "Invalid arguments to crypto_decrypt_range.")
+        return NULL;
+    }
+
+    // Contenedor: la clave sale de su KDF y su sal, y el IV es el nonce aleatorio del encabezado
+    CryptoContainer container;
+    if (!probe_container(header, header_size, &container)) {
+        LOG(ERROR, "CTR data without an encryption container.")
+        return NULL;
+    }
+    size_t ciphertext_offset = (size_t) (container.ciphertext - header);
+    if (stream_offset < ciphertext_offset) {
+        LOG(ERROR, "The range starts inside the container header.")
+        return NULL;
+    }
+    stream_offset -= ciphertext_offset;
+    encryption = container.encryption;
+    mode = container.mode;
+    if (mode != ENC_MODE_CTR) {
+        LOG(ERROR, "Random-access decryption requires CTR mode.")
+        return NULL;
+    }
+
+    const EVP_CIPHER *cipher = determine_cipher(encryption, mode);
+    if (!cipher) {
+        LOG(ERROR, "CTR mode requires an AES encryption algorithm.")
+        return NULL;
+    }
+    if (!crypto_kdf_available(container.kdf.algorithm)) {
+        LOG(ERROR, "El KDF del contenedor no está disponible en esta versión de OpenSSL.")
+        return NULL;
+    }
+
+    unsigned char *key_iv = thread_key_material();
+    if (key_iv == NULL || !crypto_kdf_derive(&container.kdf, (const char *) password, container.salt, container.salt_len, key_iv, EVP_CIPHER_key_length(cipher))) {
+        release_thread_state();
+        return NULL;
+    }
+    const unsigned char *iv = container.nonce;
+
+    // Si el rango no empieza en un límite de bloque se descarta el prefijo del primer bloque
+    size_t skip = stream_offset % CRYPTO_CTR_BLOCK_SIZE;
+    uint8_t *buffer = mem_calloc(skip + slice_size, 1);
+    if (!buffer) {
+        LOG(ERROR, "Memory allocation failed for plaintext.")
+        release_thread_state();
+        return NULL;
+    }
+    memcpy(buffer + skip, encrypted_slice, slice_size);
+
+    bool ok = ctr_crypt(cipher, key_iv, iv, stream_offset / CRYPTO_CTR_BLOCK_SIZE, buffer, skip + slice_size, buffer);
+    release_thread_state();
+    if (!ok) {
+        LOG(ERROR, "CTR decryption failed.")
+        mem_free(buffer);
+        return NULL;
+    }
+
+    memmove(buffer, buffer + skip, slice_size);
+    return buffer;
+}
+
+uint8_t* crypto_encrypt(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const char *password, size_t *encrypted_size) {
+    return crypto_encrypt_with_kdf(data, size, encryption, mode, password, NULL, encrypted_size);
+}
+
+uint8_t* crypto_encrypt_with_kdf(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const char *password, const KdfParams *kdf, size_t *encrypted_size) {
+    if (!data || size == 0 || !password || !encrypted_size) {
+        LOG(ERROR, "Invalid arguments to crypto_encrypt.")
+        return NULL;
+    }
+
+    // Los modos autenticados, CTR y los KDF explícitos usan el contenedor versionado. CTR necesita
+    // la sal y el nonce aleatorios: con la clave y el IV legacy todos los payloads de una misma
+    // contraseña compartirían el keystream.
+    bool explicit_kdf = kdf != NULL && kdf->algorithm != KDF_NONE;
+    if (explicit_kdf || crypto_is_aead(encryption, mode) || mode == ENC_MODE_CTR) {
+        KdfParams params = {0};
+        if (explicit_kdf) {
+            params = *kdf;
+        }
+        crypto_kdf_defaults(&params);
+        if (!crypto_kdf_available(params.algorithm)) {
+            LOG(ERROR, "The selected key derivation function is not available.")
+            return NULL;
+        }
+        // La extracción rechazaría el encabezado
+        if (!crypto_kdf_valid(&params)) {
+            LOG(ERROR, "Parámetros de KDF fuera de rango.")
+            return NULL;
+        }
+        return container_encrypt(data, size, encryption, mode, password, &params, encrypted_size);
+    }
+    const EVP_CIPHER *cipher = determine_cipher(encryption, mode);
+    if (!cipher) {
+        LOG(ERROR, "Unsupported encryption algorithm or mode.")
+        return NULL;
+    }
+
+    // Contexto y buffer de clave reutilizados del thread actual
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    unsigned char *key_iv = thread_key_material();
+    if (!ctx || !key_iv) {
+        LOG(ERROR, "Failed to create EVP_CIPHER_CTX.")
         ERR_print_errors_fp(stderr);
+        return NULL;
     }
 
+    // Generar clave e IV usando PBKDF2 con la sal fija legacy
+    if (!derive_legacy_key_iv(cipher, password, key_iv)) {
+        ERR_print_errors_fp(stderr);
+        release_thread_state();
+        return NULL;
+    }
     unsigned char *key = key_iv;
-    unsigned char *iv = key_iv + key_len;
+    unsigned char *iv = key_iv + EVP_CIPHER_key_length(cipher);
 
     // Inicializar la encriptación
     if (EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
         LOG(ERROR, "EVP_EncryptInit_ex failed.")
+        release_thread_state();
+        return NULL;
     }
 
-    // EVP_CIPHER_CTX_set_padding(ctx, 0);
-
-    // Asignar memoria para el ciphertext (size + block_size)
+    // El ciphertext se escribe directamente después del campo de tamaño (size + block_size como máximo)
     int block_size = EVP_CIPHER_block_size(cipher);
-    int max_ciphertext_len = size + block_size;
-    unsigned char *ciphertext = malloc(max_ciphertext_len);
-    if (!ciphertext) {
+    uint8_t *final_ciphertext = mem_alloc(sizeof(uint32_t) + size + block_size);
+    if (!final_ciphertext) {
         LOG(ERROR, "Memory allocation failed for ciphertext.")
-        EVP_CIPHER_CTX_free(ctx);
-        free(key_iv);
+        release_thread_state();
         return NULL;
     }
+    unsigned char *ciphertext = final_ciphertext + sizeof(uint32_t);
 
     int len;
     int ciphertext_len = 0;
 
     // Encriptar los datos
     if (EVP_EncryptUpdate(ctx, ciphertext, &len, data, size) != 1) {
-        LOG(ERROR, "EVP_EncryptUpdate failed.");
+        LOG(ERROR, "EVP_EncryptUpdate failed.")
+        release_thread_state();
+        mem_free(final_ciphertext);
+        return NULL;
     }
     ciphertext_len += len;
 
     // Finalizar la encriptación
     if (EVP_EncryptFinal_ex(ctx, ciphertext + ciphertext_len, &len) != 1) {
-        LOG(ERROR, "EVP_EncryptFinal_ex failed.");
-    }
-    ciphertext_len += len;
-
-    // Limpiar
-    EVP_CIPHER_CTX_free(ctx);
-    free(key_iv);
-
-    *encrypted_size = sizeof(uint32_t) + ciphertext_len;
-
-    // Concatenar el tamaño al principio del ciphertext
-    uint8_t *final_ciphertext = malloc(*encrypted_size);
-    if (!final_ciphertext) {
-        LOG(ERROR, "Memory allocation failed for final_ciphertext.");
-        free(ciphertext);
+        LOG(ERROR, "EVP_EncryptFinal_ex failed.")
+        release_thread_state();
+        mem_free(final_ciphertext);
         return NULL;
     }
+    ciphertext_len += len;
 
-    // Crear un buffer temporal para `ciphertext_len` y ajustar la endianess
-    uint8_t temp_size_buffer[sizeof(uint32_t)];
-    memcpy(temp_size_buffer, &ciphertext_len, sizeof(ciphertext_len));
-    adjust_data_endianness(temp_size_buffer);
-
-    // Copiar el tamaño ajustado en endianess al inicio del `final_ciphertext`
-    memcpy(final_ciphertext, temp_size_buffer, sizeof(uint32_t));
+    // Limpiar la clave y el contexto para la próxima operación
+    release_thread_state();
 
-    // Copiar los datos cifrados después del tamaño
-    memcpy(final_ciphertext + sizeof(uint32_t), ciphertext, ciphertext_len);
-    free(ciphertext);
+    // Tamaño al principio del ciphertext, ajustando la endianess
+    uint32_t stored_size = (uint32_t) ciphertext_len;
+    memcpy(final_ciphertext, &stored_size, sizeof(uint32_t));
+    adjust_data_endianness(final_ciphertext);
 
+    *encrypted_size = sizeof(uint32_t) + ciphertext_len;
     return final_ciphertext;
 }
 
@@ -177,57 +1369,81 @@ uint8_t* crypto_decrypt(const uint8_t *encrypted_data, size_t encrypted_size, En
         return NULL;
     }
 
+    // Contenedor versionado: se descifra según su encabezado. El resto sigue el formato legacy.
+    // AEAD y CTR solo se cifran dentro del contenedor, así que sin él no se pueden descifrar.
+    if (crypto_is_aead(encryption, mode) || mode == ENC_MODE_CTR) {
+        return container_decrypt(encrypted_data, encrypted_size, encryption, mode, password, decrypted_size);
+    }
+    if (crypto_is_container(encrypted_data, encrypted_size)) {
+        uint8_t *plaintext = container_decrypt(encrypted_data, encrypted_size, encryption, mode, password, decrypted_size);
+        if (plaintext) {
+            return plaintext;
+        }
+        // Un payload legacy puede empezar por casualidad como un contenedor
+        LOG(DEBUG, "[Crypto] No se pudo descifrar como contenedor. Se prueba el formato legacy.")
+    }
     const EVP_CIPHER *cipher = determine_cipher(encryption, mode);
     if (!cipher) {
         LOG(ERROR, "Unsupported decryption algorithm or mode.")
         return NULL;
     }
 
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
+    // Contexto y buffer de clave reutilizados del thread actual
+    EVP_CIPHER_CTX *ctx = thread_cipher_ctx();
+    unsigned char *key_iv = thread_key_material();
+    if (!ctx || !key_iv) {
         LOG(ERROR, "Failed to create EVP_CIPHER_CTX.")
         ERR_print_errors_fp(stderr);
+        return NULL;
     }
 
     // Generar clave e IV usando PBKDF2 (debe ser el mismo que en la encriptación)
-    int key_len = EVP_CIPHER_key_length(cipher);
-    int iv_len = EVP_CIPHER_iv_length(cipher);
-    int total_len = key_len + iv_len;
-    unsigned char *key_iv = malloc(total_len);
-    if (!key_iv) {
-        LOG(ERROR, "Memory allocation failed for key_iv.")
-        EVP_CIPHER_CTX_free(ctx);
+    if (!derive_legacy_key_iv(cipher, (const char *) password, key_iv)) {
+        release_thread_state();
         return NULL;
     }
+    unsigned char *key = key_iv;
+    unsigned char *iv = key_iv + EVP_CIPHER_key_length(cipher);
 
-    // Sal (salt) fija de 8 bytes (debe ser la misma que en la encriptación)
-    unsigned char salt[8] = {0};
-    if (!PKCS5_PBKDF2_HMAC((const char *)password, strlen((const char *)password), salt, sizeof(salt), 10000, EVP_sha256(), total_len, key_iv)) {
-        LOG(ERROR, "PKCS5_PBKDF2_HMAC failed.");
+    // CBC y ECB grandes se descifran en paralelo por segmentos alineados a bloque
+    size_t segments = 1;
+    if ((mode == ENC_MODE_CBC || mode == ENC_MODE_ECB) && encrypted_size % EVP_CIPHER_block_size(cipher) == 0) {
+        segments = parallel_segment_count(encrypted_size);
+    }
+    if (segments > 1) {
+        unsigned char *plaintext = mem_alloc(encrypted_size);
+        if (!plaintext || !parallel_block_decrypt(cipher, key, iv, encrypted_data, encrypted_size, plaintext, segments)) {
+            LOG(ERROR, "Parallel decryption failed.")
+            ERR_print_errors_fp(stderr);
+            mem_free(plaintext);
+            release_thread_state();
+            return NULL;
+        }
+        release_thread_state();
+        *decrypted_size = encrypted_size;
+        return plaintext;
     }
-
-    unsigned char *key = key_iv;
-    unsigned char *iv = key_iv + key_len;
 
     // Inicializar la desencriptación
     if (EVP_DecryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
         LOG(ERROR, "EVP_DecryptInit_ex failed.")
         ERR_print_errors_fp(stderr);
+        release_thread_state();
+        return NULL;
     }
 
     // Opcional: Deshabilitar padding si no es necesario
-     EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
 
     // Asignar memoria para el plaintext (encrypted_size)
-    unsigned char *plaintext = malloc(encrypted_size);
+    unsigned char *plaintext = mem_alloc(encrypted_size);
     if (!plaintext) {
         LOG(ERROR, "Memory allocation failed for plaintext.")
-        EVP_CIPHER_CTX_free(ctx);
-        free(key_iv);
+        release_thread_state();
         return NULL;
     }
 
-    int len;
+    int len = 0;
     int plaintext_len = 0;
 
     // Desencriptar los datos
@@ -237,18 +1453,16 @@ uint8_t* crypto_decrypt(const uint8_t *encrypted_data, size_t encrypted_size, En
     }
     plaintext_len += len;
 
-
     // Finalizar la desencriptación
+    len = 0;
     if (EVP_DecryptFinal_ex(ctx, plaintext + plaintext_len, &len) != 1) {
         LOG(ERROR, "EVP_DecryptFinal_ex failed.")
         ERR_print_errors_fp(stderr);
     }
     plaintext_len += len;
 
-
-    // Limpiar
-    EVP_CIPHER_CTX_free(ctx);
-    free(key_iv);
+    // Limpiar la clave y el contexto para la próxima operación
+    release_thread_state();
 
     *decrypted_size = plaintext_len;
     return plaintext;
@@ -0,0 +1,572 @@
+#include "./include/daemon.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include "./include/arguments.h"
+#include "./include/crypto.h"
+#include "./include/logger.h"
+#include "./include/pixel_pool.h"
+#include "./include/thread_pool.h"
+#include "./include/utils.h"
+
+#ifdef MSG_NOSIGNAL
+#define DAEMON_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define DAEMON_SEND_FLAGS 0
+#endif
+
+typedef struct {
+    ThreadPool *pool;           // Splits large payloads; shared by every connection
+    atomic_bool stopping;
+    pthread_mutex_t lock;       // Guards clients
+    pthread_cond_t idle;        // Broadcast when a connection closes
+    size_t clients;
+} Daemon;
+
+typedef struct {
+    Daemon *daemon;
+    int fd;
+} Connection;
+
+static volatile sig_atomic_t stop_signal_received = 0;
+
+// getopt keeps its state in globals, so requests are parsed one at a time
+static pthread_mutex_t parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void handle_stop_signal(int signal_number) {
+    (void) signal_number;
+    stop_signal_received = 1;
+}
+
+static uint32_t ms_to_us(double ms) {
+    double us = ms * 1000.0;
+    return us <= 0 ? 0 : us >= (double) UINT32_MAX ? UINT32_MAX : (uint32_t) us;
+}
+
+static bool daemon_stopping(Daemon *daemon) {
+    return atomic_load(&daemon->stopping) || stop_signal_received;
+}
+
+/**
+ * @brief Wait until the socket has data. Gives up when the daemon stops, so idle connections do not hold it.
+ */
+static bool wait_readable(int fd, Daemon *daemon) {
+    while (!daemon_stopping(daemon)) {
+        struct pollfd poll_fd = {.fd = fd, .events = POLLIN};
+        int ready = poll(&poll_fd, 1, DAEMON_POLL_MS);
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Read exactly `size` bytes. The first descriptor passed with them (if any) is stored in `passed_fd`.
+ *
+ * @param daemon    Daemon whose shutdown interrupts the wait, or NULL to block (client side).
+ * @param passed_fd Where to store a received descriptor, or NULL to close any.
+ */
+static bool recv_full(int fd, Daemon *daemon, uint8_t *buffer, size_t size, int *passed_fd) {
+    size_t received = 0;
+    while (received < size) {
+        if (daemon != NULL && !wait_readable(fd, daemon)) {
+            return false;
+        }
+
+        union {
+            struct cmsghdr header;
+            char buffer[CMSG_SPACE(4 * sizeof(int))];
+        } control;
+        struct iovec io = {.iov_base = buffer + received, .iov_len = size - received};
+        struct msghdr message = {.msg_iov = &io, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer)};
+        ssize_t count = recvmsg(fd, &message, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            size_t fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < fd_count; i++) {
+                int received_fd;
+                memcpy(&received_fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (passed_fd != NULL && *passed_fd < 0) {
+                    fcntl(received_fd, F_SETFD, FD_CLOEXEC);
+                    *passed_fd = received_fd;
+                } else {
+                    close(received_fd);
+                }
+            }
+        }
+        received += (size_t) count;
+    }
+    return true;
+}
+
+/**
+ * @brief Write exactly `size` bytes, passing `pass_fd` with the first ones when it is not negative.
+ */
+static bool send_full(int fd, const uint8_t *buffer, size_t size, int pass_fd) {
+    size_t sent = 0;
+    while (sent < size) {
+        union {
+            struct cmsghdr header;
+            char buffer[CMSG_SPACE(sizeof(int))];
+        } control;
+        struct iovec io = {.iov_base = (void *) (buffer + sent), .iov_len = size - sent};
+        struct msghdr message = {.msg_iov = &io, .msg_iovlen = 1};
+        if (pass_fd >= 0) {
+            memset(&control, 0, sizeof(control));
+            message.msg_control = control.buffer;
+            message.msg_controllen = sizeof(control.buffer);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+        }
+        ssize_t count = sendmsg(fd, &message, DAEMON_SEND_FLAGS);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        sent += (size_t) count;
+        pass_fd = -1;
+    }
+    return true;
+}
+
+static bool socket_address(const char *socket_path, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        LOG(ERROR, "[Daemon] Socket path too long: %s", socket_path)
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+/**
+ * @brief Make a relative path of a request absolute, using the working directory of the client.
+ */
+static const char* resolve_path(const char *cwd, const char *path, char *buffer) {
+    if (path == NULL || path[0] == '/') {
+        return path;
+    }
+    int length = snprintf(buffer, PATH_MAX, "%s/%s", cwd, path);
+    return length > 0 && length < PATH_MAX ? buffer : NULL;
+}
+
+/**
+ * @brief Validate and run the job described by the strings block of a request.
+ */
+static void serve_job(Daemon *daemon, uint8_t flags, uint32_t arg_count, char *strings, size_t strings_size, int carrier_fd, JobResult *result) {
+    memset(result, 0, sizeof(JobResult));
+    result->status = JOB_ERROR_ARGUMENTS;
+
+    // cwd followed by the arguments, each one terminated by '\0'
+    char *argv[DAEMON_MAX_ARGUMENTS + 2];
+    int argc = 0;
+    argv[argc++] = "stegobmp";
+    const char *cwd = NULL;
+    for (size_t offset = 0; offset < strings_size;) {
+        char *string = strings + offset;
+        offset += strlen(string) + 1;
+        if (cwd == NULL) {
+            cwd = string;
+        } else if ((size_t) argc <= arg_count && argc <= DAEMON_MAX_ARGUMENTS) {
+            argv[argc++] = string;
+        } else {
+            argc = -1;
+            break;
+        }
+    }
+    if (cwd == NULL || cwd[0] != '/' || argc != (int) arg_count + 1) {
+        LOG(WARNING, "[Daemon] Malformed job request.")
+        return;
+    }
+    argv[argc] = NULL;
+
+    ProgramOptions options;
+    // parse_arguments sets the log level of the request. In a scope of this thread that only changes the
+    // scope, so the daemon's level, which every worker reads, is never written
+    LogScope parse_scope = {true, log_current_level(), NULL, NULL};
+    LogScope saved_scope;
+    pthread_mutex_lock(&parse_lock);
+    log_scope_enter(&parse_scope, &saved_scope);
+    optind = 1;
+    int ok = parse_arguments(argc, argv, &options);
+    log_scope_exit(&saved_scope);
+    pthread_mutex_unlock(&parse_lock);
+    if (!ok || (options.mode != MODE_EMBED && options.mode != MODE_EXTRACT)) {
+        LOG(WARNING, "[Daemon] Rejected request: only valid embed or extract jobs are served.")
+        memset(options.password, 0, sizeof(options.password));
+        return;
+    }
+
+    char paths[3][PATH_MAX];
+    options.input_file = resolve_path(cwd, options.input_file, paths[0]);
+    options.input_bmp_file = resolve_path(cwd, options.input_bmp_file, paths[1]);
+    options.output_file = resolve_path(cwd, options.output_file, paths[2]);
+    if ((flags & DAEMON_FLAG_CARRIER_FD) != 0) {
+        // The descriptor stays open until the job ends; the loader reopens it by path
+        options.input_bmp_file = carrier_fd >= 0 && snprintf(paths[1], PATH_MAX, "/dev/fd/%d", carrier_fd) > 0 ? paths[1] : NULL;
+    }
+    if (options.input_bmp_file == NULL || options.output_file == NULL || (options.mode == MODE_EMBED && options.input_file == NULL)) {
+        LOG(WARNING, "[Daemon] Rejected request: invalid paths.")
+        memset(options.password, 0, sizeof(options.password));
+        return;
+    }
+
+    run_stego_job(&options, NULL, daemon->pool, result);
+    memset(options.password, 0, sizeof(options.password));
+    LOG(DEBUG, "[Daemon] %s job: %s in %.1f ms.", options.mode == MODE_EMBED ? "Embed" : "Extract", job_status_to_string(result->status), result->total_ms)
+}
+
+static void encode_response(const JobResult *result, uint8_t *response) {
+    memset(response, 0, DAEMON_RESPONSE_SIZE);
+    memcpy(response, DAEMON_RESPONSE_MAGIC, 4);
+    response[4] = DAEMON_PROTOCOL_VERSION;
+    response[5] = (uint8_t) result->status;
+    store_be64(response + 8, result->payload_bytes);
+    store_be64(response + 16, result->stored_bytes);
+    store_be32(response + 24, ms_to_us(result->load_ms));
+    store_be32(response + 28, ms_to_us(result->crypto_ms));
+    store_be32(response + 32, ms_to_us(result->steg_ms));
+    store_be32(response + 36, ms_to_us(result->write_ms));
+    store_be32(response + 40, ms_to_us(result->total_ms));
+}
+
+static bool decode_response(const uint8_t *response, JobResult *result) {
+    if (memcmp(response, DAEMON_RESPONSE_MAGIC, 4) != 0 || response[4] != DAEMON_PROTOCOL_VERSION || response[5] > JOB_ERROR_OUTPUT) {
+        LOG(ERROR, "[Daemon] Invalid response from the daemon.")
+        return false;
+    }
+    result->status = (JobStatus) response[5];
+    result->payload_bytes = (size_t) load_be64(response + 8);
+    result->stored_bytes = (size_t) load_be64(response + 16);
+    result->load_ms = load_be32(response + 24) / 1000.0;
+    result->crypto_ms = load_be32(response + 28) / 1000.0;
+    result->steg_ms = load_be32(response + 32) / 1000.0;
+    result->write_ms = load_be32(response + 36) / 1000.0;
+    result->total_ms = load_be32(response + 40) / 1000.0;
+    return true;
+}
+
+static void *connection_main(void *arg) {
+    Connection *connection = arg;
+    Daemon *daemon = connection->daemon;
+
+    while (!daemon_stopping(daemon)) {
+        uint8_t header[DAEMON_REQUEST_HEADER_SIZE];
+        int carrier_fd = -1;
+        if (!recv_full(connection->fd, daemon, header, sizeof(header), &carrier_fd)) {
+            if (carrier_fd >= 0) {
+                close(carrier_fd);
+            }
+            break;
+        }
+        uint32_t arg_count = load_be32(header + 8);
+        uint32_t strings_size = load_be32(header + 12);
+        if (memcmp(header, DAEMON_REQUEST_MAGIC, 4) != 0 || header[4] != DAEMON_PROTOCOL_VERSION ||
+            strings_size > DAEMON_MAX_REQUEST_SIZE || arg_count > DAEMON_MAX_ARGUMENTS) {
+            LOG(WARNING, "[Daemon] Invalid request header, closing the connection.")
+            if (carrier_fd >= 0) {
+                close(carrier_fd);
+            }
+            break;
+        }
+
+        char *strings = malloc(strings_size + 1);
+        bool received = strings != NULL && recv_full(connection->fd, daemon, (uint8_t *) strings, strings_size, &carrier_fd);
+        JobResult result = {.status = JOB_ERROR_ARGUMENTS};
+        if (received) {
+            strings[strings_size] = '\0';
+            if (header[5] == DAEMON_REQUEST_SHUTDOWN) {
+                LOG(INFO, "[Daemon] Shutdown requested.")
+                atomic_store(&daemon->stopping, true);
+                result.status = JOB_OK;
+            } else if (header[5] == DAEMON_REQUEST_JOB && strings_size > 0 && strings[strings_size - 1] == '\0') {
+                serve_job(daemon, header[6], arg_count, strings, strings_size, carrier_fd, &result);
+            }
+        }
+        if (carrier_fd >= 0) {
+            close(carrier_fd);
+        }
+        if (strings != NULL) {
+            // The block holds the password
+            OPENSSL_cleanse(strings, strings_size);
+            free(strings);
+        }
+
+        uint8_t response[DAEMON_RESPONSE_SIZE];
+        encode_response(&result, response);
+        if (!received || !send_full(connection->fd, response, sizeof(response), -1)) {
+            break;
+        }
+    }
+
+    close(connection->fd);
+    free(connection);
+    pthread_mutex_lock(&daemon->lock);
+    daemon->clients--;
+    pthread_cond_broadcast(&daemon->idle);
+    pthread_mutex_unlock(&daemon->lock);
+    return NULL;
+}
+
+/**
+ * @brief Bind the listening socket, replacing the file left by a daemon that is no longer running.
+ */
+static int open_listen_socket(const char *socket_path) {
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address)) {
+        return -1;
+    }
+
+    struct stat info;
+    if (lstat(socket_path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            LOG(ERROR, "[Daemon] %s exists and is not a socket.", socket_path)
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool in_use = probe >= 0 && connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (in_use) {
+            LOG(ERROR, "[Daemon] Another daemon is already listening on %s.", socket_path)
+            return -1;
+        }
+        unlink(socket_path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG(ERROR, "[Daemon] Could not create the socket: %s", strerror(errno))
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // Only the owner may connect: requests carry passwords
+    mode_t saved_mask = umask(0177);
+    int bound = bind(fd, (struct sockaddr *) &address, sizeof(address));
+    umask(saved_mask);
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+        LOG(ERROR, "[Daemon] Could not listen on %s: %s", socket_path, strerror(errno))
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_daemon(const char *socket_path, const DaemonSettings *settings) {
+    DaemonSettings defaults = {0};
+    if (settings == NULL) {
+        settings = &defaults;
+    }
+
+    int listen_fd = open_listen_socket(socket_path);
+    if (listen_fd < 0) {
+        return -1;
+    }
+
+    Daemon daemon = {.clients = 0};
+    atomic_init(&daemon.stopping, false);
+    pthread_mutex_init(&daemon.lock, NULL);
+    pthread_cond_init(&daemon.idle, NULL);
+    daemon.pool = settings->workers != 1 ? thread_pool_create(settings->workers, settings->pin_cpus) : NULL;
+    pixel_pool_set_workers(daemon.pool ? thread_pool_size(daemon.pool) : 1);
+    crypto_init();
+    crypto_set_key_cache(DAEMON_KEY_CACHE_ENTRIES);
+
+    // Stop on SIGINT/SIGTERM; a client that goes away must not kill the daemon with SIGPIPE
+    struct sigaction stop_action = {.sa_handler = handle_stop_signal};
+    struct sigaction ignore_action = {.sa_handler = SIG_IGN};
+    struct sigaction saved_int, saved_term, saved_pipe;
+    sigemptyset(&stop_action.sa_mask);
+    sigemptyset(&ignore_action.sa_mask);
+    stop_signal_received = 0;
+    sigaction(SIGINT, &stop_action, &saved_int);
+    sigaction(SIGTERM, &stop_action, &saved_term);
+    sigaction(SIGPIPE, &ignore_action, &saved_pipe);
+
+    LOG(INFO, "[Daemon] Listening on %s with %zu workers.", socket_path, daemon.pool ? thread_pool_size(daemon.pool) : (size_t) 1)
+    while (!daemon_stopping(&daemon)) {
+        struct pollfd poll_fd = {.fd = listen_fd, .events = POLLIN};
+        if (poll(&poll_fd, 1, DAEMON_POLL_MS) <= 0) {
+            continue;
+        }
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            continue;
+        }
+        fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+
+        pthread_mutex_lock(&daemon.lock);
+        bool accepted = daemon.clients < DAEMON_MAX_CLIENTS;
+        daemon.clients += accepted ? 1 : 0;
+        pthread_mutex_unlock(&daemon.lock);
+
+        Connection *connection = accepted ? malloc(sizeof(Connection)) : NULL;
+        pthread_t thread;
+        if (connection != NULL) {
+            connection->daemon = &daemon;
+            connection->fd = client_fd;
+        }
+        if (connection == NULL || pthread_create(&thread, NULL, connection_main, connection) != 0) {
+            LOG(WARNING, "[Daemon] Connection refused: %s.", accepted ? "could not start its thread" : "too many clients")
+            free(connection);
+            close(client_fd);
+            if (accepted) {
+                pthread_mutex_lock(&daemon.lock);
+                daemon.clients--;
+                pthread_mutex_unlock(&daemon.lock);
+            }
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    // New connections are refused from here on; the running jobs finish and their clients get the answer
+    close(listen_fd);
+    unlink(socket_path);
+    atomic_store(&daemon.stopping, true);
+    pthread_mutex_lock(&daemon.lock);
+    while (daemon.clients > 0) {
+        pthread_cond_wait(&daemon.idle, &daemon.lock);
+    }
+    pthread_mutex_unlock(&daemon.lock);
+
+    size_t hits = 0, misses = 0;
+    crypto_key_cache_stats(&hits, &misses);
+    LOG(INFO, "[Daemon] Stopped. Key cache: %zu hits, %zu misses.", hits, misses)
+
+    crypto_set_key_cache(0);
+    thread_pool_destroy(daemon.pool);
+    pixel_pool_set_workers(1);
+    pthread_cond_destroy(&daemon.idle);
+    pthread_mutex_destroy(&daemon.lock);
+    sigaction(SIGINT, &saved_int, NULL);
+    sigaction(SIGTERM, &saved_term, NULL);
+    sigaction(SIGPIPE, &saved_pipe, NULL);
+    return 0;
+}
+
+static int connect_daemon(const char *socket_path) {
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        LOG(ERROR, "[Daemon] Could not connect to %s: %s", socket_path, strerror(errno))
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Send one request and read its response.
+ */
+static bool send_request(const char *socket_path, DaemonRequestType type, uint8_t flags, int argc, char *argv[], int pass_fd, JobResult *result) {
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        LOG(ERROR, "[Daemon] Could not read the working directory.")
+        return false;
+    }
+    if (argc < 0 || argc > DAEMON_MAX_ARGUMENTS) {
+        LOG(ERROR, "[Daemon] Too many arguments for a request.")
+        return false;
+    }
+
+    size_t strings_size = strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++) {
+        strings_size += strlen(argv[i]) + 1;
+    }
+    if (strings_size > DAEMON_MAX_REQUEST_SIZE) {
+        LOG(ERROR, "[Daemon] Request too large.")
+        return false;
+    }
+
+    size_t request_size = DAEMON_REQUEST_HEADER_SIZE + strings_size;
+    uint8_t *request = calloc(1, request_size);
+    if (request == NULL) {
+        LOG(ERROR, "Memory allocation failed for the daemon request.")
+        return false;
+    }
+    memcpy(request, DAEMON_REQUEST_MAGIC, 4);
+    request[4] = DAEMON_PROTOCOL_VERSION;
+    request[5] = (uint8_t) type;
+    request[6] = flags;
+    store_be32(request + 8, (uint32_t) argc);
+    store_be32(request + 12, (uint32_t) strings_size);
+    char *strings = (char *) request + DAEMON_REQUEST_HEADER_SIZE;
+    size_t offset = 0;
+    for (int i = -1; i < argc; i++) {
+        const char *string = i < 0 ? cwd : argv[i];
+        size_t length = strlen(string) + 1;
+        memcpy(strings + offset, string, length);
+        offset += length;
+    }
+
+    int fd = connect_daemon(socket_path);
+    uint8_t response[DAEMON_RESPONSE_SIZE];
+    bool ok = fd >= 0 && send_full(fd, request, request_size, pass_fd) && recv_full(fd, NULL, response, sizeof(response), NULL);
+    if (fd >= 0 && !ok) {
+        LOG(ERROR, "[Daemon] The daemon closed the connection.")
+    }
+    ok = ok && decode_response(response, result);
+
+    OPENSSL_cleanse(request, request_size);
+    free(request);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return ok;
+}
+
+bool daemon_submit_job(const char *socket_path, int argc, char *argv[], const char *carrier_path, JobResult *result) {
+    memset(result, 0, sizeof(JobResult));
+    int carrier_fd = carrier_path != NULL ? open(carrier_path, O_RDONLY) : -1;
+    if (carrier_path != NULL && carrier_fd < 0) {
+        LOG(WARNING, "[Daemon] Could not open %s, the daemon will try the path.", carrier_path)
+    }
+    bool ok = send_request(socket_path, DAEMON_REQUEST_JOB, carrier_fd >= 0 ? DAEMON_FLAG_CARRIER_FD : 0, argc, argv, carrier_fd, result);
+    if (carrier_fd >= 0) {
+        close(carrier_fd);
+    }
+    return ok;
+}
+
+bool daemon_request_shutdown(const char *socket_path) {
+    JobResult result;
+    return send_request(socket_path, DAEMON_REQUEST_SHUTDOWN, 0, 0, NULL, -1, &result) && result.status == JOB_OK;
+}
@@ -0,0 +1,137 @@
+#include "./include/descriptor.h"
+#include "./include/checksum.h"
+#include "./include/crypto.h"
+#include "./include/file_package.h"
+#include "./include/stego_bmp.h"
+#include "./include/utils.h"
+
+#define DESCRIPTOR_CRC_OFFSET (DESCRIPTOR_SIZE - 4)
+
+static uint8_t log2_of(uint64_t value) {
+    uint8_t log = 0;
+    while (value > 1) {
+        value >>= 1;
+        log++;
+    }
+    return log;
+}
+
+void descriptor_from_options(const ProgramOptions *options, StegoDescriptor *descriptor) {
+    memset(descriptor, 0, sizeof(StegoDescriptor));
+    descriptor->steg_algorithm = options->steg_algorithm;
+    descriptor->compression = options->compression;
+    descriptor->checksum = options->checksum;
+    descriptor->encryption_algo = options->encryption_algo;
+    descriptor->encryption_mode = options->encryption_mode;
+    descriptor->kdf = options->kdf;
+}
+
+size_t descriptor_first_row(const BMPImage *bmp) {
+    size_t row_components = bmp->width * 3;
+    size_t rows = (DESCRIPTOR_COMPONENTS + row_components - 1) / row_components;
+    return rows < bmp->height ? bmp->height - rows : 0;
+}
+
+size_t descriptor_payload_capacity(const BMPImage *bmp, StegAlgorithm steg_alg) {
+    // Only the dimensions are used, so a header-only image stands for the rows below the descriptor
+    BMPImage rows = {.width = bmp->width, .height = descriptor_first_row(bmp)};
+    return rows.height > 0 ? steg_capacity(&rows, steg_alg) : 0;
+}
+
+static void encode_descriptor(const StegoDescriptor *descriptor, uint8_t *block) {
+    memset(block, 0, DESCRIPTOR_SIZE);
+    memcpy(block, DESCRIPTOR_MAGIC, 4);
+    block[4] = DESCRIPTOR_VERSION;
+    block[5] = (uint8_t) descriptor->steg_algorithm;
+    block[6] = descriptor->package_version;
+    block[7] = (uint8_t) descriptor->compression;
+    block[8] = descriptor->checksum ? DESCRIPTOR_FLAG_CHECKSUM : 0;
+    block[9] = (uint8_t) descriptor->encryption_algo;
+    block[10] = (uint8_t) descriptor->encryption_mode;
+    block[11] = (uint8_t) descriptor->kdf.algorithm;
+    block[12] = log2_of(descriptor->kdf.scrypt_n);
+    store_be32(block + 16, descriptor->kdf.iterations);
+    store_be32(block + 20, descriptor->kdf.scrypt_r);
+    store_be32(block + 24, descriptor->kdf.scrypt_p);
+    store_be32(block + DESCRIPTOR_CRC_OFFSET, crc32c(0, block, DESCRIPTOR_CRC_OFFSET));
+}
+
+static bool decode_descriptor(const uint8_t *block, StegoDescriptor *descriptor) {
+    if (memcmp(block, DESCRIPTOR_MAGIC, 4) != 0) {
+        LOG(DEBUG, "[Descriptor] No descriptor in the carrier.")
+        return false;
+    }
+    if (block[4] != DESCRIPTOR_VERSION || load_be32(block + DESCRIPTOR_CRC_OFFSET) != crc32c(0, block, DESCRIPTOR_CRC_OFFSET)) {
+        LOG(ERROR, "Unsupported or damaged descriptor (version %u).", block[4])
+        return false;
+    }
+    // Values this build does not know are rejected rather than guessed
+    if (block[5] < STEG_LSB1 || block[5] > STEG_LSBI || (block[6] != 0 && block[6] != PACKAGE_LARGE_VERSION) ||
+        block[7] > COMPRESSION_ZSTD || (block[8] & ~DESCRIPTOR_FLAG_CHECKSUM) != 0 || block[9] > ENC_CHACHA20 ||
+        block[10] > ENC_MODE_CTR || block[11] > KDF_SCRYPT || block[12] > CRYPTO_SCRYPT_MAX_LOG_N ||
+        block[13] != 0 || block[14] != 0 || block[15] != 0) {
+        LOG(ERROR, "The descriptor holds values this version does not support.")
+        return false;
+    }
+
+    memset(descriptor, 0, sizeof(StegoDescriptor));
+    descriptor->steg_algorithm = (StegAlgorithm) block[5];
+    descriptor->package_version = block[6];
+    descriptor->compression = (CompressionAlgorithm) block[7];
+    descriptor->checksum = (block[8] & DESCRIPTOR_FLAG_CHECKSUM) != 0;
+    descriptor->encryption_algo = (EncryptionAlgorithm) block[9];
+    descriptor->encryption_mode = (EncryptionMode) block[10];
+    descriptor->kdf.algorithm = (KdfAlgorithm) block[11];
+    descriptor->kdf.scrypt_n = block[12] > 0 ? (uint64_t) 1 << block[12] : 0;
+    descriptor->kdf.iterations = load_be32(block + 16);
+    descriptor->kdf.scrypt_r = load_be32(block + 20);
+    descriptor->kdf.scrypt_p = load_be32(block + 24);
+    return true;
+}
+
+bool write_descriptor(BMPImage *bmp, const StegoDescriptor *descriptor) {
+    if (bmp == NULL || descriptor == NULL || descriptor_first_row(bmp) == 0) {
+        LOG(ERROR, "The carrier is too small for a descriptor.")
+        return false;
+    }
+    if (descriptor->kdf.scrypt_n != 0 && ((uint64_t) 1 << log2_of(descriptor->kdf.scrypt_n)) != descriptor->kdf.scrypt_n) {
+        LOG(ERROR, "scrypt N must be a power of two to be described.")
+        return false;
+    }
+    uint8_t block[DESCRIPTOR_SIZE];
+    encode_descriptor(descriptor, block);
+    return embed_at_component(bmp, block, DESCRIPTOR_SIZE, descriptor_first_row(bmp) * bmp->width * 3, STEG_LSB1);
+}
+
+bool read_descriptor(BMPImage *bmp, StegoDescriptor *descriptor) {
+    if (bmp == NULL || descriptor == NULL || descriptor_first_row(bmp) == 0) {
+        return false;
+    }
+    size_t first_component = descriptor_first_row(bmp) * bmp->width * 3;
+    uint8_t block[DESCRIPTOR_SIZE];
+    return bmp_load_rows(bmp, first_component, first_component + DESCRIPTOR_COMPONENTS) &&
+           extract_at_component(bmp, first_component, DESCRIPTOR_SIZE, block, STEG_LSB1) &&
+           decode_descriptor(block, descriptor);
+}
+
+bool descriptor_configure(BMPImage *bmp, ProgramOptions *options) {
+    StegoDescriptor descriptor;
+    if (bmp == NULL || options == NULL || !read_descriptor(bmp, &descriptor)) {
+        return false;
+    }
+    if (descriptor.encryption_algo != ENC_NONE && strlen(options->password) == 0) {
+        LOG(ERROR, "The hidden file is encrypted: -pass is required to extract it.")
+        return false;
+    }
+
+    options->steg_algorithm = descriptor.steg_algorithm;
+    if (options->encryption_algo == ENC_NONE) {
+        options->encryption_algo = descriptor.encryption_algo;
+    }
+    if (options->encryption_mode == ENC_MODE_NONE) {
+        options->encryption_mode = descriptor.encryption_mode;
+    }
+    LOG(INFO, "[Descriptor] Extraction configured from the carrier: algorithm %d, encryption %d, mode %d, compression %d.",
+        descriptor.steg_algorithm, descriptor.encryption_algo, descriptor.encryption_mode, descriptor.compression)
+    return true;
+}
@@ -21,10 +21,15 @@ FilePackage *new_file_package(const char *file_path){
         fclose(file);
         return NULL;
     }
+    if (file_size > UINT32_MAX) {
+        LOG(ERROR, "The file %s is larger than 4 GB: it can only be embedded with -stream.", file_path)
+        fclose(file);
+        return NULL;
+    }
     LOG(DEBUG, "[File] File size: %lu bytes.", file_size)
 
     // Allocate memory for the file data
-    unsigned char *bitmap = (unsigned char *)malloc(file_size);
+    unsigned char *bitmap = (unsigned char *)mem_alloc(file_size);
     if (bitmap == NULL) {
         LOG(ERROR, "Could not allocate memory for file data.")
         fclose(file);
@@ -35,7 +40,7 @@ FilePackage *new_file_package(const char *file_path){
     if (fread(bitmap, 1, file_size, file) != file_size){
         LOG(ERROR, "Could not read the file data.")
         fclose(file);
-        free(bitmap);
+        mem_free(bitmap);
         return NULL;
     }
 
@@ -43,17 +48,17 @@ FilePackage *new_file_package(const char *file_path){
     uint8_t* extension = get_file_extension(file_path);
     if (extension == NULL) {
         LOG(ERROR, "Could not get the file extension.")
-        free(bitmap);
+        mem_free(bitmap);
         fclose(file);
         return NULL;
     }
 
     // Create the FilePackage structure
-    FilePackage *package = (FilePackage *)malloc(sizeof(FilePackage));
+    FilePackage *package = (FilePackage *)mem_alloc(sizeof(FilePackage));
     if (package == NULL) {
         LOG(ERROR, "Could not allocate memory for the FilePackage.")
-        free(bitmap);
-        free(extension);
+        mem_free(bitmap);
+        mem_free(extension);
         fclose(file);
         return NULL;
     }
@@ -62,6 +67,7 @@ FilePackage *new_file_package(const char *file_path){
     package->size = file_size;
     package->data = bitmap;
     package->extension = extension;
+    package->compression = COMPRESSION_NONE;
 
     fclose(file);  // Close the file after reading
 
@@ -83,17 +89,23 @@ uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size) {
         return NULL;
     }
 
-    // Get file size
-    uint32_t file_size = get_file_size(file);
-    if (file_size == 0) {
+    // Get file size. Larger files need the 64-bit header, which only streaming embeds write
+    size_t full_size = get_file_size(file);
+    if (full_size == 0) {
         LOG(ERROR, "Could not get the file size.")
         fclose(file);
         return NULL;
     }
+    if (full_size > UINT32_MAX) {
+        LOG(ERROR, "The file %s is larger than 4 GB: it can only be embedded with -stream.", file_path)
+        fclose(file);
+        return NULL;
+    }
+    uint32_t file_size = (uint32_t) full_size;
     LOG(DEBUG, "[File] File size: %u bytes.", file_size)
 
     // Allocate memory for the file data
-    uint8_t *buffer = (uint8_t *)malloc( sizeof(uint32_t) + file_size + EXTENSION_SIZE);
+    uint8_t *buffer = (uint8_t *)mem_alloc( sizeof(uint32_t) + file_size + EXTENSION_SIZE);
     if (buffer == NULL) {
         LOG(ERROR, "Could not allocate memory for the buffer.")
         fclose(file);
@@ -115,7 +127,7 @@ uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size) {
     if (fread(&buffer[buffer_index], 1, file_size, file) != file_size){
         LOG(ERROR, "Could not read the file data.")
         fclose(file);
-        free(buffer);
+        mem_free(buffer);
         return NULL;
     }
     buffer_index += file_size;
@@ -125,7 +137,7 @@ uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size) {
     uint8_t* extension = get_file_extension(file_path);
     if (extension == NULL) {
         LOG(ERROR, "Could not get the file extension.")
-        free(buffer);
+        mem_free(buffer);
         fclose(file);
         return NULL;
     }
@@ -135,7 +147,7 @@ uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size) {
     LOG(DEBUG, "[File] File extension: %s.", extension)
 
     // Close the file and free the extension
-    free(extension);
+    mem_free(extension);
     fclose(file);
 
     // Set the buffer size and return the buffer
@@ -144,37 +156,144 @@ uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size) {
 }
 
 
+uint8_t* embed_data_from_buffer(const uint8_t *data, size_t size, const char *extension, size_t *buffer_size) {
+    if (data == NULL || size == 0 || size > UINT32_MAX || extension == NULL || buffer_size == NULL) {
+        LOG(ERROR, "Invalid data or extension.")
+        return NULL;
+    }
+    size_t extension_size = strlen(extension) + 1;
+    if (extension[0] != '.' || extension_size < 3 || extension_size > EXTENSION_SIZE) {
+        LOG(ERROR, "Invalid file extension: %s.", extension)
+        return NULL;
+    }
+
+    uint8_t *buffer = (uint8_t *)mem_alloc(sizeof(uint32_t) + size + extension_size);
+    if (buffer == NULL) {
+        LOG(ERROR, "Could not allocate memory for the buffer.")
+        return NULL;
+    }
+
+    // size || data || extension, with the size in the configured endianness
+    uint32_t file_size = (uint32_t) size;
+    memcpy(buffer, &file_size, sizeof(uint32_t));
+    adjust_data_endianness(buffer);
+    memcpy(buffer + sizeof(uint32_t), data, size);
+    memcpy(buffer + sizeof(uint32_t) + size, extension, extension_size);
+
+    *buffer_size = sizeof(uint32_t) + size + extension_size;
+    return buffer;
+}
+
+size_t write_package_header(uint8_t *header, uint64_t size, bool large, CompressionAlgorithm compression) {
+    if (!large && compression == COMPRESSION_NONE && size <= UINT32_MAX) {
+        for (size_t i = 0; i < PACKAGE_SIZE_FIELD; i++) {
+            header[i] = (uint8_t) (size >> (8 * (PACKAGE_SIZE_FIELD - 1 - i)));
+        }
+        return PACKAGE_SIZE_FIELD;
+    }
+    memset(header, 0, PACKAGE_LARGE_HEADER_SIZE);
+    if (compression != COMPRESSION_NONE) {
+        header[PACKAGE_SIZE_FIELD] = PACKAGE_COMPRESSED_VERSION;
+        header[5] = (uint8_t) compression;
+    } else {
+        header[PACKAGE_SIZE_FIELD] = PACKAGE_LARGE_VERSION;
+    }
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        header[8 + i] = (uint8_t) (size >> (8 * (sizeof(uint64_t) - 1 - i)));
+    }
+    return PACKAGE_LARGE_HEADER_SIZE;
+}
+
+size_t parse_package_header(const uint8_t *header, size_t available, uint64_t *size, CompressionAlgorithm *compression) {
+    if (header == NULL || size == NULL || available < PACKAGE_SIZE_FIELD) {
+        return 0;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < PACKAGE_SIZE_FIELD; i++) {
+        value = value << 8 | header[i];
+    }
+    if (compression != NULL) {
+        *compression = COMPRESSION_NONE;
+    }
+    if (value != 0) {
+        *size = value;
+        return PACKAGE_SIZE_FIELD;
+    }
+    if (available < PACKAGE_LARGE_HEADER_SIZE || header[6] != 0 || header[7] != 0) {
+        return 0;
+    }
+    // La versión 2 nombra el códec en el primer byte reservado
+    uint8_t version = header[PACKAGE_SIZE_FIELD];
+    bool compressed = version == PACKAGE_COMPRESSED_VERSION && compression != NULL &&
+                      (header[5] == COMPRESSION_DEFLATE || header[5] == COMPRESSION_ZSTD);
+    if (!compressed && (version != PACKAGE_LARGE_VERSION || header[5] != 0)) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        value = value << 8 | header[8 + i];
+    }
+    if (value == 0 || (compressed && value > UINT32_MAX)) {
+        return 0;
+    }
+    if (compressed) {
+        *compression = (CompressionAlgorithm) header[5];
+    }
+    *size = value;
+    return PACKAGE_LARGE_HEADER_SIZE;
+}
+
+size_t file_package_header_size(const FilePackage *package) {
+    return package != NULL && package->compression != COMPRESSION_NONE ? PACKAGE_LARGE_HEADER_SIZE : PACKAGE_SIZE_FIELD;
+}
+
+FilePackage *new_file_package_from_buffer(const uint8_t *data, size_t size) {
+    if (data == NULL || size < sizeof(uint32_t)) {
+        LOG(ERROR, "Invalid data buffer.")
+        return NULL;
+    }
+
+    // The file and its extension (up to the '\0') must fit in the buffer
+    uint64_t file_size = 0;
+    CompressionAlgorithm compression;
+    size_t header_size = parse_package_header(data, size, &file_size, &compression);
+    if (header_size == 0 || file_size > UINT32_MAX || file_size >= size - header_size ||
+        memchr(data + header_size + file_size, '\0', size - header_size - file_size) == NULL) {
+        LOG(ERROR, "The data does not hold a valid file.")
+        return NULL;
+    }
+    return new_file_package_from_data(data);
+}
+
 FilePackage *new_file_package_from_data(const uint8_t *data){
     if(data == NULL){
         LOG(ERROR, "Invalid data pointer.")
         return NULL;
     }
-    size_t data_index = 0;
 
     // Asignar memoria para la estructura FilePackage
-    FilePackage *file = (FilePackage *)malloc(sizeof(FilePackage));
+    FilePackage *file = (FilePackage *)mem_alloc(sizeof(FilePackage));
     if (file == NULL) {
         LOG(ERROR, "Could not allocate memory for FilePackage.")
         return NULL;
     }
 
-    // Extraer el tamaño de los datos (los primeros 4 bytes)
-    file->size = *(uint32_t *)&data[data_index];
-    data_index += sizeof(uint32_t);
-    if (file->size <= 0) {
-        LOG(ERROR, "Invalid file data size: %u bytes.", file->size)
-        free(file);
+    // Extraer el tamaño de los datos: el campo de 32 bits, o el encabezado versionado si es 0
+    uint64_t size = 0;
+    size_t data_index = parse_package_header(data, PACKAGE_MAX_HEADER_SIZE, &size, &file->compression);
+    if (data_index == 0 || size > UINT32_MAX) {
+        LOG(ERROR, "Invalid file package header.")
+        mem_free(file);
         return NULL;
     }
-    adjust_data_endianness((uint8_t *) &file->size);
+    file->size = (uint32_t) size;
     LOG(INFO, "[File] File size: %u bytes.", file->size)
 
 
     // Asignar memoria para los datos del archivo y copiarlos
-    file->data = (unsigned char *)malloc(file->size);
+    file->data = (unsigned char *)mem_alloc(file->size);
     if (file->data == NULL) {
         LOG(ERROR, "[File] Could not allocate memory for file data.")
-        free(file);
+        mem_free(file);
         return NULL;
     }
     memcpy(file->data, &data[data_index], file->size);
@@ -192,17 +311,17 @@ FilePackage *new_file_package_from_data(const uint8_t *data){
     // Check if the extension is valid
     if(extension[0] != '.' || strlen(extension) < 2){
         LOG(ERROR, "Invalid file extension: %s.", extension)
-        free(file->data);
-        free(file);
+        mem_free(file->data);
+        mem_free(file);
         return NULL;
     }
 
     // Asignar memoria y copiar la extensión
-    file->extension = (uint8_t*) strdup(extension); // strdup asigna y copia la cadena
+    file->extension = (uint8_t*) mem_strdup(extension); // strdup asigna y copia la cadena
     if (file->extension == NULL){
         LOG(ERROR, "Could not allocate memory for file extension.")
-        free(file->data);
-        free(file);
+        mem_free(file->data);
+        mem_free(file);
         return NULL;
     }
 
@@ -221,7 +340,7 @@ uint8_t* create_data_buffer(const FilePackage *package, size_t *buffer_size) {
     size_t extension_length = strlen((char*)package->extension) + 1;  // +1 para incluir el '\0'
     *buffer_size = sizeof(package->size) + package->size + extension_length;
 
-    uint8_t *buffer = (uint8_t *)malloc(*buffer_size);
+    uint8_t *buffer = (uint8_t *)mem_alloc(*buffer_size);
     if (buffer == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para el buffer de datos.")
         return NULL;
@@ -249,7 +368,7 @@ uint8_t* create_data_buffer(const FilePackage *package, size_t *buffer_size) {
 
     if (offset != *buffer_size) {
         LOG(ERROR, "Error al crear el buffer de datos: tamaños inconsistentes.")
-        free(buffer);
+        mem_free(buffer);
         return NULL;
     }
 
@@ -275,7 +394,7 @@ int create_file_from_package(const char *filename, FilePackage *package) {
 
     // Concatenate filename and extension to form the full filename
     size_t full_filename_length = strlen(filename) + strlen((char*)package->extension) + 1; // +1 for null terminator
-    char *full_filename = (char *)malloc(full_filename_length);
+    char *full_filename = (char *)mem_alloc(full_filename_length);
     if (full_filename == NULL) {
         LOG(ERROR, "Could not allocate memory for the full filename.")
         return -1;
@@ -287,7 +406,7 @@ int create_file_from_package(const char *filename, FilePackage *package) {
     FILE *file = fopen(full_filename, "wb");
     if (file == NULL) {
         LOG(ERROR, "Could not open file %s for writing.", full_filename)
-        free(full_filename);
+        mem_free(full_filename);
         return -1;
     }
 
@@ -297,7 +416,7 @@ int create_file_from_package(const char *filename, FilePackage *package) {
         LOG(ERROR, "Error writing data to file %s. Expected %u bytes, wrote %lu bytes.",
             full_filename, package->size, written_bytes)
         fclose(file);
-        free(full_filename);
+        mem_free(full_filename);
         return -1;
     }
 
@@ -306,7 +425,7 @@ int create_file_from_package(const char *filename, FilePackage *package) {
 
     // Clean up
     fclose(file);
-    free(full_filename);
+    mem_free(full_filename);
 
     return 1;
 }
@@ -329,18 +448,30 @@ int create_file_from_raw_data(const char *filename, const uint8_t *data){
     return result;
 }
 
+bool file_package_slice(FilePackage *package, size_t start, size_t length) {
+    if (package == NULL || start >= package->size || length == 0) {
+        LOG(ERROR, "Range outside the hidden file.")
+        return false;
+    }
+    size_t available = package->size - start;
+    size_t kept = length < available ? length : available;
+    memmove(package->data, package->data + start, kept);
+    package->size = (uint32_t) kept;
+    return true;
+}
+
 void free_file_package(FilePackage *package) {
     if (package == NULL) return;
 
     if (package->data != NULL) {
-        free(package->data);
+        mem_free(package->data);
     }
 
     if (package->extension != NULL) {
-        free(package->extension);
+        mem_free(package->extension);
     }
 
-    free(package);
+    mem_free(package);
 }
 
 void print_file_package(FilePackage *package) {
@@ -0,0 +1,86 @@
+#ifndef STEGOBMP_ALLOCATOR_H
+#define STEGOBMP_ALLOCATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Pluggable allocation for the buffers of a job.
+ *
+ * The modules on the job path (bmp_image, file_package, stego_bmp, crypto, stego_job) allocate
+ * through mem_alloc / mem_free, which use the allocator of the calling thread's scope, or
+ * malloc/free when no scope is active. Jobs run inside the scope of their own Arena, so all the
+ * buffers of a job come from a few large chunks and are released at once when the job ends.
+ *
+ * Memory that outlives a job (the carrier cache, the key cache, per-thread crypto state) must be
+ * allocated outside any scope. mem_free may be given such memory inside a scope: an arena hands
+ * pointers it does not own back to its parent allocator.
+ */
+
+#define ARENA_CHUNK_SIZE (64 * 1024)    // Size of the chunks small allocations are carved from
+
+/**
+ * @brief A set of allocation callbacks.
+ *
+ * `reallocate` may be NULL for allocators that are only used as the parent of an arena.
+ */
+typedef struct {
+    void *(*allocate)(size_t size, void *user_data);
+    void *(*reallocate)(void *ptr, size_t size, void *user_data);
+    void (*release)(void *ptr, void *user_data);
+    void *user_data;
+} Allocator;
+
+typedef struct ArenaChunk ArenaChunk;
+
+/**
+ * @brief Bump-pointer allocator for the buffers of one job.
+ *
+ * Allocations are carved from ARENA_CHUNK_SIZE chunks; larger ones get a chunk of their own that
+ * is returned to the parent as soon as it is freed. Freeing the last allocation of the current
+ * chunk gives its space back; anything else is reclaimed by arena_destroy. An arena may move
+ * between threads, but only one thread may use it at a time, and it must not be copied after arena_init.
+ */
+typedef struct {
+    Allocator allocator;        // Callbacks to pass to allocator_scope_enter
+    const Allocator *parent;    // Where the chunks come from, NULL for malloc/free
+    ArenaChunk *chunks;         // Current chunk first
+} Arena;
+
+void *mem_alloc(size_t size);
+void *mem_calloc(size_t count, size_t size);
+void *mem_realloc(void *ptr, size_t size);
+void mem_free(void *ptr);
+char *mem_strdup(const char *string);
+
+/**
+ * @brief Make `allocator` the allocator of the calling thread.
+ *
+ * @param allocator The allocator to use, or NULL for malloc/free.
+ * @param saved     Where the previous allocator is stored, to restore it with allocator_scope_exit.
+ */
+void allocator_scope_enter(const Allocator *allocator, const Allocator **saved);
+
+/**
+ * @brief Restore the allocator that was active before allocator_scope_enter.
+ */
+void allocator_scope_exit(const Allocator *saved);
+
+/**
+ * @brief Prepare an empty arena. No memory is taken until the first allocation.
+ *
+ * @param parent Allocator the chunks come from, or NULL for malloc/free. Must outlive the arena.
+ */
+void arena_init(Arena *arena, const Allocator *parent);
+
+/**
+ * @brief Release every allocation of the arena at once.
+ *
+ * With malloc/free as the parent one chunk is kept by the calling thread for the next arena, so
+ * a worker that runs job after job does not go back to malloc for the small buffers.
+ */
+void arena_destroy(Arena *arena);
+
+#endif //STEGOBMP_ALLOCATOR_H
@@ -0,0 +1,93 @@
+#ifndef STEGOBMP_ANALYSIS_H
+#define STEGOBMP_ANALYSIS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "bmp_image.h"
+#include "thread_pool.h"
+
+/**
+ * LSB steganalysis of a carrier, per colour channel.
+ *
+ * Two classic estimates of how much of the least significant bit plane was replaced:
+ *
+ *  - The chi-square pair-of-values test (Westfeld and Pfitzmann). Replacing LSBs with random bits
+ *    evens out the counts of each pair of values 2k and 2k+1. The test is run on growing prefixes of
+ *    the image in embedding order, and the estimate is the share of the channel over which the pairs
+ *    stay even. It detects sequential embedding, which is how every algorithm here writes, but a
+ *    noisy area whose pairs are already even extends the rate past the end of the payload.
+ *  - RS analysis (Fridrich, Goljan and Du). Groups of four adjacent samples of a row are classified
+ *    as regular or singular by how flipping their LSBs changes their smoothness; the estimate comes
+ *    from how those proportions move when every LSB of the image is flipped. It also detects payloads
+ *    spread over the image.
+ *
+ * Both rates are fractions of the samples of a channel: LSB1 over the whole image gives about 1.
+ *
+ * The rows are split into ANALYSIS_SEGMENTS segments, each counted by a pool task. A task copies
+ * its rows into one buffer per channel and group position, skipping the padding, and classifies
+ * eight groups per vector instruction. Histograms are counted into two tables per channel so that
+ * runs of equal values do not wait on each other. A lazily loaded image is read by the tasks
+ * themselves, one segment at a time.
+ */
+
+#define ANALYSIS_SEGMENTS 128           // Row segments: pool tasks, and steps of the chi-square prefixes
+#define ANALYSIS_CHI_SQUARE_MIN 5       // Pairs expecting fewer occurrences are left out of the test
+#define ANALYSIS_CHI_SQUARE_THRESHOLD 0.5   // p-value above which a prefix counts as embedded
+
+/**
+ * @brief Statistics of one colour channel.
+ */
+typedef struct {
+    uint64_t histogram[256];
+    double chi_square;          // Statistic over the whole channel
+    size_t degrees;             // Degrees of freedom of the statistic (pairs counted - 1)
+    double chi_square_p;        // Probability that the pairs are as even as random LSBs would leave them
+    double chi_square_rate;     // Share of the channel, from its first sample, over which the pairs stay even
+    uint64_t groups;            // RS groups counted
+    uint64_t regular[4];        // Regular groups: mask, negative mask, and both again with every LSB flipped
+    uint64_t singular[4];       // Singular groups, in the same order
+    double rs_rate;             // RS estimate of the embedding rate, NAN if the rows are too short for groups
+} ChannelAnalysis;
+
+/**
+ * @brief Statistics of a whole image, indexed by ColorType.
+ */
+typedef struct {
+    ChannelAnalysis channels[3];
+    size_t samples;             // Samples per channel (width * height)
+    double elapsed_ms;
+} ImageAnalysis;
+
+/**
+ * @brief How run_analysis counts the image.
+ */
+typedef struct {
+    size_t workers;     // Worker threads. 0 = one per CPU, 1 = no pool
+    bool pin_cpus;      // Pin each pool worker to a CPU
+} AnalysisSettings;
+
+/**
+ * @brief Compute the chi-square and RS statistics of every channel.
+ *
+ * @param bmp      Image to analyze. If it was opened lazily, its rows are loaded here.
+ * @param pool     Workers that count the segments, or NULL to count them here.
+ * @param analysis Filled with the statistics.
+ * @return bool false if the image could not be read or the buffers could not be allocated.
+ */
+bool analyze_image(BMPImage *bmp, ThreadPool *pool, ImageAnalysis *analysis);
+
+/**
+ * @brief Analyze a BMP file and write the estimated embedding rates.
+ *
+ * The report has one tab-separated line per channel: channel, chi-square statistic, its degrees of
+ * freedom and p-value, the chi-square rate and the RS rate ("-" if not computed).
+ *
+ * @param path        Path to the BMP file.
+ * @param report_path Path to the report, or NULL to write it to stdout.
+ * @param settings    Worker settings, or NULL for one worker per CPU.
+ * @return int 0, or -1 if the image or the report could not be opened.
+ */
+int run_analysis(const char *path, const char *report_path, const AnalysisSettings *settings);
+
+#endif //STEGOBMP_ANALYSIS_H
@@ -0,0 +1,103 @@
+#ifndef STEGOBMP_ARCHIVE_H
+#define STEGOBMP_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "stego_job.h"
+#include "thread_pool.h"
+
+/**
+ * Archives: the files of a directory hidden in one carrier.
+ *
+ * An archive is the data of a regular package (size || data || extension, with extension
+ * ARCHIVE_EXTENSION), so it is embedded and encrypted like any file. The data starts with an
+ * ARCHIVE_HEADER_SIZE byte header and an index, followed by the members:
+ *
+ *   magic "SBAR" | version (1) | reserved (1) | member count (2) | index size (4) | reserved (4)
+ *
+ * and one index entry per member:
+ *
+ *   offset (4) | stored size (4) | size (4) | CRC-32 (4) | flags (1) | name length (1) | name
+ *
+ * All fields are big-endian and offsets count from the start of the archive. With
+ * ARCHIVE_FLAG_COMPRESSED the stored bytes are compressed data (see compression.h), with zstd if
+ * ARCHIVE_FLAG_ZSTD is also set and deflate otherwise; the size and CRC are those of the original file. Since members are compressed one by one, extracting a
+ * member of an unencrypted archive reads from the carrier only the header, the index and the rows
+ * holding that member.
+ */
+
+#define ARCHIVE_MAGIC "SBAR"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_ENTRY_SIZE 18           // Index entry without its name
+#define ARCHIVE_EXTENSION ".sbar"
+#define ARCHIVE_NAME_MAX 255
+#define ARCHIVE_MAX_MEMBERS UINT16_MAX
+#define ARCHIVE_FLAG_COMPRESSED 0x01
+#define ARCHIVE_FLAG_ZSTD 0x02
+
+/**
+ * @brief Index entry of an archive member.
+ */
+typedef struct {
+    char name[ARCHIVE_NAME_MAX + 1];
+    uint32_t offset;            // First stored byte, from the start of the archive
+    uint32_t stored_size;       // Bytes the member takes in the archive
+    uint32_t size;              // Bytes of the original file
+    uint32_t crc;               // CRC-32 of the original file
+    uint8_t flags;
+} ArchiveEntry;
+
+/**
+ * @brief Build an archive with the regular files of a directory (not recursive), sorted by name.
+ *
+ * @param directory   Directory to archive.
+ * @param compression Compress each member with this algorithm, or COMPRESSION_NONE. Members that
+ *                    do not get smaller are stored as they are.
+ * @param pool        Workers that read and compress the members, or NULL to do it here.
+ * @param size        Set to the size of the archive.
+ * @return uint8_t* The archive (freed with mem_free), or NULL on error.
+ */
+uint8_t* archive_build(const char *directory, CompressionAlgorithm compression, ThreadPool *pool, size_t *size);
+
+/**
+ * @brief Check the header of an archive.
+ *
+ * @param header     ARCHIVE_HEADER_SIZE bytes.
+ * @param count      Set to the number of members.
+ * @param index_size Set to the size of the index that follows the header.
+ * @return bool false if the header does not describe an archive.
+ */
+bool archive_parse_header(const uint8_t *header, size_t *count, size_t *index_size);
+
+/**
+ * @brief Read the index of an archive.
+ *
+ * Every member must lie inside the archive and have a plain file name (no directories, "." or
+ * "..") so extraction cannot write outside the output directory.
+ *
+ * @param index        Index bytes, after the header.
+ * @param index_size   Size of the index.
+ * @param count        Number of members, from the header.
+ * @param archive_size Size of the whole archive.
+ * @return ArchiveEntry* `count` entries (freed with mem_free), or NULL if the index is invalid.
+ */
+ArchiveEntry* archive_parse_index(const uint8_t *index, size_t index_size, size_t count, size_t archive_size);
+
+/**
+ * @brief Run an archive embed or extract job.
+ *
+ * When embedding, `-in` is the directory to archive. When extracting, `-out` is the directory
+ * (created if needed) where the members, or only those listed in `members`, are written. Members
+ * are extracted in parallel on `jobs` workers.
+ *
+ * @param options Validated options with `archive` set.
+ * @param result  Filled with the status, sizes and timings of the job. May be NULL.
+ * @return JobStatus JOB_OK on success.
+ */
+JobStatus run_archive_job(const ProgramOptions *options, JobResult *result);
+
+#endif //STEGOBMP_ARCHIVE_H
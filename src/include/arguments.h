@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <getopt.h>
 #include "logger.h"
@@ -13,6 +14,12 @@
 #define DEFAULT_ENCRYPTION_MODE ENC_MODE_CBC    // Default encryption mode: CBC
 #define DEFAULT_LOG_LEVEL INFO                  // Default log level: INFO
 
+// Default target latency for -kdf-bench, in milliseconds
+#define DEFAULT_KDF_TARGET_MS 250
+
+// Maximum number of worker threads accepted by -jobs
+#define MAX_JOBS 1024
+
 // Maximum allowed password length
 #define MAX_PASSWORD_LENGTH 128
 
@@ -29,9 +36,30 @@ typedef struct {
     const char *input_bmp_file;             // Input BMP file (carrier in embed mode, source in extract mode)
     const char *output_file;            // Output BMP file (for embedding) or file to save the extracted data
     StegAlgorithm steg_algorithm;           // Steganography algorithm to use (LSB1, LSB4, LSBI)
-    EncryptionAlgorithm encryption_algo;    // Encryption algorithm (aes128, aes192, aes256, 3des)
-    EncryptionMode encryption_mode;         // Encryption mode (ecb, cfb, ofb, cbc)
+    bool steg_auto;                         // -steg auto: detect the algorithm from the size field when extracting
+    EncryptionAlgorithm encryption_algo;    // Encryption algorithm (aes128, aes192, aes256, 3des, chacha20)
+    EncryptionMode encryption_mode;         // Encryption mode (ecb, cfb, cfb1, cfb8, cfb128, ofb, cbc, ctr, gcm)
     char password[MAX_PASSWORD_LENGTH];     // Password for encryption/decryption
+    KdfParams kdf;                          // Key derivation function (KDF_NONE = legacy PBKDF2 defaults)
+    double kdf_target_ms;                   // Target latency for -kdf-bench, in milliseconds
+    const char *batch_file;                 // Manifest with one job per line (batch mode)
+    const char *scan_directory;             // Tree of files probed for hidden payloads (scan mode)
+    const char *report_file;                // Per-job report of a batch run (NULL = stdout)
+    size_t jobs;                            // Worker threads for batch runs and chunked jobs (0 = one per CPU)
+    bool pin_cpus;                          // Pin each worker thread to a CPU
+    bool pipeline;                          // Run batch jobs through the staged pipeline
+    const char *socket_path;                // Daemon socket: served with -serve, used by -connect
+    bool stripe;                            // -p (and -out when embedding) list several carriers, separated by commas
+    CompressionAlgorithm compression;       // Compress the payload before embedding (extraction detects it)
+    bool archive;                           // -in (embed) or -out (extract) is a directory, hidden as one archive
+    const char *members;                    // Archive members to extract, separated by commas. NULL extracts all
+    bool checksum;                          // Split the payload in chunks with a CRC32C each (extraction detects it)
+    bool verify_all;                        // Check every chunk when extracting instead of stopping at the first damaged one
+    bool range;                             // Extract only bytes [range_start, range_start + range_length) of the hidden file
+    size_t range_start;
+    size_t range_length;
+    bool stream;                            // Move the payload between its file and the carrier one window of rows at a time
+    bool describe;                          // Record the algorithm and crypto options in a descriptor (see descriptor.h)
 } ProgramOptions;
 
 /**
@@ -58,6 +86,22 @@ int parse_arguments(int argc, char *argv[], ProgramOptions *options);
  */
 void log_program_options(const ProgramOptions *options);
 
+/**
+ * @brief Convert a key derivation function to the name used on the command line.
+ *
+ * @param kdf The key derivation function.
+ * @return The name of the function (e.g. "pbkdf2", "scrypt"), or "UNKNOWN".
+ */
+const char* kdf_algorithm_to_string(KdfAlgorithm kdf);
+
+/**
+ * @brief Convert a steganography algorithm to the name used on the command line.
+ *
+ * @param alg The steganography algorithm.
+ * @return The name of the algorithm (e.g. "LSB1"), or "UNKNOWN".
+ */
+const char* steg_algorithm_to_string(StegAlgorithm alg);
+
 
 #ifdef TESTING
 /**
@@ -68,8 +112,9 @@ OperationMode parse_operation_mode(const char *str);
 StegAlgorithm parse_steg_algorithm(const char *str);
 EncryptionAlgorithm parse_encryption_algorithm(const char *str);
 EncryptionMode parse_encryption_mode(const char *str);
+KdfAlgorithm parse_kdf_algorithm(const char *str);
+CompressionAlgorithm parse_compression_algorithm(const char *str);
 const char* operation_mode_to_string(OperationMode mode);
-const char* steg_algorithm_to_string(StegAlgorithm alg);
 const char* encryption_algorithm_to_string(EncryptionAlgorithm alg);
 const char* encryption_mode_to_string(EncryptionMode mode);
 #endif
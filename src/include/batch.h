@@ -0,0 +1,61 @@
+#ifndef STEGOBMP_BATCH_H
+#define STEGOBMP_BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "stego_job.h"
+
+#define BATCH_MAX_COLUMNS 32        // Maximum number of columns in a manifest line
+
+/**
+ * Manifest format (tab-separated, one job per line):
+ *
+ *   mode    in         p           out          steg   a       m     pass
+ *   embed   msg.txt    lado.bmp    out.bmp      LSBI   aes128  cbc   secreto
+ *   extract            out.bmp     msg_out      LSBI   aes128  cbc   secreto
+ *
+ * The optional header line names the columns after the command line options (without the dash),
+ * so any option can be used as a column (e.g. `kdf`, `kdf-iter`). Without a header the columns are
+ * the ones shown above. Empty cells and `-` are treated as absent options. Lines starting with `#`
+ * are comments.
+ *
+ * Each line is turned into an argument vector and validated with parse_arguments, so a manifest
+ * line has exactly the same semantics as the equivalent command line.
+ *
+ * Jobs run on a work-stealing thread pool. A job that reads a file written by an earlier line (or
+ * writes a file an earlier line uses) waits for it, so dependent lines keep the manifest order.
+ * Paths are compared as written; an extract `out` also matches `out.<ext>`.
+ */
+
+/**
+ * @brief How run_batch schedules the jobs.
+ */
+typedef struct {
+    size_t workers;     // Worker threads (per CPU stage in pipeline mode). 0 = one per CPU
+    bool pin_cpus;      // Pin each pool worker to a CPU
+    bool pipeline;      // Run the jobs through the staged pipeline instead of the work-stealing pool
+} BatchSettings;
+
+/**
+ * @brief Run every job of a manifest in this process and write a per-job report.
+ *
+ * Crypto state is initialized once per worker and reused, and consecutive jobs of a worker on the
+ * same carrier reuse the loaded image. Large LSB1/LSB4 payloads are split into chunks that idle
+ * workers steal. The report is written in manifest order.
+ *
+ * In pipeline mode each job goes through the load, extract, crypto, embed and write stages, each
+ * one with its own threads and connected by bounded lock-free queues, so disk and CPU work of
+ * different jobs overlap. The loader reads ahead the files of the next line. The report then ends
+ * with one comment line per stage (threads, jobs, busy time, utilization, waits and input queue
+ * depth), and total_ms includes the time a job waited between stages.
+ *
+ * @param manifest_path Path to the manifest file.
+ * @param report_path   Path to the TSV report, or NULL to write it to stdout.
+ * @param settings      Scheduling settings, or NULL for the pool with one worker per CPU.
+ * @return int Number of failed jobs, or -1 if the manifest or the report could not be opened or the run could not start.
+ */
+int run_batch(const char *manifest_path, const char *report_path, const BatchSettings *settings);
+
+#endif //STEGOBMP_BATCH_H
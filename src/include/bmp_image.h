@@ -1,23 +1,48 @@
 #ifndef STEGOBMP_BMP_IMAGE_H
 #define STEGOBMP_BMP_IMAGE_H
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include "allocator.h"
 #include "logger.h"
+#include "pixel_pool.h"
 #include "utils.h"
 
 #define BMP_HEADER_SIZE 54  // Total size of the BMP header for V3 format
+#define BMP_PRIVATE_BLOCK_SIZE (64 * 1024)  // Bytes of rows a copy-on-write image allocates at a time for the rows it writes
+
+/**
+ * @brief Pixel data shared by an image and its copies. Freed with the last image that uses it.
+ */
+typedef struct {
+    unsigned char *pixels;                   // From the pixel pool. Never written while shared
+    atomic_size_t references;
+} PixelStore;
 
 /**
  * @brief Structure to hold BMP image data, including header and pixel data.
  */
 typedef struct {
     unsigned char header[BMP_HEADER_SIZE];   // BMP header (54 bytes for V3 format)
-    unsigned char *data;                     // Pointer to the pixel data
+    unsigned char *data;                     // Pointer to the pixel data, from the pixel pool. The shared pixels, read only, when shared
     size_t data_size;                        // Size of the pixel data in bytes and padding
     size_t width;                            // Width of the image in pixels
     size_t height;                           // Height of the image in pixels
+    // Copy-on-write (NULL otherwise): after copy_bmp, an image and its copies read the same
+    // pixels until a row is first written
+    PixelStore *shared;
+    unsigned char **rows;                    // Where each row currently lives: `shared` or a private block (also in a sparse image)
+    bool *dirty_rows;                        // Rows copied to a private block and possibly modified
+    size_t dirty_row_count;
+    unsigned char **private_blocks;          // Blocks of `block_rows` rows, from the pixel pool. NULL until a row of the block is written
+    size_t block_rows;
+    // Lazy loading (NULL otherwise): after new_bmp_lazy, rows are read from the file by bmp_load_rows
+    bool *loaded_rows;
+    int source_fd;
+    off_t source_offset;                     // Position of the pixel data in the file
 } BMPImage;
 
 typedef enum {
@@ -44,11 +69,95 @@ typedef struct {
  */
 BMPImage *new_bmp_file(const char *file_path);
 
+/**
+ * @brief Validates the header copied into `bmp->header` and fills the dimensions and data size.
+ *
+ * Checks that the image is a V3 BMP of 24 bits per pixel without compression. Fields are read as
+ * little-endian integers, and the data size of images of 4 GB or more (whose 32-bit size field is 0
+ * or truncated) is taken from the dimensions, so very large carriers are described correctly. A
+ * size smaller than the rows is rejected: rows are always read and written whole.
+ *
+ * @param bmp Image whose header was read. Only `width`, `height` and `data_size` are written.
+ * @return bool true if the header describes a supported BMP.
+ */
+bool bmp_parse_header(BMPImage *bmp);
+
+/**
+ * @brief Loads a BMP image from a complete BMP file held in memory.
+ *
+ * Applies the same checks as new_bmp_file. The pixel data is copied, so the buffer may be freed afterwards.
+ *
+ * @param buffer Contents of a BMP file.
+ * @param size   Size of the buffer in bytes.
+ * @return BMPImage* Pointer to a dynamically allocated BMPImage structure, or NULL if an error occurred.
+ */
+BMPImage *new_bmp_from_buffer(const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Opens a BMP file and reads only its header. The pixel rows are read by bmp_load_rows.
+ *
+ * Applies the same checks as new_bmp_file. Meant for reading a few components of a large image:
+ * only the rows that are loaded are read from disk. Components of rows that were not loaded must
+ * not be read, and the image must not be copied or saved.
+ *
+ * @param file_path Path to the BMP file on disk.
+ * @return BMPImage* The image, holding the file open until free_bmp, or NULL if an error occurred.
+ */
+BMPImage *new_bmp_file_lazy(const char *file_path);
+
+/**
+ * @brief Reads and validates only the header of the BMP file starting at the current offset of `fd`.
+ *
+ * Applies the same checks as new_bmp_lazy, including that the file holds all the pixel data, but
+ * allocates nothing: `bmp` gets the header, the dimensions, the data size and `source_offset`, and
+ * no pixel can be read from it. Meant for deciding cheaply which files are worth opening.
+ *
+ * @return bool false if the file is not a supported BMP.
+ */
+bool bmp_probe(int fd, BMPImage *bmp);
+
+/**
+ * @brief Like new_bmp_file_lazy, for a BMP file starting at the current offset of `fd`.
+ *
+ * The descriptor must refer to a regular file, since rows are read with pread. It is duplicated, so
+ * the caller keeps ownership of `fd`.
+ */
+BMPImage *new_bmp_lazy(int fd);
+
+/**
+ * @brief Like new_bmp_lazy, without a buffer for the whole image.
+ *
+ * Rows are loaded into blocks of about BMP_PRIVATE_BLOCK_SIZE bytes, and only the blocks holding a
+ * loaded row are allocated. Meant for peeking at many files (scan.h). `data` is only the first
+ * block, so pixels must be read through bmp_row or get_component_by_index, and the image must not
+ * be written either.
+ */
+BMPImage *new_bmp_sparse(int fd);
+
+/**
+ * @brief Reads from disk the rows holding the components [first_component, end_component).
+ *
+ * Rows already loaded are not read again. Does nothing for an image loaded in full.
+ *
+ * @return bool false if the range is outside the image or the file could not be read.
+ */
+bool bmp_load_rows(BMPImage *bmp, size_t first_component, size_t end_component);
+
+/**
+ * @brief Serializes a BMPImage to the bytes of a BMP file (header followed by the pixel data).
+ *
+ * @param bmp  Image to serialize.
+ * @param size Where the size of the returned buffer is stored.
+ * @return uint8_t* Buffer with the file contents, or NULL on error. The caller must free it.
+ */
+uint8_t* bmp_to_buffer(const BMPImage *bmp, size_t *size);
+
 /**
  * @brief Saves a BMPImage to a file.
  *
  * This function writes the BMP header and pixel data to the specified output file.
  * It ensures that both the header and the pixel data are properly written to disk.
+ * The clean rows of a copy are written straight from the shared pixels.
  *
  * @param output_file Path to the output BMP file.
  * @param bmp Pointer to a BMPImage structure that holds the header and pixel data.
@@ -64,13 +173,61 @@ int save_bmp_file(const char *output_file, BMPImage *bmp);
 void free_bmp(BMPImage *bmp);
 
 /**
- * @brief Creates a deep copy of a BMPImage structure.
+ * @brief Creates a copy of a BMPImage structure that shares the pixel data copy-on-write.
  *
- * @param bmp Pointer to the BMPImage structure to copy.
- * @return BMPImage* Pointer to a new BMPImage structure with copied data.
+ * The pixels are not copied: both images read the same shared store, and each one copies a row
+ * into its own memory the first time the row is made writable with bmp_prepare_write. That memory
+ * is allocated in blocks of about BMP_PRIVATE_BLOCK_SIZE bytes, only for the blocks holding written
+ * rows. Rows the source already modified are copied right away. The images can be freed in any
+ * order. When the pixels cannot be shared (the data is shorter than its rows), the copy is a deep one.
+ *
+ * @param bmp Pointer to the BMPImage structure to copy. It becomes copy-on-write too.
+ * @return BMPImage* Pointer to a new BMPImage structure with the same pixels.
  */
 BMPImage* copy_bmp(BMPImage *bmp);
 
+/**
+ * @brief Makes the components [first_component, end_component) writable.
+ *
+ * For an image sharing its pixels, the rows holding them are copied to its own buffer and marked
+ * dirty. Does nothing for a regular image. Embedding calls it before writing, so it must be called
+ * before the writes of a range are split between threads.
+ *
+ * @return bool false if the range is outside the image or a block for its rows could not be allocated.
+ */
+bool bmp_prepare_write(BMPImage *bmp, size_t first_component, size_t end_component);
+
+/**
+ * @brief Gives an image back the shared pixels by restoring only its dirty rows.
+ *
+ * This lets a copy be reused for the next modification of the same original, at a cost
+ * proportional to the rows the previous one touched. The private blocks are kept for it.
+ *
+ * @return size_t Number of rows restored.
+ */
+size_t bmp_discard_changes(BMPImage *bmp);
+
+/**
+ * @brief Finds the rows whose pixels differ between two images of the same dimensions.
+ *
+ * Between copies of the same image only their dirty rows are compared. Padding is ignored.
+ *
+ * @param changed Set to whether each row differs (height entries). May be NULL.
+ * @return size_t Number of different rows, or SIZE_MAX if the dimensions differ.
+ */
+size_t bmp_diff_rows(const BMPImage *a, const BMPImage *b, bool *changed);
+
+/**
+ * @brief Bytes of pixel buffers held by this image alone: its pixels for a regular image, its
+ * private blocks for one sharing its pixels. The shared pixels are not counted.
+ */
+size_t bmp_private_bytes(const BMPImage *bmp);
+
+/**
+ * @brief Pixels of a row, wherever the row currently lives. The padding after `width * 3` bytes is not pixel data.
+ */
+const uint8_t *bmp_row(const BMPImage *bmp, size_t row);
+
 /**
  * @brief Obtiene un puntero al componente de color (byte) en un BMP según el índice de componente global.
  *
@@ -0,0 +1,69 @@
+#ifndef STEGOBMP_BOUNDED_QUEUE_H
+#define STEGOBMP_BOUNDED_QUEUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * Bounded multi-producer multi-consumer queue of pointers, without locks.
+ *
+ * Each slot carries a sequence number that tells producers and consumers whether it is free or
+ * full for the current lap of the ring, so a push or a pop is a single compare-and-swap on the
+ * shared position plus a store on the slot. The capacity is rounded up to a power of two.
+ *
+ * The blocking variants spin briefly and then back off with short sleeps; they are meant for
+ * pipeline stages whose items take milliseconds to process.
+ */
+typedef struct BoundedQueue BoundedQueue;
+
+/**
+ * @brief Create a queue that holds at least `capacity` items.
+ *
+ * @return BoundedQueue* The queue, or NULL on allocation failure.
+ */
+BoundedQueue* bounded_queue_create(size_t capacity);
+
+/**
+ * @brief Free the queue. Items still queued are not freed.
+ */
+void bounded_queue_destroy(BoundedQueue *queue);
+
+/**
+ * @brief Add an item if there is room.
+ *
+ * @return bool false if the queue is full.
+ */
+bool bounded_queue_try_push(BoundedQueue *queue, void *item);
+
+/**
+ * @brief Take the oldest item if there is one.
+ *
+ * @return bool false if the queue is empty.
+ */
+bool bounded_queue_try_pop(BoundedQueue *queue, void **item);
+
+/**
+ * @brief Add an item, waiting while the queue is full.
+ *
+ * @return double Milliseconds spent waiting for room.
+ */
+double bounded_queue_push(BoundedQueue *queue, void *item);
+
+/**
+ * @brief Take the oldest item, waiting while the queue is empty.
+ *
+ * @return double Milliseconds spent waiting for an item.
+ */
+double bounded_queue_pop(BoundedQueue *queue, void **item);
+
+/**
+ * @brief Number of queued items. Only a snapshot while other threads use the queue.
+ */
+size_t bounded_queue_size(const BoundedQueue *queue);
+
+/**
+ * @brief Number of slots of the queue.
+ */
+size_t bounded_queue_capacity(const BoundedQueue *queue);
+
+#endif //STEGOBMP_BOUNDED_QUEUE_H
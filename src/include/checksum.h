@@ -0,0 +1,101 @@
+#ifndef STEGOBMP_CHECKSUM_H
+#define STEGOBMP_CHECKSUM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "file_package.h"
+#include "thread_pool.h"
+
+/**
+ * Chunked packages: the hidden file split in chunks, each with its own CRC32C.
+ *
+ * A chunked package keeps the layout header || data || extension, with the header of the package
+ * it splits, and only its data differs:
+ *
+ *   magic "SBCK" | version (1) | reserved (3) | chunk size (4) | file size (4) | CRC32C of every chunk (4 each) | file
+ *
+ * All fields are big-endian. Chunks are checked independently, so extraction verifies them in
+ * parallel, a range only needs the chunks it overlaps, and damage is reported by byte range. When
+ * the file is also compressed, the chunks hold the compressed data; when encrypted, the chunked
+ * package is what gets encrypted.
+ */
+
+#define CHECKSUM_MAGIC "SBCK"
+#define CHECKSUM_VERSION 1
+#define CHECKSUM_HEADER_SIZE 16
+#define CHECKSUM_CHUNK_SIZE (64 * 1024)
+#define CHECKSUM_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief Outcome of verify_file_package.
+ */
+typedef struct {
+    size_t chunks;              // Chunks of the file
+    size_t checked;             // Chunks verified (fewer than `chunks` when it stopped early)
+    size_t damaged;             // Chunks whose CRC did not match
+    size_t first_damaged;       // File offset of the first damaged chunk, or SIZE_MAX
+} ChecksumReport;
+
+/**
+ * @brief Update a CRC32C (Castagnoli) with `size` bytes. Start with 0.
+ *
+ * Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+ */
+uint32_t crc32c(uint32_t crc, const uint8_t *data, size_t size);
+
+/**
+ * @brief Split the data of a package (header || data || extension) in checksummed chunks, in place.
+ *
+ * @param package    Package built by embed_data_from_file. Replaced by the chunked one (the old
+ *                   buffer is freed with mem_free).
+ * @param size       Size of the package, updated.
+ * @param chunk_size Bytes per chunk, up to CHECKSUM_MAX_CHUNK_SIZE. 0 uses CHECKSUM_CHUNK_SIZE.
+ * @return bool false on error; the package is then unchanged.
+ */
+bool checksum_package(uint8_t **package, size_t *size, size_t chunk_size);
+
+/**
+ * @brief Read a chunked header.
+ *
+ * @param header     CHECKSUM_HEADER_SIZE bytes.
+ * @param chunk_size Set to the chunk size.
+ * @param file_size  Set to the size of the file.
+ * @return bool false if the bytes are not a chunked header.
+ */
+bool checksum_parse_header(const uint8_t *header, size_t *chunk_size, size_t *file_size);
+
+/**
+ * @brief Bytes before the file in the data of a chunked package: the header and the CRC table.
+ */
+size_t checksum_overhead(size_t chunk_size, size_t file_size);
+
+/**
+ * @brief Whether the data of an extracted package starts with a chunked header.
+ */
+bool package_is_checksummed(const FilePackage *package);
+
+/**
+ * @brief Verify every chunk of a chunked package and leave only the file in it.
+ *
+ * Chunks are verified on `pool` when given. Damaged chunks are logged as byte ranges of the file.
+ *
+ * @param package       Chunked package. Its data becomes the file when every chunk is intact.
+ * @param pool          Workers for the verification, or NULL to verify here.
+ * @param stop_at_first Stop at the first damaged chunk instead of checking all of them. The
+ *                      first damaged chunk is still the lowest one.
+ * @param report        Filled with the chunks checked and damaged. May be NULL.
+ * @return bool false if the package is not a valid chunked package or a chunk is damaged.
+ */
+bool verify_file_package(FilePackage *package, ThreadPool *pool, bool stop_at_first, ChecksumReport *report);
+
+#ifdef TESTING
+/**
+ * Only used for testing purposes. The table-driven CRC32C without the initial and final
+ * inversion; its tables are built by the first call to crc32c.
+ */
+uint32_t crc32c_portable(uint32_t crc, const uint8_t *data, size_t size);
+#endif
+
+#endif //STEGOBMP_CHECKSUM_H
@@ -0,0 +1,86 @@
+#ifndef STEGOBMP_COMPRESSION_H
+#define STEGOBMP_COMPRESSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "file_package.h"
+#include "types.h"
+
+/**
+ * Compressed packages.
+ *
+ * A compressed package is marked by its header, which also names the codec (version
+ * PACKAGE_COMPRESSED_VERSION, see file_package.h), so the steganography algorithms, encryption,
+ * ranges and stripes handle it like any other package. Its data holds the size of the original
+ * file followed by the compressed file:
+ *
+ *   original size (8, big-endian) | compressed file
+ *
+ * Extraction reads the header, so no option is needed to read a compressed package back.
+ * Deflate (zlib) is always available; zstd only when the build found libzstd (STEGOBMP_HAVE_ZSTD).
+ */
+
+#define COMPRESSION_SIZE_FIELD 8
+
+/**
+ * @brief Whether this build can compress and decompress with `algorithm`.
+ */
+bool compression_available(CompressionAlgorithm algorithm);
+
+/**
+ * @brief Compress the data of a package (size || data || extension) in place, giving it the
+ * compressed header.
+ *
+ * When compression does not make the package smaller, it is left as it is, so it is never stored
+ * larger than the raw file.
+ *
+ * @param package   Package built by embed_data_from_file. Replaced by the compressed one (the old
+ *                  buffer is wiped and freed with mem_free).
+ * @param size      Size of the package, updated.
+ * @param algorithm COMPRESSION_DEFLATE or COMPRESSION_ZSTD.
+ * @return bool false if compression failed; the package is then unchanged.
+ */
+bool compress_package(uint8_t **package, size_t *size, CompressionAlgorithm algorithm);
+
+/**
+ * @brief Compress a buffer into the data of a compressed package (original size followed by the compressed bytes).
+ *
+ * The codec is not part of the result: whoever stores it records the codec (a package header, an archive entry).
+ *
+ * @param compressed_size Set to the size of the result, or 0 when NULL is returned.
+ * @return uint8_t* The compressed data, freed with mem_free, or NULL if compression failed or would
+ *                  not make the data smaller.
+ */
+uint8_t* compress_buffer(const uint8_t *data, size_t size, CompressionAlgorithm algorithm, size_t *compressed_size);
+
+/**
+ * @brief Whether the header of an extracted package named a codec.
+ */
+bool package_is_compressed(const FilePackage *package);
+
+/**
+ * @brief Replace the data of a compressed package with the original file.
+ *
+ * The codec is `package->compression`, which is COMPRESSION_NONE afterwards.
+ *
+ * @return bool false if the data is not a valid compressed stream.
+ */
+bool decompress_file_package(FilePackage *package);
+
+/**
+ * @brief Like create_file_from_package for a compressed package, decompressing while writing.
+ *
+ * The original file is written in fixed-size pieces and never held in memory as a whole.
+ *
+ * @return 1 if the file was created, -1 on error.
+ */
+int create_file_from_compressed_package(const char *file_name, const FilePackage *package);
+
+/**
+ * @brief Convert a compression algorithm to the name used on the command line ("deflate", "zstd").
+ */
+const char* compression_algorithm_to_string(CompressionAlgorithm algorithm);
+
+#endif //STEGOBMP_COMPRESSION_H
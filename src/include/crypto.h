@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 
 #include "logger.h"
 #include "bmp_image.h"
@@ -14,13 +15,61 @@
 #include "file_package.h"
 #include "utils.h"
 
+/**
+ * Contenedor cifrado versionado:
+ *
+ *   magic (4) || versión (1) || algoritmo (1) || modo (1) ||
+ *   kdf (1) || kdf_params_len (1) || kdf_params ||                   (solo versión 2)
+ *   salt_len (1) || salt || nonce_len (1) || nonce || tag_len (1) || tag || ciphertext
+ *
+ * Los parámetros del KDF son, en big-endian: PBKDF2 = iteraciones (4); scrypt = log2(N) (1) || r (4) || p (4).
+ * La versión 1 no los incluye y usa PBKDF2-SHA256 con CRYPTO_KDF_ITERATIONS.
+ *
+ * Lo usan los modos autenticados (AEAD), donde todos los bytes previos al tag se autentican como AAD,
+ * CTR, y los modos legacy cuando se elige un KDF explícito (el nonce es el IV aleatorio y no hay tag).
+ * Sin KDF explícito los formatos legacy (ECB/CFB/OFB/CBC) no llevan encabezado y se siguen
+ * cifrando y descifrando como antes. CTR con la clave y el IV legacy reutilizaría el keystream
+ * entre mensajes de la misma contraseña, así que CTR sin contenedor no se cifra ni se descifra.
+ */
+#define CRYPTO_CONTAINER_MAGIC "SBMC"       // Identificador del contenedor cifrado versionado
+#define CRYPTO_CONTAINER_MAGIC_SIZE 4       // Tamaño en bytes del identificador
+#define CRYPTO_CONTAINER_VERSION 2          // Versión actual del contenedor
+#define CRYPTO_CONTAINER_VERSION_V1 1       // Versión sin parámetros de KDF (solo lectura)
+#define CRYPTO_SALT_SIZE 16                 // Tamaño de la sal aleatoria del contenedor
+#define CRYPTO_AEAD_NONCE_SIZE 12           // Tamaño del nonce para GCM y ChaCha20-Poly1305
+#define CRYPTO_AEAD_TAG_SIZE 16             // Tamaño del tag de autenticación
+#define CRYPTO_KDF_ITERATIONS 10000         // Iteraciones de PBKDF2 por defecto (y las del formato legacy)
+#define CRYPTO_SCRYPT_N 16384               // Costo por defecto de scrypt
+#define CRYPTO_SCRYPT_R 8                   // Tamaño de bloque por defecto de scrypt
+#define CRYPTO_SCRYPT_P 1                   // Paralelización por defecto de scrypt
+#define CRYPTO_SCRYPT_MAX_LOG_N 22          // Máximo log2(N) aceptado al leer un encabezado
+#define CRYPTO_KDF_MAX_ITERATIONS 100000000 // Máximo de iteraciones aceptado al leer un encabezado
+#define CRYPTO_SCRYPT_MAX_RP (1 << 16)      // Cota (excluida) de r * p de scrypt aceptada al leer un encabezado
+#define CRYPTO_KDF_TARGET_MS 250            // Latencia objetivo por defecto de -kdf-bench
+#define CRYPTO_PARALLEL_MIN_SIZE (4 * 1024 * 1024)  // Tamaño mínimo para procesar CBC/ECB/CTR en paralelo
+#define CRYPTO_CTR_BLOCK_SIZE 16            // Tamaño del bloque del keystream CTR (AES)
+
+/**
+ * @brief Precarga los ciphers de OpenSSL usados por el módulo (EVP_CIPHER_fetch en OpenSSL 3).
+ *
+ * Es idempotente y thread-safe. Si no se llama, la tabla se inicializa en la primera operación.
+ */
+void crypto_init(void);
+
+/**
+ * @brief Libera los ciphers precargados y el contexto reutilizable del thread actual.
+ *
+ * Los contextos de los demás threads se liberan automáticamente cuando terminan.
+ */
+void crypto_cleanup(void);
+
 /**
  * @brief Encripta datos utilizando el algoritmo y modo especificado.
  *
  * @param data           Puntero a los datos a encriptar.
  * @param size           Tamaño de los datos a encriptar en bytes.
  * @param encryption     Algoritmo de encriptación a utilizar (e.g., ENC_AES128, ENC_AES192, ENC_AES256, ENC_3DES).
- * @param mode           Modo de encriptación a utilizar (e.g., ENC_MODE_ECB, ENC_MODE_CFB, ENC_MODE_OFB, ENC_MODE_CBC).
+ * @param mode           Modo de encriptación a utilizar (e.g., ENC_MODE_ECB, ENC_MODE_CFB, ENC_MODE_CFB8, ENC_MODE_CFB128, ENC_MODE_OFB, ENC_MODE_CBC, ENC_MODE_GCM, ENC_MODE_CTR).
  * @param password       Contraseña para generar la clave y el IV.
  * @param encrypted_size Puntero donde se almacenará el tamaño de los datos encriptados.
  * @return uint8_t*      Puntero a los datos encriptados. El llamante es responsable de liberar la memoria.
@@ -42,4 +91,135 @@ uint8_t* crypto_encrypt(const uint8_t *data, size_t size, EncryptionAlgorithm en
  */
 uint8_t* crypto_decrypt(const uint8_t *encrypted_data, size_t encrypted_size, EncryptionAlgorithm encryption, EncryptionMode mode, const uint8_t *password, size_t *decrypted_size);
 
+/**
+ * @brief Encripta datos derivando la clave con el KDF indicado.
+ *
+ * Con un KDF explícito el resultado siempre usa el contenedor versionado, que guarda el KDF, sus
+ * parámetros y una sal aleatoria para que la extracción no dependa de los valores por defecto.
+ *
+ * @param kdf            Parámetros del KDF. NULL o KDF_NONE equivalen a crypto_encrypt.
+ * @return uint8_t*      Igual que crypto_encrypt.
+ */
+uint8_t* crypto_encrypt_with_kdf(const uint8_t *data, size_t size, EncryptionAlgorithm encryption, EncryptionMode mode, const char *password, const KdfParams *kdf, size_t *encrypted_size);
+
+/**
+ * @brief Completa con valores por defecto los campos en 0 de los parámetros del KDF.
+ *
+ * @param kdf Parámetros a completar. KDF_NONE se reemplaza por PBKDF2-SHA256.
+ */
+void crypto_kdf_defaults(KdfParams *kdf);
+
+/**
+ * @brief Indica si los parámetros están dentro de los límites que se aceptan al leer un encabezado
+ * (CRYPTO_KDF_MAX_ITERATIONS, CRYPTO_SCRYPT_MAX_LOG_N y CRYPTO_SCRYPT_MAX_RP, N potencia de 2).
+ * Los campos en 0 se evalúan con su valor por defecto.
+ */
+bool crypto_kdf_valid(const KdfParams *kdf);
+
+/**
+ * @brief Indica si la versión de OpenSSL enlazada soporta el KDF.
+ */
+bool crypto_kdf_available(KdfAlgorithm algorithm);
+
+/**
+ * @brief Deriva `out_len` bytes de clave a partir de la contraseña y la sal.
+ *
+ * @return bool true si la derivación fue exitosa.
+ */
+bool crypto_kdf_derive(const KdfParams *kdf, const char *password, const uint8_t *salt, size_t salt_len, uint8_t *out, size_t out_len);
+
+/**
+ * @brief Mide el tiempo de una derivación con los parámetros indicados.
+ *
+ * @return double Milisegundos de una derivación de 32 bytes, o un valor negativo si falló.
+ */
+double crypto_kdf_time(const KdfParams *kdf);
+
+/**
+ * @brief Busca los parámetros del KDF cuya derivación tarda aproximadamente `target_ms` en este equipo.
+ *
+ * PBKDF2 escala las iteraciones de forma lineal; scrypt duplica N (con r y p por defecto)
+ * mientras no supere el objetivo.
+ *
+ * @param algorithm   KDF a calibrar.
+ * @param target_ms   Latencia objetivo en milisegundos.
+ * @param kdf         Parámetros recomendados.
+ * @param measured_ms Tiempo medido con los parámetros recomendados.
+ * @return bool       true si la calibración fue exitosa.
+ */
+bool crypto_kdf_calibrate(KdfAlgorithm algorithm, double target_ms, KdfParams *kdf, double *measured_ms);
+
+/**
+ * @brief Activa un cache de claves derivadas compartido por todos los threads.
+ *
+ * Con el cache activo, crypto_kdf_derive devuelve la clave guardada cuando se repiten el KDF, sus
+ * parámetros, la sal y la contraseña (por ejemplo, la derivación legacy con sal fija o la extracción
+ * de varias imágenes cifradas juntas). Pensado para procesos de larga duración como -serve.
+ * Las entradas se identifican por un hash y se bloquean en memoria; se borran al desactivarlo
+ * o en crypto_cleanup. crypto_kdf_time y la calibración no lo usan.
+ *
+ * @param entries Cantidad de claves a recordar (se reemplaza la usada hace más tiempo). 0 lo desactiva (default).
+ */
+void crypto_set_key_cache(size_t entries);
+
+/**
+ * @brief Aciertos y fallos del cache de claves desde que se activó.
+ */
+void crypto_key_cache_stats(size_t *hits, size_t *misses);
+
+/**
+ * @brief Descifra solo un rango de un payload cifrado en modo CTR.
+ *
+ * El keystream CTR es direccionable: el contador del bloque del rango se calcula directamente a
+ * partir del IV, sin procesar los bloques anteriores. CTR se cifra siempre dentro del contenedor
+ * versionado, así que la clave y el IV salen de su encabezado (KDF, sal y nonce aleatorios); sin
+ * encabezado no se puede descifrar.
+ *
+ * @param header          Primeros bytes del payload (sin el campo de tamaño), al menos el encabezado
+ *                        del contenedor.
+ * @param header_size     Cantidad de bytes de `header`.
+ * @param encrypted_slice Bytes de ciphertext del rango.
+ * @param slice_size      Cantidad de bytes del rango.
+ * @param stream_offset   Posición del primer byte del rango dentro del payload, contando el encabezado.
+ * @param encryption      Algoritmo de encriptación (AES). En un contenedor se usa el del encabezado.
+ * @param mode            Modo de encriptación (debe ser ENC_MODE_CTR).
+ * @param password        Contraseña utilizada para generar la clave.
+ * @return uint8_t*       Buffer de `slice_size` bytes con el texto plano. El llamante es responsable de liberar la memoria.
+ *                        Devuelve NULL en caso de error.
+ */
+uint8_t* crypto_decrypt_range(const uint8_t *header, size_t header_size, const uint8_t *encrypted_slice, size_t slice_size, size_t stream_offset, EncryptionAlgorithm encryption, EncryptionMode mode, const uint8_t *password);
+
+/**
+ * @brief Fija la cantidad máxima de threads que usa el procesamiento paralelo (descifrado CBC/ECB y CTR)
+ * en las llamadas del thread actual.
+ *
+ * Los buffers de al menos CRYPTO_PARALLEL_MIN_SIZE bytes se dividen en segmentos alineados a bloque
+ * que se procesan en paralelo; el resultado es idéntico al procesamiento serial. El límite no afecta
+ * a los otros threads.
+ *
+ * @param threads Cantidad máxima de threads. 0 usa la cantidad de CPUs disponibles (default), 1 desactiva el paralelismo.
+ * @return size_t El límite anterior del thread, para restaurarlo.
+ */
+size_t crypto_set_max_threads(size_t threads);
+
+/**
+ * @brief Indica si la combinación de algoritmo y modo es un cifrado autenticado (AEAD).
+ *
+ * Los modos AEAD (AES-GCM y ChaCha20-Poly1305) siempre se serializan en el contenedor versionado.
+ *
+ * @param encryption Algoritmo de encriptación.
+ * @param mode       Modo de encriptación.
+ * @return bool      true si es AEAD, false en caso contrario.
+ */
+bool crypto_is_aead(EncryptionAlgorithm encryption, EncryptionMode mode);
+
+/**
+ * @brief Indica si un buffer cifrado comienza con el encabezado del contenedor versionado.
+ *
+ * @param data Puntero a los datos cifrados (sin el campo de tamaño).
+ * @param size Tamaño de los datos en bytes.
+ * @return bool true si los datos tienen el magic y una versión soportada.
+ */
+bool crypto_is_container(const uint8_t *data, size_t size);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef STEGOBMP_DAEMON_H
+#define STEGOBMP_DAEMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stego_job.h"
+
+/**
+ * Local daemon: a warm process that runs embed/extract jobs sent over a Unix domain socket.
+ *
+ * All integers are big-endian. A request is a 16-byte header followed by a block of strings:
+ *
+ *   magic "SBMQ" (4) || version (1) || type (1) || flags (1) || reserved (1) ||
+ *   argument count (4) || strings length (4) || cwd '\0' arg_1 '\0' ... arg_n '\0'
+ *
+ * The arguments are the same command line options of a single job ("-embed", "-in", "x.txt", ...).
+ * Relative paths are resolved against `cwd`, the working directory of the client. With
+ * DAEMON_FLAG_CARRIER_FD the client passes an open descriptor of the carrier (SCM_RIGHTS, with the
+ * header) and the daemon reads the image through it instead of opening the -p path.
+ *
+ * The response has a fixed size:
+ *
+ *   magic "SBMR" (4) || version (1) || status (1) || reserved (2) ||
+ *   payload bytes (8) || stored bytes (8) || load, crypto, steg, write and total time in µs (4 each)
+ *
+ * A connection may carry any number of requests, one after the other.
+ */
+#define DAEMON_REQUEST_MAGIC "SBMQ"
+#define DAEMON_RESPONSE_MAGIC "SBMR"
+#define DAEMON_PROTOCOL_VERSION 1
+#define DAEMON_REQUEST_HEADER_SIZE 16
+#define DAEMON_RESPONSE_SIZE 44
+#define DAEMON_MAX_REQUEST_SIZE (64 * 1024)    // Largest strings block accepted
+#define DAEMON_MAX_ARGUMENTS 64
+#define DAEMON_MAX_CLIENTS 64                  // Connections served at the same time
+#define DAEMON_KEY_CACHE_ENTRIES 64            // Derived keys kept by the daemon
+#define DAEMON_POLL_MS 250                     // How often idle threads check for shutdown
+
+#define DAEMON_FLAG_CARRIER_FD 0x01            // The carrier is the descriptor passed with the request
+
+typedef enum {
+    DAEMON_REQUEST_JOB = 0,         // Run an embed or extract job
+    DAEMON_REQUEST_SHUTDOWN = 1     // Stop accepting connections and exit once the running jobs finish
+} DaemonRequestType;
+
+/**
+ * @brief How run_daemon runs the jobs.
+ */
+typedef struct {
+    size_t workers;     // Threads used to split large payloads. 0 = one per CPU, 1 = no pool
+    bool pin_cpus;      // Pin each pool worker to a CPU
+} DaemonSettings;
+
+/**
+ * @brief Serve jobs on a Unix domain socket until SIGINT, SIGTERM or a shutdown request.
+ *
+ * OpenSSL, the derived-key cache and the worker pool are set up once. Each connection is served
+ * by its own thread; jobs are validated like the command line and answered with their status
+ * and timings. A stale socket file left by a previous run is replaced.
+ *
+ * @param socket_path Path of the socket. It is created with owner-only permissions and removed on exit.
+ * @param settings    Worker settings, or NULL for the defaults.
+ * @return int 0 on a clean shutdown, -1 if the socket could not be set up.
+ */
+int run_daemon(const char *socket_path, const DaemonSettings *settings);
+
+/**
+ * @brief Send one job to a running daemon and wait for its result.
+ *
+ * @param socket_path  Path of the daemon socket.
+ * @param argc         Number of job arguments.
+ * @param argv         Job arguments, without the program name.
+ * @param carrier_path Carrier to pass as an open descriptor, or NULL to let the daemon open the -p path.
+ * @param result       Filled with the status, sizes and timings reported by the daemon.
+ * @return bool false if the daemon could not be reached or sent an invalid response.
+ */
+bool daemon_submit_job(const char *socket_path, int argc, char *argv[], const char *carrier_path, JobResult *result);
+
+/**
+ * @brief Ask a running daemon to shut down.
+ *
+ * @return bool true if the daemon acknowledged the request.
+ */
+bool daemon_request_shutdown(const char *socket_path);
+
+#endif //STEGOBMP_DAEMON_H
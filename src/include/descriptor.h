@@ -0,0 +1,89 @@
+#ifndef STEGOBMP_DESCRIPTOR_H
+#define STEGOBMP_DESCRIPTOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "bmp_image.h"
+#include "types.h"
+
+/**
+ * Self-describing carriers: an opt-in block recording how the payload was hidden, so extraction
+ * can configure itself without -steg or the crypto options.
+ *
+ * The descriptor is always stored with LSB1 in the last rows of the pixel data (the top of the
+ * image), starting at the first component of those rows, whatever algorithm hides the payload.
+ * The payload keeps its usual place and layout from component 0, so a described carrier is still
+ * extracted like any other when -steg is given. Embedding checks that the payload stops before the
+ * descriptor's rows.
+ *
+ *   magic "SBDS" | version (1) | steg (1) | package version (1) | compression (1) | flags (1) |
+ *   encryption (1) | mode (1) | kdf (1) | log2(scrypt N) (1) | reserved (3) |
+ *   kdf iterations (4) | scrypt r (4) | scrypt p (4) | CRC32C of the previous bytes (4)
+ *
+ * Enumerations are stored with their values in types.h, as in the encrypted container. Multi-byte
+ * fields are big-endian. KDF fields of 0 mean the defaults of the function.
+ */
+
+#define DESCRIPTOR_MAGIC "SBDS"
+#define DESCRIPTOR_VERSION 1
+#define DESCRIPTOR_SIZE 32
+#define DESCRIPTOR_COMPONENTS (DESCRIPTOR_SIZE * 8)     // One bit per component
+#define DESCRIPTOR_FLAG_CHECKSUM 0x01                    // The package data is split in checksummed chunks
+
+/**
+ * @brief How a payload was hidden.
+ */
+typedef struct {
+    StegAlgorithm steg_algorithm;
+    uint8_t package_version;            // 0: 32-bit size field; PACKAGE_LARGE_VERSION: 64-bit header
+    CompressionAlgorithm compression;
+    bool checksum;
+    EncryptionAlgorithm encryption_algo;
+    EncryptionMode encryption_mode;
+    KdfParams kdf;
+} StegoDescriptor;
+
+/**
+ * @brief Describe a payload embedded with `options` (after validation).
+ */
+void descriptor_from_options(const ProgramOptions *options, StegoDescriptor *descriptor);
+
+/**
+ * @brief Index of the first row holding the descriptor, or 0 if the image is too small for one
+ * and a payload.
+ */
+size_t descriptor_first_row(const BMPImage *bmp);
+
+/**
+ * @brief Bytes that `steg_alg` can hide before the descriptor's rows.
+ */
+size_t descriptor_payload_capacity(const BMPImage *bmp, StegAlgorithm steg_alg);
+
+/**
+ * @brief Write the descriptor in the last rows of `bmp`.
+ *
+ * @return bool false if the image is too small or a field is out of range.
+ */
+bool write_descriptor(BMPImage *bmp, const StegoDescriptor *descriptor);
+
+/**
+ * @brief Read the descriptor from the last rows of `bmp`. Lazily loaded images only read those rows.
+ *
+ * @return bool false if there is no valid descriptor (wrong magic, version or CRC, or unknown values).
+ */
+bool read_descriptor(BMPImage *bmp, StegoDescriptor *descriptor);
+
+/**
+ * @brief Fill the extraction options of `options` from the descriptor of `bmp`, its loaded carrier.
+ *
+ * Sets the steganography algorithm and, unless given, the encryption algorithm and mode. A lazily
+ * loaded carrier only reads the descriptor's rows.
+ *
+ * @return bool false if the carrier has no descriptor, or it is encrypted and no password was given.
+ */
+bool descriptor_configure(BMPImage *bmp, ProgramOptions *options);
+
+#endif //STEGOBMP_DESCRIPTOR_H
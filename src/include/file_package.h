@@ -6,10 +6,34 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include "allocator.h"
 #include "logger.h"
 #include "types.h"
 #include "utils.h"
 
+/**
+ * Paquetes grandes: el campo de tamaño de 32 bits limita el archivo oculto a 4 GB. Como un tamaño 0
+ * nunca es válido en ese formato, un campo de tamaño 0 indica un encabezado con el tamaño en 64 bits:
+ *
+ *   0 (4) | versión (1) | reservado (3) | tamaño (8) | datos | extensión
+ *
+ * Los campos son big-endian. Solo se usa cuando el archivo no entra en 32 bits, así los archivos
+ * menores conservan el formato original. Un paquete grande no entra en un FilePackage: se oculta y
+ * se extrae por partes (ver stream.h).
+ *
+ * Un paquete comprimido usa el mismo encabezado con su propia versión, que indica el códec:
+ *
+ *   0 (4) | versión 2 (1) | códec (1) | reservado (2) | tamaño (8) | datos | extensión
+ *
+ * Los datos son los de compression.h. Como lo comprimido nunca supera al archivo, siempre entra en
+ * un FilePackage.
+ */
+#define PACKAGE_SIZE_FIELD 4                // Campo de tamaño del formato original
+#define PACKAGE_LARGE_VERSION 1
+#define PACKAGE_COMPRESSED_VERSION 2
+#define PACKAGE_LARGE_HEADER_SIZE 16
+#define PACKAGE_MAX_HEADER_SIZE PACKAGE_LARGE_HEADER_SIZE
+
 /**
  * @brief Structure to hold message file data in memory.
  */
@@ -17,6 +41,7 @@ typedef struct {
     uint32_t size;          // Size of the file
     uint8_t* data;          // File data (bitmap)
     uint8_t* extension;     // File extension (e.g., .txt, .bmp)
+    CompressionAlgorithm compression;   // Codec named by the package header, COMPRESSION_NONE if not compressed
 } FilePackage;
 
 /**
@@ -41,6 +66,55 @@ FilePackage *new_file_package(const char *file_path);
  */
 uint8_t* embed_data_from_file(const char *file_path, size_t *buffer_size);
 
+/**
+ * @brief Crea el buffer para embeber (`tamaño || datos || extensión`) a partir de datos en memoria.
+ *
+ * @param data        Contenido del archivo.
+ * @param size        Tamaño del contenido en bytes (hasta 4 GB).
+ * @param extension   Extensión a guardar, con el punto (e.g., ".txt").
+ * @param buffer_size Puntero donde se almacenará el tamaño total del buffer creado.
+ * @return uint8_t*   Buffer creado. El llamante es responsable de liberar la memoria. Devuelve NULL si ocurre algún error.
+ */
+uint8_t* embed_data_from_buffer(const uint8_t *data, size_t size, const char *extension, size_t *buffer_size);
+
+/**
+ * @brief Escribe el encabezado de un paquete: el campo de tamaño, o el encabezado de 64 bits si el
+ * archivo no entra en 32 bits, si se pide o si está comprimido.
+ *
+ * @param header      Buffer de al menos PACKAGE_MAX_HEADER_SIZE bytes.
+ * @param size        Tamaño del archivo (mayor a 0).
+ * @param large       Usar el encabezado de 64 bits aunque el tamaño entre en 32.
+ * @param compression Códec de los datos, o COMPRESSION_NONE.
+ * @return size_t Bytes escritos: PACKAGE_SIZE_FIELD o PACKAGE_LARGE_HEADER_SIZE.
+ */
+size_t write_package_header(uint8_t *header, uint64_t size, bool large, CompressionAlgorithm compression);
+
+/**
+ * @brief Lee el encabezado de un paquete, en cualquiera de sus formatos.
+ *
+ * @param header      Comienzo del paquete.
+ * @param available   Bytes disponibles en `header`. Para el encabezado de 64 bits hacen falta
+ *                    PACKAGE_LARGE_HEADER_SIZE.
+ * @param size        Recibe el tamaño del archivo.
+ * @param compression Recibe el códec de los datos. NULL si quien llama no sabe descomprimir: un
+ *                    paquete comprimido es entonces inválido.
+ * @return size_t Tamaño del encabezado, o 0 si no es válido.
+ */
+size_t parse_package_header(const uint8_t *header, size_t available, uint64_t *size, CompressionAlgorithm *compression);
+
+/**
+ * @brief Bytes que ocupa el encabezado de un paquete en memoria al ocultarlo.
+ */
+size_t file_package_header_size(const FilePackage *package);
+
+/**
+ * @brief Igual que new_file_package_from_data, pero verifica que el tamaño guardado y la extensión
+ * entren en los `size` bytes del buffer (por ejemplo, datos descifrados con una contraseña incorrecta).
+ *
+ * @return FilePackage* El paquete, o NULL si los datos no describen un archivo válido.
+ */
+FilePackage *new_file_package_from_buffer(const uint8_t *data, size_t size);
+
 
 /**
  * @brief Creates a FilePackage from raw data in memory.
@@ -63,6 +137,15 @@ FilePackage *new_file_package_from_data(const uint8_t *data);
  */
 uint8_t* create_data_buffer(const FilePackage *package, size_t *buffer_size);
 
+/**
+ * @brief Deja en el paquete solo los bytes [start, start + length) del archivo.
+ *
+ * El rango se recorta al final del archivo; la extensión no cambia.
+ *
+ * @return bool false si `start` está fuera del archivo o `length` es 0.
+ */
+bool file_package_slice(FilePackage *package, size_t start, size_t length);
+
 /**
  * Free the memory associated with a FilePackage.
  * @param package Pointer to the FilePackage
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 /**
  * @brief Niveles de log para la salida de mensajes de depuración e información.
@@ -22,9 +23,63 @@ typedef enum {
  */
 extern LogLevel log_level;
 
+/**
+ * @brief Función que recibe los mensajes de log en lugar de stdout/stderr.
+ *
+ * @param level     Nivel del mensaje.
+ * @param message   Mensaje ya formateado, sin salto de línea final.
+ * @param user_data Puntero indicado al activar el ámbito.
+ */
+typedef void (*LogHandler)(LogLevel level, const char *message, void *user_data);
+
+/**
+ * @brief Configuración de log propia de un thread, que reemplaza a la global mientras está activa.
+ *
+ * La usa la API de la biblioteca para que cada llamada respete el nivel y el destino de su
+ * contexto sin modificar `log_level`. Dentro de un ámbito los mensajes `FATAL` no terminan el programa.
+ */
+typedef struct {
+    bool active;
+    LogLevel level;
+    LogHandler handler;     // NULL escribe en stdout/stderr como el log global
+    void *user_data;
+} LogScope;
+
+/**
+ * @brief Ámbito de log del thread actual.
+ */
+extern __thread LogScope log_scope;
+
+/**
+ * @brief Activa un ámbito de log en el thread actual.
+ *
+ * @param scope Configuración a usar.
+ * @param saved Donde se guarda el ámbito anterior, para restaurarlo con log_scope_exit.
+ */
+void log_scope_enter(const LogScope *scope, LogScope *saved);
+
+/**
+ * @brief Restaura el ámbito guardado por log_scope_enter.
+ */
+void log_scope_exit(const LogScope *saved);
+
+/**
+ * @brief Nivel de log vigente en el thread actual: el del ámbito activo o el global.
+ */
+static inline LogLevel log_current_level(void) {
+    return log_scope.active ? log_scope.level : log_level;
+}
+
+/**
+ * @brief Escribe un mensaje de log. Usar a través de la macro LOG.
+ */
+void log_write(LogLevel level, const char *file, int line, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
 /**
  * @brief Cambia el nivel mínimo de severidad para registrar los mensajes de log.
  *
+ * Con un ámbito activo en el thread solo cambia el nivel del ámbito, y `log_level` queda igual.
+ *
  * @param new_level Nivel mínimo de log a registrar. Los mensajes con nivel menor serán ignorados.
  */
 void set_log_level(LogLevel new_level);
@@ -51,22 +106,15 @@ LogLevel parse_log_level(const char *level);
  *
  * Los mensajes `INFO` y `DEBUG` se envían a `stdout`, mientras que los mensajes `ERROR` y `FATAL` se envían a `stderr`.
  * Los metadatos de archivo y línea solo se incluyen para los niveles `ERROR` y `FATAL`.
+ * Con un ámbito de log activo en el thread se usan su nivel y su función de salida.
  *
  * @param level Nivel de severidad del mensaje.
  * @param fmt Formato del mensaje (similar a printf).
  * @param ... Argumentos variables para el formato del mensaje.
  */
 #define LOG(level, fmt, ...)   {\
-    if(level >= log_level) {\
-        FILE* output = (level == ERROR || level == FATAL) ? stderr : stdout; \
-        if (level == ERROR || level == FATAL) {\
-            fprintf(output, "%s: %s:%d: ", log_level_to_string(level), __FILE__, __LINE__); \
-        } else {\
-            fprintf(output, "%s: ", log_level_to_string(level)); \
-        }\
-        fprintf(output, fmt, ##__VA_ARGS__); \
-        fprintf(output, "\n");\
-        if (level == FATAL) exit(1);\
+    if(level >= log_current_level()) {\
+        log_write(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__); \
     }\
 }
 
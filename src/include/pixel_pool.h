@@ -0,0 +1,73 @@
+#ifndef STEGOBMP_PIXEL_POOL_H
+#define STEGOBMP_PIXEL_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Process-wide pool of pixel buffers.
+ *
+ * Batch and daemon workloads load carrier after carrier, usually with the same dimensions.
+ * Released buffers are kept in size classes (steps of 1/8 of a power of two) and handed to the
+ * next image of that class, so its pages are already mapped and no page faults are taken.
+ *
+ * By default the pool keeps PIXEL_POOL_DEFAULT_LIMIT bytes of unused buffers, or one buffer of the
+ * largest class it has handed out per image processed at once if that is more, so even carriers
+ * larger than the default are recycled.
+ *
+ * Buffers are aligned to PIXEL_BUFFER_ALIGNMENT bytes. From PIXEL_HUGE_PAGE_THRESHOLD bytes on
+ * they are mapped directly, aligned to 2 MB, and marked with MADV_HUGEPAGE so the kernel can back
+ * them with transparent huge pages.
+ */
+
+#define PIXEL_BUFFER_ALIGNMENT 64                           // Cache line, and the widest vector load
+#define PIXEL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define PIXEL_HUGE_PAGE_THRESHOLD PIXEL_HUGE_PAGE_SIZE      // Larger buffers are huge-page backed
+#define PIXEL_POOL_DEFAULT_LIMIT (256 * 1024 * 1024)        // Bytes kept by the pool while unused, at least
+#define PIXEL_POOL_AUTO_LIMIT SIZE_MAX                      // pixel_pool_set_limit: back to the default limit
+
+/**
+ * @brief Get a pixel buffer of at least `size` bytes. The contents are undefined.
+ *
+ * @return uint8_t* The buffer, or NULL if it could not be allocated. Release it with pixel_buffer_release.
+ */
+uint8_t* pixel_buffer_acquire(size_t size);
+
+/**
+ * @brief Give a buffer back to the pool. It is unmapped instead if the pool is full.
+ */
+void pixel_buffer_release(uint8_t *buffer);
+
+/**
+ * @brief Set how many bytes of unused buffers the pool may keep. 0 disables pooling.
+ *
+ * Buffers over the new limit are freed right away. PIXEL_POOL_AUTO_LIMIT restores the default,
+ * which follows the workload.
+ */
+void pixel_pool_set_limit(size_t bytes);
+
+/**
+ * @brief Tell the pool how many images are processed at once (1 by default).
+ *
+ * With the default limit the pool then keeps up to that many buffers of the largest class it has
+ * handed out, so a batch of large carriers on several workers recycles every one of them.
+ */
+void pixel_pool_set_workers(size_t workers);
+
+/**
+ * @brief Free every unused buffer kept by the pool.
+ */
+void pixel_pool_trim(void);
+
+/**
+ * @brief Counters of the pool since the process started.
+ *
+ * @param hits         Acquisitions served with a recycled buffer. May be NULL.
+ * @param misses       Acquisitions that had to allocate. May be NULL.
+ * @param cached_bytes Memory taken by the unused buffers the pool keeps, headers and whole mappings included. May be NULL.
+ */
+void pixel_pool_stats(size_t *hits, size_t *misses, size_t *cached_bytes);
+
+#endif //STEGOBMP_PIXEL_POOL_H
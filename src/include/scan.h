@@ -0,0 +1,102 @@
+#ifndef STEGOBMP_SCAN_H
+#define STEGOBMP_SCAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "stego_bmp.h"
+#include "thread_pool.h"
+#include "types.h"
+
+/**
+ * Scanning a directory tree for likely carriers.
+ *
+ * Every regular file under the directory is probed: bmp_probe reads and validates its header, and
+ * for each algorithm peek_payload reads the size field and the extension that follows it from a
+ * sparse image (new_bmp_sparse). Only the first rows and, when a size fits, the rows of its trailer
+ * are read and allocated; no image is loaded in full and no payload is extracted.
+ *
+ * Files are probed on a thread pool in batches of SCAN_BATCH_SIZE. While a batch runs, the next one
+ * is opened and probed and readahead is requested for its first rows, so the workers find them in
+ * the page cache and the device sees many requests at once.
+ */
+
+#define SCAN_BATCH_SIZE 256             // Files open at once per batch (two batches are in flight)
+#define SCAN_PREFIX_COMPONENTS 128      // Components read ahead: pattern map, size field and container magic
+
+/**
+ * @brief How likely a file is to hide something, from least to most.
+ */
+typedef enum {
+    SCAN_NOT_BMP,       // Not a supported BMP
+    SCAN_CLEAN,         // No algorithm reads a size that fits
+    SCAN_SIZE_ONLY,     // A size fits but nothing after it is recognized: legacy encryption, or chance
+    SCAN_AMBIGUOUS,     // Several algorithms read a recognized payload
+    SCAN_RECOGNIZED     // One algorithm reads a payload with an extension or an encrypted container
+} ScanVerdict;
+
+/**
+ * @brief What the scan found in one file.
+ */
+typedef struct {
+    char *path;
+    ScanVerdict verdict;
+    StegAlgorithm steg_algorithm;       // Most likely algorithm, STEG_NONE if no size fits
+    PayloadPeek peek;                   // What steg_algorithm reads
+    size_t fitting;                     // Algorithms whose size field fits the image
+} ScanResult;
+
+/**
+ * @brief Totals of a scan.
+ */
+typedef struct {
+    size_t files;       // Regular files found
+    size_t bitmaps;     // Supported BMPs among them
+    size_t flagged;     // Files with a verdict of SCAN_SIZE_ONLY or more
+    double elapsed_ms;
+} ScanSummary;
+
+/**
+ * @brief How run_scan probes the files.
+ */
+typedef struct {
+    size_t workers;     // Worker threads. 0 = one per CPU, 1 = no pool
+    bool pin_cpus;      // Pin each pool worker to a CPU
+} ScanSettings;
+
+/**
+ * @brief Probe every regular file under `directory`, following subdirectories but not symbolic links to them.
+ *
+ * @param directory Root of the tree.
+ * @param pool      Workers that probe the files, or NULL to probe them here.
+ * @param count     Set to the number of results.
+ * @param summary   Filled with the totals. May be NULL.
+ * @return ScanResult* One result per file, most likely carriers first (freed with free_scan_results),
+ *                     or NULL if the directory could not be read.
+ */
+ScanResult* scan_directory(const char *directory, ThreadPool *pool, size_t *count, ScanSummary *summary);
+
+/**
+ * @brief Free the results of scan_directory.
+ */
+void free_scan_results(ScanResult *results, size_t count);
+
+/**
+ * @brief Name of a verdict in the scan report.
+ */
+const char* scan_verdict_to_string(ScanVerdict verdict);
+
+/**
+ * @brief Scan a directory tree and write the ranked list of likely carriers.
+ *
+ * The report has one tab-separated line per flagged file, most likely first: verdict, algorithm,
+ * hidden size, extension ("encrypted" for an encrypted container, "-" if none) and path.
+ *
+ * @param directory   Root of the tree.
+ * @param report_path Path to the report, or NULL to write it to stdout.
+ * @param settings    Worker settings, or NULL for one worker per CPU.
+ * @return int Number of flagged files, or -1 if the directory or the report could not be opened.
+ */
+int run_scan(const char *directory, const char *report_path, const ScanSettings *settings);
+
+#endif //STEGOBMP_SCAN_H
@@ -12,6 +12,17 @@
 #include "types.h"
 #include "utils.h"
 
+/**
+ * @brief Lo que dice el comienzo de un portador sobre lo oculto con un algoritmo, sin extraerlo.
+ */
+typedef struct {
+    StegAlgorithm steg_algorithm;
+    uint32_t size;                      // Campo de tamaño: el archivo, o lo cifrado cuando hay contraseña
+    bool has_extension;                 // Después de los datos hay una extensión válida ('.', imprimible y '\0')
+    char extension[EXTENSION_SIZE];
+    bool encrypted_container;           // Los datos empiezan con el identificador del contenedor cifrado
+} PayloadPeek;
+
 /**
  * @brief Inserta datos secretos en una imagen BMP utilizando el algoritmo de esteganografía especificado.
  *
@@ -43,6 +54,151 @@ FilePackage* extract_data(const BMPImage *bmp, StegAlgorithm steg_alg);
  */
 uint8_t* extract_encrypted_data(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *extracted_size);
 
+/**
+ * @brief Lee el campo de tamaño de lo oculto con `steg_alg` y la extensión que lo sigue, sin extraer los datos.
+ *
+ * Solo se leen el mapa de patrones (LSBI), el campo de tamaño, los primeros bytes de los datos y la
+ * extensión; en una imagen de new_bmp_file_lazy solo se cargan del disco las filas que los guardan.
+ *
+ * @param bmp      Puntero a la estructura BMPImage.
+ * @param steg_alg Algoritmo de esteganografía (STEG_LSB1, STEG_LSB4, STEG_LSBI).
+ * @param peek     Recibe el tamaño y, si la hay, la extensión.
+ * @return bool    false si el tamaño es 0 o no entra en la capacidad del algoritmo.
+ */
+bool peek_payload(BMPImage *bmp, StegAlgorithm steg_alg, PayloadPeek *peek);
+
+/**
+ * @brief Detecta con qué algoritmo se ocultó un archivo probando LSB1, LSB4 y LSBI con peek_payload.
+ *
+ * Se descartan los candidatos cuyo tamaño no entra en la imagen. Gana el único que empieza con el
+ * contenedor cifrado o, sin `encrypted`, el único con una extensión válida. Lo cifrado sin -kdf no
+ * tiene nada reconocible, así que si ningún candidato cumple lo anterior gana el único cuyo tamaño entra.
+ *
+ * @param bmp       Puntero a la estructura BMPImage.
+ * @param encrypted Si lo oculto está cifrado.
+ * @param peek      Si no es NULL, recibe lo leído con el algoritmo ganador.
+ * @return StegAlgorithm El algoritmo, o STEG_NONE si ninguno o más de uno encuentran un archivo.
+ */
+StegAlgorithm detect_steg_algorithm(BMPImage *bmp, bool encrypted, PayloadPeek *peek);
+
+/**
+ * @brief Indica si el algoritmo permite embeber o extraer rangos de bytes de forma independiente.
+ *
+ * En LSB1 y LSB4 cada byte ocupa componentes fijos (8 y 2 respectivamente), por lo que rangos disjuntos
+ * modifican componentes disjuntos y pueden procesarse en paralelo. LSBI no, porque la inversión depende
+ * de los patrones de toda la imagen.
+ *
+ * @param steg_alg Algoritmo de esteganografía.
+ * @return bool    true para LSB1 y LSB4.
+ */
+bool steg_supports_ranges(StegAlgorithm steg_alg);
+
+/**
+ * @brief Calcula cuántos bytes (tamaño, datos y extensión incluidos) se pueden ocultar en la imagen.
+ *
+ * @param bmp      Puntero a la estructura BMPImage.
+ * @param steg_alg Algoritmo de esteganografía.
+ * @return size_t  Capacidad en bytes, o 0 en caso de error.
+ */
+size_t steg_capacity(const BMPImage *bmp, StegAlgorithm steg_alg);
+
+/**
+ * @brief Inserta solo los bytes [start, start + length) de los datos, en la misma posición que usaría embed.
+ *
+ * Solo válido para los algoritmos de steg_supports_ranges. Rangos disjuntos pueden insertarse desde
+ * threads distintos sobre la misma imagen.
+ *
+ * @param bmp         Puntero a la estructura BMPImage.
+ * @param secret_data Datos completos que se ocultan (no solo el rango).
+ * @param start       Primer byte del rango.
+ * @param length      Cantidad de bytes del rango.
+ * @param steg_alg    Algoritmo de esteganografía (STEG_LSB1 o STEG_LSB4).
+ * @return bool       true si la inserción fue exitosa, false en caso de error.
+ */
+bool embed_range(BMPImage *bmp, const uint8_t *secret_data, size_t start, size_t length, StegAlgorithm steg_alg);
+
+/**
+ * @brief Deja modificables los componentes donde embed_range insertaría los bytes [start, start + length).
+ *
+ * En una copia de copy_bmp copia las filas compartidas. Debe llamarse antes de repartir los rangos
+ * entre hilos, así embed_range no vuelve a copiar filas de forma concurrente.
+ *
+ * @return bool true si el rango está dentro de la imagen.
+ */
+bool prepare_embed_range(BMPImage *bmp, size_t start, size_t length, StegAlgorithm steg_alg);
+
+/**
+ * @brief Extrae los bytes [start, start + length) de lo que se ocultó con embed.
+ *
+ * Solo válido para los algoritmos de steg_supports_ranges.
+ *
+ * @param bmp      Puntero a la estructura BMPImage.
+ * @param start    Primer byte del rango (el campo de tamaño empieza en 0).
+ * @param length   Cantidad de bytes del rango.
+ * @param buffer   Buffer de al menos `length` bytes donde se almacenan los datos.
+ * @param steg_alg Algoritmo de esteganografía (STEG_LSB1 o STEG_LSB4).
+ * @return bool    true si la extracción fue exitosa, false en caso de error.
+ */
+bool extract_range(const BMPImage *bmp, size_t start, size_t length, uint8_t *buffer, StegAlgorithm steg_alg);
+
+/**
+ * @brief Lee el campo de tamaño de lo oculto, en el orden de bytes con que lo escribe embed.
+ *
+ * @param bmp      Puntero a la estructura BMPImage.
+ * @param steg_alg Algoritmo de esteganografía.
+ * @param offset   Componente desde donde se lee. Se actualiza para continuar desde el fin del campo.
+ * @param context  pattern_map de LSBI, o NULL para LSB1 y LSB4.
+ * @return uint32_t Tamaño de los datos ocultos, o 0 en caso de error.
+ */
+uint32_t extract_data_size(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *offset, void *context);
+
+/**
+ * @brief Lee el encabezado del paquete oculto: el campo de tamaño o, si es 0, el encabezado versionado
+ * de un paquete comprimido (ver file_package.h).
+ *
+ * @param offset      Componente desde donde se lee. Se actualiza para continuar desde el fin del encabezado.
+ * @param context     pattern_map de LSBI, o NULL para LSB1 y LSB4.
+ * @param size        Recibe el tamaño de los datos.
+ * @param compression Recibe el códec del paquete, o COMPRESSION_NONE.
+ * @return size_t Tamaño del encabezado, o 0 si no es válido o es el de un paquete grande (ver stream.h).
+ */
+size_t extract_package_header(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *offset, void *context,
+                              uint32_t *size, CompressionAlgorithm *compression);
+
+/**
+ * @brief Oculta `size` bytes a partir del componente `first_component`, fuera del flujo de embed.
+ *
+ * Lo usan los bloques con un lugar fijo en la imagen, como el descriptor (ver descriptor.h).
+ *
+ * @param steg_alg Algoritmo de esteganografía (STEG_LSB1 o STEG_LSB4).
+ * @return bool    false si los bytes no entran desde ese componente.
+ */
+bool embed_at_component(BMPImage *bmp, const uint8_t *data, size_t size, size_t first_component, StegAlgorithm steg_alg);
+
+/**
+ * @brief Extrae `size` bytes ocultos con embed_at_component a partir de `first_component`.
+ */
+bool extract_at_component(const BMPImage *bmp, size_t first_component, size_t size, uint8_t *buffer, StegAlgorithm steg_alg);
+
+/**
+ * @brief Extrae solo los bytes [start, start + length) del archivo ocultado con embed (sin cifrar).
+ *
+ * La posición de cada byte se calcula directamente (en LSBI, salteando el mapa de patrones y los
+ * componentes rojos), así que solo se leen el campo de tamaño, el rango y la extensión. En una imagen
+ * de new_bmp_file_lazy solo se cargan del disco las filas que los contienen. Un archivo comprimido
+ * (ver compression.h) se extrae y descomprime completo, y el rango se toma del archivo original. De
+ * un archivo dividido en bloques (ver checksum.h) se leen y verifican solo los bloques del rango.
+ *
+ * @param bmp       Puntero a la estructura BMPImage.
+ * @param steg_alg  Algoritmo de esteganografía (STEG_LSB1, STEG_LSB4, STEG_LSBI).
+ * @param start     Primer byte del archivo.
+ * @param length    Cantidad de bytes. El rango se recorta al final del archivo.
+ * @param file_size Si no es NULL, recibe el tamaño completo del archivo oculto.
+ * @return FilePackage* Paquete con los bytes del rango y la extensión, o NULL si el rango está fuera
+ *                      del archivo, un bloque del rango está dañado o hubo un error.
+ */
+FilePackage* extract_data_range(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t length, size_t *file_size);
+
 #ifdef TESTING
 /**
  * Only used for testing purposes.
@@ -60,7 +216,6 @@ bool check_capacity_lsbi(const BMPImage *bmp, size_t num_bits);
 bool embed_bits_generic(BMPImage *bmp, const uint8_t *data, size_t num_bits, size_t *offset, int bits_per_component);
 bool extract_bits_generic(const BMPImage *bmp, size_t num_bits, uint8_t *buffer, size_t *offset, int bits_per_component);
 
-size_t extract_data_size(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *offset, void *context);
 bool extract_extension(const BMPImage *bmp, StegAlgorithm steg_alg, char *ext_buffer, size_t *offset, void *context);
 #endif
 
@@ -0,0 +1,144 @@
+#ifndef STEGOBMP_STEGO_JOB_H
+#define STEGOBMP_STEGO_JOB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "bmp_image.h"
+#include "file_package.h"
+#include "thread_pool.h"
+
+#define JOB_CHUNK_SIZE (1024 * 1024)  // Payload bytes embedded or extracted by each stealable chunk
+
+/**
+ * @brief Outcome of a single embed or extract job.
+ */
+typedef enum {
+    JOB_OK,
+    JOB_ERROR_ARGUMENTS,    // Invalid options (e.g. a bad manifest line)
+    JOB_ERROR_INPUT,        // The file to embed could not be read
+    JOB_ERROR_CARRIER,      // The BMP file could not be loaded
+    JOB_ERROR_CRYPTO,       // Encryption or decryption failed
+    JOB_ERROR_STEG,         // Embedding or extraction failed (e.g. not enough capacity)
+    JOB_ERROR_OUTPUT        // The output file could not be written
+} JobStatus;
+
+/**
+ * @brief Status, sizes and per-stage timings of a job.
+ */
+typedef struct {
+    JobStatus status;
+    size_t payload_bytes;   // Packaged payload: size || data || extension
+    size_t stored_bytes;    // Bytes hidden in (or recovered from) the carrier, after encryption
+    double load_ms;         // Reading the input file and the carrier
+    double crypto_ms;       // Encryption or decryption
+    double steg_ms;         // Embedding or extraction
+    double write_ms;        // Writing the output file
+    double total_ms;
+} JobResult;
+
+/**
+ * @brief Steps of a job, in the order they run.
+ *
+ * Every job goes through all of them: embed jobs skip the extract step and extract jobs skip the
+ * embed step, so a pipeline can connect the stages in a single line.
+ */
+typedef enum {
+    JOB_STAGE_LOAD,     // Read the input file and the carrier
+    JOB_STAGE_EXTRACT,  // Extract the hidden bytes (extract jobs)
+    JOB_STAGE_CRYPTO,   // Encrypt or decrypt, when a password was given
+    JOB_STAGE_EMBED,    // Hide the payload in the carrier (embed jobs)
+    JOB_STAGE_WRITE,    // Write the output file
+    JOB_STAGE_COUNT
+} JobStage;
+
+/**
+ * @brief Data a job carries from one stage to the next.
+ */
+typedef struct {
+    const ProgramOptions *options;
+    ProgramOptions carrier_options;     // Copy of the options completed from the carrier when -steg was left out
+    JobResult result;       // The status stays JOB_OK until a stage fails; later stages are then skipped
+    BMPImage *bmp;
+    bool owns_bmp;          // false when the image belongs to a carrier cache
+    bool borrows_copy;      // The image is the cache's copy, restored when the job is done with it
+    uint8_t *data;          // Payload in flight: read from the input, encrypted, or extracted
+    size_t size;
+    FilePackage *package;   // Extracted (and decrypted) file
+    double start_ms;
+    Arena arena;            // Every buffer of the job comes from here while its stages run
+} JobState;
+
+/**
+ * @brief Keeps the last loaded carrier so consecutive jobs on the same BMP do not read it again.
+ *
+ * Extract jobs read the cached image directly. Embed jobs borrow a copy-on-write copy of it,
+ * which only copies the rows the payload touches and gets them back from the carrier after the
+ * output is saved, so the same cover can be reused by many jobs. The entry is dropped when a job
+ * writes to the cached path. A cache serves one job at a time.
+ */
+typedef struct {
+    char *carrier_path;
+    BMPImage *carrier;
+    BMPImage *working_copy; // Copy of `carrier` lent to embed jobs, created on first use
+} JobCarrierCache;
+
+/**
+ * @brief Run one embed or extract job described by already validated options.
+ *
+ * An extract job without a steganography algorithm reads it, once its carrier is loaded, from the
+ * carrier's descriptor or, with -steg auto, detects it from the size field.
+ *
+ * @param options Parsed options (mode must be MODE_EMBED or MODE_EXTRACT).
+ * @param cache   Carrier cache shared between jobs, or NULL to always load the carrier.
+ * @param pool    Pool used to split large LSB1/LSB4 payloads into chunks that idle workers can steal,
+ *                or NULL to embed and extract serially. May be called from one of its workers.
+ * @param result  Filled with the status, sizes and timings of the job. May be NULL.
+ * @return JobStatus JOB_OK on success, or the stage that failed.
+ */
+JobStatus run_stego_job(const ProgramOptions *options, JobCarrierCache *cache, ThreadPool *pool, JobResult *result);
+
+/**
+ * @brief Prepare a job to run stage by stage. Invalid options mark the state as failed.
+ */
+void job_state_init(JobState *state, const ProgramOptions *options);
+
+/**
+ * @brief Run one stage of a job. Does nothing if an earlier stage failed.
+ *
+ * Stages must run in JobStage order, but each one may run on a different thread.
+ *
+ * @param cache Carrier cache used by the load and write stages, or NULL.
+ * @param pool  Pool used to split large payloads in the extract and embed stages, or NULL.
+ * @return JobStatus The status of the job after the stage.
+ */
+JobStatus run_job_stage(JobState *state, JobStage stage, JobCarrierCache *cache, ThreadPool *pool);
+
+/**
+ * @brief Free whatever the job still holds, releasing its arena, and set its total time.
+ */
+void job_state_release(JobState *state);
+
+/**
+ * @brief Convert a stage to the name used in reports ("load", "crypto", ...).
+ */
+const char* job_stage_to_string(JobStage stage);
+
+/**
+ * @brief Release the carrier held by the cache.
+ *
+ * @param cache The cache to clear. The structure itself is not freed.
+ */
+void clear_job_carrier_cache(JobCarrierCache *cache);
+
+/**
+ * @brief Convert a job status to the string used in reports.
+ *
+ * @param status The job status.
+ * @return A constant string such as "ok" or "error-crypto".
+ */
+const char* job_status_to_string(JobStatus status);
+
+#endif //STEGOBMP_STEGO_JOB_H
@@ -0,0 +1,166 @@
+#ifndef STEGOBMP_STEGOLIB_H
+#define STEGOBMP_STEGOLIB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "logger.h"
+#include "types.h"
+
+/**
+ * Embeddable API of stegolib.
+ *
+ * A StegoContext holds the options of a job (steganography algorithm, encryption, password, KDF
+ * and logging). It is immutable once created, so one context may be shared by any number of
+ * threads, and each call works only on its own buffers. Calls never change the global log level
+ * and never exit the process: log messages go to the context's handler (or are dropped) and every
+ * failure is reported as a StegoError.
+ *
+ * Embedded payloads use the same format as the command line tool, so images are interchangeable.
+ *
+ * The working buffers of each call come from an arena that is released when the call returns.
+ * Its chunks, the context and the buffers handed to the caller are allocated with the context's
+ * malloc_fn / free_fn hooks when they are set.
+ */
+
+#define STEGO_EXTENSION_SIZE 16     // Buffer size for an extension, including the '\0'
+#define STEGO_API __attribute__((visibility("default")))   // The shared library exports only these functions
+
+typedef enum {
+    STEGO_OK = 0,
+    STEGO_ERROR_ARGUMENTS,          // Invalid options or parameters
+    STEGO_ERROR_MEMORY,             // An allocation failed
+    STEGO_ERROR_IO,                 // Reading or writing a file descriptor failed
+    STEGO_ERROR_CARRIER,            // The carrier is not a supported BMP (24 bits, uncompressed, V3 header)
+    STEGO_ERROR_CAPACITY,           // The payload does not fit in the carrier
+    STEGO_ERROR_NOT_FOUND,          // No valid payload could be extracted from the carrier
+    STEGO_ERROR_CRYPTO              // Encryption failed, or decryption failed (e.g. wrong password)
+} StegoError;
+
+/**
+ * @brief Receives the log messages of the calls made with a context.
+ */
+typedef void (*StegoLogHandler)(LogLevel level, const char *message, void *user_data);
+
+/**
+ * @brief Options of a context. Initialize with stego_options_init.
+ */
+typedef struct {
+    StegAlgorithm steg_algorithm;
+    EncryptionAlgorithm encryption;     // ENC_NONE with a password uses the command line default
+    EncryptionMode mode;                // ENC_MODE_NONE with a password uses the command line default
+    const char *password;               // NULL or "" to store the payload unencrypted
+    KdfParams kdf;                      // Key derivation when embedding (KDF_NONE = legacy PBKDF2)
+    CompressionAlgorithm compression;   // Compress the payload before embedding. Extraction detects it
+    bool checksum;                      // Split the payload in chunks with a CRC32C each. Extraction detects and verifies it
+    LogLevel log_level;                 // Messages below this level are dropped. Default: NONE
+    StegoLogHandler log_handler;        // NULL writes the messages to stdout/stderr
+    void *log_user_data;
+    void *(*malloc_fn)(size_t size, void *user_data);   // Allocation hooks, both or none. NULL uses malloc/free
+    void (*free_fn)(void *ptr, void *user_data);
+    void *allocator_data;
+} StegoOptions;
+
+typedef struct StegoContext StegoContext;
+
+/**
+ * @brief Fill the options with the defaults: LSB1, no encryption, no logging.
+ */
+STEGO_API void stego_options_init(StegoOptions *options);
+
+/**
+ * @brief Create a context. The options (and the password) are copied.
+ *
+ * @param options Options of the context.
+ * @param context Where the new context is stored.
+ * @return StegoError STEGO_OK, or STEGO_ERROR_ARGUMENTS if the options are not valid.
+ */
+STEGO_API StegoError stego_ctx_new(const StegoOptions *options, StegoContext **context);
+
+/**
+ * @brief Free a context and wipe its password.
+ */
+STEGO_API void stego_ctx_free(StegoContext *context);
+
+/**
+ * @brief Hide a file held in memory in a BMP image held in memory.
+ *
+ * @param context      Context of the job.
+ * @param carrier      Contents of the carrier BMP file.
+ * @param carrier_size Size of the carrier in bytes.
+ * @param data         Contents of the file to hide.
+ * @param data_size    Size of the file in bytes.
+ * @param extension    Extension stored with the file, with the dot (e.g. ".txt").
+ * @param output       Where the resulting BMP file is stored. Free it with stego_free.
+ * @param output_size  Where the size of the resulting BMP file is stored.
+ */
+STEGO_API StegoError stego_embed_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                                        const uint8_t *data, size_t data_size, const char *extension,
+                                        uint8_t **output, size_t *output_size);
+
+/**
+ * @brief Recover the file hidden in a BMP image held in memory.
+ *
+ * @param context      Context of the job.
+ * @param carrier      Contents of the BMP file.
+ * @param carrier_size Size of the BMP file in bytes.
+ * @param data         Where the recovered file is stored. Free it with stego_free.
+ * @param data_size    Where the size of the recovered file is stored.
+ * @param extension    Buffer of STEGO_EXTENSION_SIZE bytes for the stored extension, or NULL.
+ */
+STEGO_API StegoError stego_extract_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                                          uint8_t **data, size_t *data_size, char *extension);
+
+/**
+ * @brief Recover only bytes [start, start + length) of the file hidden in a BMP image held in memory.
+ *
+ * Only the size field, the range and the extension are decoded. With a password the whole payload
+ * has to be decrypted, and the range is cut from it.
+ *
+ * @param start        First byte of the hidden file.
+ * @param length       Number of bytes, cut at the end of the file. Must not be 0.
+ * @param data         Where the bytes are stored. Free it with stego_free.
+ * @param data_size    Where the number of bytes returned is stored.
+ * @param file_size    Where the size of the whole hidden file is stored, or NULL.
+ * @param extension    Buffer of STEGO_EXTENSION_SIZE bytes for the stored extension, or NULL.
+ * @return StegoError  STEGO_ERROR_ARGUMENTS if `start` is past the end of the hidden file.
+ */
+STEGO_API StegoError stego_extract_range_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                                                size_t start, size_t length, uint8_t **data, size_t *data_size,
+                                                size_t *file_size, char *extension);
+
+/**
+ * @brief Like stego_extract_range_buffer, for a carrier stored in a regular file, writing the bytes
+ * to `output_fd`.
+ *
+ * The carrier starts at the current offset of `carrier_fd`, which is not changed. Without a
+ * password only the rows of the image holding the range are read.
+ */
+STEGO_API StegoError stego_extract_range_fd(const StegoContext *context, int carrier_fd, size_t start, size_t length,
+                                            int output_fd, size_t *file_size, char *extension);
+
+/**
+ * @brief Like stego_embed_buffer, reading the carrier and the file from descriptors and writing
+ * the resulting BMP to `output_fd`. The descriptors are read from and written to their current
+ * offset and are not closed.
+ */
+STEGO_API StegoError stego_embed_fd(const StegoContext *context, int carrier_fd, int data_fd, const char *extension, int output_fd);
+
+/**
+ * @brief Like stego_extract_buffer, reading the carrier from a descriptor and writing the
+ * recovered file to `output_fd`.
+ */
+STEGO_API StegoError stego_extract_fd(const StegoContext *context, int carrier_fd, int output_fd, char *extension);
+
+/**
+ * @brief Free a buffer returned by a call made with `context`.
+ */
+STEGO_API void stego_free(const StegoContext *context, void *buffer);
+
+/**
+ * @brief Describe an error code ("ok", "carrier", ...).
+ */
+STEGO_API const char* stego_error_to_string(StegoError error);
+
+#endif //STEGOBMP_STEGOLIB_H
@@ -0,0 +1,65 @@
+#ifndef STEGOBMP_STREAM_H
+#define STEGOBMP_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "stego_job.h"
+#include "types.h"
+
+/**
+ * Streaming embed and extract, for payloads and carriers that do not fit in memory.
+ *
+ * The carrier is read (and, when embedding, written) one window of rows at a time, and the payload
+ * moves straight between its file and the window, so memory use does not grow with the image or
+ * the file. Windows start at multiples of 8 rows, where LSB1 and LSB4 start a new byte, so each one
+ * is embedded or extracted with embed_range and extract_range as an image of its own.
+ *
+ * Payloads over 4 GB use the 64-bit package header (see file_package.h); smaller ones keep the
+ * original size field, so a streamed embed can be extracted by a regular job and the other way
+ * around. The payload is stored as it is: no encryption, compression or checksummed chunks, since
+ * those work on the whole file in memory.
+ */
+
+#define STREAM_WINDOW_SIZE (4 * 1024 * 1024)   // Bytes of rows read per window
+
+/**
+ * @brief Hide a file in a carrier, writing the result to `output_path`.
+ *
+ * @param carrier_path BMP carrier.
+ * @param input_path   File to hide. Its extension is stored after the data.
+ * @param output_path  BMP written with the payload.
+ * @param steg_alg     STEG_LSB1 or STEG_LSB4.
+ * @param large_header Use the 64-bit header even if the file fits in 32 bits.
+ * @param stored       Set to the bytes hidden (header, file and extension). May be NULL.
+ * @return bool false if the file does not fit or an I/O error occurred.
+ */
+bool stream_embed(const char *carrier_path, const char *input_path, const char *output_path, StegAlgorithm steg_alg,
+                  bool large_header, uint64_t *stored);
+
+/**
+ * @brief Extract the file hidden in a carrier to `output_name` followed by its extension.
+ *
+ * Reads the header and the extension first, then copies the data window by window. A partial
+ * output is removed on error.
+ *
+ * @param carrier_path BMP carrier.
+ * @param output_name  Output path without the extension.
+ * @param steg_alg     STEG_LSB1 or STEG_LSB4.
+ * @param file_size    Set to the size of the hidden file. May be NULL.
+ * @return bool false if the carrier holds no valid file or an I/O error occurred.
+ */
+bool stream_extract(const char *carrier_path, const char *output_name, StegAlgorithm steg_alg, uint64_t *file_size);
+
+/**
+ * @brief Run an embed or extract job with `stream` set.
+ *
+ * @param options Validated options.
+ * @param result  Filled with the status, sizes and timings of the job. May be NULL.
+ * @return JobStatus JOB_OK on success.
+ */
+JobStatus run_streamed_job(const ProgramOptions *options, JobResult *result);
+
+#endif //STEGOBMP_STREAM_H
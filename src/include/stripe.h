@@ -0,0 +1,54 @@
+#ifndef STEGOBMP_STRIPE_H
+#define STEGOBMP_STRIPE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "arguments.h"
+#include "stego_job.h"
+
+/**
+ * Striped embedding: one payload spread over several carriers.
+ *
+ * The stream a single job would embed (the package, or the encrypted container) is cut into one
+ * stripe per carrier, sized in proportion to each carrier's capacity. Every carrier hides its
+ * stripe with the usual size field, preceded by a STRIPE_HEADER_SIZE byte header:
+ *
+ *   magic "SBST" | version (1) | reserved (1) | index (2) | count (2) | reserved (2) |
+ *   payload id (4) | stream length (4) | stripe offset (4)
+ *
+ * All fields are big-endian. The payload id is the FNV-1a hash of the whole stream, so stripes of
+ * different payloads are not mixed up and the reassembled stream is checked. Carriers can be given
+ * in any order when extracting.
+ */
+
+#define STRIPE_MAGIC "SBST"
+#define STRIPE_VERSION 1
+#define STRIPE_HEADER_SIZE 24
+#define STRIPE_MAX_CARRIERS 64
+
+/**
+ * @brief Split a stream over carriers in proportion to their capacities.
+ *
+ * @param capacities  Bytes of stream each carrier can hold (after its size field and header).
+ * @param count       Number of carriers.
+ * @param stream_size Bytes to split.
+ * @param lengths     Set to the bytes of the stream given to each carrier, in order.
+ * @return bool false if the stream does not fit in the carriers.
+ */
+bool stripe_plan(const size_t *capacities, size_t count, size_t stream_size, size_t *lengths);
+
+/**
+ * @brief Run a striped embed or extract job.
+ *
+ * `-p` is a comma-separated list of carriers. When embedding, `-out` lists one output per carrier;
+ * when extracting, it is the extracted file. Each carrier is loaded, embedded or extracted and
+ * saved on its own worker thread.
+ *
+ * @param options Validated options with `stripe` set.
+ * @param result  Filled with the status, sizes and timings of the job. May be NULL.
+ * @return JobStatus JOB_OK on success.
+ */
+JobStatus run_striped_job(const ProgramOptions *options, JobResult *result);
+
+#endif //STEGOBMP_STRIPE_H
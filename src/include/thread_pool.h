@@ -0,0 +1,99 @@
+#ifndef STEGOBMP_THREAD_POOL_H
+#define STEGOBMP_THREAD_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * Fixed-size worker pool with per-worker deques and work stealing.
+ *
+ * Every worker owns a deque: it pushes and pops its own tasks at the bottom (LIFO, so the task it
+ * just spawned runs next while its data is still in cache) and, when the deque is empty, steals the
+ * oldest task from the top of another worker's deque. Tasks submitted from a worker go to its own
+ * deque; tasks submitted from any other thread go to the requested worker (or round robin).
+ *
+ * Tasks are tracked in task groups. Waiting on a group from inside a worker keeps executing tasks
+ * instead of blocking, so a task may split itself into subtasks and wait for them without deadlocks.
+ */
+
+typedef void (*ThreadPoolTask)(void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * @brief Set of tasks that can be waited on together. Initialize with THREAD_POOL_GROUP_INIT.
+ */
+typedef struct {
+    size_t pending;     // Submitted tasks that have not finished yet (guarded by the pool)
+} TaskGroup;
+
+#define THREAD_POOL_GROUP_INIT {0}
+#define THREAD_POOL_ANY_WORKER ((size_t) -1)
+
+/**
+ * @brief Per-worker counters, filled by thread_pool_stats.
+ */
+typedef struct {
+    size_t executed;    // Tasks run by the worker (own and stolen)
+    size_t stolen;      // Tasks taken from another worker's deque
+} ThreadPoolWorkerStats;
+
+/**
+ * @brief Start a pool of `workers` threads.
+ *
+ * @param workers  Number of workers. 0 uses the number of online CPUs.
+ * @param pin_cpus Pin worker i to the i-th CPU of the process affinity mask (Linux only, best effort).
+ * @return ThreadPool* The pool, or NULL if no worker could be started.
+ */
+ThreadPool* thread_pool_create(size_t workers, bool pin_cpus);
+
+/**
+ * @brief Queue a task.
+ *
+ * @param pool   The pool.
+ * @param worker Preferred worker for the task, or THREAD_POOL_ANY_WORKER. Ignored when called from
+ *               a worker of the pool, which always pushes to its own deque.
+ * @param group  Group that tracks the task, or NULL.
+ * @param task   Function to run.
+ * @param arg    Argument passed to the function.
+ * @return bool  false if the task could not be queued.
+ */
+bool thread_pool_submit(ThreadPool *pool, size_t worker, TaskGroup *group, ThreadPoolTask task, void *arg);
+
+/**
+ * @brief Wait until every task of the group has finished.
+ *
+ * From a worker of the pool, the caller runs pending tasks (its own first, then stolen ones)
+ * while it waits.
+ */
+void thread_pool_wait(ThreadPool *pool, TaskGroup *group);
+
+/**
+ * @brief Run the remaining tasks, stop the workers and free the pool.
+ */
+void thread_pool_destroy(ThreadPool *pool);
+
+/**
+ * @brief Number of workers of the pool.
+ */
+size_t thread_pool_size(const ThreadPool *pool);
+
+/**
+ * @brief Index of the calling worker in the pool, or THREAD_POOL_ANY_WORKER when the caller is not one of its workers.
+ */
+size_t thread_pool_current_worker(const ThreadPool *pool);
+
+/**
+ * @brief Copy the per-worker counters.
+ *
+ * @param stats Array of thread_pool_size(pool) entries.
+ */
+void thread_pool_stats(ThreadPool *pool, ThreadPoolWorkerStats *stats);
+
+/**
+ * @brief Number of online CPUs (at least 1).
+ */
+size_t thread_pool_default_size(void);
+
+#endif //STEGOBMP_THREAD_POOL_H
@@ -3,11 +3,18 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 typedef enum {
     MODE_NONE,
     MODE_EMBED,
-    MODE_EXTRACT
+    MODE_EXTRACT,
+    MODE_KDF_BENCH,
+    MODE_BATCH,
+    MODE_SERVE,
+    MODE_PEEK,
+    MODE_SCAN,
+    MODE_ANALYZE
 } OperationMode;
 
 typedef enum {
@@ -22,7 +29,8 @@ typedef enum EncryptionAlgorithm{
     ENC_AES128,
     ENC_AES192,
     ENC_AES256,
-    ENC_3DES
+    ENC_3DES,
+    ENC_CHACHA20
 } EncryptionAlgorithm;
 
 typedef enum EncryptionMode{
@@ -30,8 +38,37 @@ typedef enum EncryptionMode{
     ENC_MODE_ECB,
     ENC_MODE_CFB,
     ENC_MODE_OFB,
-    ENC_MODE_CBC
+    ENC_MODE_CBC,
+    ENC_MODE_GCM,
+    ENC_MODE_CFB1,
+    ENC_MODE_CFB8,
+    ENC_MODE_CFB128,
+    ENC_MODE_CTR
 } EncryptionMode;
 
+typedef enum KdfAlgorithm{
+    KDF_NONE,
+    KDF_PBKDF2_SHA256,
+    KDF_PBKDF2_SHA512,
+    KDF_SCRYPT
+} KdfAlgorithm;
+
+typedef enum CompressionAlgorithm{
+    COMPRESSION_NONE,
+    COMPRESSION_DEFLATE,
+    COMPRESSION_ZSTD
+} CompressionAlgorithm;
+
+/**
+ * Parámetros de derivación de clave. Los campos en 0 toman el valor por defecto del KDF.
+ */
+typedef struct {
+    KdfAlgorithm algorithm;
+    uint32_t iterations;    // PBKDF2
+    uint64_t scrypt_n;      // scrypt: costo de CPU/memoria (potencia de 2)
+    uint32_t scrypt_r;      // scrypt: tamaño de bloque
+    uint32_t scrypt_p;      // scrypt: paralelización
+} KdfParams;
+
 
 #endif //STEGOBMP_TYPES_H
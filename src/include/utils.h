@@ -39,10 +39,52 @@ size_t get_file_size(FILE *file);
  *
  * @param file_name Nombre del archivo.
  * @return uint8_t* Cadena duplicada con la extensión del archivo (incluyendo el punto), o NULL si no se encuentra una extensión válida.
- *                 El llamante es responsable de liberar la memoria.
+ *                 El llamante es responsable de liberarla con mem_free.
  */
 uint8_t* get_file_extension(const char *file_name);
 
+/**
+ * @brief Obtiene el tiempo monotónico actual, para medir duraciones.
+ *
+ * @return double Tiempo en milisegundos desde un origen arbitrario.
+ */
+double get_time_ms(void);
+
+/**
+ * @brief Escribe `value` en big-endian en los primeros 2, 4 u 8 bytes de `buffer`, sin importar la
+ * endianess del sistema. Es el orden de los campos binarios de los formatos propios (contenedor
+ * cifrado, protocolo de -serve, franjas, archivos, chunks y descriptor).
+ */
+static inline void store_be16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = (uint8_t) (value >> 8);
+    buffer[1] = (uint8_t) value;
+}
+
+static inline void store_be32(uint8_t *buffer, uint32_t value) {
+    store_be16(buffer, (uint16_t) (value >> 16));
+    store_be16(buffer + 2, (uint16_t) value);
+}
+
+static inline void store_be64(uint8_t *buffer, uint64_t value) {
+    store_be32(buffer, (uint32_t) (value >> 32));
+    store_be32(buffer + 4, (uint32_t) value);
+}
+
+/**
+ * @brief Lee un entero big-endian de 2, 4 u 8 bytes escrito con store_be16/32/64.
+ */
+static inline uint16_t load_be16(const uint8_t *buffer) {
+    return (uint16_t) (buffer[0] << 8 | buffer[1]);
+}
+
+static inline uint32_t load_be32(const uint8_t *buffer) {
+    return (uint32_t) load_be16(buffer) << 16 | load_be16(buffer + 2);
+}
+
+static inline uint64_t load_be64(const uint8_t *buffer) {
+    return (uint64_t) load_be32(buffer) << 32 | load_be32(buffer + 4);
+}
+
 /**
  * @brief Detecta si el sistema es big-endian.
  *
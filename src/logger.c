@@ -2,14 +2,64 @@
 // Created by Felipe Cupitó on 30/09/2024.
 //
 #include "logger.h"
+#include <stdarg.h>
+
+#define LOG_MESSAGE_SIZE 1024   // Largo máximo de un mensaje enviado a un LogHandler
 
 /**
  * @brief Nivel de log actual. Por defecto, se establece en DEBUG para máxima información.
  */
 LogLevel log_level = DEBUG;
 
+/**
+ * @brief Ámbito de log de cada thread. Inactivo por defecto, así que rige el nivel global.
+ */
+__thread LogScope log_scope = {false, NONE, NULL, NULL};
+
 void set_log_level(LogLevel new_level) {
-    log_level = new_level;
+    if (log_scope.active) {
+        log_scope.level = new_level;
+    } else {
+        log_level = new_level;
+    }
+}
+
+void log_scope_enter(const LogScope *scope, LogScope *saved) {
+    *saved = log_scope;
+    log_scope = *scope;
+    log_scope.active = true;
+}
+
+void log_scope_exit(const LogScope *saved) {
+    log_scope = *saved;
+}
+
+void log_write(LogLevel level, const char *file, int line, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    if (log_scope.active && log_scope.handler != NULL) {
+        char message[LOG_MESSAGE_SIZE];
+        vsnprintf(message, sizeof(message), fmt, args);
+        va_end(args);
+        log_scope.handler(level, message, log_scope.user_data);
+        return;
+    }
+
+    FILE* output = (level == ERROR || level == FATAL) ? stderr : stdout;
+    if (level == ERROR || level == FATAL) {
+        fprintf(output, "%s: %s:%d: ", log_level_to_string(level), file, line);
+    } else {
+        fprintf(output, "%s: ", log_level_to_string(level));
+    }
+    vfprintf(output, fmt, args);
+    fprintf(output, "\n");
+    va_end(args);
+
+    // Una biblioteca no termina el proceso: FATAL solo sale fuera de un ámbito
+    if (level == FATAL && !log_scope.active) {
+        exit(1);
+    }
 }
 
 const char *log_level_to_string(LogLevel level) {
@@ -7,6 +7,95 @@
 #include "./include/file_package.h"
 #include "./include/stego_bmp.h"
 #include "./include/crypto.h"
+#include "./include/stego_job.h"
+#include "./include/batch.h"
+#include "./include/daemon.h"
+#include "./include/stripe.h"
+#include "./include/archive.h"
+#include "./include/stream.h"
+#include "./include/scan.h"
+#include "./include/analysis.h"
+#include "./include/thread_pool.h"
+
+/**
+ * @brief Time every available KDF on this host and print the parameters that match the target latency.
+ */
+static void run_kdf_bench(double target_ms) {
+    KdfAlgorithm algorithms[] = {KDF_PBKDF2_SHA256, KDF_PBKDF2_SHA512, KDF_SCRYPT};
+
+    KdfParams defaults = {.algorithm = KDF_PBKDF2_SHA256};
+    crypto_kdf_defaults(&defaults);
+    char flags[64];
+    snprintf(flags, sizeof(flags), "-kdf-iter %u", defaults.iterations);
+    printf("KDF benchmark (objetivo: %.0f ms por derivación)\n\n", target_ms);
+    printf("%-14s  %-34s  %8.1f ms  (default actual)\n", "pbkdf2", flags, crypto_kdf_time(&defaults));
+
+    for (size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+        const char *name = kdf_algorithm_to_string(algorithms[i]);
+        KdfParams kdf;
+        double measured_ms = 0;
+        if (!crypto_kdf_calibrate(algorithms[i], target_ms, &kdf, &measured_ms)) {
+            printf("%-14s  no disponible\n", name);
+            continue;
+        }
+
+        if (kdf.algorithm == KDF_SCRYPT) {
+            snprintf(flags, sizeof(flags), "-kdf-n %llu -kdf-r %u -kdf-p %u", (unsigned long long) kdf.scrypt_n, kdf.scrypt_r, kdf.scrypt_p);
+        } else {
+            snprintf(flags, sizeof(flags), "-kdf-iter %u", kdf.iterations);
+        }
+        printf("%-14s  %-34s  %8.1f ms  (-kdf %s)\n", name, flags, measured_ms, name);
+    }
+}
+
+/**
+ * @brief Print the size and extension of what `steg_alg` hides in `path`, reading only the rows that hold them.
+ *
+ * With STEG_NONE the algorithm is detected first; `encrypted` tells whether a password was given.
+ */
+static int run_peek(const char *path, StegAlgorithm steg_alg, bool encrypted) {
+    BMPImage *bmp = new_bmp_file_lazy(path);
+    PayloadPeek peek;
+    bool found = false;
+    if (bmp != NULL && steg_alg == STEG_NONE) {
+        steg_alg = detect_steg_algorithm(bmp, encrypted, &peek);
+        found = steg_alg != STEG_NONE;
+    } else if (bmp != NULL) {
+        found = peek_payload(bmp, steg_alg, &peek);
+    }
+    free_bmp(bmp);
+    if (!found && steg_alg == STEG_NONE) {
+        LOG(ERROR, "Could not detect the steganography algorithm of %s: use -steg.", path)
+        return 1;
+    }
+    if (!found) {
+        LOG(ERROR, "No hidden file found with %s in %s.", steg_algorithm_to_string(steg_alg), path)
+        return 1;
+    }
+    printf("Algoritmo: %s\n", steg_algorithm_to_string(steg_alg));
+    printf("Tamaño:    %u bytes\n", peek.size);
+    printf("Extensión: %s\n", peek.encrypted_container ? "(cifrado)" : peek.has_extension ? peek.extension : "-");
+    return 0;
+}
+
+/**
+ * @brief Copy the job arguments for the daemon: everything but the program name and -connect.
+ *
+ * @return int Number of arguments written to `forwarded`, which must hold argc entries.
+ */
+static int daemon_job_arguments(int argc, char *argv[], char *forwarded[]) {
+    int count = 0;
+    for (int i = 1; i < argc; i++) {
+        const char *name = argv[i];
+        name += name[0] == '-' ? (name[1] == '-' ? 2 : 1) : 0;
+        if (strcmp(name, "connect") == 0) {
+            i++;    // Skip its value too
+        } else if (strncmp(name, "connect=", 8) != 0) {
+            forwarded[count++] = argv[i];
+        }
+    }
+    return count;
+}
 
 int main(int argc, char *argv[]) {
     // Parse command-line arguments
@@ -18,117 +107,79 @@ int main(int argc, char *argv[]) {
     // Log the parsed arguments
     log_program_options(&arguments);
 
-    // Check the operation mode
-    if (arguments.mode == MODE_EMBED) {
-        LOG(INFO, "Embedding mode selected.")
-
-        // Load the input file
-        size_t  size = 0;
-        uint8_t *emd_data = embed_data_from_file(arguments.input_file, &size);
-
-        // Load the BMP file
-        BMPImage *bmp = new_bmp_file(arguments.input_bmp_file);
-        if (bmp == NULL) {
-            LOG(ERROR, "Error loading the BMP file.")
-            return 1;
-        }
-
-        // Encrypt the data if necessary
-        if(arguments.encryption_mode != ENC_NONE){
-            LOG(INFO, "Encrypting the data.")
-            uint8_t* temp = crypto_encrypt(emd_data, size, arguments.encryption_algo, arguments.encryption_mode, arguments.password, &size);
-            if(temp == NULL){
-                LOG(ERROR, "Error encrypting the data.")
-                free_bmp(bmp);
-                return 1;
-            }
-            free(emd_data);
-            emd_data = temp;
-        }
-
-        // Embed the data into the BMP image
-        embed(bmp, emd_data, size, arguments.steg_algorithm);
-
-        // Save the BMP file
-        int save_result = save_bmp_file(arguments.output_file, bmp);
-        if (save_result != 0) {
-            LOG(ERROR, "Error saving the BMP file.")
-            free_bmp(bmp);
-            free(emd_data);
-            return 1;
-        }
-
-        free(emd_data);
-        free_bmp(bmp);
-
-    } else if (arguments.mode == MODE_EXTRACT) {
-        LOG(INFO, "Extraction mode selected.")
+    // Prefetch the ciphers once; contexts are released on exit
+    crypto_init();
+    atexit(crypto_cleanup);
 
-        // Load the BMP file
-        BMPImage *bmp = new_bmp_file(arguments.input_bmp_file);
-        if (bmp == NULL) {
-            LOG(ERROR, "Error loading the BMP file.")
+    // Check the operation mode
+    if (arguments.mode == MODE_KDF_BENCH) {
+        LOG(INFO, "KDF benchmark mode selected.")
+        run_kdf_bench(arguments.kdf_target_ms);
+        return 0;
+    }
+    if (arguments.mode == MODE_BATCH) {
+        LOG(INFO, "Batch mode selected.")
+        BatchSettings settings = {arguments.jobs, arguments.pin_cpus, arguments.pipeline};
+        return run_batch(arguments.batch_file, arguments.report_file, &settings) == 0 ? 0 : 1;
+    }
+    if (arguments.mode == MODE_SERVE) {
+        LOG(INFO, "Daemon mode selected.")
+        DaemonSettings settings = {arguments.jobs, arguments.pin_cpus};
+        return run_daemon(arguments.socket_path, &settings) == 0 ? 0 : 1;
+    }
+    if (arguments.mode == MODE_SCAN) {
+        LOG(INFO, "Scan mode selected.")
+        ScanSettings settings = {arguments.jobs, arguments.pin_cpus};
+        return run_scan(arguments.scan_directory, arguments.report_file, &settings) >= 0 ? 0 : 1;
+    }
+    if (arguments.mode == MODE_ANALYZE) {
+        LOG(INFO, "Analyze mode selected.")
+        AnalysisSettings settings = {arguments.jobs, arguments.pin_cpus};
+        return run_analysis(arguments.input_bmp_file, arguments.report_file, &settings) == 0 ? 0 : 1;
+    }
+    if (arguments.mode == MODE_PEEK) {
+        LOG(INFO, "Peek mode selected.")
+        return run_peek(arguments.input_bmp_file, arguments.steg_algorithm, strlen(arguments.password) > 0);
+    }
+    if (arguments.socket_path != NULL) {
+        // The daemon validates the job again and reads the carrier through the descriptor we pass
+        char **forwarded = malloc((size_t) argc * sizeof(char *));
+        JobResult result;
+        bool sent = forwarded != NULL && daemon_submit_job(arguments.socket_path, daemon_job_arguments(argc, argv, forwarded), forwarded,
+                                                           arguments.input_bmp_file, &result);
+        free(forwarded);
+        memset(arguments.password, 0, sizeof(arguments.password));
+        if (!sent || result.status != JOB_OK) {
+            LOG(ERROR, "Job failed: %s.", sent ? job_status_to_string(result.status) : "daemon unreachable")
             return 1;
         }
+        LOG(DEBUG, "Job completed by the daemon in %.1f ms.", result.total_ms)
+        return 0;
+    }
 
-        FilePackage *package = NULL;
-        // Extract the data from the BMP image
-        if(arguments.encryption_mode == ENC_NONE){
-            package = extract_data(bmp, arguments.steg_algorithm);
-            if (package == NULL) {
-                LOG(ERROR, "Error extracting data.")
-                free_bmp(bmp);
-                return 1;
-            }
-
-        } else{
-            LOG(INFO, "Decrypting the extracted data.")
-            size_t extracted_size = 0;
-            uint8_t *encrypted_data = extract_encrypted_data(bmp, arguments.steg_algorithm, &extracted_size);
-            if (encrypted_data == NULL) {
-                LOG(ERROR, "Error extracting encrypted data.")
-                free_bmp(bmp);
-                return 1;
-            }
-
-            // Decrypt the extracted data
-            uint8_t *decrypted_data = crypto_decrypt(encrypted_data, extracted_size, arguments.encryption_algo, arguments.encryption_mode, (const uint8_t *)arguments.password, &extracted_size);
-            free(encrypted_data);
-            if (decrypted_data == NULL) {
-                LOG(ERROR, "Error decrypting the extracted data.")
-                free_bmp(bmp);
-                return 1;
-            }
-
-            // Create a FilePackage from the decrypted data
-            package = new_file_package_from_data(decrypted_data);
-            free(decrypted_data);
-            if (package == NULL) {
-                LOG(ERROR, "Error creating FilePackage from de crypted data.")
-                free_bmp(bmp);
-                return 1;
-            }
-
-        }
-
-        // Save the extracted data to a file
-        if(!create_file_from_package(arguments.output_file, package)){
-            LOG(ERROR, "Error creating the output file.")
-            free_file_package(package);
-            free_bmp(bmp);
+    if (arguments.stripe || arguments.archive || arguments.stream) {
+        JobResult result;
+        JobStatus status = arguments.stripe    ? run_striped_job(&arguments, &result)
+                           : arguments.archive ? run_archive_job(&arguments, &result)
+                                               : run_streamed_job(&arguments, &result);
+        if (status != JOB_OK) {
+            LOG(ERROR, "Job failed: %s.", job_status_to_string(result.status))
             return 1;
         }
+        LOG(DEBUG, "Job completed in %.1f ms.", result.total_ms)
+        return 0;
+    }
 
-        free_file_package(package);
-        free_bmp(bmp);
-
-        LOG(INFO, "Output file created successfully.")
-    }else{
-        LOG(ERROR, "Invalid operation mode.")
+    // Single embed or extract job; large LSB1/LSB4 payloads are split over the workers
+    ThreadPool *pool = arguments.jobs != 1 ? thread_pool_create(arguments.jobs, arguments.pin_cpus) : NULL;
+    JobResult result;
+    JobStatus status = run_stego_job(&arguments, NULL, pool, &result);
+    thread_pool_destroy(pool);
+    if (status != JOB_OK) {
+        LOG(ERROR, "Job failed: %s.", job_status_to_string(result.status))
         return 1;
     }
+    LOG(DEBUG, "Job completed in %.1f ms.", result.total_ms)
 
     return 0;
 }
-
-
@@ -0,0 +1,267 @@
+#include "./include/pixel_pool.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "./include/logger.h"
+
+#define PIXEL_POOL_MAX_CLASSES 64           // Distinct buffer sizes the pool keeps
+#define PIXEL_POOL_SMALL_STEP 64            // Granularity of the smallest classes
+
+/**
+ * @brief Bookkeeping stored in the PIXEL_BUFFER_ALIGNMENT bytes in front of each buffer.
+ *
+ * A mapped buffer keeps it in a normal page of its own in front of the first huge page, so the
+ * pixels start on the 2 MB boundary and a capacity that is a multiple of 2 MB maps no extra huge page.
+ */
+typedef struct PixelBufferHeader {
+    struct PixelBufferHeader *next;     // Next free buffer of the same class
+    size_t capacity;                    // Usable bytes
+    size_t mapping_size;                // Bytes mapped with mmap, header page included. 0 if allocated with posix_memalign
+} PixelBufferHeader;
+
+_Static_assert(sizeof(PixelBufferHeader) <= PIXEL_BUFFER_ALIGNMENT, "The header must fit in front of the buffer");
+
+typedef struct {
+    size_t capacity;
+    PixelBufferHeader *free_list;
+} PixelPoolClass;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static PixelPoolClass pool_classes[PIXEL_POOL_MAX_CLASSES];
+static size_t pool_class_count = 0;
+static size_t pool_limit = PIXEL_POOL_AUTO_LIMIT;
+static size_t pool_workers = 1;
+static size_t pool_largest_bytes = 0;       // Memory of the largest buffer handed out, for the default limit
+static size_t pool_cached_bytes = 0;        // Memory of the free buffers, as counted by buffer_bytes
+static size_t pool_hits = 0;
+static size_t pool_misses = 0;
+
+/**
+ * @brief Round a size up to its class: steps of 1/8 of the highest power of two below it, so at most 12.5% is wasted.
+ */
+static size_t class_capacity(size_t size) {
+    size_t power = 1;
+    while (power <= size / 2) {
+        power *= 2;
+    }
+    size_t step = power / 8 > PIXEL_POOL_SMALL_STEP ? power / 8 : PIXEL_POOL_SMALL_STEP;
+    return (size + step - 1) / step * step;
+}
+
+/**
+ * @brief Memory taken by a buffer of class `capacity`: its mapping, or its allocation with the header.
+ */
+static size_t buffer_bytes(size_t capacity) {
+    if (capacity >= PIXEL_HUGE_PAGE_THRESHOLD) {
+        return (capacity + PIXEL_HUGE_PAGE_SIZE - 1) / PIXEL_HUGE_PAGE_SIZE * PIXEL_HUGE_PAGE_SIZE + (size_t) sysconf(_SC_PAGESIZE);
+    }
+    return PIXEL_BUFFER_ALIGNMENT + capacity;
+}
+
+static PixelBufferHeader *header_of(uint8_t *buffer) {
+    return (PixelBufferHeader *) (buffer - PIXEL_BUFFER_ALIGNMENT);
+}
+
+static uint8_t *new_buffer(size_t capacity) {
+    PixelBufferHeader *header = NULL;
+    size_t mapping_size = 0;
+
+    if (capacity >= PIXEL_HUGE_PAGE_THRESHOLD) {
+        // Map one extra huge page and trim the ends so the pixels start on a 2 MB boundary, keeping
+        // the page in front of it for the header. The first boundary past the start of the mapping
+        // always leaves at least that page
+        mapping_size = buffer_bytes(capacity);
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        size_t huge_size = mapping_size - page_size;
+        uint8_t *mapping = mmap(NULL, huge_size + PIXEL_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+        uint8_t *aligned = (uint8_t *) (((uintptr_t) mapping + PIXEL_HUGE_PAGE_SIZE) & ~((uintptr_t) PIXEL_HUGE_PAGE_SIZE - 1));
+        if (aligned - page_size > mapping) {
+            munmap(mapping, (size_t) (aligned - page_size - mapping));
+        }
+        size_t tail = (size_t) (mapping + huge_size + PIXEL_HUGE_PAGE_SIZE - (aligned + huge_size));
+        if (tail > 0) {
+            munmap(aligned + huge_size, tail);
+        }
+#ifdef MADV_HUGEPAGE
+        // Only a hint: without transparent huge pages the buffer still works with normal pages
+        madvise(aligned, huge_size, MADV_HUGEPAGE);
+#endif
+        header = (PixelBufferHeader *) (aligned - PIXEL_BUFFER_ALIGNMENT);
+    } else {
+        void *memory = NULL;
+        if (posix_memalign(&memory, PIXEL_BUFFER_ALIGNMENT, PIXEL_BUFFER_ALIGNMENT + capacity) != 0) {
+            return NULL;
+        }
+        header = memory;
+    }
+
+    header->next = NULL;
+    header->capacity = capacity;
+    header->mapping_size = mapping_size;
+    return (uint8_t *) header + PIXEL_BUFFER_ALIGNMENT;
+}
+
+static void destroy_buffer(PixelBufferHeader *header) {
+    if (header->mapping_size > 0) {
+        uint8_t *buffer = (uint8_t *) header + PIXEL_BUFFER_ALIGNMENT;
+        munmap(buffer - sysconf(_SC_PAGESIZE), header->mapping_size);
+    } else {
+        free(header);
+    }
+}
+
+static PixelPoolClass *find_class(size_t capacity, bool create) {
+    for (size_t i = 0; i < pool_class_count; i++) {
+        if (pool_classes[i].capacity == capacity) {
+            return &pool_classes[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    // Reuse a class that has no free buffers left before giving up
+    for (size_t i = 0; i < pool_class_count; i++) {
+        if (pool_classes[i].free_list == NULL) {
+            pool_classes[i].capacity = capacity;
+            return &pool_classes[i];
+        }
+    }
+    if (pool_class_count == PIXEL_POOL_MAX_CLASSES) {
+        return NULL;
+    }
+    pool_classes[pool_class_count].capacity = capacity;
+    pool_classes[pool_class_count].free_list = NULL;
+    return &pool_classes[pool_class_count++];
+}
+
+/**
+ * @brief Take free buffers out of the pool until it holds at most `limit` bytes. Called with the lock held.
+ *
+ * @return PixelBufferHeader* The removed buffers, linked through `next`, to destroy without the lock.
+ */
+static PixelBufferHeader *shrink_to(size_t limit) {
+    PixelBufferHeader *removed = NULL;
+    for (size_t i = 0; i < pool_class_count && pool_cached_bytes > limit; i++) {
+        while (pool_classes[i].free_list != NULL && pool_cached_bytes > limit) {
+            PixelBufferHeader *header = pool_classes[i].free_list;
+            pool_classes[i].free_list = header->next;
+            pool_cached_bytes -= buffer_bytes(header->capacity);
+            header->next = removed;
+            removed = header;
+        }
+    }
+    return removed;
+}
+
+/**
+ * @brief Bytes the pool may keep. Called with the lock held.
+ */
+static size_t current_limit(void) {
+    if (pool_limit != PIXEL_POOL_AUTO_LIMIT) {
+        return pool_limit;
+    }
+    size_t workload = pool_largest_bytes > SIZE_MAX / pool_workers ? SIZE_MAX : pool_workers * pool_largest_bytes;
+    return workload > PIXEL_POOL_DEFAULT_LIMIT ? workload : PIXEL_POOL_DEFAULT_LIMIT;
+}
+
+static void destroy_list(PixelBufferHeader *header) {
+    while (header != NULL) {
+        PixelBufferHeader *next = header->next;
+        destroy_buffer(header);
+        header = next;
+    }
+}
+
+uint8_t* pixel_buffer_acquire(size_t size) {
+    if (size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    size_t capacity = class_capacity(size > 0 ? size : 1);
+
+    pthread_mutex_lock(&pool_lock);
+    if (buffer_bytes(capacity) > pool_largest_bytes) {
+        pool_largest_bytes = buffer_bytes(capacity);
+    }
+    PixelPoolClass *pool_class = find_class(capacity, false);
+    PixelBufferHeader *header = pool_class != NULL ? pool_class->free_list : NULL;
+    if (header != NULL) {
+        pool_class->free_list = header->next;
+        pool_cached_bytes -= buffer_bytes(capacity);
+        pool_hits++;
+    } else {
+        pool_misses++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (header != NULL) {
+        LOG(DEBUG, "[Pixel pool] Reusing a buffer of %zu bytes.", capacity)
+        header->next = NULL;
+        return (uint8_t *) header + PIXEL_BUFFER_ALIGNMENT;
+    }
+    return new_buffer(capacity);
+}
+
+void pixel_buffer_release(uint8_t *buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    PixelBufferHeader *header = header_of(buffer);
+
+    pthread_mutex_lock(&pool_lock);
+    bool kept = false;
+    if (pool_cached_bytes + buffer_bytes(header->capacity) <= current_limit()) {
+        PixelPoolClass *pool_class = find_class(header->capacity, true);
+        if (pool_class != NULL) {
+            header->next = pool_class->free_list;
+            pool_class->free_list = header;
+            pool_cached_bytes += buffer_bytes(header->capacity);
+            kept = true;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (!kept) {
+        destroy_buffer(header);
+    }
+}
+
+void pixel_pool_set_limit(size_t bytes) {
+    pthread_mutex_lock(&pool_lock);
+    pool_limit = bytes;
+    PixelBufferHeader *removed = shrink_to(current_limit());
+    pthread_mutex_unlock(&pool_lock);
+    destroy_list(removed);
+}
+
+void pixel_pool_set_workers(size_t workers) {
+    pthread_mutex_lock(&pool_lock);
+    pool_workers = workers > 0 ? workers : 1;
+    PixelBufferHeader *removed = shrink_to(current_limit());
+    pthread_mutex_unlock(&pool_lock);
+    destroy_list(removed);
+}
+
+void pixel_pool_trim(void) {
+    pthread_mutex_lock(&pool_lock);
+    PixelBufferHeader *removed = shrink_to(0);
+    pthread_mutex_unlock(&pool_lock);
+    destroy_list(removed);
+}
+
+void pixel_pool_stats(size_t *hits, size_t *misses, size_t *cached_bytes) {
+    pthread_mutex_lock(&pool_lock);
+    if (hits != NULL) {
+        *hits = pool_hits;
+    }
+    if (misses != NULL) {
+        *misses = pool_misses;
+    }
+    if (cached_bytes != NULL) {
+        *cached_bytes = pool_cached_bytes;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
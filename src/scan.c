@@ -0,0 +1,290 @@
+#include "./include/scan.h"
+#include "./include/arguments.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief A file of the batch being prepared or probed.
+ */
+typedef struct {
+    ScanResult *result;
+    int fd;                     // Open from preparation until the probe, -1 if the file is not a BMP
+} ScanFile;
+
+/**
+ * @brief Growable list of paths, freed with mem_free each.
+ */
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} PathList;
+
+static char* join_path(const char *directory, const char *name) {
+    size_t length = strlen(directory) + 1 + strlen(name) + 1;
+    char *path = mem_alloc(length);
+    if (path != NULL) {
+        snprintf(path, length, "%s/%s", directory, name);
+    }
+    return path;
+}
+
+static bool add_path(PathList *list, char *path) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        char **grown = realloc(list->paths, capacity * sizeof(char *));
+        if (grown == NULL) {
+            return false;
+        }
+        list->paths = grown;
+        list->capacity = capacity;
+    }
+    list->paths[list->count++] = path;
+    return true;
+}
+
+/**
+ * @brief Add the regular files under `directory` to `list`. Unreadable subdirectories are skipped.
+ */
+static bool list_tree(const char *directory, PathList *list, bool root) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        if (root) {
+            LOG(ERROR, "Could not open the directory %s.", directory)
+        } else {
+            LOG(DEBUG, "[Scan] Skipping unreadable directory %s.", directory)
+        }
+        return !root;
+    }
+    bool ok = true;
+    struct dirent *dirent;
+    while (ok && (dirent = readdir(dir)) != NULL) {
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+            continue;
+        }
+        char *path = join_path(directory, dirent->d_name);
+        if (path == NULL) {
+            ok = false;
+            break;
+        }
+
+        // d_type saves a stat per entry; links are followed to files but not to directories
+        bool is_directory = dirent->d_type == DT_DIR;
+        bool is_file = dirent->d_type == DT_REG;
+        struct stat info;
+        if ((dirent->d_type == DT_UNKNOWN || dirent->d_type == DT_LNK) && lstat(path, &info) == 0) {
+            is_directory = S_ISDIR(info.st_mode);
+            is_file = S_ISREG(info.st_mode) || (S_ISLNK(info.st_mode) && stat(path, &info) == 0 && S_ISREG(info.st_mode));
+        }
+
+        if (is_directory) {
+            ok = list_tree(path, list, false);
+            mem_free(path);
+        } else if (is_file) {
+            ok = add_path(list, path);
+            if (!ok) {
+                mem_free(path);
+            }
+        } else {
+            mem_free(path);
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+/**
+ * @brief Open a file and check its header; for a BMP, ask the kernel to read its first rows ahead.
+ */
+static void prepare_file(ScanFile *file) {
+    file->fd = open(file->result->path, O_RDONLY | O_CLOEXEC);
+    BMPImage probe;
+    if (file->fd >= 0 && bmp_probe(file->fd, &probe)) {
+        size_t row_components = probe.width * 3;
+        size_t rows = (SCAN_PREFIX_COMPONENTS + row_components - 1) / row_components;
+        rows = rows < probe.height ? rows : probe.height;
+        posix_fadvise(file->fd, probe.source_offset, (off_t) (rows * (probe.data_size / probe.height)), POSIX_FADV_WILLNEED);
+        file->result->verdict = SCAN_CLEAN;
+        return;
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    file->result->verdict = SCAN_NOT_BMP;
+}
+
+/**
+ * @brief Peek with every algorithm and keep the most likely one.
+ */
+static void probe_task(void *arg) {
+    ScanFile *file = arg;
+    ScanResult *result = file->result;
+    if (file->fd < 0) {
+        return;
+    }
+    BMPImage *bmp = new_bmp_sparse(file->fd);
+    close(file->fd);
+    file->fd = -1;
+    if (bmp == NULL) {
+        result->verdict = SCAN_NOT_BMP;
+        return;
+    }
+
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4, STEG_LSBI};
+    size_t recognized = 0;
+    for (size_t i = 0; i < 3; i++) {
+        PayloadPeek peek;
+        if (!peek_payload(bmp, algorithms[i], &peek)) {
+            continue;
+        }
+        bool known = peek.has_extension || peek.encrypted_container;
+        // The first recognized payload wins; otherwise the first size that fits
+        if ((known && recognized == 0) || result->fitting == 0) {
+            result->steg_algorithm = algorithms[i];
+            result->peek = peek;
+        }
+        result->fitting++;
+        recognized += known;
+    }
+    free_bmp(bmp);
+
+    result->verdict = recognized > 1 ? SCAN_AMBIGUOUS
+                      : recognized == 1 ? SCAN_RECOGNIZED
+                      : result->fitting > 0 ? SCAN_SIZE_ONLY : SCAN_CLEAN;
+    LOG(DEBUG, "[Scan] %s: %s.", result->path, scan_verdict_to_string(result->verdict))
+}
+
+static void prepare_batch(ScanFile *files, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        prepare_file(&files[i]);
+    }
+}
+
+static int compare_results(const void *a, const void *b) {
+    const ScanResult *left = a, *right = b;
+    if (left->verdict != right->verdict) {
+        return left->verdict > right->verdict ? -1 : 1;
+    }
+    return strcmp(left->path, right->path);
+}
+
+ScanResult* scan_directory(const char *directory, ThreadPool *pool, size_t *count, ScanSummary *summary) {
+    double start = get_time_ms();
+    PathList list = {NULL, 0, 0};
+    if (directory == NULL || count == NULL || !list_tree(directory, &list, true)) {
+        for (size_t i = 0; i < list.count; i++) {
+            mem_free(list.paths[i]);
+        }
+        free(list.paths);
+        return NULL;
+    }
+
+    ScanResult *results = calloc(list.count > 0 ? list.count : 1, sizeof(ScanResult));
+    ScanFile *files = calloc(list.count > 0 ? list.count : 1, sizeof(ScanFile));
+    if (results == NULL || files == NULL) {
+        LOG(ERROR, "Could not allocate the scan of %s.", directory)
+        for (size_t i = 0; i < list.count; i++) {
+            mem_free(list.paths[i]);
+        }
+        free(list.paths);
+        free(results);
+        free(files);
+        return NULL;
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        results[i].path = list.paths[i];
+        files[i].result = &results[i];
+        files[i].fd = -1;
+    }
+    free(list.paths);
+
+    // The next batch is opened and read ahead while the workers probe the current one
+    size_t first_count = list.count < SCAN_BATCH_SIZE ? list.count : SCAN_BATCH_SIZE;
+    prepare_batch(files, first_count);
+    for (size_t batch = 0; batch < list.count; batch += SCAN_BATCH_SIZE) {
+        size_t batch_count = list.count - batch < SCAN_BATCH_SIZE ? list.count - batch : SCAN_BATCH_SIZE;
+        TaskGroup group = THREAD_POOL_GROUP_INIT;
+        for (size_t i = batch; i < batch + batch_count; i++) {
+            if (pool == NULL || !thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, probe_task, &files[i])) {
+                probe_task(&files[i]);
+            }
+        }
+        size_t next = batch + batch_count;
+        prepare_batch(files + next, list.count - next < SCAN_BATCH_SIZE ? list.count - next : SCAN_BATCH_SIZE);
+        if (pool != NULL) {
+            thread_pool_wait(pool, &group);
+        }
+    }
+    free(files);
+
+    qsort(results, list.count, sizeof(ScanResult), compare_results);
+    ScanSummary totals = {list.count, 0, 0, 0};
+    for (size_t i = 0; i < list.count; i++) {
+        totals.bitmaps += results[i].verdict != SCAN_NOT_BMP;
+        totals.flagged += results[i].verdict >= SCAN_SIZE_ONLY;
+    }
+    totals.elapsed_ms = get_time_ms() - start;
+    LOG(INFO, "[Scan] %zu files, %zu BMP, %zu flagged in %.1f ms.", totals.files, totals.bitmaps, totals.flagged, totals.elapsed_ms)
+    if (summary != NULL) {
+        *summary = totals;
+    }
+    *count = list.count;
+    return results;
+}
+
+void free_scan_results(ScanResult *results, size_t count) {
+    if (results == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        mem_free(results[i].path);
+    }
+    free(results);
+}
+
+const char* scan_verdict_to_string(ScanVerdict verdict) {
+    switch (verdict) {
+        case SCAN_NOT_BMP: return "not-bmp";
+        case SCAN_CLEAN: return "clean";
+        case SCAN_SIZE_ONLY: return "size-only";
+        case SCAN_AMBIGUOUS: return "ambiguous";
+        case SCAN_RECOGNIZED: return "recognized";
+        default: return "UNKNOWN";
+    }
+}
+
+int run_scan(const char *directory, const char *report_path, const ScanSettings *settings) {
+    ScanSettings defaults = {0, false};
+    settings = settings != NULL ? settings : &defaults;
+    ThreadPool *pool = settings->workers != 1 ? thread_pool_create(settings->workers, settings->pin_cpus) : NULL;
+    size_t count = 0;
+    ScanSummary summary;
+    ScanResult *results = scan_directory(directory, pool, &count, &summary);
+    thread_pool_destroy(pool);
+    if (results == NULL) {
+        return -1;
+    }
+    FILE *report = report_path != NULL ? fopen(report_path, "w") : stdout;
+    if (report == NULL) {
+        LOG(ERROR, "Could not open the report %s.", report_path)
+        free_scan_results(results, count);
+        return -1;
+    }
+
+    fprintf(report, "# verdict\tsteg\tsize\textension\tpath\n");
+    for (size_t i = 0; i < count && results[i].verdict >= SCAN_SIZE_ONLY; i++) {
+        const PayloadPeek *peek = &results[i].peek;
+        fprintf(report, "%s\t%s\t%u\t%s\t%s\n", scan_verdict_to_string(results[i].verdict),
+                steg_algorithm_to_string(results[i].steg_algorithm), peek->size,
+                peek->encrypted_container ? "encrypted" : peek->has_extension ? peek->extension : "-", results[i].path);
+    }
+    fprintf(report, "# %zu files, %zu BMP, %zu flagged in %.1f ms\n", summary.files, summary.bitmaps, summary.flagged, summary.elapsed_ms);
+    if (report != stdout) {
+        fclose(report);
+    }
+    free_scan_results(results, count);
+    return (int) summary.flagged;
+}
@@ -1,4 +1,7 @@
 #include "stego_bmp.h"
+#include "checksum.h"
+#include "compression.h"
+#include "crypto.h"
 
 #define HIDDEN_DATA_SIZE_FIELD 32   // Tamaño en bits del campo que almacena el tamaño de los datos ocultos
 #define EXTENSION_SIZE 16           // Tamaño máximo permitido para la extensión del archivo
@@ -76,6 +79,13 @@ bool embed_bits_generic(BMPImage *bmp, const uint8_t *data, size_t num_bits, siz
     size_t component_index = *offset;
     size_t bit_index = 0;
 
+    // Si la imagen comparte sus píxeles, copiar antes las filas que se van a modificar
+    size_t total_components = bmp->width * bmp->height * 3;
+    size_t end_component = component_index + (num_bits + bits_per_component - 1) / bits_per_component;
+    if (component_index < total_components && !bmp_prepare_write(bmp, component_index, end_component < total_components ? end_component : total_components)) {
+        return false;
+    }
+
     for (; bit_index < num_bits; bit_index += bits_per_component) {
         if (component_index >= bmp->data_size) {
             LOG(ERROR, "No hay espacio suficiente en BMP para embebido de datos.")
@@ -247,6 +257,13 @@ bool embed_bits_lsbi(BMPImage *bmp, const uint8_t *data, size_t num_bits, size_t
         return false;
     }
 
+    // Solo verde y azul llevan datos: dos de cada tres componentes, más el pattern_map al inicio
+    size_t total_components = bmp->width * bmp->height * 3;
+    size_t end_component = component_index + num_bits / 2 * 3 + 3;
+    if (*offset < total_components && !bmp_prepare_write(bmp, *offset, end_component < total_components ? end_component : total_components)) {
+        return false;
+    }
+
     // Paso 1: Insertar datos y contar cambios
     for (; component_index < bmp->width * bmp->height * 3 && bit_to_embed_count < num_bits; component_index++) {
         Component comp = get_component_by_index(bmp, component_index);
@@ -274,11 +291,11 @@ bool embed_bits_lsbi(BMPImage *bmp, const uint8_t *data, size_t num_bits, size_t
         return false;
     }
 
-    // Paso 2: Construir pattern_map
+    // Paso 2: Construir pattern_map; el patrón 00 va en el bit más significativo, como lo lee extract_bits_lsbi
     uint8_t pattern_map = 0;
     for (int p = 0; p < PATTERN_MAP_SIZE; p++) {
         if (pattern_changed[p] > pattern_unchanged[p]) {
-            pattern_map |= (1 << p);
+            pattern_map |= (1 << (3 - p));
         }
     }
     LOG(INFO, "[Stego Embed] Pattern Map: %d%d%d%d%d%d%d%d",
@@ -310,8 +327,8 @@ bool embed_bits_lsbi(BMPImage *bmp, const uint8_t *data, size_t num_bits, size_t
 
         uint8_t pattern = (*comp.component_ptr >> 1) & 0x03;
 
-        // Solo invertir si el patrón está marcado y el LSB actualmente no coincide
-        if ((pattern_map & (1 << pattern)) && ((*comp.component_ptr & 0x01) != ((data[bit_to_embed_count / 8] >> (7 - (bit_to_embed_count % 8))) & 0x01))) {
+        // El paso 1 dejó el bit tal cual; en los patrones marcados se guarda invertido
+        if (pattern_map & (1 << (3 - pattern))) {
             *comp.component_ptr ^= 0x01;
         }
 
@@ -475,6 +492,31 @@ uint32_t extract_data_size(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *
     return extracted_size;
 }
 
+size_t extract_package_header(const BMPImage *bmp, StegAlgorithm steg_alg, size_t *offset, void *context,
+                              uint32_t *size, CompressionAlgorithm *compression) {
+    if (size == NULL || compression == NULL) {
+        LOG(ERROR, "Argumentos NULL en extract_package_header.")
+        return 0;
+    }
+    *compression = COMPRESSION_NONE;
+    *size = extract_data_size(bmp, steg_alg, offset, context);
+    if (*size != 0) {
+        return PACKAGE_SIZE_FIELD;
+    }
+
+    // Un campo de tamaño 0 sigue con el resto del encabezado versionado (ver file_package.h)
+    uint8_t header[PACKAGE_LARGE_HEADER_SIZE] = {0};
+    uint64_t stored_size = 0;
+    if (!steg_operations[steg_alg].extract(bmp, BYTES_TO_BITS(PACKAGE_LARGE_HEADER_SIZE - PACKAGE_SIZE_FIELD),
+                                           header + PACKAGE_SIZE_FIELD, offset, context) ||
+        parse_package_header(header, sizeof(header), &stored_size, compression) == 0 || *compression == COMPRESSION_NONE) {
+        // Un encabezado de 64 bits sin comprimir es un paquete grande, que no entra en un FilePackage
+        return 0;
+    }
+    *size = (uint32_t) stored_size;
+    return PACKAGE_LARGE_HEADER_SIZE;
+}
+
 /**
  * @brief Extrae la extensión del archivo embebido en la imagen BMP.
  *
@@ -552,7 +594,7 @@ FilePackage* extract_data(const BMPImage *bmp, StegAlgorithm steg_alg) {
     }
 
     // Crear un FilePackage para almacenar los datos extraídos
-    FilePackage *package = (FilePackage *)malloc(sizeof(FilePackage));
+    FilePackage *package = (FilePackage *)mem_alloc(sizeof(FilePackage));
     if (package == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para FilePackage en extract_data.")
         return NULL;
@@ -560,6 +602,7 @@ FilePackage* extract_data(const BMPImage *bmp, StegAlgorithm steg_alg) {
     package->size = 0;
     package->data = NULL;
     package->extension = NULL;
+    package->compression = COMPRESSION_NONE;
 
     size_t offset = 0;
     uint8_t pattern_map = 0;
@@ -582,17 +625,20 @@ FilePackage* extract_data(const BMPImage *bmp, StegAlgorithm steg_alg) {
             pattern_map & 0x01)
     }
 
-    // Extraer el tamaño del archivo
-    package->size = extract_data_size(bmp, steg_alg, &offset, &pattern_map);
-    if (package->size == 0) {
+    // Extraer el encabezado del paquete: el tamaño del archivo y, si está comprimido, el códec
+    if (extract_package_header(bmp, steg_alg, &offset, &pattern_map, &package->size, &package->compression) == 0) {
         LOG(ERROR, "Error al extraer tamaño de los datos en extract_data.")
+        if (steg_supports_ranges(steg_alg)) {
+            // Los paquetes grandes guardan 0 en el campo de 32 bits (ver file_package.h)
+            LOG(INFO, "[Stego Extract] Tamaño 0: puede ser un archivo de más de 4 GB, que se extrae con -stream.")
+        }
         free_file_package(package);
         return NULL;
     }
     LOG(INFO, "[Stego Extract] Tamaño de los datos extraídos: %u bytes.", package->size)
 
     // Extraer los datos del archivo
-    package->data = (uint8_t *)malloc(package->size);
+    package->data = (uint8_t *)mem_alloc(package->size);
     if (package->data == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para los datos en extract_data.")
         free_file_package(package);
@@ -605,7 +651,7 @@ FilePackage* extract_data(const BMPImage *bmp, StegAlgorithm steg_alg) {
     }
 
     // Extraer la extensión del archivo
-    package->extension = (uint8_t *)malloc(EXTENSION_SIZE);
+    package->extension = (uint8_t *)mem_alloc(EXTENSION_SIZE);
     if (package->extension == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para la extensión en extract_data.")
         free_file_package(package);
@@ -659,18 +705,433 @@ uint8_t* extract_encrypted_data(const BMPImage *bmp, StegAlgorithm steg_alg, siz
     LOG(INFO, "[Stego Extract] Tamaño de los datos cifrados extraídos: %u bytes.", encrypted_size)
 
     // Extraer los datos cifrados
-    encrypted_data = (uint8_t *)malloc(encrypted_size);
+    encrypted_data = (uint8_t *)mem_alloc(encrypted_size);
     if (encrypted_data == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para los datos cifrados en extract_encrypted_data.")
         return NULL;
     }
     if (!steg_operations[steg_alg].extract(bmp, BYTES_TO_BITS(encrypted_size), encrypted_data, &offset, &pattern_map)) {
         LOG(ERROR, "Error al extraer datos cifrados con el algoritmo especificado en extract_encrypted_data.")
-        free(encrypted_data);
+        mem_free(encrypted_data);
         return NULL;
     }
     LOG(INFO, "[Stego Extract] Datos cifrados extraídos correctamente.")
 
     *extracted_size = encrypted_size;
     return encrypted_data;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Cantidad de bits que LSB1 y LSB4 guardan en cada componente, o 0 si el algoritmo no usa posiciones fijas.
+ */
+static int range_bits_per_component(StegAlgorithm steg_alg) {
+    switch (steg_alg) {
+        case STEG_LSB1: return 1;
+        case STEG_LSB4: return 4;
+        default: return 0;
+    }
+}
+
+bool steg_supports_ranges(StegAlgorithm steg_alg) {
+    return range_bits_per_component(steg_alg) != 0;
+}
+
+size_t steg_capacity(const BMPImage *bmp, StegAlgorithm steg_alg) {
+    if (bmp == NULL) {
+        LOG(ERROR, "BMPImage NULL en steg_capacity.")
+        return 0;
+    }
+    size_t components = bmp->width * bmp->height * 3;
+    switch (steg_alg) {
+        case STEG_LSB1: return components / 8;
+        case STEG_LSB4: return components / 2;
+        case STEG_LSBI: {
+            // Dos componentes por píxel (verde y azul), menos el mapa de patrones
+            size_t bits = bmp->width * bmp->height * 2 * 2;
+            return bits > PATTERN_MAP_SIZE ? (bits - PATTERN_MAP_SIZE) / 8 : 0;
+        }
+        default: return 0;
+    }
+}
+
+bool embed_range(BMPImage *bmp, const uint8_t *secret_data, size_t start, size_t length, StegAlgorithm steg_alg) {
+    int bits_per_component = range_bits_per_component(steg_alg);
+    if (bmp == NULL || bmp->data == NULL || secret_data == NULL || bits_per_component == 0) {
+        LOG(ERROR, "Argumentos inválidos en embed_range.")
+        return false;
+    }
+    if (start + length > steg_capacity(bmp, steg_alg)) {
+        LOG(ERROR, "El rango excede la capacidad de la imagen en embed_range.")
+        return false;
+    }
+
+    // Cada byte ocupa 8 / bits_per_component componentes a partir del inicio
+    size_t offset = BYTES_TO_BITS(start) / bits_per_component;
+    return embed_bits_generic(bmp, secret_data + start, BYTES_TO_BITS(length), &offset, bits_per_component);
+}
+
+bool prepare_embed_range(BMPImage *bmp, size_t start, size_t length, StegAlgorithm steg_alg) {
+    int bits_per_component = range_bits_per_component(steg_alg);
+    if (bmp == NULL || bits_per_component == 0) {
+        LOG(ERROR, "Argumentos inválidos en prepare_embed_range.")
+        return false;
+    }
+    size_t first = BYTES_TO_BITS(start) / bits_per_component;
+    return bmp_prepare_write(bmp, first, first + BYTES_TO_BITS(length) / bits_per_component);
+}
+
+bool extract_range(const BMPImage *bmp, size_t start, size_t length, uint8_t *buffer, StegAlgorithm steg_alg) {
+    int bits_per_component = range_bits_per_component(steg_alg);
+    if (bmp == NULL || bmp->data == NULL || buffer == NULL || bits_per_component == 0) {
+        LOG(ERROR, "Argumentos inválidos en extract_range.")
+        return false;
+    }
+    if (start + length > steg_capacity(bmp, steg_alg)) {
+        LOG(ERROR, "El rango excede la capacidad de la imagen en extract_range.")
+        return false;
+    }
+
+    size_t offset = BYTES_TO_BITS(start) / bits_per_component;
+    return extract_bits_generic(bmp, BYTES_TO_BITS(length), buffer, &offset, bits_per_component);
+}
+
+/**
+ * @brief Verifica que `size` bytes ocultos con `steg_alg` entren desde el componente `first_component`.
+ */
+static bool fits_at_component(const BMPImage *bmp, size_t first_component, size_t size, int bits_per_component) {
+    size_t total_components = bmp->width * bmp->height * 3;
+    return first_component <= total_components && BYTES_TO_BITS(size) / bits_per_component <= total_components - first_component;
+}
+
+bool embed_at_component(BMPImage *bmp, const uint8_t *data, size_t size, size_t first_component, StegAlgorithm steg_alg) {
+    int bits_per_component = range_bits_per_component(steg_alg);
+    if (bmp == NULL || bmp->data == NULL || data == NULL || bits_per_component == 0) {
+        LOG(ERROR, "Argumentos inválidos en embed_at_component.")
+        return false;
+    }
+    if (!fits_at_component(bmp, first_component, size, bits_per_component)) {
+        LOG(ERROR, "Los datos exceden la imagen en embed_at_component.")
+        return false;
+    }
+    return embed_bits_generic(bmp, data, BYTES_TO_BITS(size), &first_component, bits_per_component);
+}
+
+bool extract_at_component(const BMPImage *bmp, size_t first_component, size_t size, uint8_t *buffer, StegAlgorithm steg_alg) {
+    int bits_per_component = range_bits_per_component(steg_alg);
+    if (bmp == NULL || bmp->data == NULL || buffer == NULL || bits_per_component == 0) {
+        LOG(ERROR, "Argumentos inválidos en extract_at_component.")
+        return false;
+    }
+    if (!fits_at_component(bmp, first_component, size, bits_per_component)) {
+        LOG(ERROR, "Los datos exceden la imagen en extract_at_component.")
+        return false;
+    }
+    return extract_bits_generic(bmp, BYTES_TO_BITS(size), buffer, &first_component, bits_per_component);
+}
+
+/**
+ * @brief Componente donde empieza el bit `bit` de lo ocultado con embed, contando desde el campo de tamaño.
+ */
+static size_t stream_bit_component(StegAlgorithm steg_alg, size_t bit) {
+    switch (steg_alg) {
+        case STEG_LSB1: return bit;
+        case STEG_LSB4: return bit / 4;
+        default: {
+            // LSBI usa los componentes azul y verde después del mapa de patrones. Antes del primer
+            // bit hay tres componentes que no son rojos (0, 1 y 3), y cada píxel tiene dos
+            size_t non_red = 3 + bit;
+            return non_red / 2 * 3 + non_red % 2;
+        }
+    }
+}
+
+/**
+ * @brief Carga las filas que guardan los bytes [start, end) de lo ocultado, sin pasar del final de la imagen.
+ */
+static bool load_stream_bytes(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t end) {
+    size_t total_components = bmp->width * bmp->height * 3;
+    size_t first = stream_bit_component(steg_alg, BYTES_TO_BITS(start));
+    size_t last = stream_bit_component(steg_alg, BYTES_TO_BITS(end) - 1) + 1;
+    return first < total_components && bmp_load_rows(bmp, first, last < total_components ? last : total_components);
+}
+
+/**
+ * @brief Lee los bytes [start, start + length) de lo ocultado, cargando antes las filas que los guardan.
+ */
+static bool read_stream_bytes(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t length, uint8_t *buffer, uint8_t *pattern_map) {
+    size_t offset = stream_bit_component(steg_alg, BYTES_TO_BITS(start));
+    return load_stream_bytes(bmp, steg_alg, start, start + length) &&
+           steg_operations[steg_alg].extract(bmp, BYTES_TO_BITS(length), buffer, &offset, pattern_map);
+}
+
+/**
+ * @brief Lee el mapa de patrones (LSBI) y el encabezado del paquete, cargando solo las filas que los guardan.
+ *
+ * @return size_t Tamaño del encabezado, o 0 si no se pudo leer o no es válido.
+ */
+static size_t read_package_header(BMPImage *bmp, StegAlgorithm steg_alg, uint8_t *pattern_map, uint32_t *size,
+                                  CompressionAlgorithm *compression) {
+    size_t offset = 0;
+    if (!bmp_load_rows(bmp, 0, steg_alg == STEG_LSBI ? PATTERN_MAP_SIZE : 0) ||
+        !load_stream_bytes(bmp, steg_alg, 0, PACKAGE_MAX_HEADER_SIZE)) {
+        return 0;
+    }
+    if (steg_alg == STEG_LSBI && !steg_operations[STEG_LSB1].extract(bmp, PATTERN_MAP_SIZE, pattern_map, &offset, NULL)) {
+        LOG(ERROR, "Error al extraer pattern_map con LSB1.")
+        return 0;
+    }
+    return extract_package_header(bmp, steg_alg, &offset, pattern_map, size, compression);
+}
+
+/**
+ * @brief Crea el paquete de un rango de `length` bytes con la extensión del archivo oculto, que
+ * sigue a los `size` bytes de datos. Los datos del rango los completa quien llama.
+ */
+static FilePackage* new_range_package(BMPImage *bmp, StegAlgorithm steg_alg, uint32_t size, size_t length, uint8_t *pattern_map) {
+    size_t capacity = steg_capacity(bmp, steg_alg);
+    size_t extension_start = sizeof(uint32_t) + size;
+    size_t extension_end = capacity - extension_start < EXTENSION_SIZE ? capacity : extension_start + EXTENSION_SIZE;
+    if (!load_stream_bytes(bmp, steg_alg, extension_start, extension_end)) {
+        return NULL;
+    }
+
+    FilePackage *package = (FilePackage *)mem_calloc(1, sizeof(FilePackage));
+    if (package == NULL) {
+        LOG(ERROR, "No se pudo asignar memoria para FilePackage en extract_data_range.")
+        return NULL;
+    }
+    package->size = (uint32_t) length;
+    package->data = (uint8_t *)mem_alloc(length);
+    package->extension = (uint8_t *)mem_alloc(EXTENSION_SIZE);
+    if (package->data == NULL || package->extension == NULL) {
+        LOG(ERROR, "No se pudo asignar memoria para los datos en extract_data_range.")
+        free_file_package(package);
+        return NULL;
+    }
+    size_t offset = stream_bit_component(steg_alg, BYTES_TO_BITS(extension_start));
+    if (!extract_extension(bmp, steg_alg, (char *) package->extension, &offset, pattern_map)) {
+        LOG(ERROR, "Error al extraer la extensión en extract_data_range.")
+        free_file_package(package);
+        return NULL;
+    }
+    return package;
+}
+
+/**
+ * @brief Extrae el archivo completo, lo verifica, lo descomprime y deja solo el rango: lo
+ * comprimido no se puede leer por partes.
+ */
+static FilePackage* extract_whole_range(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t length, size_t *file_size) {
+    if (!bmp_load_rows(bmp, 0, bmp->width * bmp->height * 3)) {
+        return NULL;
+    }
+    FilePackage *package = extract_data(bmp, steg_alg);
+    if (package == NULL || (package_is_checksummed(package) && !verify_file_package(package, NULL, true, NULL)) ||
+        (package_is_compressed(package) && !decompress_file_package(package))) {
+        free_file_package(package);
+        return NULL;
+    }
+    if (file_size != NULL) {
+        *file_size = package->size;
+    }
+    if (!file_package_slice(package, start, length)) {
+        free_file_package(package);
+        return NULL;
+    }
+    return package;
+}
+
+/**
+ * @brief Extrae un rango de un archivo dividido en bloques con CRC32C (ver checksum.h), leyendo y
+ * verificando solo los bloques que el rango toca.
+ */
+static FilePackage* extract_checksummed_range(BMPImage *bmp, StegAlgorithm steg_alg, uint32_t size, const uint8_t *header,
+                                              size_t start, size_t length, size_t *file_size, uint8_t *pattern_map) {
+    size_t chunk_size = 0, chunked_size = 0;
+    checksum_parse_header(header, &chunk_size, &chunked_size);
+    size_t overhead = checksum_overhead(chunk_size, chunked_size);
+    if (overhead + chunked_size != size) {
+        LOG(ERROR, "El archivo dividido en bloques está truncado.")
+        return NULL;
+    }
+    size_t file_start = sizeof(uint32_t) + overhead;
+
+    if (file_size != NULL) {
+        *file_size = chunked_size;
+    }
+    if (start >= chunked_size || length == 0) {
+        LOG(ERROR, "El rango pedido está fuera del archivo oculto de %zu bytes.", chunked_size)
+        return NULL;
+    }
+    if (length > chunked_size - start) {
+        length = chunked_size - start;
+    }
+    size_t first_chunk = start / chunk_size;
+    size_t end_chunk = (start + length - 1) / chunk_size + 1;
+    size_t span_start = first_chunk * chunk_size;
+    size_t span_end = end_chunk * chunk_size < chunked_size ? end_chunk * chunk_size : chunked_size;
+    LOG(INFO, "[Stego Extract] Extrayendo %zu de %zu bytes desde el byte %zu (bloques %zu a %zu).", length, chunked_size, start,
+        first_chunk, end_chunk - 1)
+
+    size_t crc_count = end_chunk - first_chunk;
+    uint8_t *crcs = (uint8_t *)mem_alloc(crc_count * sizeof(uint32_t));
+    uint8_t *span = (uint8_t *)mem_alloc(span_end - span_start);
+    FilePackage *package = NULL;
+    bool valid = crcs != NULL && span != NULL &&
+                 read_stream_bytes(bmp, steg_alg, sizeof(uint32_t) + CHECKSUM_HEADER_SIZE + first_chunk * sizeof(uint32_t),
+                                   crc_count * sizeof(uint32_t), crcs, pattern_map) &&
+                 read_stream_bytes(bmp, steg_alg, file_start + span_start, span_end - span_start, span, pattern_map);
+    for (size_t i = 0; valid && i < crc_count; i++) {
+        size_t chunk_start = i * chunk_size;
+        size_t chunk_length = span_end - span_start - chunk_start < chunk_size ? span_end - span_start - chunk_start : chunk_size;
+        if (crc32c(0, span + chunk_start, chunk_length) != load_be32(crcs + i * sizeof(uint32_t))) {
+            LOG(ERROR, "Bytes dañados [%zu, %zu) del archivo oculto.", span_start + chunk_start, span_start + chunk_start + chunk_length)
+            valid = false;
+        }
+    }
+    if (valid) {
+        package = new_range_package(bmp, steg_alg, size, length, pattern_map);
+    }
+    if (package != NULL) {
+        memcpy(package->data, span + (start - span_start), length);
+    }
+    mem_free(crcs);
+    mem_free(span);
+    return package;
+}
+
+FilePackage* extract_data_range(BMPImage *bmp, StegAlgorithm steg_alg, size_t start, size_t length, size_t *file_size) {
+    if (bmp == NULL || bmp->data == NULL || (steg_alg != STEG_LSB1 && steg_alg != STEG_LSB4 && steg_alg != STEG_LSBI)) {
+        LOG(ERROR, "Argumentos inválidos en extract_data_range.")
+        return NULL;
+    }
+
+    // El mapa de patrones de LSBI y el encabezado del paquete
+    uint8_t pattern_map = 0;
+    uint32_t size = 0;
+    CompressionAlgorithm compression;
+    size_t header_size = read_package_header(bmp, steg_alg, &pattern_map, &size, &compression);
+    size_t capacity = steg_capacity(bmp, steg_alg);
+    if (header_size == 0 || header_size + (size_t) size >= capacity) {
+        LOG(ERROR, "Tamaño de los datos ocultos inválido: %u bytes.", size)
+        return NULL;
+    }
+
+    // El encabezado dice si está comprimido: lo comprimido no se puede leer por partes
+    if (compression != COMPRESSION_NONE) {
+        LOG(INFO, "[Stego Extract] El archivo está comprimido: se extrae completo para leer el rango.")
+        return extract_whole_range(bmp, steg_alg, start, length, file_size);
+    }
+
+    // Un archivo dividido en bloques empieza con su encabezado
+    if (size >= CHECKSUM_HEADER_SIZE) {
+        uint8_t header[CHECKSUM_HEADER_SIZE];
+        FilePackage probe = {CHECKSUM_HEADER_SIZE, header, NULL, COMPRESSION_NONE};
+        if (!read_stream_bytes(bmp, steg_alg, sizeof(uint32_t), CHECKSUM_HEADER_SIZE, header, &pattern_map)) {
+            LOG(ERROR, "Error al extraer el comienzo de los datos en extract_data_range.")
+            return NULL;
+        }
+        if (package_is_checksummed(&probe)) {
+            return extract_checksummed_range(bmp, steg_alg, size, header, start, length, file_size, &pattern_map);
+        }
+    }
+
+    if (file_size != NULL) {
+        *file_size = size;
+    }
+    if (start >= size || length == 0) {
+        LOG(ERROR, "El rango pedido está fuera del archivo oculto de %u bytes.", size)
+        return NULL;
+    }
+    if (length > size - start) {
+        length = size - start;
+    }
+    LOG(INFO, "[Stego Extract] Extrayendo %zu de %u bytes desde el byte %zu.", length, size, start)
+
+    // Solo se leen las filas del rango y de la extensión
+    FilePackage *package = new_range_package(bmp, steg_alg, size, length, &pattern_map);
+    if (package != NULL && !read_stream_bytes(bmp, steg_alg, sizeof(uint32_t) + start, length, package->data, &pattern_map)) {
+        LOG(ERROR, "Error al extraer el rango de datos en extract_data_range.")
+        free_file_package(package);
+        return NULL;
+    }
+    return package;
+}
+
+bool peek_payload(BMPImage *bmp, StegAlgorithm steg_alg, PayloadPeek *peek) {
+    if (bmp == NULL || bmp->data == NULL || peek == NULL || (steg_alg != STEG_LSB1 && steg_alg != STEG_LSB4 && steg_alg != STEG_LSBI)) {
+        LOG(ERROR, "Argumentos inválidos en peek_payload.")
+        return false;
+    }
+    memset(peek, 0, sizeof(PayloadPeek));
+    peek->steg_algorithm = steg_alg;
+
+    uint8_t pattern_map = 0;
+    uint32_t size = 0;
+    CompressionAlgorithm compression;
+    size_t capacity = steg_capacity(bmp, steg_alg);
+    size_t header_size = capacity > sizeof(uint32_t) ? read_package_header(bmp, steg_alg, &pattern_map, &size, &compression) : 0;
+    if (header_size == 0 || (size_t) size >= capacity - header_size) {
+        LOG(DEBUG, "[Stego Peek] %d: el tamaño %u no entra en la imagen.", steg_alg, size)
+        return false;
+    }
+    peek->size = size;
+
+    // Los primeros bytes de los datos dicen si es un contenedor cifrado
+    if (size >= CRYPTO_CONTAINER_MAGIC_SIZE) {
+        uint8_t magic[CRYPTO_CONTAINER_MAGIC_SIZE];
+        if (!read_stream_bytes(bmp, steg_alg, header_size, CRYPTO_CONTAINER_MAGIC_SIZE, magic, &pattern_map)) {
+            return false;
+        }
+        peek->encrypted_container = memcmp(magic, CRYPTO_CONTAINER_MAGIC, CRYPTO_CONTAINER_MAGIC_SIZE) == 0;
+    }
+
+    // La extensión sigue a los datos; puede quedar cortada por el final de la imagen
+    size_t extension_start = header_size + size;
+    size_t extension_length = capacity - extension_start < EXTENSION_SIZE ? capacity - extension_start : EXTENSION_SIZE;
+    char extension[EXTENSION_SIZE] = {0};
+    if (!read_stream_bytes(bmp, steg_alg, extension_start, extension_length, (uint8_t *) extension, &pattern_map)) {
+        return false;
+    }
+    size_t length = strnlen(extension, extension_length);
+    peek->has_extension = extension[0] == '.' && length >= 2 && length < extension_length;
+    for (size_t i = 1; i < length && peek->has_extension; i++) {
+        peek->has_extension = extension[i] > ' ' && extension[i] < 0x7F && extension[i] != '/' && extension[i] != '\\';
+    }
+    if (peek->has_extension) {
+        memcpy(peek->extension, extension, length + 1);
+    }
+    LOG(DEBUG, "[Stego Peek] %d: %u bytes, extensión %s.", steg_alg, size, peek->has_extension ? peek->extension : "no válida")
+    return true;
+}
+
+StegAlgorithm detect_steg_algorithm(BMPImage *bmp, bool encrypted, PayloadPeek *peek) {
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4, STEG_LSBI};
+    PayloadPeek candidates[3];
+    bool valid[3], recognized[3];
+    size_t fitting = 0, recognized_count = 0;
+    for (size_t i = 0; i < 3; i++) {
+        valid[i] = peek_payload(bmp, algorithms[i], &candidates[i]);
+        recognized[i] = valid[i] && (candidates[i].encrypted_container || (!encrypted && candidates[i].has_extension));
+        fitting += valid[i];
+        recognized_count += recognized[i];
+    }
+
+    // Un candidato reconocido le gana a los que solo tienen un tamaño que entra
+    size_t matches = 0, winner = 0;
+    for (size_t i = 0; i < 3; i++) {
+        if ((recognized_count > 0 ? recognized[i] : valid[i]) && matches++ == 0) {
+            winner = i;
+        }
+    }
+    if (matches != 1) {
+        LOG(ERROR, matches == 0 ? "Ningún algoritmo encuentra un archivo oculto (%zu tamaños válidos)."
+                                : "Más de un algoritmo encuentra un archivo oculto (%zu tamaños válidos): indicar -steg.", fitting)
+        return STEG_NONE;
+    }
+    if (peek != NULL) {
+        *peek = candidates[winner];
+    }
+    LOG(INFO, "[Stego Peek] Algoritmo detectado: %d, %u bytes.", algorithms[winner], candidates[winner].size)
+    return algorithms[winner];
+}
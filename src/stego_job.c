@@ -0,0 +1,617 @@
+#include "./include/stego_job.h"
+#include "./include/checksum.h"
+#include "./include/compression.h"
+#include "./include/crypto.h"
+#include "./include/descriptor.h"
+#include "./include/file_package.h"
+#include "./include/stego_bmp.h"
+
+/**
+ * @brief Get the carrier for a job, from the cache when the path matches.
+ *
+ * @param writable Whether the job modifies the image. Writable jobs borrow the cache's copy-on-write
+ *                 copy of the carrier, or get their own copy if it cannot share the pixels.
+ * @param owned    Set to true when the caller must free the returned image.
+ * @param borrowed Set to true when the returned image is the cache's copy, to restore after the job.
+ */
+static BMPImage* acquire_carrier(const char *path, JobCarrierCache *cache, bool writable, bool *owned, bool *borrowed) {
+    *owned = true;
+    *borrowed = false;
+    if (cache == NULL) {
+        return new_bmp_file(path);
+    }
+
+    if (cache->carrier_path == NULL || strcmp(cache->carrier_path, path) != 0) {
+        clear_job_carrier_cache(cache);
+        // The cached image outlives the job, so it does not come from the job arena
+        const Allocator *saved = NULL;
+        allocator_scope_enter(NULL, &saved);
+        BMPImage *bmp = new_bmp_file(path);
+        allocator_scope_exit(saved);
+        if (bmp == NULL) {
+            return NULL;
+        }
+        cache->carrier_path = strdup(path);
+        if (cache->carrier_path == NULL) {
+            return bmp;
+        }
+        cache->carrier = bmp;
+    } else {
+        LOG(DEBUG, "[Job] Reusing cached carrier %s.", path)
+    }
+
+    if (writable) {
+        if (cache->working_copy == NULL) {
+            const Allocator *saved = NULL;
+            allocator_scope_enter(NULL, &saved);
+            cache->working_copy = copy_bmp(cache->carrier);
+            allocator_scope_exit(saved);
+        }
+        BMPImage *copy = cache->working_copy;
+        if (copy == NULL || copy->shared == NULL) {
+            // A deep copy cannot be restored cheaply, so the job keeps it
+            cache->working_copy = NULL;
+            return copy;
+        }
+        // Only the rows the payload touches are copied from the carrier
+        bmp_discard_changes(copy);
+        *owned = false;
+        *borrowed = true;
+        return copy;
+    }
+    *owned = false;
+    return cache->carrier;
+}
+
+/**
+ * @brief Drop the cached carrier if a job just overwrote it.
+ */
+static void invalidate_carrier(JobCarrierCache *cache, const char *written_path) {
+    if (cache != NULL && cache->carrier_path != NULL && strcmp(cache->carrier_path, written_path) == 0) {
+        clear_job_carrier_cache(cache);
+    }
+}
+
+/**
+ * @brief A byte range of the hidden stream, embedded or extracted by one pool task.
+ */
+typedef struct {
+    BMPImage *target;           // Image written by embed chunks
+    const BMPImage *source;     // Image read by extract chunks
+    const uint8_t *data;        // Whole stream to embed
+    uint8_t *buffer;            // Where the extracted bytes of the chunk go
+    size_t start;               // First byte of the chunk in the hidden stream
+    size_t length;
+    StegAlgorithm steg_alg;
+    bool ok;
+} StegChunk;
+
+static void embed_chunk_task(void *arg) {
+    StegChunk *chunk = arg;
+    chunk->ok = embed_range(chunk->target, chunk->data, chunk->start, chunk->length, chunk->steg_alg);
+}
+
+static void extract_chunk_task(void *arg) {
+    StegChunk *chunk = arg;
+    chunk->ok = extract_range(chunk->source, chunk->start, chunk->length, chunk->buffer, chunk->steg_alg);
+}
+
+/**
+ * @brief Whether the algorithm can be split and there are other workers to take the chunks.
+ */
+static bool can_split(ThreadPool *pool, StegAlgorithm steg_alg) {
+    return pool != NULL && thread_pool_size(pool) > 1 && steg_supports_ranges(steg_alg);
+}
+
+/**
+ * @brief Embed (target != NULL) or extract bytes [start, start + length) of the hidden stream in
+ * JOB_CHUNK_SIZE pieces and wait for all of them. A calling worker runs chunks while it waits.
+ *
+ * Extracted bytes are written to `buffer`, which corresponds to position `start`.
+ */
+static bool run_chunks(ThreadPool *pool, BMPImage *target, const BMPImage *source, const uint8_t *data,
+                       uint8_t *buffer, size_t start, size_t length, StegAlgorithm steg_alg) {
+    size_t count = (length + JOB_CHUNK_SIZE - 1) / JOB_CHUNK_SIZE;
+    StegChunk *chunks = mem_calloc(count, sizeof(StegChunk));
+    if (chunks == NULL) {
+        LOG(ERROR, "Memory allocation failed for the payload chunks.")
+        return false;
+    }
+
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    ThreadPoolTask task = target != NULL ? embed_chunk_task : extract_chunk_task;
+    for (size_t i = 0; i < count; i++) {
+        StegChunk *chunk = &chunks[i];
+        chunk->target = target;
+        chunk->source = source;
+        chunk->data = data;
+        chunk->start = start + i * JOB_CHUNK_SIZE;
+        chunk->length = i + 1 < count ? JOB_CHUNK_SIZE : length - i * JOB_CHUNK_SIZE;
+        chunk->buffer = buffer != NULL ? buffer + i * JOB_CHUNK_SIZE : NULL;
+        chunk->steg_alg = steg_alg;
+        if (!thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, task, chunk)) {
+            task(chunk);
+        }
+    }
+    thread_pool_wait(pool, &group);
+
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        ok = ok && chunks[i].ok;
+    }
+    mem_free(chunks);
+    LOG(DEBUG, "[Job] Processed %zu bytes in %zu chunks.", length, count)
+    return ok;
+}
+
+/**
+ * @brief Embed the stream, splitting large LSB1/LSB4 payloads into chunks.
+ */
+static bool embed_payload(ThreadPool *pool, BMPImage *bmp, const uint8_t *data, size_t size, StegAlgorithm steg_alg) {
+    if (!can_split(pool, steg_alg) || size < 2 * JOB_CHUNK_SIZE) {
+        return embed(bmp, data, size, steg_alg);
+    }
+    if (size > steg_capacity(bmp, steg_alg)) {
+        LOG(ERROR, "Not enough capacity to embed %zu bytes.", size)
+        return false;
+    }
+    // Copy the touched rows of a shared image here, so the chunks never copy rows concurrently
+    if (!prepare_embed_range(bmp, 0, size, steg_alg)) {
+        return false;
+    }
+    return run_chunks(pool, bmp, NULL, data, NULL, 0, size, steg_alg);
+}
+
+/**
+ * @brief Extract a large LSB1/LSB4 payload in chunks.
+ *
+ * Only the package header is read when the payload is small or the algorithm cannot be split; then
+ * `handled` is false and the caller uses the serial extraction.
+ *
+ * @param with_package Return `header || data || extension` (for new_file_package_from_data) instead of the data alone.
+ * @param data_size    Set to the hidden size.
+ * @param handled      Set to true when the chunked extraction was used (even if it failed).
+ * @return The extracted buffer, or NULL.
+ */
+static uint8_t* extract_payload_chunked(ThreadPool *pool, const BMPImage *bmp, StegAlgorithm steg_alg, bool with_package,
+                                        size_t *data_size, bool *handled) {
+    *handled = false;
+    if (!can_split(pool, steg_alg)) {
+        return NULL;
+    }
+    // The header is decoded like every other extraction does; its raw bytes are kept for the package
+    size_t offset = 0;
+    uint32_t hidden_size = 0;
+    CompressionAlgorithm compression;
+    size_t header_size = extract_package_header(bmp, steg_alg, &offset, NULL, &hidden_size, &compression);
+    size_t size = hidden_size;
+    uint8_t header[PACKAGE_MAX_HEADER_SIZE];
+    if (header_size == 0 || size < 2 * JOB_CHUNK_SIZE || !extract_range(bmp, 0, header_size, header, steg_alg)) {
+        return NULL;
+    }
+    *handled = true;
+
+    size_t capacity = steg_capacity(bmp, steg_alg);
+    if (header_size + size > capacity) {
+        LOG(ERROR, "The hidden size (%zu bytes) exceeds the carrier capacity.", size)
+        return NULL;
+    }
+    LOG(INFO, "Extracting %zu bytes in chunks.", size)
+
+    // The package layout keeps the header and leaves room for the extension
+    size_t prefix = with_package ? header_size : 0;
+    uint8_t *buffer = mem_calloc(prefix + size + (with_package ? EXTENSION_SIZE : 0), 1);
+    if (buffer == NULL) {
+        LOG(ERROR, "Memory allocation failed for the extracted data.")
+        return NULL;
+    }
+    memcpy(buffer, header, prefix);
+    if (!run_chunks(pool, NULL, bmp, NULL, buffer + prefix, header_size, size, steg_alg)) {
+        mem_free(buffer);
+        return NULL;
+    }
+
+    if (with_package) {
+        // The extension is validated by new_file_package_from_data
+        size_t extension_offset = header_size + size;
+        size_t available = capacity - extension_offset < EXTENSION_SIZE ? capacity - extension_offset : EXTENSION_SIZE;
+        if (available == 0 || !extract_range(bmp, extension_offset, available, buffer + extension_offset, steg_alg)) {
+            LOG(ERROR, "Error extracting the file extension.")
+            mem_free(buffer);
+            return NULL;
+        }
+    }
+    *data_size = size;
+    return buffer;
+}
+
+/**
+ * @brief Complete the extraction options left out of the command line from the loaded carrier.
+ *
+ * Without -steg the algorithm (and, unless given, the encryption) comes from the carrier's
+ * descriptor; with -steg auto it is detected from the size field. The job then runs with its own
+ * completed copy of the options.
+ */
+static JobStatus resolve_carrier_options(JobState *state) {
+    const ProgramOptions *options = state->options;
+    if (options->mode != MODE_EXTRACT || options->steg_algorithm != STEG_NONE) {
+        return JOB_OK;
+    }
+    state->carrier_options = *options;
+    state->options = &state->carrier_options;
+    if (!options->steg_auto) {
+        if (!descriptor_configure(state->bmp, &state->carrier_options)) {
+            LOG(ERROR, "%s has no descriptor to configure the extraction: use -steg.", options->input_bmp_file)
+            return JOB_ERROR_ARGUMENTS;
+        }
+        LOG(DEBUG, "[Job] Extraction options read from the descriptor.")
+        return JOB_OK;
+    }
+    state->carrier_options.steg_algorithm = detect_steg_algorithm(state->bmp, strlen(options->password) > 0, NULL);
+    if (state->carrier_options.steg_algorithm == STEG_NONE) {
+        LOG(ERROR, "Could not detect the steganography algorithm of %s: use -steg.", options->input_bmp_file)
+        return JOB_ERROR_ARGUMENTS;
+    }
+    LOG(DEBUG, "[Job] Detected steganography algorithm: %s", steg_algorithm_to_string(state->carrier_options.steg_algorithm))
+    return JOB_OK;
+}
+
+static JobStatus load_stage(JobState *state, JobCarrierCache *cache) {
+    const ProgramOptions *options = state->options;
+    double start = get_time_ms();
+
+    // Load the input file
+    if (options->mode == MODE_EMBED) {
+        state->data = embed_data_from_file(options->input_file, &state->size);
+        if (state->data == NULL) {
+            LOG(ERROR, "Error reading the input file.")
+            return JOB_ERROR_INPUT;
+        }
+        state->result.payload_bytes = state->size;
+        // Compressing first makes every later stage (and the capacity check) work on fewer bytes
+        if (options->compression != COMPRESSION_NONE && !compress_package(&state->data, &state->size, options->compression)) {
+            LOG(ERROR, "Error compressing the input file.")
+            return JOB_ERROR_INPUT;
+        }
+        // The chunks cover what is stored, so they are computed after compressing
+        if (options->checksum && !checksum_package(&state->data, &state->size, 0)) {
+            LOG(ERROR, "Error splitting the input file in checksummed chunks.")
+            return JOB_ERROR_INPUT;
+        }
+    }
+
+    // Load the BMP file. Only embed jobs modify it.
+    if (options->range && options->encryption_algo == ENC_NONE) {
+        // Only the rows holding the range are read, so the carrier is neither loaded in full nor cached
+        state->bmp = new_bmp_file_lazy(options->input_bmp_file);
+        state->owns_bmp = true;
+    } else {
+        state->bmp = acquire_carrier(options->input_bmp_file, cache, options->mode == MODE_EMBED, &state->owns_bmp, &state->borrows_copy);
+    }
+    if (state->bmp == NULL) {
+        state->result.load_ms = get_time_ms() - start;
+        LOG(ERROR, "Error loading the BMP file.")
+        return JOB_ERROR_CARRIER;
+    }
+
+    JobStatus status = resolve_carrier_options(state);
+    if (status == JOB_OK && state->options->range && state->options->encryption_algo != options->encryption_algo) {
+        // The descriptor says the payload is encrypted: the range is decrypted from the whole carrier
+        free_bmp(state->bmp);
+        state->bmp = acquire_carrier(options->input_bmp_file, cache, false, &state->owns_bmp, &state->borrows_copy);
+        status = state->bmp != NULL ? JOB_OK : JOB_ERROR_CARRIER;
+    }
+    state->result.load_ms = get_time_ms() - start;
+    return status;
+}
+
+static JobStatus extract_stage(JobState *state, ThreadPool *pool) {
+    const ProgramOptions *options = state->options;
+    double start = get_time_ms();
+    bool chunked = false;
+    JobStatus status = JOB_OK;
+
+    if (options->range && options->encryption_algo == ENC_NONE) {
+        state->package = extract_data_range(state->bmp, options->steg_algorithm, options->range_start, options->range_length, NULL);
+        if (state->package == NULL) {
+            LOG(ERROR, "Error extracting the range.")
+            status = JOB_ERROR_STEG;
+        } else {
+            state->result.stored_bytes = state->package->size + strlen((const char *) state->package->extension) + 1;
+        }
+    } else if (options->encryption_algo == ENC_NONE) {
+        // Extract the data from the BMP image
+        size_t extracted_size = 0;
+        uint8_t *stream = extract_payload_chunked(pool, state->bmp, options->steg_algorithm, true, &extracted_size, &chunked);
+        if (chunked) {
+            state->package = stream != NULL ? new_file_package_from_data(stream) : NULL;
+            mem_free(stream);
+        } else {
+            state->package = extract_data(state->bmp, options->steg_algorithm);
+        }
+        if (state->package == NULL) {
+            LOG(ERROR, "Error extracting data.")
+            status = JOB_ERROR_STEG;
+        } else {
+            state->result.stored_bytes = file_package_header_size(state->package) + state->package->size + strlen((const char *) state->package->extension) + 1;
+            if (package_is_checksummed(state->package) && !verify_file_package(state->package, pool, !options->verify_all, NULL)) {
+                LOG(ERROR, "The hidden file is damaged.")
+                status = JOB_ERROR_STEG;
+            }
+        }
+    } else {
+        state->data = extract_payload_chunked(pool, state->bmp, options->steg_algorithm, false, &state->size, &chunked);
+        if (!chunked) {
+            state->data = extract_encrypted_data(state->bmp, options->steg_algorithm, &state->size);
+        }
+        if (state->data == NULL) {
+            LOG(ERROR, "Error extracting encrypted data.")
+            status = JOB_ERROR_STEG;
+        } else {
+            state->result.stored_bytes = sizeof(uint32_t) + state->size;
+        }
+    }
+    state->result.steg_ms = get_time_ms() - start;
+
+    // The carrier is no longer needed
+    if (state->owns_bmp) {
+        free_bmp(state->bmp);
+    }
+    state->bmp = NULL;
+    return status;
+}
+
+static JobStatus crypto_stage(JobState *state, ThreadPool *pool) {
+    const ProgramOptions *options = state->options;
+    if (options->encryption_algo == ENC_NONE) {
+        if (options->mode == MODE_EMBED) {
+            state->result.stored_bytes = state->size;
+        }
+        return JOB_OK;
+    }
+    double start = get_time_ms();
+
+    if (options->mode == MODE_EMBED) {
+        // Encrypt the data
+        LOG(INFO, "Encrypting the data.")
+        size_t size = 0;
+        uint8_t *encrypted = crypto_encrypt_with_kdf(state->data, state->size, options->encryption_algo, options->encryption_mode, options->password, &options->kdf, &size);
+        state->result.crypto_ms = get_time_ms() - start;
+        mem_free(state->data);
+        state->data = encrypted;
+        state->size = size;
+        if (encrypted == NULL) {
+            LOG(ERROR, "Error encrypting the data.")
+            return JOB_ERROR_CRYPTO;
+        }
+        state->result.stored_bytes = size;
+        return JOB_OK;
+    }
+
+    // Decrypt the extracted data
+    LOG(INFO, "Decrypting the extracted data.")
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = crypto_decrypt(state->data, state->size, options->encryption_algo, options->encryption_mode, (const uint8_t *) options->password, &decrypted_size);
+    state->result.crypto_ms = get_time_ms() - start;
+    mem_free(state->data);
+    state->data = NULL;
+    if (decrypted == NULL) {
+        LOG(ERROR, "Error decrypting the extracted data.")
+        return JOB_ERROR_CRYPTO;
+    }
+
+    // Create a FilePackage from the decrypted data; a wrong password may still leave valid padding
+    state->package = new_file_package_from_buffer(decrypted, decrypted_size);
+    mem_free(decrypted);
+    if (state->package == NULL) {
+        LOG(ERROR, "Error creating FilePackage from the decrypted data.")
+        return JOB_ERROR_CRYPTO;
+    }
+    if (package_is_checksummed(state->package) && !verify_file_package(state->package, pool, !options->verify_all, NULL)) {
+        LOG(ERROR, "The hidden file is damaged.")
+        return JOB_ERROR_STEG;
+    }
+    // The ciphertext cannot be read in pieces, so a range is cut from the whole file
+    if (options->range && ((package_is_compressed(state->package) && !decompress_file_package(state->package)) ||
+                           !file_package_slice(state->package, options->range_start, options->range_length))) {
+        return JOB_ERROR_STEG;
+    }
+    return JOB_OK;
+}
+
+static JobStatus embed_stage(JobState *state, ThreadPool *pool) {
+    const ProgramOptions *options = state->options;
+    double start = get_time_ms();
+    // The payload must stop before the rows of the descriptor
+    size_t capacity = options->describe ? descriptor_payload_capacity(state->bmp, options->steg_algorithm) : SIZE_MAX;
+    bool embedded = state->size <= capacity && embed_payload(pool, state->bmp, state->data, state->size, options->steg_algorithm);
+    if (state->size > capacity) {
+        LOG(ERROR, "The payload does not fit before the descriptor: %zu bytes, %zu available.", state->size, capacity)
+    }
+    if (embedded && options->describe) {
+        StegoDescriptor descriptor;
+        descriptor_from_options(options, &descriptor);
+        embedded = write_descriptor(state->bmp, &descriptor);
+    }
+    state->result.steg_ms = get_time_ms() - start;
+    mem_free(state->data);
+    state->data = NULL;
+    if (!embedded) {
+        LOG(ERROR, "Error embedding the data.")
+        return JOB_ERROR_STEG;
+    }
+    return JOB_OK;
+}
+
+static JobStatus write_stage(JobState *state, JobCarrierCache *cache) {
+    const ProgramOptions *options = state->options;
+    double start = get_time_ms();
+
+    if (options->mode == MODE_EMBED) {
+        // Save the BMP file
+        int save_result = save_bmp_file(options->output_file, state->bmp);
+        state->result.write_ms = get_time_ms() - start;
+        if (state->borrows_copy) {
+            size_t restored = bmp_discard_changes(state->bmp);
+            LOG(DEBUG, "[Job] Restored %zu rows of the carrier copy.", restored)
+            state->bmp = NULL;
+            state->borrows_copy = false;
+        }
+        invalidate_carrier(cache, options->output_file);
+        if (save_result != 0) {
+            LOG(ERROR, "Error saving the BMP file.")
+            return JOB_ERROR_OUTPUT;
+        }
+        return JOB_OK;
+    }
+
+    // Save the extracted data to a file
+    FilePackage *package = state->package;
+    state->result.payload_bytes = file_package_header_size(package) + package->size + strlen((const char *) package->extension) + 1;
+    // A range was already taken from the decompressed file
+    int created = !options->range && package_is_compressed(package) ? create_file_from_compressed_package(options->output_file, package)
+                                                                     : create_file_from_package(options->output_file, package);
+    state->result.write_ms = get_time_ms() - start;
+    if (created != 1) {
+        LOG(ERROR, "Error creating the output file.")
+        return JOB_ERROR_OUTPUT;
+    }
+    LOG(INFO, "Output file created successfully.")
+    return JOB_OK;
+}
+
+void job_state_init(JobState *state, const ProgramOptions *options) {
+    memset(state, 0, sizeof(JobState));
+    state->options = options;
+    state->start_ms = get_time_ms();
+    arena_init(&state->arena, NULL);
+    if (options == NULL || (options->mode != MODE_EMBED && options->mode != MODE_EXTRACT)) {
+        LOG(ERROR, "Invalid operation mode.")
+        state->result.status = JOB_ERROR_ARGUMENTS;
+    } else if (options->stripe) {
+        LOG(ERROR, "Striped jobs run with run_striped_job.")
+        state->result.status = JOB_ERROR_ARGUMENTS;
+    } else if (options->archive) {
+        LOG(ERROR, "Archive jobs run with run_archive_job.")
+        state->result.status = JOB_ERROR_ARGUMENTS;
+    } else if (options->stream) {
+        LOG(ERROR, "Streamed jobs run with run_streamed_job.")
+        state->result.status = JOB_ERROR_ARGUMENTS;
+    }
+}
+
+JobStatus run_job_stage(JobState *state, JobStage stage, JobCarrierCache *cache, ThreadPool *pool) {
+    if (state->result.status != JOB_OK) {
+        return state->result.status;
+    }
+    bool embedding = state->options->mode == MODE_EMBED;
+    const Allocator *saved_allocator = NULL;
+    allocator_scope_enter(&state->arena.allocator, &saved_allocator);
+
+    JobStatus status = JOB_OK;
+    switch (stage) {
+        case JOB_STAGE_LOAD:
+            status = load_stage(state, cache);
+            break;
+        case JOB_STAGE_EXTRACT:
+            status = embedding ? JOB_OK : extract_stage(state, pool);
+            break;
+        case JOB_STAGE_CRYPTO:
+            status = crypto_stage(state, pool);
+            break;
+        case JOB_STAGE_EMBED:
+            status = embedding ? embed_stage(state, pool) : JOB_OK;
+            break;
+        case JOB_STAGE_WRITE:
+            status = write_stage(state, cache);
+            break;
+        default:
+            status = JOB_ERROR_ARGUMENTS;
+            break;
+    }
+    allocator_scope_exit(saved_allocator);
+    state->result.status = status;
+    return status;
+}
+
+void job_state_release(JobState *state) {
+    // Return the pixels to the pool. The image may also be outside the arena, when the cache failed to keep it
+    if (state->owns_bmp) {
+        const Allocator *saved_allocator = NULL;
+        allocator_scope_enter(&state->arena.allocator, &saved_allocator);
+        free_bmp(state->bmp);
+        allocator_scope_exit(saved_allocator);
+    } else if (state->borrows_copy) {
+        // A failed embed leaves the borrowed copy dirty
+        bmp_discard_changes(state->bmp);
+    }
+    memset(state->carrier_options.password, 0, sizeof(state->carrier_options.password));
+    // Everything else the job allocated goes away with its arena
+    arena_destroy(&state->arena);
+    state->bmp = NULL;
+    state->borrows_copy = false;
+    state->data = NULL;
+    state->package = NULL;
+    state->result.total_ms = get_time_ms() - state->start_ms;
+}
+
+JobStatus run_stego_job(const ProgramOptions *options, JobCarrierCache *cache, ThreadPool *pool, JobResult *result) {
+    if (options != NULL && options->mode == MODE_EMBED) {
+        LOG(INFO, "Embedding mode selected.")
+    } else if (options != NULL && options->mode == MODE_EXTRACT) {
+        LOG(INFO, "Extraction mode selected.")
+    }
+
+    JobState state;
+    job_state_init(&state, options);
+    for (int stage = 0; stage < JOB_STAGE_COUNT; stage++) {
+        if (run_job_stage(&state, (JobStage) stage, cache, pool) != JOB_OK) {
+            break;
+        }
+    }
+    job_state_release(&state);
+
+    if (result != NULL) {
+        *result = state.result;
+    }
+    return state.result.status;
+}
+
+void clear_job_carrier_cache(JobCarrierCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    const Allocator *saved = NULL;
+    allocator_scope_enter(NULL, &saved);
+    free_bmp(cache->working_copy);
+    free_bmp(cache->carrier);
+    allocator_scope_exit(saved);
+    free(cache->carrier_path);
+    cache->working_copy = NULL;
+    cache->carrier = NULL;
+    cache->carrier_path = NULL;
+}
+
+const char* job_status_to_string(JobStatus status) {
+    switch (status) {
+        case JOB_OK: return "ok";
+        case JOB_ERROR_ARGUMENTS: return "error-arguments";
+        case JOB_ERROR_INPUT: return "error-input";
+        case JOB_ERROR_CARRIER: return "error-carrier";
+        case JOB_ERROR_CRYPTO: return "error-crypto";
+        case JOB_ERROR_STEG: return "error-steg";
+        case JOB_ERROR_OUTPUT: return "error-output";
+        default: return "UNKNOWN";
+    }
+}
+
+const char* job_stage_to_string(JobStage stage) {
+    switch (stage) {
+        case JOB_STAGE_LOAD: return "load";
+        case JOB_STAGE_EXTRACT: return "extract";
+        case JOB_STAGE_CRYPTO: return "crypto";
+        case JOB_STAGE_EMBED: return "embed";
+        case JOB_STAGE_WRITE: return "write";
+        default: return "UNKNOWN";
+    }
+}
@@ -0,0 +1,520 @@
+#include "./include/stegolib.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include "./include/allocator.h"
+#include "./include/arguments.h"
+#include "./include/bmp_image.h"
+#include "./include/checksum.h"
+#include "./include/compression.h"
+#include "./include/crypto.h"
+#include "./include/file_package.h"
+#include "./include/stego_bmp.h"
+
+#define STEGO_READ_CHUNK (64 * 1024)    // Initial buffer when reading a descriptor
+
+struct StegoContext {
+    StegoOptions options;
+    char password[MAX_PASSWORD_LENGTH];     // options.password points here
+    Allocator allocator;                    // The caller's hooks
+    const Allocator *parent;                // &allocator, or NULL for malloc/free
+};
+
+static void *hook_allocate(size_t size, void *user_data) {
+    const StegoOptions *options = user_data;
+    return options->malloc_fn(size, options->allocator_data);
+}
+
+static void hook_release(void *ptr, void *user_data) {
+    const StegoOptions *options = user_data;
+    options->free_fn(ptr, options->allocator_data);
+}
+
+/**
+ * @brief Allocate memory that outlives the call: buffers for the caller, or the context itself.
+ */
+static void *context_allocate(const StegoContext *context, size_t size) {
+    return context->parent != NULL ? context->parent->allocate(size, context->parent->user_data) : malloc(size);
+}
+
+static void context_release(const StegoContext *context, void *ptr) {
+    if (context->parent != NULL) {
+        context->parent->release(ptr, context->parent->user_data);
+    } else {
+        free(ptr);
+    }
+}
+
+/**
+ * @brief State of the calling thread that a call replaces while it runs.
+ */
+typedef struct {
+    LogScope log;
+    const Allocator *allocator;
+} SavedScope;
+
+/**
+ * @brief Route the log messages of the calling thread to the context, and its allocations to
+ * `arena`, while a call runs.
+ */
+static void enter_context(const StegoContext *context, Arena *arena, SavedScope *saved) {
+    LogScope scope = {true, context->options.log_level, context->options.log_handler, context->options.log_user_data};
+    log_scope_enter(&scope, &saved->log);
+    arena_init(arena, context->parent);
+    allocator_scope_enter(&arena->allocator, &saved->allocator);
+}
+
+static void exit_context(Arena *arena, const SavedScope *saved) {
+    allocator_scope_exit(saved->allocator);
+    arena_destroy(arena);
+    log_scope_exit(&saved->log);
+}
+
+static bool is_encrypted(const StegoContext *context) {
+    return context->password[0] != '\0';
+}
+
+void stego_options_init(StegoOptions *options) {
+    memset(options, 0, sizeof(StegoOptions));
+    options->steg_algorithm = STEG_LSB1;
+    options->encryption = ENC_NONE;
+    options->mode = ENC_MODE_NONE;
+    options->log_level = NONE;
+}
+
+StegoError stego_ctx_new(const StegoOptions *options, StegoContext **context) {
+    if (options == NULL || context == NULL) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    *context = NULL;
+    if (options->steg_algorithm != STEG_LSB1 && options->steg_algorithm != STEG_LSB4 && options->steg_algorithm != STEG_LSBI) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    if (options->password != NULL && strlen(options->password) >= MAX_PASSWORD_LENGTH) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    if ((options->malloc_fn == NULL) != (options->free_fn == NULL)) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+
+    StegoContext *created = options->malloc_fn != NULL ? options->malloc_fn(sizeof(StegoContext), options->allocator_data)
+                                                       : malloc(sizeof(StegoContext));
+    if (created == NULL) {
+        return STEGO_ERROR_MEMORY;
+    }
+    memset(created, 0, sizeof(StegoContext));
+    created->options = *options;
+    if (options->malloc_fn != NULL) {
+        created->allocator.allocate = hook_allocate;
+        created->allocator.release = hook_release;
+        created->allocator.user_data = &created->options;
+        created->parent = &created->allocator;
+    }
+    if (options->password != NULL) {
+        strcpy(created->password, options->password);
+    }
+    created->options.password = created->password;
+
+    // Same defaults and checks as the command line
+    StegoOptions *copy = &created->options;
+    if (!is_encrypted(created)) {
+        copy->encryption = ENC_NONE;
+        copy->mode = ENC_MODE_NONE;
+        memset(&copy->kdf, 0, sizeof(KdfParams));
+    } else if (copy->encryption == ENC_CHACHA20) {
+        copy->mode = ENC_MODE_NONE;
+    } else {
+        copy->encryption = copy->encryption == ENC_NONE ? DEFAULT_ENCRYPTION_ALGO : copy->encryption;
+        copy->mode = copy->mode == ENC_MODE_NONE ? DEFAULT_ENCRYPTION_MODE : copy->mode;
+    }
+    if (copy->compression != COMPRESSION_NONE && !compression_available(copy->compression)) {
+        stego_ctx_free(created);
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    bool valid = copy->encryption <= ENC_CHACHA20 && copy->mode <= ENC_MODE_CTR && copy->kdf.algorithm <= KDF_SCRYPT;
+    valid = valid && !((copy->mode == ENC_MODE_GCM || copy->mode == ENC_MODE_CTR) && copy->encryption == ENC_3DES);
+    valid = valid && (copy->kdf.algorithm == KDF_NONE || (crypto_kdf_available(copy->kdf.algorithm) && crypto_kdf_valid(&copy->kdf)));
+    if (!valid) {
+        stego_ctx_free(created);
+        return STEGO_ERROR_ARGUMENTS;
+    }
+
+    crypto_init();
+    *context = created;
+    return STEGO_OK;
+}
+
+void stego_ctx_free(StegoContext *context) {
+    if (context == NULL) {
+        return;
+    }
+    OPENSSL_cleanse(context->password, sizeof(context->password));
+    context_release(context, context);
+}
+
+/**
+ * @brief Embed an already packaged payload (size || data || extension) in the image, compressing,
+ * checksumming and encrypting it first if needed.
+ */
+static StegoError embed_package(const StegoContext *context, BMPImage *bmp, uint8_t **package, size_t *package_size) {
+    const StegoOptions *options = &context->options;
+    if (options->compression != COMPRESSION_NONE && !compress_package(package, package_size, options->compression)) {
+        return STEGO_ERROR_MEMORY;
+    }
+    if (options->checksum && !checksum_package(package, package_size, 0)) {
+        return STEGO_ERROR_MEMORY;
+    }
+    const uint8_t *payload = *package;
+    size_t payload_size = *package_size;
+    uint8_t *encrypted = NULL;
+
+    if (is_encrypted(context)) {
+        encrypted = crypto_encrypt_with_kdf(*package, *package_size, options->encryption, options->mode, context->password, &options->kdf, &payload_size);
+        if (encrypted == NULL) {
+            return STEGO_ERROR_CRYPTO;
+        }
+        payload = encrypted;
+    }
+
+    StegoError error = STEGO_OK;
+    if (payload_size > steg_capacity(bmp, options->steg_algorithm)) {
+        LOG(ERROR, "Not enough capacity to embed %zu bytes.", payload_size)
+        error = STEGO_ERROR_CAPACITY;
+    } else if (!embed(bmp, payload, payload_size, options->steg_algorithm)) {
+        error = STEGO_ERROR_CAPACITY;
+    }
+    mem_free(encrypted);
+    return error;
+}
+
+StegoError stego_embed_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                              const uint8_t *data, size_t data_size, const char *extension,
+                              uint8_t **output, size_t *output_size) {
+    if (context == NULL || carrier == NULL || data == NULL || extension == NULL || output == NULL || output_size == NULL) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    *output = NULL;
+    *output_size = 0;
+
+    Arena arena;
+    SavedScope saved;
+    enter_context(context, &arena, &saved);
+    StegoError error = STEGO_OK;
+    size_t package_size = 0;
+    uint8_t *package = embed_data_from_buffer(data, data_size, extension, &package_size);
+    BMPImage *bmp = package != NULL ? new_bmp_from_buffer(carrier, carrier_size) : NULL;
+    if (package == NULL) {
+        error = STEGO_ERROR_ARGUMENTS;
+    } else if (bmp == NULL) {
+        error = STEGO_ERROR_CARRIER;
+    } else {
+        error = embed_package(context, bmp, &package, &package_size);
+    }
+    if (error == STEGO_OK) {
+        // The result belongs to the caller, not to the arena
+        const Allocator *arena_allocator = NULL;
+        allocator_scope_enter(context->parent, &arena_allocator);
+        *output = bmp_to_buffer(bmp, output_size);
+        allocator_scope_exit(arena_allocator);
+        error = *output != NULL ? STEGO_OK : STEGO_ERROR_MEMORY;
+    }
+
+    if (package != NULL) {
+        OPENSSL_cleanse(package, package_size);
+    }
+    free_bmp(bmp);
+    exit_context(&arena, &saved);
+    return error;
+}
+
+/**
+ * @brief Extract the file hidden in the image, decrypting it if needed.
+ */
+static StegoError extract_package(const StegoContext *context, const BMPImage *bmp, FilePackage **package) {
+    const StegoOptions *options = &context->options;
+    if (!is_encrypted(context)) {
+        *package = extract_data(bmp, options->steg_algorithm);
+        return *package != NULL ? STEGO_OK : STEGO_ERROR_NOT_FOUND;
+    }
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = extract_encrypted_data(bmp, options->steg_algorithm, &encrypted_size);
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = encrypted != NULL ? crypto_decrypt(encrypted, encrypted_size, options->encryption, options->mode,
+                                                            (const uint8_t *) context->password, &decrypted_size) : NULL;
+    *package = decrypted != NULL ? new_file_package_from_buffer(decrypted, decrypted_size) : NULL;
+    if (decrypted != NULL) {
+        OPENSSL_cleanse(decrypted, decrypted_size);
+    }
+    return encrypted == NULL ? STEGO_ERROR_NOT_FOUND : *package == NULL ? STEGO_ERROR_CRYPTO : STEGO_OK;
+}
+
+/**
+ * @brief Give back the original file of a checksummed and/or compressed package. A damaged chunk
+ * counts as no valid payload.
+ */
+static StegoError expand_package(FilePackage *package) {
+    if (package_is_checksummed(package) && !verify_file_package(package, NULL, true, NULL)) {
+        return STEGO_ERROR_NOT_FOUND;
+    }
+    return !package_is_compressed(package) || decompress_file_package(package) ? STEGO_OK : STEGO_ERROR_NOT_FOUND;
+}
+
+/**
+ * @brief Extract bytes [start, start + length) of the hidden file. Without a password only those
+ * bytes are decoded, reading the rows of a lazily loaded image on demand.
+ */
+static StegoError extract_range_package(const StegoContext *context, BMPImage *bmp, size_t start, size_t length,
+                                        FilePackage **package, size_t *file_size) {
+    if (!is_encrypted(context)) {
+        size_t size = 0;
+        *package = extract_data_range(bmp, context->options.steg_algorithm, start, length, &size);
+        if (file_size != NULL) {
+            *file_size = size;
+        }
+        // The size field was valid, so the range was wrong
+        return *package != NULL ? STEGO_OK : size != 0 && start >= size ? STEGO_ERROR_ARGUMENTS : STEGO_ERROR_NOT_FOUND;
+    }
+
+    // The ciphertext cannot be read in pieces
+    if (!bmp_load_rows(bmp, 0, bmp->width * bmp->height * 3)) {
+        return STEGO_ERROR_IO;
+    }
+    StegoError error = extract_package(context, bmp, package);
+    if (error == STEGO_OK) {
+        error = expand_package(*package);
+    }
+    if (error != STEGO_OK) {
+        *package = NULL;
+        return error;
+    }
+    if (file_size != NULL) {
+        *file_size = (*package)->size;
+    }
+    if (!file_package_slice(*package, start, length)) {
+        OPENSSL_cleanse((*package)->data, (*package)->size);
+        *package = NULL;
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    return STEGO_OK;
+}
+
+/**
+ * @brief Copy an extracted file to a buffer owned by the caller, and wipe it.
+ */
+static StegoError return_package(const StegoContext *context, FilePackage *package, uint8_t **data, size_t *data_size, char *extension) {
+    StegoError error = STEGO_OK;
+    // +1 so an empty file is not a malloc(0)
+    *data = context_allocate(context, package->size + 1);
+    if (*data == NULL) {
+        error = STEGO_ERROR_MEMORY;
+    } else {
+        memcpy(*data, package->data, package->size);
+        *data_size = package->size;
+    }
+    if (extension != NULL) {
+        snprintf(extension, STEGO_EXTENSION_SIZE, "%s", (const char *) package->extension);
+    }
+    OPENSSL_cleanse(package->data, package->size);
+    return error;
+}
+
+StegoError stego_extract_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                                uint8_t **data, size_t *data_size, char *extension) {
+    if (context == NULL || carrier == NULL || data == NULL || data_size == NULL) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    *data = NULL;
+    *data_size = 0;
+
+    Arena arena;
+    SavedScope saved;
+    enter_context(context, &arena, &saved);
+    FilePackage *package = NULL;
+    BMPImage *bmp = new_bmp_from_buffer(carrier, carrier_size);
+    StegoError error = bmp != NULL ? extract_package(context, bmp, &package) : STEGO_ERROR_CARRIER;
+    if (error == STEGO_OK) {
+        error = expand_package(package);
+    }
+    if (error == STEGO_OK) {
+        error = return_package(context, package, data, data_size, extension);
+    }
+    free_bmp(bmp);
+    exit_context(&arena, &saved);
+    return error;
+}
+
+StegoError stego_extract_range_buffer(const StegoContext *context, const uint8_t *carrier, size_t carrier_size,
+                                      size_t start, size_t length, uint8_t **data, size_t *data_size,
+                                      size_t *file_size, char *extension) {
+    if (context == NULL || carrier == NULL || data == NULL || data_size == NULL || length == 0) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+    *data = NULL;
+    *data_size = 0;
+
+    Arena arena;
+    SavedScope saved;
+    enter_context(context, &arena, &saved);
+    FilePackage *package = NULL;
+    BMPImage *bmp = new_bmp_from_buffer(carrier, carrier_size);
+    StegoError error = bmp != NULL ? extract_range_package(context, bmp, start, length, &package, file_size) : STEGO_ERROR_CARRIER;
+    if (package != NULL) {
+        error = return_package(context, package, data, data_size, extension);
+    }
+    free_bmp(bmp);
+    exit_context(&arena, &saved);
+    return error;
+}
+
+/**
+ * @brief Read a descriptor until end of file.
+ */
+static StegoError read_fd(const StegoContext *context, int fd, uint8_t **buffer, size_t *size) {
+    size_t capacity = STEGO_READ_CHUNK;
+    size_t used = 0;
+    uint8_t *data = context_allocate(context, capacity);
+    if (data == NULL) {
+        return STEGO_ERROR_MEMORY;
+    }
+    for (;;) {
+        if (used == capacity) {
+            // The hooks have no realloc
+            uint8_t *grown = context_allocate(context, capacity * 2);
+            if (grown == NULL) {
+                context_release(context, data);
+                return STEGO_ERROR_MEMORY;
+            }
+            memcpy(grown, data, used);
+            context_release(context, data);
+            data = grown;
+            capacity *= 2;
+        }
+        ssize_t count = read(fd, data + used, capacity - used);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            context_release(context, data);
+            return STEGO_ERROR_IO;
+        }
+        if (count == 0) {
+            break;
+        }
+        used += (size_t) count;
+    }
+    *buffer = data;
+    *size = used;
+    return STEGO_OK;
+}
+
+static StegoError write_fd(int fd, const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t count = write(fd, buffer + written, size - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return STEGO_ERROR_IO;
+        }
+        written += (size_t) count;
+    }
+    return STEGO_OK;
+}
+
+StegoError stego_embed_fd(const StegoContext *context, int carrier_fd, int data_fd, const char *extension, int output_fd) {
+    if (context == NULL) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+
+    uint8_t *carrier = NULL, *data = NULL, *output = NULL;
+    size_t carrier_size = 0, data_size = 0, output_size = 0;
+
+    StegoError error = read_fd(context, carrier_fd, &carrier, &carrier_size);
+    if (error == STEGO_OK) {
+        error = read_fd(context, data_fd, &data, &data_size);
+    }
+    if (error == STEGO_OK) {
+        error = stego_embed_buffer(context, carrier, carrier_size, data, data_size, extension, &output, &output_size);
+    }
+    if (error == STEGO_OK) {
+        error = write_fd(output_fd, output, output_size);
+    }
+
+    stego_free(context, carrier);
+    if (data != NULL) {
+        OPENSSL_cleanse(data, data_size);
+        stego_free(context, data);
+    }
+    stego_free(context, output);
+    return error;
+}
+
+StegoError stego_extract_fd(const StegoContext *context, int carrier_fd, int output_fd, char *extension) {
+    if (context == NULL) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+
+    uint8_t *carrier = NULL, *data = NULL;
+    size_t carrier_size = 0, data_size = 0;
+
+    StegoError error = read_fd(context, carrier_fd, &carrier, &carrier_size);
+    if (error == STEGO_OK) {
+        error = stego_extract_buffer(context, carrier, carrier_size, &data, &data_size, extension);
+    }
+    if (error == STEGO_OK) {
+        error = write_fd(output_fd, data, data_size);
+    }
+
+    stego_free(context, carrier);
+    if (data != NULL) {
+        OPENSSL_cleanse(data, data_size);
+        stego_free(context, data);
+    }
+    return error;
+}
+
+StegoError stego_extract_range_fd(const StegoContext *context, int carrier_fd, size_t start, size_t length,
+                                  int output_fd, size_t *file_size, char *extension) {
+    if (context == NULL || length == 0) {
+        return STEGO_ERROR_ARGUMENTS;
+    }
+
+    Arena arena;
+    SavedScope saved;
+    enter_context(context, &arena, &saved);
+    FilePackage *package = NULL;
+    BMPImage *bmp = new_bmp_lazy(carrier_fd);
+    StegoError error = bmp != NULL ? extract_range_package(context, bmp, start, length, &package, file_size) : STEGO_ERROR_CARRIER;
+    if (package != NULL) {
+        error = write_fd(output_fd, package->data, package->size);
+        if (extension != NULL) {
+            snprintf(extension, STEGO_EXTENSION_SIZE, "%s", (const char *) package->extension);
+        }
+        OPENSSL_cleanse(package->data, package->size);
+    }
+    free_bmp(bmp);
+    exit_context(&arena, &saved);
+    return error;
+}
+
+void stego_free(const StegoContext *context, void *buffer) {
+    if (context != NULL && buffer != NULL) {
+        context_release(context, buffer);
+    }
+}
+
+const char* stego_error_to_string(StegoError error) {
+    switch (error) {
+        case STEGO_OK: return "ok";
+        case STEGO_ERROR_ARGUMENTS: return "arguments";
+        case STEGO_ERROR_MEMORY: return "memory";
+        case STEGO_ERROR_IO: return "io";
+        case STEGO_ERROR_CARRIER: return "carrier";
+        case STEGO_ERROR_CAPACITY: return "capacity";
+        case STEGO_ERROR_NOT_FOUND: return "not-found";
+        case STEGO_ERROR_CRYPTO: return "crypto";
+        default: return "unknown";
+    }
+}
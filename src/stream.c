@@ -0,0 +1,429 @@
+#include "./include/stream.h"
+#include "./include/stego_bmp.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief A carrier read one window of rows at a time.
+ *
+ * `window` describes the rows currently loaded as an image of their own: the width of the carrier,
+ * the rows of the window as its height and `buffer` as its pixel data.
+ */
+typedef struct {
+    FILE *file;
+    BMPImage window;
+    size_t height;              // Rows of the carrier
+    size_t row_size;            // Bytes of a row, with padding
+    size_t window_rows;         // Rows of a full window, a multiple of 8 unless it is the only one
+    size_t window_bytes;        // Stream bytes held by a full window
+    size_t loaded;              // Index of the loaded window, or SIZE_MAX
+    uint64_t capacity;          // Stream bytes of the whole carrier
+    uint8_t *buffer;            // Rows of the loaded window
+    uint8_t *chunk;             // Stream bytes of one window
+    StegAlgorithm steg_alg;
+} StreamCarrier;
+
+/**
+ * @brief The bytes hidden by a streamed embed: the package header, the file and its extension.
+ */
+typedef struct {
+    const uint8_t *header;
+    size_t header_size;
+    FILE *file;
+    uint64_t file_size;
+    const char *extension;
+    size_t extension_size;      // Including the terminator
+    uint64_t position;
+} StreamPayload;
+
+/**
+ * @brief Receives the bytes read by read_stream, in order.
+ */
+typedef bool (*StreamSink)(const uint8_t *bytes, size_t size, void *ctx);
+
+static void close_carrier(StreamCarrier *carrier) {
+    if (carrier->file != NULL) {
+        fclose(carrier->file);
+    }
+    mem_free(carrier->buffer);
+    mem_free(carrier->chunk);
+    memset(carrier, 0, sizeof(StreamCarrier));
+}
+
+static bool open_carrier(StreamCarrier *carrier, const char *path, StegAlgorithm steg_alg) {
+    memset(carrier, 0, sizeof(StreamCarrier));
+    carrier->loaded = SIZE_MAX;
+    carrier->steg_alg = steg_alg;
+    if (!steg_supports_ranges(steg_alg)) {
+        LOG(ERROR, "Streaming only supports LSB1 and LSB4.")
+        return false;
+    }
+
+    carrier->file = fopen(path, "rb");
+    if (carrier->file == NULL) {
+        LOG(ERROR, "Could not open carrier %s: %s", path, strerror(errno))
+        return false;
+    }
+    if (fread(carrier->window.header, 1, BMP_HEADER_SIZE, carrier->file) != BMP_HEADER_SIZE ||
+        !bmp_parse_header(&carrier->window)) {
+        LOG(ERROR, "Could not read the BMP header of %s.", path)
+        return false;
+    }
+
+    carrier->height = carrier->window.height;
+    carrier->row_size = (carrier->window.width * 3 + 3) & ~(size_t) 3;
+    struct stat info;
+    if (carrier->window.data_size < carrier->row_size * carrier->height || fstat(fileno(carrier->file), &info) != 0 ||
+        (uint64_t) info.st_size < BMP_HEADER_SIZE + (uint64_t) carrier->window.data_size) {
+        LOG(ERROR, "The pixel data of %s is shorter than its rows.", path)
+        return false;
+    }
+    posix_fadvise(fileno(carrier->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Windows start at multiples of 8 rows, where both algorithms start a new byte
+    carrier->capacity = steg_capacity(&carrier->window, steg_alg);
+    carrier->window_rows = STREAM_WINDOW_SIZE / carrier->row_size / 8 * 8;
+    if (carrier->window_rows < 8) {
+        carrier->window_rows = 8;
+    }
+    if (carrier->window_rows > carrier->height) {
+        carrier->window_rows = carrier->height;
+    }
+    carrier->window.height = carrier->window_rows;
+    carrier->window_bytes = steg_capacity(&carrier->window, steg_alg);
+
+    carrier->buffer = mem_alloc(carrier->window_rows * carrier->row_size);
+    carrier->chunk = mem_alloc(carrier->window_bytes);
+    if (carrier->buffer == NULL || carrier->chunk == NULL) {
+        LOG(ERROR, "Could not allocate the stream window.")
+        return false;
+    }
+    LOG(DEBUG, "[stream] %zu rows per window, %zu bytes each, %llu bytes of capacity.", carrier->window_rows,
+        carrier->window_bytes, (unsigned long long) carrier->capacity)
+    return true;
+}
+
+static size_t window_count(const StreamCarrier *carrier) {
+    return (carrier->height + carrier->window_rows - 1) / carrier->window_rows;
+}
+
+/**
+ * @brief Read the rows of window `index` into the buffer, unless they are already there.
+ */
+static bool load_window(StreamCarrier *carrier, size_t index) {
+    if (carrier->loaded == index) {
+        return true;
+    }
+    size_t first_row = index * carrier->window_rows;
+    size_t rows = carrier->height - first_row < carrier->window_rows ? carrier->height - first_row : carrier->window_rows;
+    off_t offset = (off_t) BMP_HEADER_SIZE + (off_t) first_row * (off_t) carrier->row_size;
+    if (fseeko(carrier->file, offset, SEEK_SET) != 0 ||
+        fread(carrier->buffer, 1, rows * carrier->row_size, carrier->file) != rows * carrier->row_size) {
+        LOG(ERROR, "Could not read rows %zu to %zu of the carrier.", first_row, first_row + rows)
+        carrier->loaded = SIZE_MAX;
+        return false;
+    }
+    carrier->window.data = carrier->buffer;
+    carrier->window.height = rows;
+    carrier->window.data_size = rows * carrier->row_size;
+    carrier->loaded = index;
+    return true;
+}
+
+/**
+ * @brief Extract the stream bytes [start, start + length) of the carrier and pass them to `sink`.
+ */
+static bool read_stream(StreamCarrier *carrier, uint64_t start, uint64_t length, StreamSink sink, void *ctx) {
+    if (start > carrier->capacity || length > carrier->capacity - start) {
+        LOG(ERROR, "Stream range beyond the capacity of the carrier.")
+        return false;
+    }
+    while (length > 0) {
+        size_t index = (size_t) (start / carrier->window_bytes);
+        if (!load_window(carrier, index)) {
+            return false;
+        }
+        size_t local = (size_t) (start - (uint64_t) index * carrier->window_bytes);
+        size_t available = steg_capacity(&carrier->window, carrier->steg_alg) - local;
+        size_t size = length < available ? (size_t) length : available;
+        if (size == 0 || !extract_range(&carrier->window, local, size, carrier->chunk, carrier->steg_alg) ||
+            !sink(carrier->chunk, size, ctx)) {
+            return false;
+        }
+        start += size;
+        length -= size;
+    }
+    return true;
+}
+
+static bool copy_to_buffer(const uint8_t *bytes, size_t size, void *ctx) {
+    uint8_t **cursor = ctx;
+    memcpy(*cursor, bytes, size);
+    *cursor += size;
+    return true;
+}
+
+static bool write_to_file(const uint8_t *bytes, size_t size, void *ctx) {
+    if (fwrite(bytes, 1, size, (FILE *) ctx) != size) {
+        LOG(ERROR, "Could not write the extracted file: %s", strerror(errno))
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Fill `buffer` with the next `size` bytes of the payload.
+ */
+static bool read_payload(StreamPayload *payload, uint8_t *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        uint64_t position = payload->position + done;
+        uint64_t file_end = payload->header_size + payload->file_size;
+        size_t count;
+        if (position < payload->header_size) {
+            count = payload->header_size - (size_t) position;
+            count = count < size - done ? count : size - done;
+            memcpy(buffer + done, payload->header + position, count);
+        } else if (position < file_end) {
+            count = file_end - position < size - done ? (size_t) (file_end - position) : size - done;
+            if (fread(buffer + done, 1, count, payload->file) != count) {
+                LOG(ERROR, "Could not read the file to hide.")
+                return false;
+            }
+        } else {
+            size_t extension_position = (size_t) (position - file_end);
+            count = payload->extension_size - extension_position;
+            count = count < size - done ? count : size - done;
+            memcpy(buffer + done, payload->extension + extension_position, count);
+        }
+        done += count;
+    }
+    payload->position += size;
+    return true;
+}
+
+/**
+ * @brief Copy the bytes of the carrier after its last row (padding some encoders leave) unchanged.
+ */
+static bool copy_trailing_bytes(StreamCarrier *carrier, FILE *output) {
+    size_t remaining = carrier->window.data_size - carrier->height * carrier->row_size;
+    off_t offset = (off_t) BMP_HEADER_SIZE + (off_t) carrier->height * (off_t) carrier->row_size;
+    if (remaining > 0 && fseeko(carrier->file, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    carrier->loaded = SIZE_MAX;
+    size_t buffer_size = carrier->window_rows * carrier->row_size;
+    while (remaining > 0) {
+        size_t size = remaining < buffer_size ? remaining : buffer_size;
+        if (fread(carrier->buffer, 1, size, carrier->file) != size || fwrite(carrier->buffer, 1, size, output) != size) {
+            return false;
+        }
+        remaining -= size;
+    }
+    return true;
+}
+
+static bool embed_windows(StreamCarrier *carrier, StreamPayload *payload, uint64_t total, FILE *output) {
+    // The trailing bytes are measured with the data size of the whole carrier, before windows replace it
+    size_t data_size = carrier->window.data_size;
+    if (fwrite(carrier->window.header, 1, BMP_HEADER_SIZE, output) != BMP_HEADER_SIZE) {
+        return false;
+    }
+    size_t windows = window_count(carrier);
+    for (size_t index = 0; index < windows; index++) {
+        if (!load_window(carrier, index)) {
+            return false;
+        }
+        if (payload->position < total) {
+            size_t capacity = steg_capacity(&carrier->window, carrier->steg_alg);
+            size_t size = total - payload->position < capacity ? (size_t) (total - payload->position) : capacity;
+            if (!read_payload(payload, carrier->chunk, size) ||
+                !embed_range(&carrier->window, carrier->chunk, 0, size, carrier->steg_alg)) {
+                return false;
+            }
+        }
+        if (fwrite(carrier->buffer, 1, carrier->window.data_size, output) != carrier->window.data_size) {
+            return false;
+        }
+    }
+    carrier->window.data_size = data_size;
+    return copy_trailing_bytes(carrier, output);
+}
+
+bool stream_embed(const char *carrier_path, const char *input_path, const char *output_path, StegAlgorithm steg_alg,
+                  bool large_header, uint64_t *stored) {
+    if (carrier_path == NULL || input_path == NULL || output_path == NULL) {
+        LOG(ERROR, "Invalid arguments for stream_embed.")
+        return false;
+    }
+    StreamCarrier carrier;
+    if (!open_carrier(&carrier, carrier_path, steg_alg)) {
+        close_carrier(&carrier);
+        return false;
+    }
+
+    FILE *input = fopen(input_path, "rb");
+    struct stat info;
+    if (input == NULL || fstat(fileno(input), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        LOG(ERROR, "Could not read the file to hide %s.", input_path)
+        if (input != NULL) {
+            fclose(input);
+        }
+        close_carrier(&carrier);
+        return false;
+    }
+    posix_fadvise(fileno(input), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    char *extension = (char *) get_file_extension(input_path);
+    uint8_t header[PACKAGE_MAX_HEADER_SIZE];
+    StreamPayload payload = {
+        .header = header,
+        .header_size = write_package_header(header, (uint64_t) info.st_size, large_header, COMPRESSION_NONE),
+        .file = input,
+        .file_size = (uint64_t) info.st_size,
+        .extension = extension != NULL ? extension : "",
+        .extension_size = (extension != NULL ? strlen(extension) : 0) + 1,
+        .position = 0,
+    };
+    uint64_t total = payload.header_size + payload.file_size + payload.extension_size;
+
+    bool success = false;
+    if (total > carrier.capacity) {
+        LOG(ERROR, "The file does not fit in the carrier: %llu bytes needed, %llu available.", (unsigned long long) total,
+            (unsigned long long) carrier.capacity)
+    } else {
+        LOG(INFO, "[stream] Hiding %llu bytes in %zu windows.", (unsigned long long) total, window_count(&carrier))
+        FILE *output = fopen(output_path, "wb");
+        if (output == NULL) {
+            LOG(ERROR, "Could not create %s: %s", output_path, strerror(errno))
+        } else {
+            success = embed_windows(&carrier, &payload, total, output);
+            success = fclose(output) == 0 && success;
+            if (!success) {
+                LOG(ERROR, "Could not write %s.", output_path)
+                remove(output_path);
+            }
+        }
+    }
+
+    if (success && stored != NULL) {
+        *stored = total;
+    }
+    mem_free(extension);
+    fclose(input);
+    close_carrier(&carrier);
+    return success;
+}
+
+/**
+ * @brief Read the package header and the extension, and check the file fits between them.
+ */
+static bool read_package_layout(StreamCarrier *carrier, uint64_t *header_size, uint64_t *file_size, char *extension) {
+    uint8_t header[PACKAGE_MAX_HEADER_SIZE];
+    size_t available = carrier->capacity < sizeof(header) ? (size_t) carrier->capacity : sizeof(header);
+    uint8_t *cursor = header;
+    if (!read_stream(carrier, 0, available, copy_to_buffer, &cursor)) {
+        return false;
+    }
+    *header_size = parse_package_header(header, available, file_size, NULL);
+    // The extension takes at least a dot, a character and the terminator
+    if (*header_size == 0 || *file_size > carrier->capacity - *header_size ||
+        carrier->capacity - *header_size - *file_size < 3) {
+        LOG(ERROR, "The carrier does not hold a valid file.")
+        return false;
+    }
+
+    uint64_t extension_start = *header_size + *file_size;
+    uint64_t left = carrier->capacity - extension_start;
+    size_t extension_size = left < EXTENSION_SIZE ? (size_t) left : EXTENSION_SIZE;
+    memset(extension, 0, EXTENSION_SIZE);
+    cursor = (uint8_t *) extension;
+    if (!read_stream(carrier, extension_start, extension_size, copy_to_buffer, &cursor)) {
+        return false;
+    }
+    if (extension[0] != '.' || memchr(extension, '\0', extension_size) == NULL || strlen(extension) < 2) {
+        LOG(ERROR, "The carrier does not hold a valid file extension.")
+        return false;
+    }
+    return true;
+}
+
+bool stream_extract(const char *carrier_path, const char *output_name, StegAlgorithm steg_alg, uint64_t *file_size) {
+    if (carrier_path == NULL || output_name == NULL) {
+        LOG(ERROR, "Invalid arguments for stream_extract.")
+        return false;
+    }
+    StreamCarrier carrier;
+    uint64_t header_size = 0, size = 0;
+    char extension[EXTENSION_SIZE];
+    if (!open_carrier(&carrier, carrier_path, steg_alg) ||
+        !read_package_layout(&carrier, &header_size, &size, extension)) {
+        close_carrier(&carrier);
+        return false;
+    }
+
+    size_t path_size = strlen(output_name) + strlen(extension) + 1;
+    char *path = mem_alloc(path_size);
+    FILE *output = NULL;
+    if (path != NULL) {
+        snprintf(path, path_size, "%s%s", output_name, extension);
+        output = fopen(path, "wb");
+    }
+    if (output == NULL) {
+        LOG(ERROR, "Could not create the extracted file %s%s.", output_name, extension)
+        mem_free(path);
+        close_carrier(&carrier);
+        return false;
+    }
+
+    LOG(INFO, "[stream] Extracting %llu bytes to %s.", (unsigned long long) size, path)
+    bool success = read_stream(&carrier, header_size, size, write_to_file, output);
+    success = fclose(output) == 0 && success;
+    if (!success) {
+        remove(path);
+    } else if (file_size != NULL) {
+        *file_size = size;
+    }
+    mem_free(path);
+    close_carrier(&carrier);
+    return success;
+}
+
+JobStatus run_streamed_job(const ProgramOptions *options, JobResult *result) {
+    JobResult job_result;
+    memset(&job_result, 0, sizeof(JobResult));
+    double start = get_time_ms();
+    job_result.status = JOB_ERROR_ARGUMENTS;
+
+    if (options == NULL || !options->stream || (options->mode != MODE_EMBED && options->mode != MODE_EXTRACT)) {
+        LOG(ERROR, "Invalid streamed job.")
+    } else if (options->mode == MODE_EMBED) {
+        uint64_t stored = 0;
+        if (stream_embed(options->input_bmp_file, options->input_file, options->output_file, options->steg_algorithm,
+                         false, &stored)) {
+            job_result.status = JOB_OK;
+            job_result.stored_bytes = (size_t) stored;
+            job_result.payload_bytes = (size_t) stored;
+        } else {
+            job_result.status = JOB_ERROR_STEG;
+        }
+    } else {
+        uint64_t size = 0;
+        if (stream_extract(options->input_bmp_file, options->output_file, options->steg_algorithm, &size)) {
+            job_result.status = JOB_OK;
+            job_result.payload_bytes = (size_t) size;
+            job_result.stored_bytes = (size_t) size;
+        } else {
+            job_result.status = JOB_ERROR_STEG;
+        }
+    }
+
+    job_result.total_ms = get_time_ms() - start;
+    job_result.steg_ms = job_result.total_ms;
+    if (result != NULL) {
+        *result = job_result;
+    }
+    return job_result.status;
+}
@@ -0,0 +1,422 @@
+#include "./include/stripe.h"
+#include "./include/checksum.h"
+#include "./include/compression.h"
+#include "./include/crypto.h"
+#include "./include/stego_bmp.h"
+#include "./include/utils.h"
+
+#define STRIPE_FNV_OFFSET 2166136261u
+#define STRIPE_FNV_PRIME 16777619u
+
+/**
+ * @brief One carrier of a striped job and what its worker did with it.
+ */
+typedef struct {
+    const ProgramOptions *options;
+    const char *carrier_path;
+    const char *output_path;    // Stego image written by embed jobs
+    BMPImage *bmp;
+    size_t capacity;            // Stream bytes the carrier can hold
+    const uint8_t *stream;      // Whole stream, when embedding
+    size_t offset;              // First stream byte of the stripe
+    size_t length;
+    size_t index;
+    uint8_t *stripe;            // Header of the stripe, followed by its data once extracted
+    size_t stripe_size;
+    double load_ms;
+    double steg_ms;
+    double write_ms;
+    JobStatus status;
+} StripeCarrier;
+
+static uint32_t fnv1a(const uint8_t *data, size_t size) {
+    uint32_t hash = STRIPE_FNV_OFFSET;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * STRIPE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Split a comma-separated list in place. Returns the number of entries, or 0 if there are
+ * more than `max` or one of them is empty.
+ */
+static size_t split_list(char *list, char **entries, size_t max) {
+    size_t count = 0;
+    char *cursor = list;
+    while (cursor != NULL) {
+        char *comma = strchr(cursor, ',');
+        if (comma != NULL) {
+            *comma = '\0';
+        }
+        if (*cursor == '\0' || count == max) {
+            return 0;
+        }
+        entries[count++] = cursor;
+        cursor = comma != NULL ? comma + 1 : NULL;
+    }
+    return count;
+}
+
+bool stripe_plan(const size_t *capacities, size_t count, size_t stream_size, size_t *lengths) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += capacities[i];
+    }
+    if (count == 0 || stream_size > total) {
+        LOG(ERROR, "The payload (%zu bytes) exceeds the capacity of the carriers (%zu bytes).", stream_size, total)
+        return false;
+    }
+
+    // Proportional share rounded down, then the remainder to the carriers with room left
+    size_t assigned = 0;
+    for (size_t i = 0; i < count; i++) {
+        lengths[i] = (size_t) ((double) stream_size * (double) capacities[i] / (double) total);
+        lengths[i] = lengths[i] < capacities[i] ? lengths[i] : capacities[i];
+        assigned += lengths[i];
+    }
+    for (size_t i = 0; i < count && assigned < stream_size; i++) {
+        size_t extra = capacities[i] - lengths[i];
+        extra = extra < stream_size - assigned ? extra : stream_size - assigned;
+        lengths[i] += extra;
+        assigned += extra;
+    }
+    return assigned == stream_size;
+}
+
+static void load_carrier_task(void *arg) {
+    StripeCarrier *carrier = arg;
+    double start = get_time_ms();
+    carrier->bmp = new_bmp_file(carrier->carrier_path);
+    carrier->load_ms = get_time_ms() - start;
+    if (carrier->bmp == NULL) {
+        LOG(ERROR, "Error loading the BMP file %s.", carrier->carrier_path)
+        carrier->status = JOB_ERROR_CARRIER;
+        return;
+    }
+    size_t capacity = steg_capacity(carrier->bmp, carrier->options->steg_algorithm);
+    size_t overhead = sizeof(uint32_t) + STRIPE_HEADER_SIZE;
+    carrier->capacity = capacity > overhead ? capacity - overhead : 0;
+}
+
+static void embed_stripe_task(void *arg) {
+    StripeCarrier *carrier = arg;
+    const ProgramOptions *options = carrier->options;
+    double start = get_time_ms();
+
+    // Size field, header and stripe, embedded like any other stream
+    size_t size = sizeof(uint32_t) + STRIPE_HEADER_SIZE + carrier->length;
+    uint8_t *buffer = mem_alloc(size);
+    if (buffer == NULL) {
+        LOG(ERROR, "Memory allocation failed for the stripe of %s.", carrier->carrier_path)
+        carrier->status = JOB_ERROR_STEG;
+        return;
+    }
+    store_be32(buffer, (uint32_t) (STRIPE_HEADER_SIZE + carrier->length));
+    memcpy(buffer + sizeof(uint32_t), carrier->stripe, STRIPE_HEADER_SIZE);
+    memcpy(buffer + sizeof(uint32_t) + STRIPE_HEADER_SIZE, carrier->stream + carrier->offset, carrier->length);
+    bool embedded = embed(carrier->bmp, buffer, size, options->steg_algorithm);
+    mem_free(buffer);
+    carrier->steg_ms = get_time_ms() - start;
+    if (!embedded) {
+        LOG(ERROR, "Error embedding stripe %zu in %s.", carrier->index, carrier->carrier_path)
+        carrier->status = JOB_ERROR_STEG;
+        return;
+    }
+
+    start = get_time_ms();
+    if (save_bmp_file(carrier->output_path, carrier->bmp) != 0) {
+        LOG(ERROR, "Error saving the BMP file %s.", carrier->output_path)
+        carrier->status = JOB_ERROR_OUTPUT;
+    }
+    carrier->write_ms = get_time_ms() - start;
+}
+
+static void extract_stripe_task(void *arg) {
+    StripeCarrier *carrier = arg;
+    load_carrier_task(carrier);
+    if (carrier->status != JOB_OK) {
+        return;
+    }
+    double start = get_time_ms();
+    carrier->stripe = extract_encrypted_data(carrier->bmp, carrier->options->steg_algorithm, &carrier->stripe_size);
+    carrier->steg_ms = get_time_ms() - start;
+    free_bmp(carrier->bmp);
+    carrier->bmp = NULL;
+    if (carrier->stripe == NULL || carrier->stripe_size < STRIPE_HEADER_SIZE ||
+        memcmp(carrier->stripe, STRIPE_MAGIC, strlen(STRIPE_MAGIC)) != 0 || carrier->stripe[4] != STRIPE_VERSION) {
+        LOG(ERROR, "%s does not hold a stripe.", carrier->carrier_path)
+        carrier->status = JOB_ERROR_STEG;
+    }
+}
+
+/**
+ * @brief Run `task` for every carrier on its own worker and wait for all of them.
+ *
+ * @return JobStatus The first error of a carrier, in list order, or JOB_OK.
+ */
+static JobStatus run_carriers(ThreadPool *pool, StripeCarrier *carriers, size_t count, ThreadPoolTask task) {
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t i = 0; i < count; i++) {
+        if (!thread_pool_submit(pool, i, &group, task, &carriers[i])) {
+            task(&carriers[i]);
+        }
+    }
+    thread_pool_wait(pool, &group);
+    for (size_t i = 0; i < count; i++) {
+        if (carriers[i].status != JOB_OK) {
+            return carriers[i].status;
+        }
+    }
+    return JOB_OK;
+}
+
+static JobStatus embed_stripes(const ProgramOptions *options, ThreadPool *pool, StripeCarrier *carriers, size_t count,
+                               char **outputs, JobResult *result) {
+    // The stream is what a single job would embed: the package, compressed, checksummed and encrypted as requested
+    size_t size = 0;
+    uint8_t *stream = embed_data_from_file(options->input_file, &size);
+    if (stream == NULL) {
+        LOG(ERROR, "Error reading the input file.")
+        return JOB_ERROR_INPUT;
+    }
+    result->payload_bytes = size;
+    if (options->compression != COMPRESSION_NONE && !compress_package(&stream, &size, options->compression)) {
+        LOG(ERROR, "Error compressing the input file.")
+        mem_free(stream);
+        return JOB_ERROR_INPUT;
+    }
+    if (options->checksum && !checksum_package(&stream, &size, 0)) {
+        LOG(ERROR, "Error splitting the input file in checksummed chunks.")
+        mem_free(stream);
+        return JOB_ERROR_INPUT;
+    }
+    if (options->encryption_algo != ENC_NONE) {
+        double start = get_time_ms();
+        size_t encrypted_size = 0;
+        uint8_t *encrypted = crypto_encrypt_with_kdf(stream, size, options->encryption_algo, options->encryption_mode,
+                                                     options->password, &options->kdf, &encrypted_size);
+        result->crypto_ms = get_time_ms() - start;
+        mem_free(stream);
+        if (encrypted == NULL) {
+            LOG(ERROR, "Error encrypting the data.")
+            return JOB_ERROR_CRYPTO;
+        }
+        stream = encrypted;
+        size = encrypted_size;
+    }
+    result->stored_bytes = size;
+    if (size > UINT32_MAX) {
+        LOG(ERROR, "The payload is too large for a striped job.")
+        mem_free(stream);
+        return JOB_ERROR_INPUT;
+    }
+
+    JobStatus status = run_carriers(pool, carriers, count, load_carrier_task);
+    size_t capacities[STRIPE_MAX_CARRIERS];
+    size_t lengths[STRIPE_MAX_CARRIERS];
+    for (size_t i = 0; i < count; i++) {
+        capacities[i] = carriers[i].capacity;
+    }
+    if (status == JOB_OK && !stripe_plan(capacities, count, size, lengths)) {
+        status = JOB_ERROR_STEG;
+    }
+
+    if (status == JOB_OK) {
+        uint32_t payload_id = fnv1a(stream, size);
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            StripeCarrier *carrier = &carriers[i];
+            carrier->output_path = outputs[i];
+            carrier->stream = stream;
+            carrier->offset = offset;
+            carrier->length = lengths[i];
+            offset += lengths[i];
+
+            // The header is kept in `stripe` until the worker copies it next to the data
+            carrier->stripe = mem_calloc(STRIPE_HEADER_SIZE, 1);
+            if (carrier->stripe == NULL) {
+                status = JOB_ERROR_STEG;
+                break;
+            }
+            memcpy(carrier->stripe, STRIPE_MAGIC, strlen(STRIPE_MAGIC));
+            carrier->stripe[4] = STRIPE_VERSION;
+            store_be16(carrier->stripe + 6, (uint16_t) i);
+            store_be16(carrier->stripe + 8, (uint16_t) count);
+            store_be32(carrier->stripe + 12, payload_id);
+            store_be32(carrier->stripe + 16, (uint32_t) size);
+            store_be32(carrier->stripe + 20, (uint32_t) carrier->offset);
+            LOG(INFO, "[Stripe] %s holds %zu of %zu bytes.", carrier->carrier_path, carrier->length, size)
+        }
+    }
+    if (status == JOB_OK) {
+        status = run_carriers(pool, carriers, count, embed_stripe_task);
+    }
+    mem_free(stream);
+    return status;
+}
+
+/**
+ * @brief Check that the extracted stripes belong to one payload and cover it, and join them.
+ */
+static uint8_t* assemble_stripes(StripeCarrier *carriers, size_t count, size_t *stream_size) {
+    StripeCarrier *ordered[STRIPE_MAX_CARRIERS] = {NULL};
+    const uint8_t *first = carriers[0].stripe;
+    uint32_t payload_id = load_be32(first + 12);
+    size_t size = load_be32(first + 16);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *header = carriers[i].stripe;
+        size_t index = load_be16(header + 6);
+        if (load_be16(header + 8) != count || load_be32(header + 12) != payload_id || load_be32(header + 16) != size ||
+            index >= count || ordered[index] != NULL) {
+            LOG(ERROR, "%s holds a stripe of another payload, or the carriers are incomplete.", carriers[i].carrier_path)
+            return NULL;
+        }
+        ordered[index] = &carriers[i];
+    }
+
+    uint8_t *stream = mem_alloc(size > 0 ? size : 1);
+    if (stream == NULL) {
+        LOG(ERROR, "Memory allocation failed for the striped payload.")
+        return NULL;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = ordered[i]->stripe_size - STRIPE_HEADER_SIZE;
+        if (load_be32(ordered[i]->stripe + 20) != offset || length > size - offset) {
+            LOG(ERROR, "Stripe %zu of %s does not continue the payload.", i, ordered[i]->carrier_path)
+            mem_free(stream);
+            return NULL;
+        }
+        memcpy(stream + offset, ordered[i]->stripe + STRIPE_HEADER_SIZE, length);
+        offset += length;
+    }
+    if (offset != size || fnv1a(stream, size) != payload_id) {
+        LOG(ERROR, "The reassembled payload does not match its id.")
+        mem_free(stream);
+        return NULL;
+    }
+    *stream_size = size;
+    return stream;
+}
+
+static JobStatus extract_stripes(const ProgramOptions *options, ThreadPool *pool, StripeCarrier *carriers, size_t count,
+                                 JobResult *result) {
+    JobStatus status = run_carriers(pool, carriers, count, extract_stripe_task);
+    if (status != JOB_OK) {
+        return status;
+    }
+    size_t size = 0;
+    uint8_t *stream = assemble_stripes(carriers, count, &size);
+    if (stream == NULL) {
+        return JOB_ERROR_STEG;
+    }
+    result->stored_bytes = size;
+
+    FilePackage *package = NULL;
+    if (options->encryption_algo == ENC_NONE) {
+        package = new_file_package_from_buffer(stream, size);
+    } else if (size > sizeof(uint32_t)) {
+        // Like a single carrier, the container keeps its size field, which extraction skips
+        double start = get_time_ms();
+        size_t decrypted_size = 0;
+        uint8_t *decrypted = crypto_decrypt(stream + sizeof(uint32_t), size - sizeof(uint32_t), options->encryption_algo,
+                                            options->encryption_mode, (const uint8_t *) options->password, &decrypted_size);
+        result->crypto_ms = get_time_ms() - start;
+        if (decrypted == NULL) {
+            LOG(ERROR, "Error decrypting the extracted data.")
+            mem_free(stream);
+            return JOB_ERROR_CRYPTO;
+        }
+        package = new_file_package_from_buffer(decrypted, decrypted_size);
+        mem_free(decrypted);
+    }
+    mem_free(stream);
+    if (package == NULL) {
+        LOG(ERROR, "The striped payload is not a valid file.")
+        return options->encryption_algo == ENC_NONE ? JOB_ERROR_STEG : JOB_ERROR_CRYPTO;
+    }
+    if (package_is_checksummed(package) && !verify_file_package(package, pool, !options->verify_all, NULL)) {
+        LOG(ERROR, "The hidden file is damaged.")
+        free_file_package(package);
+        return JOB_ERROR_STEG;
+    }
+
+    double start = get_time_ms();
+    result->payload_bytes = file_package_header_size(package) + package->size + strlen((const char *) package->extension) + 1;
+    int created = package_is_compressed(package) ? create_file_from_compressed_package(options->output_file, package)
+                                                 : create_file_from_package(options->output_file, package);
+    result->write_ms = get_time_ms() - start;
+    free_file_package(package);
+    if (created != 1) {
+        LOG(ERROR, "Error creating the output file.")
+        return JOB_ERROR_OUTPUT;
+    }
+    LOG(INFO, "Output file created successfully.")
+    return JOB_OK;
+}
+
+JobStatus run_striped_job(const ProgramOptions *options, JobResult *result) {
+    JobResult job_result;
+    memset(&job_result, 0, sizeof(JobResult));
+    double start = get_time_ms();
+    job_result.status = JOB_ERROR_ARGUMENTS;
+
+    char *carrier_list = options != NULL && options->input_bmp_file != NULL ? strdup(options->input_bmp_file) : NULL;
+    char *output_list = options != NULL && options->output_file != NULL ? strdup(options->output_file) : NULL;
+    char *carrier_paths[STRIPE_MAX_CARRIERS];
+    char *output_paths[STRIPE_MAX_CARRIERS];
+    size_t count = carrier_list != NULL ? split_list(carrier_list, carrier_paths, STRIPE_MAX_CARRIERS) : 0;
+    size_t outputs = output_list != NULL ? split_list(output_list, output_paths, STRIPE_MAX_CARRIERS) : 0;
+    bool embedding = options != NULL && options->mode == MODE_EMBED;
+
+    StripeCarrier *carriers = NULL;
+    ThreadPool *pool = NULL;
+    if (count == 0 || (embedding && outputs != count)) {
+        LOG(ERROR, "A striped job needs up to %d carriers%s.", STRIPE_MAX_CARRIERS, embedding ? " and one output per carrier" : "")
+    } else {
+        // One worker per carrier, so every carrier is read, embedded and written concurrently
+        carriers = calloc(count, sizeof(StripeCarrier));
+        pool = carriers != NULL ? thread_pool_create(count, options->pin_cpus) : NULL;
+        if (pool == NULL) {
+            LOG(ERROR, "Could not start the striped job.")
+        }
+    }
+
+    if (pool != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            carriers[i].options = options;
+            carriers[i].carrier_path = carrier_paths[i];
+            carriers[i].index = i;
+            carriers[i].status = JOB_OK;
+        }
+        if (embedding) {
+            LOG(INFO, "Striping the payload over %zu carriers.", count)
+            job_result.status = embed_stripes(options, pool, carriers, count, output_paths, &job_result);
+        } else {
+            LOG(INFO, "Extracting a payload striped over %zu carriers.", count)
+            job_result.status = extract_stripes(options, pool, carriers, count, &job_result);
+        }
+        thread_pool_destroy(pool);
+
+        // Carriers were processed in parallel, so the slowest one sets the stage time
+        for (size_t i = 0; i < count; i++) {
+            job_result.load_ms = carriers[i].load_ms > job_result.load_ms ? carriers[i].load_ms : job_result.load_ms;
+            job_result.steg_ms = carriers[i].steg_ms > job_result.steg_ms ? carriers[i].steg_ms : job_result.steg_ms;
+            if (embedding) {
+                job_result.write_ms = carriers[i].write_ms > job_result.write_ms ? carriers[i].write_ms : job_result.write_ms;
+            }
+            free_bmp(carriers[i].bmp);
+            mem_free(carriers[i].stripe);
+        }
+    }
+    free(carriers);
+    free(carrier_list);
+    free(output_list);
+
+    job_result.total_ms = get_time_ms() - start;
+    if (result != NULL) {
+        *result = job_result;
+    }
+    return job_result.status;
+}
@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include "./include/thread_pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include "./include/logger.h"
+
+#define DEQUE_INITIAL_CAPACITY 64   // Initial number of slots of a worker deque (grows on demand)
+
+typedef struct {
+    ThreadPoolTask task;
+    void *arg;
+    TaskGroup *group;
+} PoolTask;
+
+typedef struct {
+    ThreadPool *pool;
+    size_t index;
+    pthread_t thread;
+    bool started;
+    pthread_mutex_t lock;       // Guards the deque
+    PoolTask *tasks;            // Ring buffer: the top is at `head`, the bottom at `head + count - 1`
+    size_t head;
+    size_t count;
+    size_t capacity;
+    ThreadPoolWorkerStats stats; // Guarded by the pool lock
+} Worker;
+
+struct ThreadPool {
+    Worker *workers;
+    size_t size;
+    pthread_mutex_t lock;           // Guards queued, stopping, next_worker, the stats and the group counters
+    pthread_cond_t work_available;  // Signaled when a task is queued, broadcast when a group finishes
+    pthread_cond_t group_done;      // Broadcast when a group finishes, for waiters outside the pool
+    long queued;                    // Tasks sitting in the deques (briefly negative while a submit is in flight)
+    size_t next_worker;             // Round robin for tasks submitted from outside the pool
+    bool stopping;
+};
+
+// Worker running on the calling thread, if any
+static __thread Worker *current_worker = NULL;
+
+static bool deque_push_bottom(Worker *worker, const PoolTask *task) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count == worker->capacity) {
+        size_t capacity = worker->capacity ? worker->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+        PoolTask *tasks = malloc(capacity * sizeof(PoolTask));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&worker->lock);
+            return false;
+        }
+        for (size_t i = 0; i < worker->count; i++) {
+            tasks[i] = worker->tasks[(worker->head + i) % worker->capacity];
+        }
+        free(worker->tasks);
+        worker->tasks = tasks;
+        worker->capacity = capacity;
+        worker->head = 0;
+    }
+    worker->tasks[(worker->head + worker->count) % worker->capacity] = *task;
+    worker->count++;
+    pthread_mutex_unlock(&worker->lock);
+    return true;
+}
+
+static bool deque_pop_bottom(Worker *worker, PoolTask *task) {
+    pthread_mutex_lock(&worker->lock);
+    bool found = worker->count > 0;
+    if (found) {
+        worker->count--;
+        *task = worker->tasks[(worker->head + worker->count) % worker->capacity];
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+static bool deque_steal_top(Worker *worker, PoolTask *task) {
+    pthread_mutex_lock(&worker->lock);
+    bool found = worker->count > 0;
+    if (found) {
+        *task = worker->tasks[worker->head];
+        worker->head = (worker->head + 1) % worker->capacity;
+        worker->count--;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+/**
+ * @brief Take a task for `self`: the newest one of its own deque, or the oldest one of another worker.
+ */
+static bool take_task(ThreadPool *pool, Worker *self, PoolTask *task) {
+    bool stolen = false;
+    bool found = deque_pop_bottom(self, task);
+    for (size_t i = 1; !found && i < pool->size; i++) {
+        found = deque_steal_top(&pool->workers[(self->index + i) % pool->size], task);
+        stolen = found;
+    }
+    if (found) {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        if (stolen) {
+            self->stats.stolen++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+static void run_task(ThreadPool *pool, Worker *self, const PoolTask *task) {
+    task->task(task->arg);
+
+    pthread_mutex_lock(&pool->lock);
+    self->stats.executed++;
+    if (task->group != NULL && --task->group->pending == 0) {
+        pthread_cond_broadcast(&pool->group_done);
+        pthread_cond_broadcast(&pool->work_available);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *worker_main(void *arg) {
+    Worker *self = arg;
+    ThreadPool *pool = self->pool;
+    current_worker = self;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->queued <= 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+        if (pool->queued <= 0) {
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        PoolTask task;
+        if (take_task(pool, self, &task)) {
+            run_task(pool, self, &task);
+        } else {
+            // Another worker took the task between the count and the deque
+            sched_yield();
+        }
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief Pin a worker to the index-th CPU allowed for the process.
+ */
+static void pin_worker(Worker *worker) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+    size_t target = worker->index % (size_t) CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- != 0) {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(worker->thread, sizeof(set), &set) != 0) {
+            LOG(DEBUG, "[Pool] Could not pin worker %zu to CPU %d.", worker->index, cpu)
+        }
+        return;
+    }
+#else
+    (void) worker;
+#endif
+}
+
+size_t thread_pool_default_size(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t) cpus : 1;
+}
+
+ThreadPool* thread_pool_create(size_t workers, bool pin_cpus) {
+    if (workers == 0) {
+        workers = thread_pool_default_size();
+    }
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) {
+        LOG(ERROR, "Memory allocation failed for the thread pool.")
+        return NULL;
+    }
+    pool->workers = calloc(workers, sizeof(Worker));
+    if (pool->workers == NULL) {
+        LOG(ERROR, "Memory allocation failed for the thread pool workers.")
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->group_done, NULL);
+    for (size_t i = 0; i < workers; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pthread_mutex_init(&pool->workers[i].lock, NULL);
+    }
+
+    // Workers only look at `size` deques, so it is set before starting them
+    pool->size = workers;
+    size_t started = 0;
+    for (size_t i = 0; i < workers; i++) {
+        Worker *worker = &pool->workers[i];
+        worker->started = pthread_create(&worker->thread, NULL, worker_main, worker) == 0;
+        if (!worker->started) {
+            LOG(WARNING, "[Pool] Could not start worker %zu.", i)
+            continue;
+        }
+        started++;
+        if (pin_cpus) {
+            pin_worker(worker);
+        }
+    }
+    if (started == 0) {
+        LOG(ERROR, "Could not start any thread pool worker.")
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+    LOG(DEBUG, "[Pool] Started %zu workers%s.", started, pin_cpus ? " pinned to CPUs" : "")
+    return pool;
+}
+
+bool thread_pool_submit(ThreadPool *pool, size_t worker, TaskGroup *group, ThreadPoolTask task, void *arg) {
+    if (pool == NULL || task == NULL) {
+        return false;
+    }
+    PoolTask pool_task = {task, arg, group};
+
+    pthread_mutex_lock(&pool->lock);
+    Worker *target;
+    if (current_worker != NULL && current_worker->pool == pool) {
+        target = current_worker;
+    } else {
+        target = &pool->workers[worker < pool->size ? worker : pool->next_worker++ % pool->size];
+    }
+    if (group != NULL) {
+        group->pending++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    bool pushed = deque_push_bottom(target, &pool_task);
+
+    pthread_mutex_lock(&pool->lock);
+    if (pushed) {
+        pool->queued++;
+        pthread_cond_signal(&pool->work_available);
+    } else if (group != NULL && --group->pending == 0) {
+        pthread_cond_broadcast(&pool->group_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!pushed) {
+        LOG(ERROR, "Memory allocation failed for a thread pool task.")
+    }
+    return pushed;
+}
+
+void thread_pool_wait(ThreadPool *pool, TaskGroup *group) {
+    if (pool == NULL || group == NULL) {
+        return;
+    }
+    Worker *self = current_worker != NULL && current_worker->pool == pool ? current_worker : NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    while (group->pending > 0) {
+        if (self == NULL) {
+            pthread_cond_wait(&pool->group_done, &pool->lock);
+            continue;
+        }
+        if (pool->queued <= 0) {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+            continue;
+        }
+
+        // Help instead of blocking: the tasks of the group may be waiting in our own deque
+        pthread_mutex_unlock(&pool->lock);
+        PoolTask task;
+        if (take_task(pool, self, &task)) {
+            run_task(pool, self, &task);
+        } else {
+            sched_yield();
+        }
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->size; i++) {
+        if (pool->workers[i].started) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+    for (size_t i = 0; i < pool->size; i++) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].tasks);
+    }
+    pthread_cond_destroy(&pool->group_done);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+size_t thread_pool_size(const ThreadPool *pool) {
+    return pool != NULL ? pool->size : 0;
+}
+
+size_t thread_pool_current_worker(const ThreadPool *pool) {
+    if (pool == NULL || current_worker == NULL || current_worker->pool != pool) {
+        return THREAD_POOL_ANY_WORKER;
+    }
+    return current_worker->index;
+}
+
+void thread_pool_stats(ThreadPool *pool, ThreadPoolWorkerStats *stats) {
+    if (pool == NULL || stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    for (size_t i = 0; i < pool->size; i++) {
+        stats[i] = pool->workers[i].stats;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
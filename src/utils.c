@@ -1,5 +1,7 @@
 #include "utils.h"
 #include "logger.h"
+#include "allocator.h"
+#include <time.h>
 
 
 /**
@@ -57,7 +59,7 @@ size_t get_file_size(FILE *file) {
  *
  * @param file_name Nombre del archivo.
  * @return uint8_t* Cadena duplicada con la extensión del archivo (incluyendo el punto), o NULL si no se encuentra una extensión válida.
- *                 El llamante es responsable de liberar la memoria.
+ *                 El llamante es responsable de liberarla con mem_free.
  */
 uint8_t* get_file_extension(const char *file_name) {
     if (file_name == NULL) {
@@ -77,5 +79,11 @@ uint8_t* get_file_extension(const char *file_name) {
         return NULL;
     }
 
-    return (uint8_t*) strdup(dot);
-}
\ No newline at end of file
+    return (uint8_t*) mem_strdup(dot);
+}
+
+double get_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "../src/include/allocator.h"
+#include "../src/include/logger.h"
+
+typedef struct {
+    size_t allocations;
+    size_t releases;
+} ParentCounter;
+
+static void *counting_allocate(size_t size, void *user_data) {
+    ((ParentCounter *) user_data)->allocations++;
+    return malloc(size);
+}
+
+static void counting_release(void *ptr, void *user_data) {
+    ((ParentCounter *) user_data)->releases++;
+    free(ptr);
+}
+
+/**
+ * @brief Los bloques chicos salen del mismo chunk, alineados, y el último se puede devolver.
+ */
+void test_arena_small_blocks() {
+    ParentCounter counter = {0, 0};
+    Allocator parent = {counting_allocate, NULL, counting_release, &counter};
+    Arena arena;
+    arena_init(&arena, &parent);
+    assert(counter.allocations == 0);
+
+    const Allocator *saved = NULL;
+    allocator_scope_enter(&arena.allocator, &saved);
+    uint8_t *blocks[100];
+    for (int i = 0; i < 100; i++) {
+        blocks[i] = mem_alloc(i + 1);
+        assert(blocks[i] != NULL);
+        assert((uintptr_t) blocks[i] % _Alignof(max_align_t) == 0);
+        memset(blocks[i], i, i + 1);
+    }
+    assert(counter.allocations == 1);
+    for (int i = 0; i < 100; i++) {
+        assert(blocks[i][i] == i);
+    }
+
+    // Liberar el último bloque devuelve su espacio
+    uint8_t *last = mem_alloc(32);
+    mem_free(last);
+    assert(mem_alloc(32) == last);
+
+    uint8_t *zeroed = mem_calloc(16, 4);
+    for (int i = 0; i < 64; i++) {
+        assert(zeroed[i] == 0);
+    }
+    char *copy = mem_strdup(".txt");
+    assert(strcmp(copy, ".txt") == 0);
+    allocator_scope_exit(saved);
+
+    arena_destroy(&arena);
+    assert(counter.releases == counter.allocations);
+    printf("test_arena_small_blocks passed.\n");
+}
+
+/**
+ * @brief Los bloques grandes tienen su propio chunk y vuelven al padre al liberarlos.
+ */
+void test_arena_large_blocks() {
+    ParentCounter counter = {0, 0};
+    Allocator parent = {counting_allocate, NULL, counting_release, &counter};
+    Arena arena;
+    arena_init(&arena, &parent);
+
+    const Allocator *saved = NULL;
+    allocator_scope_enter(&arena.allocator, &saved);
+    uint8_t *small = mem_alloc(100);
+    uint8_t *large = mem_alloc(4 * ARENA_CHUNK_SIZE);
+    memset(large, 0xAB, 4 * ARENA_CHUNK_SIZE);
+    assert(counter.allocations == 2);
+    mem_free(large);
+    assert(counter.releases == 1);
+
+    // Los bloques chicos siguen saliendo del chunk actual
+    uint8_t *next = mem_alloc(100);
+    assert(next > small && next < small + ARENA_CHUNK_SIZE);
+    assert(counter.allocations == 2);
+    allocator_scope_exit(saved);
+
+    arena_destroy(&arena);
+    assert(counter.releases == counter.allocations);
+    printf("test_arena_large_blocks passed.\n");
+}
+
+/**
+ * @brief realloc crece en el lugar cuando es el último bloque y copia en otro caso.
+ */
+void test_arena_realloc() {
+    Arena arena;
+    arena_init(&arena, NULL);
+    const Allocator *saved = NULL;
+    allocator_scope_enter(&arena.allocator, &saved);
+
+    uint8_t *grown = mem_alloc(16);
+    memcpy(grown, "0123456789abcdef", 16);
+    assert(mem_realloc(grown, 256) == grown);
+
+    uint8_t *other = mem_alloc(16);
+    uint8_t *moved = mem_realloc(grown, 512);
+    assert(moved != grown && moved != other);
+    assert(memcmp(moved, "0123456789abcdef", 16) == 0);
+
+    uint8_t *large = mem_realloc(moved, 2 * ARENA_CHUNK_SIZE);
+    assert(memcmp(large, "0123456789abcdef", 16) == 0);
+    allocator_scope_exit(saved);
+    arena_destroy(&arena);
+    printf("test_arena_realloc passed.\n");
+}
+
+/**
+ * @brief Memoria pedida fuera del ámbito se libera con el padre, y los ámbitos se anidan.
+ */
+void test_allocator_scopes() {
+    uint8_t *outside = mem_alloc(64);
+    ParentCounter counter = {0, 0};
+    Allocator parent = {counting_allocate, NULL, counting_release, &counter};
+    Arena arena;
+    arena_init(&arena, &parent);
+
+    const Allocator *saved = NULL;
+    allocator_scope_enter(&arena.allocator, &saved);
+    assert(saved == NULL);
+    const Allocator *inner = NULL;
+    allocator_scope_enter(NULL, &inner);
+    uint8_t *system = mem_alloc(64);
+    allocator_scope_exit(inner);
+    assert(counter.allocations == 0);
+
+    // El padre recibe los punteros que la arena no conoce
+    counter.releases = 0;
+    free(system);
+    uint8_t *copy = malloc(8);
+    mem_free(copy);
+    assert(counter.releases == 1);
+    allocator_scope_exit(saved);
+
+    mem_free(outside);
+    arena_destroy(&arena);
+    printf("test_allocator_scopes passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    test_arena_small_blocks();
+    test_arena_large_blocks();
+    test_arena_realloc();
+    test_allocator_scopes();
+    printf("Todos los tests del allocator pasaron exitosamente.\n");
+    return 0;
+}
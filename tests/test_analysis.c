@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+#include "../src/include/analysis.h"
+#include "../src/include/arguments.h"
+#include "../src/include/stego_bmp.h"
+#include "test_utils.c"
+
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define STEGO_PATH "test_analysis.bmp"
+#define REPORT_PATH "test_analysis_report.tsv"
+
+/**
+ * @brief Oculta bytes pseudoaleatorios con LSB1 en la fracción `share` de los componentes de la imagen.
+ */
+static void embed_random(BMPImage *bmp, double share) {
+    size_t size = (size_t) ((double) (bmp->width * bmp->height * 3) * share) / 8;
+    uint8_t *data = malloc(size);
+    assert(data != NULL);
+    uint32_t state = 2463534242u;
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = (uint8_t) state;
+    }
+    assert(embed_at_component(bmp, data, size, 0, STEG_LSB1));
+    free(data);
+}
+
+static void analyze(BMPImage *bmp, ThreadPool *pool, ImageAnalysis *analysis) {
+    assert(analyze_image(bmp, pool, analysis));
+    assert(analysis->samples == bmp->width * bmp->height);
+}
+
+/**
+ * @brief Una imagen natural sin nada oculto da tasas bajas en los tres canales.
+ */
+void test_clean_image() {
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(bmp != NULL);
+    ImageAnalysis analysis;
+    analyze(bmp, NULL, &analysis);
+    for (size_t channel = 0; channel < 3; channel++) {
+        const ChannelAnalysis *stats = &analysis.channels[channel];
+        uint64_t total = 0;
+        for (size_t value = 0; value < 256; value++) {
+            total += stats->histogram[value];
+        }
+        assert(total == analysis.samples);
+        assert(stats->groups == (bmp->width / 4) * bmp->height);
+        assert(stats->chi_square_p < ANALYSIS_CHI_SQUARE_THRESHOLD && stats->chi_square_rate < 0.05);
+        assert(stats->rs_rate < 0.1);
+    }
+    free_bmp(bmp);
+    printf("test_clean_image passed.\n");
+}
+
+/**
+ * @brief Con LSB1 en toda la imagen las dos estimaciones se acercan a 1, y con la mitad RS se acerca a 0.5.
+ */
+void test_embedded_image() {
+    double shares[] = {1.0, 0.5};
+    for (size_t i = 0; i < 2; i++) {
+        BMPImage *bmp = new_bmp_file(CARRIER);
+        assert(bmp != NULL);
+        embed_random(bmp, shares[i]);
+        ImageAnalysis analysis;
+        analyze(bmp, NULL, &analysis);
+        for (size_t channel = 0; channel < 3; channel++) {
+            const ChannelAnalysis *stats = &analysis.channels[channel];
+            // La segunda mitad de lado.bmp ya tiene los pares parejos: chi-cuadrado solo acota desde abajo
+            assert(stats->chi_square_rate > shares[i] - 0.05 && fabs(stats->rs_rate - shares[i]) < 0.15);
+        }
+        assert(i == 1 || analysis.channels[GREEN].chi_square_p > 0.99);
+        free_bmp(bmp);
+    }
+
+    // Con solo valores pares lo limpio nunca es parejo, y chi-cuadrado encuentra dónde termina lo oculto
+    BMPImage *bmp = create_test_bmp(200, 200, 0x00);
+    assert(bmp != NULL);
+    uint32_t state = 88172645u;
+    for (size_t i = 0; i < bmp->data_size; i++) {
+        state = state * 1664525u + 1013904223u;
+        bmp->data[i] = (uint8_t) (state >> 24) & 0xFE;
+    }
+    embed_random(bmp, 0.5);
+    ImageAnalysis analysis;
+    analyze(bmp, NULL, &analysis);
+    for (size_t channel = 0; channel < 3; channel++) {
+        assert(fabs(analysis.channels[channel].chi_square_rate - 0.5) < 0.05);
+        assert(analysis.channels[channel].chi_square_p < 0.01);
+    }
+    free_bmp(bmp);
+    printf("test_embedded_image passed.\n");
+}
+
+/**
+ * @brief El padding no se cuenta, y el resultado no depende del pool ni de la carga diferida.
+ */
+void test_padding_and_threads() {
+    // 21 píxeles por fila: 63 bytes y un byte de padding, y un grupo RS incompleto al final
+    BMPImage *bmp = create_test_bmp(21, 300, 0x00);
+    assert(bmp != NULL);
+    size_t row_size = (21 * 3 + 3) & ~3;
+    for (size_t i = 0; i < bmp->data_size; i++) {
+        bmp->data[i] = (uint8_t) ((i % row_size) * 7 + i / row_size);
+    }
+    ImageAnalysis reference, analysis;
+    analyze(bmp, NULL, &reference);
+    for (size_t row = 0; row < bmp->height; row++) {
+        bmp->data[row * row_size + row_size - 1] = 0xAB;
+    }
+    analyze(bmp, NULL, &analysis);
+    assert(memcmp(&reference.channels, &analysis.channels, sizeof(reference.channels)) == 0);
+    assert(reference.channels[BLUE].groups == 5 * 300);
+
+    ThreadPool *pool = thread_pool_create(3, false);
+    analyze(bmp, pool, &analysis);
+    assert(memcmp(&reference.channels, &analysis.channels, sizeof(reference.channels)) == 0);
+    thread_pool_destroy(pool);
+    free_bmp(bmp);
+
+    // Con menos de cuatro píxeles por fila no hay grupos para RS
+    bmp = create_test_bmp(3, 10, 0x10);
+    assert(bmp != NULL);
+    analyze(bmp, NULL, &analysis);
+    assert(analysis.channels[RED].groups == 0 && isnan(analysis.channels[RED].rs_rate));
+    free_bmp(bmp);
+
+    bmp = new_bmp_file(CARRIER);
+    assert(bmp != NULL);
+    embed_random(bmp, 0.3);
+    assert(save_bmp_file(STEGO_PATH, bmp) == 0);
+    analyze(bmp, NULL, &reference);
+    free_bmp(bmp);
+    bmp = new_bmp_file_lazy(STEGO_PATH);
+    assert(bmp != NULL);
+    pool = thread_pool_create(2, false);
+    analyze(bmp, pool, &analysis);
+    thread_pool_destroy(pool);
+    free_bmp(bmp);
+    assert(memcmp(&reference.channels, &analysis.channels, sizeof(reference.channels)) == 0);
+    printf("test_padding_and_threads passed.\n");
+}
+
+/**
+ * @brief -analyze solo necesita -p y escribe una línea por canal.
+ */
+void test_analysis_report() {
+    AnalysisSettings settings = {2, false};
+    assert(run_analysis(STEGO_PATH, REPORT_PATH, &settings) == 0);
+    FILE *report = fopen(REPORT_PATH, "r");
+    assert(report != NULL);
+    char line[256];
+    const char *channels[] = {"blue\t", "green\t", "red\t"};
+    assert(fgets(line, sizeof(line), report) != NULL && line[0] == '#');
+    for (size_t i = 0; i < 3; i++) {
+        assert(fgets(line, sizeof(line), report) != NULL && strncmp(line, channels[i], strlen(channels[i])) == 0);
+    }
+    assert(fgets(line, sizeof(line), report) != NULL && line[0] == '#');
+    fclose(report);
+    remove(REPORT_PATH);
+    assert(run_analysis("test_analysis_missing.bmp", REPORT_PATH, &settings) == -1 && access(REPORT_PATH, F_OK) != 0);
+
+    ProgramOptions options;
+    char *argv[] = {"stegobmp", "-analyze", "-p", STEGO_PATH, "-jobs", "2"};
+    optind = 1;
+    assert(parse_arguments(6, argv, &options) == 1);
+    assert(options.mode == MODE_ANALYZE && strcmp(options.input_bmp_file, STEGO_PATH) == 0 && options.jobs == 2);
+    optind = 1;
+    assert(parse_arguments(2, argv, &options) == 0);
+    remove(STEGO_PATH);
+    printf("test_analysis_report passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+
+    test_clean_image();
+    test_embedded_image();
+    test_padding_and_threads();
+    test_analysis_report();
+
+    printf("Todos los tests de análisis pasaron exitosamente.\n");
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/include/archive.h"
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "test_utils.c"
+
+#define ARCHIVE_DIR "test_archive_in"
+#define OUTPUT_DIR "test_archive_out"
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define STEGO_PATH "test_archive.bmp"
+#define MEMBER_COUNT 4
+
+static const char *names[MEMBER_COUNT] = {"a.txt", "b.bin", "c.txt", "vacio"};
+static const size_t sizes[MEMBER_COUNT] = {30000, 4000, 50000, 0};
+
+/**
+ * @brief Contenido del archivo `i` de prueba. Los .txt se comprimen bien, b.bin no.
+ */
+static uint8_t member_byte(size_t i, size_t position) {
+    if (i == 1) {
+        uint64_t x = (position + 1) * 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        return (uint8_t) (x ^ (x >> 31));
+    }
+    return (uint8_t) ('a' + (position / 7 + i) % 26);
+}
+
+static void write_member(const char *directory, size_t i) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    for (size_t position = 0; position < sizes[i]; position++) {
+        fputc(member_byte(i, position), file);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Verifica que `directory/names[i]` tenga el contenido original.
+ */
+static bool member_matches(const char *directory, size_t i) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    bool same = true;
+    size_t position = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        same = same && position < sizes[i] && c == member_byte(i, position);
+        position++;
+    }
+    fclose(file);
+    return same && position == sizes[i];
+}
+
+static void remove_directory(const char *directory) {
+    char path[256];
+    for (size_t i = 0; i < MEMBER_COUNT; i++) {
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        remove(path);
+    }
+    rmdir(directory);
+}
+
+/**
+ * @brief El índice describe cada archivo del directorio, ordenado por nombre; los subdirectorios
+ * se ignoran. Un índice con un nombre que sale del directorio o un miembro fuera del archivo se rechaza.
+ */
+void test_archive_index() {
+    CompressionAlgorithm compressions[] = {COMPRESSION_NONE, COMPRESSION_DEFLATE};
+    for (size_t c = 0; c < 2; c++) {
+        size_t size = 0;
+        uint8_t *archive = archive_build(ARCHIVE_DIR, compressions[c], NULL, &size);
+        assert(archive != NULL);
+        size_t count = 0, index_size = 0;
+        assert(archive_parse_header(archive, &count, &index_size));
+        assert(count == MEMBER_COUNT);
+        ArchiveEntry *entries = archive_parse_index(archive + ARCHIVE_HEADER_SIZE, index_size, count, size);
+        assert(entries != NULL);
+        for (size_t i = 0; i < MEMBER_COUNT; i++) {
+            assert(strcmp(entries[i].name, names[i]) == 0 && entries[i].size == sizes[i]);
+            bool compressed = (entries[i].flags & ARCHIVE_FLAG_COMPRESSED) != 0;
+            // Solo se comprimen los que se achican
+            assert(compressed == (c == 1 && i != 1 && sizes[i] > 0));
+            assert(compressed ? entries[i].stored_size < sizes[i] : entries[i].stored_size == sizes[i]);
+        }
+        mem_free(entries);
+
+        // El nombre del primer miembro pasa a "../.."
+        memcpy(archive + ARCHIVE_HEADER_SIZE + ARCHIVE_ENTRY_SIZE, "../..", 5);
+        assert(archive_parse_index(archive + ARCHIVE_HEADER_SIZE, index_size, count, size) == NULL);
+        assert(archive_parse_index(archive + ARCHIVE_HEADER_SIZE, index_size, count, size / 2) == NULL);
+        assert(archive_parse_index(archive + ARCHIVE_HEADER_SIZE, index_size - 1, count, size) == NULL);
+        archive[0] = 'X';
+        assert(!archive_parse_header(archive, &count, &index_size));
+        mem_free(archive);
+    }
+    assert(archive_build("test_archive_missing", COMPRESSION_NONE, NULL, &(size_t){0}) == NULL);
+    printf("test_archive_index passed.\n");
+}
+
+/**
+ * @brief Un directorio se oculta en un portador y se recupera completo o por miembros, con y sin
+ * compresión y cifrado.
+ */
+void test_archive_round_trip() {
+    const char *compressions[] = {NULL, "deflate"};
+    const char *passwords[] = {NULL, "clave"};
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t p = 0; p < 2; p++) {
+            ProgramOptions options;
+            char *embed_argv[17] = {"stegobmp", "-embed", "-archive", "-in", ARCHIVE_DIR, "-p", CARRIER, "-out", STEGO_PATH,
+                                    "-steg", "LSB4", "-jobs", "3"};
+            int embed_argc = 13;
+            if (passwords[p] != NULL) {
+                embed_argv[embed_argc++] = "-pass";
+                embed_argv[embed_argc++] = (char *) passwords[p];
+            }
+            if (compressions[c] != NULL) {
+                embed_argv[embed_argc++] = "-compress";
+                embed_argv[embed_argc++] = (char *) compressions[c];
+            }
+            assert(parse_test_arguments(&options, embed_argc, embed_argv) == 1);
+            JobResult result;
+            assert(run_archive_job(&options, &result) == JOB_OK);
+            assert(result.status == JOB_OK && result.stored_bytes > 0);
+
+            char *extract_argv[] = {"stegobmp", "-extract", "-archive", "-p", STEGO_PATH, "-out", OUTPUT_DIR, "-steg", "LSB4",
+                                    "-jobs", "3", "-pass", (char *) passwords[p]};
+            assert(parse_test_arguments(&options, passwords[p] != NULL ? 13 : 11, extract_argv) == 1);
+            assert(run_archive_job(&options, &result) == JOB_OK);
+            for (size_t i = 0; i < MEMBER_COUNT; i++) {
+                assert(member_matches(OUTPUT_DIR, i));
+            }
+            remove_directory(OUTPUT_DIR);
+
+            char *member_argv[] = {"stegobmp", "-extract", "-archive", "-p", STEGO_PATH, "-out", OUTPUT_DIR, "-steg", "LSB4",
+                                   "-member", "c.txt,vacio", "-pass", (char *) passwords[p]};
+            assert(parse_test_arguments(&options, passwords[p] != NULL ? 13 : 11, member_argv) == 1);
+            assert(run_archive_job(&options, &result) == JOB_OK);
+            assert(!member_matches(OUTPUT_DIR, 0) && !member_matches(OUTPUT_DIR, 1));
+            assert(member_matches(OUTPUT_DIR, 2) && member_matches(OUTPUT_DIR, 3));
+            remove_directory(OUTPUT_DIR);
+
+            member_argv[10] = "c.txt,falta";
+            assert(parse_test_arguments(&options, passwords[p] != NULL ? 13 : 11, member_argv) == 1);
+            assert(run_archive_job(&options, NULL) == JOB_ERROR_ARGUMENTS);
+            assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+        }
+    }
+
+    // Un portador con un archivo común no tiene índice
+    ProgramOptions options;
+    char *plain_argv[] = {"stegobmp", "-extract", "-archive", "-p", IMG_BASE_PATH "ladoLSB4.bmp", "-out", OUTPUT_DIR, "-steg", "LSB4"};
+    assert(parse_test_arguments(&options, 9, plain_argv) == 1);
+    assert(run_archive_job(&options, NULL) == JOB_ERROR_STEG);
+    remove_directory(OUTPUT_DIR);
+    remove(STEGO_PATH);
+    printf("test_archive_round_trip passed.\n");
+}
+
+/**
+ * @brief Un miembro alterado en el portador no pasa la verificación del CRC.
+ */
+void test_archive_corrupted_member() {
+    size_t size = 0;
+    uint8_t *archive = archive_build(ARCHIVE_DIR, COMPRESSION_NONE, NULL, &size);
+    assert(archive != NULL);
+    size_t count = 0, index_size = 0;
+    assert(archive_parse_header(archive, &count, &index_size));
+    ArchiveEntry *entries = archive_parse_index(archive + ARCHIVE_HEADER_SIZE, index_size, count, size);
+    assert(entries != NULL);
+    archive[entries[2].offset + 100] ^= 0x01;
+
+    size_t package_size = 0;
+    uint8_t *package = embed_data_from_buffer(archive, size, ARCHIVE_EXTENSION, &package_size);
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(package != NULL && bmp != NULL && embed(bmp, package, package_size, STEG_LSB4));
+    assert(save_bmp_file(STEGO_PATH, bmp) == 0);
+
+    ProgramOptions options;
+    char *extract_argv[] = {"stegobmp", "-extract", "-archive", "-p", STEGO_PATH, "-out", OUTPUT_DIR, "-steg", "LSB4", "-member", "c.txt"};
+    assert(parse_test_arguments(&options, 11, extract_argv) == 1);
+    assert(run_archive_job(&options, NULL) == JOB_ERROR_STEG);
+    assert(!member_matches(OUTPUT_DIR, 2));
+    extract_argv[10] = "a.txt";
+    assert(parse_test_arguments(&options, 11, extract_argv) == 1);
+    assert(run_archive_job(&options, NULL) == JOB_OK);
+    assert(member_matches(OUTPUT_DIR, 0));
+
+    remove_directory(OUTPUT_DIR);
+    remove(STEGO_PATH);
+    free_bmp(bmp);
+    mem_free(package);
+    mem_free(entries);
+    mem_free(archive);
+    printf("test_archive_corrupted_member passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+    mkdir(ARCHIVE_DIR, 0755);
+    mkdir(ARCHIVE_DIR "/sub", 0755);
+    for (size_t i = 0; i < MEMBER_COUNT; i++) {
+        write_member(ARCHIVE_DIR, i);
+    }
+
+    test_archive_index();
+    test_archive_round_trip();
+    test_archive_corrupted_member();
+
+    rmdir(ARCHIVE_DIR "/sub");
+    remove_directory(ARCHIVE_DIR);
+    crypto_cleanup();
+    printf("Todos los tests de archivos múltiples pasaron exitosamente.\n");
+    return 0;
+}
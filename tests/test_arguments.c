@@ -292,6 +292,178 @@ void test_optional_only_pass(){
     print_test_result("test_optional_only_pass");
 }
 
+/**
+ * @brief Test case for the key derivation options and the KDF benchmark mode.
+ */
+void test_parse_kdf_arguments() {
+    char *argv[] = {
+            "stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp",
+            "-out", "output.bmp", "-steg", "LSB1", "-pass", "oculto", "-kdf-n", "32768"
+    };
+    int argc = sizeof(argv) / sizeof(char*);
+
+    ProgramOptions options;
+    optind = 1;  // Reiniciar optind antes de cada test
+    assert(parse_arguments(argc, argv, &options) == 1);
+    assert(options.kdf.algorithm == KDF_SCRYPT);
+    assert(options.kdf.scrypt_n == 32768);
+    assert(options.kdf.iterations == 0);
+
+    // N must be a power of two
+    char *bad_n[] = {
+            "stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp",
+            "-out", "output.bmp", "-steg", "LSB1", "-pass", "oculto", "-kdf", "scrypt", "-kdf-n", "1000"
+    };
+    optind = 1;
+    assert(parse_arguments(sizeof(bad_n) / sizeof(char*), bad_n, &options) == 0);
+
+    // Values extraction would reject in the container header are rejected up front
+    char *limits[][2] = {{"-kdf-iter", "100000001"}, {"-kdf-n", "8388608"}, {"-kdf-r", "65536"}, {"-kdf-p", "4294967295"}};
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        char *too_large[] = {
+                "stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp",
+                "-out", "output.bmp", "-steg", "LSB1", "-pass", "oculto", limits[i][0], limits[i][1]
+        };
+        optind = 1;
+        assert(parse_arguments(sizeof(too_large) / sizeof(char*), too_large, &options) == 0);
+    }
+    char *large_rp[] = {
+            "stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp",
+            "-out", "output.bmp", "-steg", "LSB1", "-pass", "oculto", "-kdf-r", "256", "-kdf-p", "256"
+    };
+    optind = 1;
+    assert(parse_arguments(sizeof(large_rp) / sizeof(char*), large_rp, &options) == 0);
+    large_rp[15] = "255";
+    optind = 1;
+    assert(parse_arguments(sizeof(large_rp) / sizeof(char*), large_rp, &options) == 1);
+    assert(options.kdf.scrypt_r == 256 && options.kdf.scrypt_p == 255);
+
+    // Iterations do not apply to scrypt
+    char *mismatch[] = {
+            "stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp",
+            "-out", "output.bmp", "-steg", "LSB1", "-pass", "oculto", "-kdf", "scrypt", "-kdf-iter", "5000"
+    };
+    optind = 1;
+    assert(parse_arguments(sizeof(mismatch) / sizeof(char*), mismatch, &options) == 0);
+
+    // The benchmark does not need files
+    char *bench[] = {"stegobmp", "-kdf-bench", "-kdf-target", "100"};
+    optind = 1;
+    assert(parse_arguments(sizeof(bench) / sizeof(char*), bench, &options) == 1);
+    assert(options.mode == MODE_KDF_BENCH);
+    assert(options.kdf_target_ms == 100.0);
+
+    print_test_result("test_parse_kdf_arguments");
+}
+
+/**
+ * @brief Test case for -range: start:length, only when extracting.
+ */
+void test_parse_range_arguments() {
+    ProgramOptions options;
+    char *extract[] = {"stegobmp", "-extract", "-p", "carrier.bmp", "-out", "output", "-steg", "LSB4", "-range", "0:4096"};
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 1);
+    assert(options.range && options.range_start == 0 && options.range_length == 4096);
+
+    const char *invalid[] = {"4096", ":10", "10:", "10:0", "-1:10", "1x:10", "10:5y"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        extract[9] = (char *) invalid[i];
+        optind = 1;
+        assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 0);
+    }
+
+    char *embed[] = {"stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp", "-out", "output.bmp", "-steg", "LSB1", "-range", "0:10"};
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*), embed, &options) == 0);
+
+    print_test_result("test_parse_range_arguments");
+}
+
+void test_parse_compression_arguments() {
+    ProgramOptions options;
+    char *embed[] = {"stegobmp", "-embed", "-in", "input.txt", "-p", "carrier.bmp", "-out", "output.bmp", "-steg", "LSB1", "-compress", "deflate"};
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*), embed, &options) == 1);
+    assert(options.compression == COMPRESSION_DEFLATE);
+
+    embed[11] = "rar";
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*), embed, &options) == 0);
+
+    // Al extraer se detecta sola
+    char *extract[] = {"stegobmp", "-extract", "-p", "carrier.bmp", "-out", "output", "-steg", "LSB1", "-compress", "deflate"};
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 1);
+    assert(options.compression == COMPRESSION_NONE);
+
+    print_test_result("test_parse_compression_arguments");
+}
+
+void test_parse_archive_arguments() {
+    ProgramOptions options;
+    char *extract[] = {"stegobmp", "-extract", "-archive", "-p", "carrier.bmp", "-out", "dir", "-steg", "LSB4", "-member", "a.txt,b.txt"};
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 1);
+    assert(options.archive && strcmp(options.members, "a.txt,b.txt") == 0);
+
+    // -member sin -archive
+    extract[2] = "-pin";
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 0);
+
+    char *embed[] = {"stegobmp", "-embed", "-archive", "-in", "dir", "-p", "carrier.bmp", "-out", "output.bmp", "-steg", "LSB1", "-stripe"};
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*), embed, &options) == 0);
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*) - 1, embed, &options) == 1);
+    assert(options.archive && options.members == NULL);
+
+    print_test_result("test_parse_archive_arguments");
+}
+
+/**
+ * @brief -checksum solo aplica al ocultar y -verify-all al extraer; -checksum no se combina con -archive.
+ */
+void test_parse_checksum_arguments() {
+    ProgramOptions options;
+    char *embed[] = {"stegobmp", "-embed", "-in", "file.txt", "-p", "carrier.bmp", "-out", "output.bmp", "-steg", "LSB1", "-checksum", "-archive"};
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*) - 1, embed, &options) == 1);
+    assert(options.checksum && !options.verify_all);
+    optind = 1;
+    assert(parse_arguments(sizeof(embed) / sizeof(char*), embed, &options) == 0);
+
+    char *extract[] = {"stegobmp", "-extract", "-p", "carrier.bmp", "-out", "file", "-steg", "LSB1", "-verify-all", "-checksum"};
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 1);
+    assert(options.verify_all && !options.checksum);
+
+    print_test_result("test_parse_checksum_arguments");
+}
+
+/**
+ * @brief -loglevel dentro de un ámbito de log solo cambia el nivel del ámbito, no el global.
+ */
+void test_log_level_in_scope() {
+    ProgramOptions options;
+    char *extract[] = {"stegobmp", "-extract", "-p", "carrier.bmp", "-out", "file", "-steg", "LSB1", "-loglevel", "ERROR"};
+    LogLevel global = log_level;
+    LogScope scope = {true, WARNING, NULL, NULL};
+    LogScope saved;
+    log_scope_enter(&scope, &saved);
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*), extract, &options) == 1);
+    assert(log_current_level() == ERROR && log_level == global);
+    optind = 1;
+    assert(parse_arguments(sizeof(extract) / sizeof(char*) - 2, extract, &options) == 1);
+    assert(log_current_level() == DEFAULT_LOG_LEVEL && log_level == global);
+    log_scope_exit(&saved);
+    assert(log_current_level() == global);
+
+    print_test_result("test_log_level_in_scope");
+}
+
 /**
  * @brief Test case for converting strings to enums.
  */
@@ -312,6 +484,7 @@ void test_parse_enums() {
     assert(parse_encryption_algorithm("aes192") == ENC_AES192);
     assert(parse_encryption_algorithm("aes256") == ENC_AES256);
     assert(parse_encryption_algorithm("3des") == ENC_3DES);
+    assert(parse_encryption_algorithm("chacha20") == ENC_CHACHA20);
     assert(parse_encryption_algorithm("invalid") == ENC_NONE);
 
     // Test encryption modes
@@ -319,8 +492,25 @@ void test_parse_enums() {
     assert(parse_encryption_mode("cfb") == ENC_MODE_CFB);
     assert(parse_encryption_mode("ofb") == ENC_MODE_OFB);
     assert(parse_encryption_mode("cbc") == ENC_MODE_CBC);
+    assert(parse_encryption_mode("gcm") == ENC_MODE_GCM);
+    assert(parse_encryption_mode("cfb1") == ENC_MODE_CFB1);
+    assert(parse_encryption_mode("cfb8") == ENC_MODE_CFB8);
+    assert(parse_encryption_mode("cfb128") == ENC_MODE_CFB128);
+    assert(parse_encryption_mode("ctr") == ENC_MODE_CTR);
     assert(parse_encryption_mode("invalid") == ENC_MODE_NONE);
 
+    // Test key derivation functions
+    assert(parse_kdf_algorithm("pbkdf2") == KDF_PBKDF2_SHA256);
+    assert(parse_kdf_algorithm("pbkdf2-sha512") == KDF_PBKDF2_SHA512);
+    assert(parse_kdf_algorithm("scrypt") == KDF_SCRYPT);
+    assert(parse_kdf_algorithm("invalid") == KDF_NONE);
+
+    // Test compression algorithms
+    assert(parse_compression_algorithm("deflate") == COMPRESSION_DEFLATE);
+    assert(parse_compression_algorithm("zlib") == COMPRESSION_DEFLATE);
+    assert(parse_compression_algorithm("zstd") == COMPRESSION_ZSTD);
+    assert(parse_compression_algorithm("invalid") == COMPRESSION_NONE);
+
     print_test_result("test_parse_enums");
 }
 
@@ -341,6 +531,12 @@ int main() {
     test_optional_mode();
     test_optinal_algorithm();
     test_optional_only_pass();
+    test_parse_kdf_arguments();
+    test_parse_range_arguments();
+    test_parse_compression_arguments();
+    test_parse_archive_arguments();
+    test_parse_checksum_arguments();
+    test_log_level_in_scope();
     test_parse_enums();
 
     printf("All tests completed.\n");
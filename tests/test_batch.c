@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../src/include/batch.h"
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "../src/include/stego_job.h"
+#include "test_utils.c"
+
+#define MANIFEST_PATH "test_batch_manifest.tsv"
+#define REPORT_PATH "test_batch_report.tsv"
+
+/**
+ * @brief Lee el archivo completo en un string terminado en '\0'.
+ */
+static char* read_text_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    size_t size = get_file_size(file);
+    char *text = malloc(size + 1);
+    assert(text != NULL);
+    assert(fread(text, 1, size, file) == size);
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+/**
+ * @brief Compara dos archivos byte a byte.
+ */
+static bool same_file_contents(const char *path_a, const char *path_b) {
+    char *a = read_text_file(path_a);
+    char *b = read_text_file(path_b);
+    bool same = strcmp(a, b) == 0;
+    free(a);
+    free(b);
+    return same;
+}
+
+/**
+ * @brief Un manifiesto con trabajos válidos e inválidos: los válidos se ejecutan y todos aparecen en el reporte.
+ *
+ * Las extracciones leen imágenes generadas por líneas anteriores, por lo que con varios workers
+ * tienen que esperar a esas líneas. En modo pipeline el reporte termina con una línea por etapa.
+ */
+void test_batch_manifest(size_t workers, bool pipeline) {
+    FILE *manifest = fopen(MANIFEST_PATH, "w");
+    assert(manifest != NULL);
+    fprintf(manifest, "mode\tin\tp\tout\tsteg\ta\tm\tpass\tkdf-iter\n");
+    fprintf(manifest, "# Ocultar y recuperar con y sin cifrado\n");
+    fprintf(manifest, "embed\t%smessage.txt\t%slado.bmp\tbatch_lsb1.bmp\tLSB1\t-\t-\t-\t-\n", IMG_BASE_PATH, IMG_BASE_PATH);
+    fprintf(manifest, "embed\t%smessage.txt\t%slado.bmp\tbatch_lsb4.bmp\tLSB4\taes256\tgcm\tclave\t2000\n", IMG_BASE_PATH, IMG_BASE_PATH);
+    fprintf(manifest, "extract\t\tbatch_lsb1.bmp\tbatch_out1\tLSB1\t\t\t\t\n");
+    fprintf(manifest, "extract\t\tbatch_lsb4.bmp\tbatch_out4\tLSB4\taes256\tgcm\tclave\t\n");
+    fprintf(manifest, "extract\t\tbatch_lsb4.bmp\tbatch_bad\tLSB4\taes256\tgcm\totra\t\n");   // Contraseña incorrecta
+    fprintf(manifest, "embed\t\t%slado.bmp\tbatch_x.bmp\tLSB1\t\t\t\t\n", IMG_BASE_PATH);  // Falta -in
+    fclose(manifest);
+
+    BatchSettings settings = {workers, false, pipeline};
+    assert(run_batch(MANIFEST_PATH, REPORT_PATH, &settings) == 2);
+
+    assert(same_file_contents("batch_out1.txt", IMG_BASE_PATH "message.txt"));
+    assert(same_file_contents("batch_out4.txt", IMG_BASE_PATH "message.txt"));
+
+    // Encabezado + una línea por trabajo, con el número de línea del manifiesto
+    char *report = read_text_file(REPORT_PATH);
+    assert(strncmp(report, "line\tmode\tstatus\t", 17) == 0);
+    assert(strstr(report, "\n3\tembed\tok\t") != NULL);
+    assert(strstr(report, "\n4\tembed\tok\t") != NULL);
+    assert(strstr(report, "\n5\textract\tok\t") != NULL);
+    assert(strstr(report, "\n6\textract\tok\t") != NULL);
+    assert(strstr(report, "\n7\textract\terror-crypto\t") != NULL);
+    assert(strstr(report, "\n8\tembed\terror-arguments\t") != NULL);
+    assert((strstr(report, "\n# stage\t") != NULL) == pipeline);
+    if (pipeline) {
+        // Cinco trabajos válidos pasan por la lectura y la escritura; solo los embed por el ocultamiento
+        assert(strstr(report, "\n# load\t1\t5\t") != NULL);
+        assert(strstr(report, "\n# embed\t") != NULL);
+        assert(strstr(report, "\n# write\t1\t5\t") != NULL);
+    }
+    free(report);
+
+    remove(MANIFEST_PATH);
+    remove(REPORT_PATH);
+    remove("batch_lsb1.bmp");
+    remove("batch_lsb4.bmp");
+    remove("batch_out1.txt");
+    remove("batch_out4.txt");
+    printf("test_batch_manifest passed (%zu workers%s).\n", workers, pipeline ? ", pipeline" : "");
+}
+
+static void store_le32(uint8_t *buffer, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) {
+        buffer[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Escribe un BMP V3 de 24 bits de `width` x `width` píxeles grises.
+ */
+static void write_square_carrier(const char *path, uint32_t width) {
+    size_t data_size = ((width * 3 + 3) & ~(size_t) 3) * width;
+    uint8_t header[BMP_HEADER_SIZE] = {'B', 'M'};
+    store_le32(header + 2, (uint32_t) (BMP_HEADER_SIZE + data_size));
+    store_le32(header + 10, BMP_HEADER_SIZE);
+    store_le32(header + 14, 40);
+    store_le32(header + 18, width);
+    store_le32(header + 22, width);
+    header[26] = 1;
+    header[28] = 24;
+
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    assert(fwrite(header, 1, BMP_HEADER_SIZE, file) == BMP_HEADER_SIZE);
+    for (size_t i = 0; i < data_size; i++) {
+        fputc(0x80, file);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Un archivo de más de dos fragmentos se oculta y se extrae repartido entre los workers,
+ * también en modo pipeline, y el campo de tamaño se lee igual que en una extracción serial.
+ */
+void test_batch_large_payload(bool pipeline) {
+    // LSB4 en 1300x1300 entra algo más de 2.5 MB
+    write_square_carrier("batch_large.bmp", 1300);
+    FILE *input = fopen("batch_large.txt", "wb");
+    assert(input != NULL);
+    for (size_t i = 0; i < 2 * JOB_CHUNK_SIZE + 12345; i++) {
+        fputc('a' + (int) (i % 26), input);
+    }
+    fclose(input);
+
+    FILE *manifest = fopen(MANIFEST_PATH, "w");
+    assert(manifest != NULL);
+    fprintf(manifest, "mode\tin\tp\tout\tsteg\n");
+    fprintf(manifest, "embed\tbatch_large.txt\tbatch_large.bmp\tbatch_large_stego.bmp\tLSB4\n");
+    fprintf(manifest, "extract\t\tbatch_large_stego.bmp\tbatch_large_out\tLSB4\n");
+    fclose(manifest);
+
+    BatchSettings settings = {3, false, pipeline};
+    assert(run_batch(MANIFEST_PATH, REPORT_PATH, &settings) == 0);
+    assert(same_file_contents("batch_large_out.txt", "batch_large.txt"));
+
+    // La extracción serial del mismo portador lee el mismo tamaño
+    BMPImage *stego = new_bmp_file("batch_large_stego.bmp");
+    assert(stego != NULL);
+    FilePackage *package = extract_data(stego, STEG_LSB4);
+    assert(package != NULL && package->size == 2 * JOB_CHUNK_SIZE + 12345);
+    free_file_package(package);
+    free_bmp(stego);
+
+    remove(MANIFEST_PATH);
+    remove(REPORT_PATH);
+    remove("batch_large.bmp");
+    remove("batch_large.txt");
+    remove("batch_large_stego.bmp");
+    remove("batch_large_out.txt");
+    printf("test_batch_large_payload passed (%s).\n", pipeline ? "pipeline" : "pool");
+}
+
+/**
+ * @brief Un manifiesto inexistente no ejecuta ningún trabajo.
+ */
+void test_batch_missing_manifest() {
+    assert(run_batch("no_existe.tsv", REPORT_PATH, NULL) == -1);
+    printf("test_batch_missing_manifest passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+
+    test_batch_manifest(1, false);
+    test_batch_manifest(4, false);
+    test_batch_manifest(1, true);
+    test_batch_manifest(3, true);
+    test_batch_large_payload(false);
+    test_batch_large_payload(true);
+    test_batch_missing_manifest();
+
+    crypto_cleanup();
+    printf("Todos los tests de batch pasaron exitosamente.\n");
+    return 0;
+}
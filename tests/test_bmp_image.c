@@ -59,7 +59,7 @@ void test_save_bmp_file() {
     const char *output_image_file = IMG_BASE_PATH  "output_image.bmp";
 
     // Step 1: Manually create a BMPImage structure for a 2x2 image
-    BMPImage bmp;
+    BMPImage bmp = {0};
     unsigned char header[BMP_HEADER_SIZE] = {
             0x42, 0x4D, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00,
             0x00, 0x00, 0x36, 0x00, 0x00, 0x00, 0x28, 0x00,
@@ -207,7 +207,7 @@ void test_copy_bmp() {
  * funcione correctamente para el acceso básico.
  */
 void test_basic_component_access() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = 2;
     bmp.height = 2;
     unsigned char pixel_data[] = {
@@ -252,7 +252,7 @@ void test_basic_component_access() {
  * fuera de los límites de la imagen, devolviendo un componente inválido.
  */
 void test_index_out_of_bounds() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = 2;
     bmp.height = 2;
     unsigned char pixel_data[] = {
@@ -278,7 +278,7 @@ void test_index_out_of_bounds() {
  * fila de píxeles para imágenes con un ancho que no es múltiplo de 4.
  */
 void test_alignment_with_padding() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = 3;
     bmp.height = 2;
     unsigned char pixel_data[] = {
@@ -321,7 +321,7 @@ void test_null_image_or_data() {
     Component component = get_component_by_index(null_bmp, 0);
     assert(component.color == INVALID_COLOR && component.component_ptr == NULL);
 
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = 2;
     bmp.height = 2;
     bmp.data = NULL;
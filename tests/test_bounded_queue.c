@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "../src/include/bounded_queue.h"
+#include "../src/include/logger.h"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS_PER_PRODUCER 20000
+
+static BoundedQueue *shared_queue;
+static unsigned char seen[PRODUCERS * ITEMS_PER_PRODUCER];
+
+/**
+ * @brief La capacidad se redondea a potencia de 2 y las operaciones sin espera respetan los límites.
+ */
+void test_bounded_queue_fifo() {
+    BoundedQueue *queue = bounded_queue_create(3);
+    assert(queue != NULL);
+    assert(bounded_queue_capacity(queue) == 4);
+
+    void *item = NULL;
+    assert(!bounded_queue_try_pop(queue, &item));
+    for (uintptr_t i = 1; i <= 4; i++) {
+        assert(bounded_queue_try_push(queue, (void *) i));
+    }
+    assert(!bounded_queue_try_push(queue, (void *) 5));
+    assert(bounded_queue_size(queue) == 4);
+
+    // Se recorre el anillo más de una vuelta
+    for (uintptr_t i = 1; i <= 10; i++) {
+        assert(bounded_queue_try_pop(queue, &item));
+        assert((uintptr_t) item == i);
+        assert(bounded_queue_try_push(queue, (void *) (i + 4)));
+    }
+    assert(bounded_queue_size(queue) == 4);
+
+    bounded_queue_destroy(queue);
+    printf("test_bounded_queue_fifo passed.\n");
+}
+
+static void *producer_main(void *arg) {
+    uintptr_t producer = (uintptr_t) arg;
+    for (uintptr_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+        // Se suma 1 para no encolar NULL
+        bounded_queue_push(shared_queue, (void *) (producer * ITEMS_PER_PRODUCER + i + 1));
+    }
+    return NULL;
+}
+
+static void *consumer_main(void *arg) {
+    (void) arg;
+    for (;;) {
+        void *item = NULL;
+        bounded_queue_pop(shared_queue, &item);
+        if (item == NULL) {
+            return NULL;
+        }
+        seen[(uintptr_t) item - 1]++;
+    }
+}
+
+/**
+ * @brief Varios productores y consumidores: cada elemento se entrega exactamente una vez.
+ */
+void test_bounded_queue_concurrent() {
+    shared_queue = bounded_queue_create(8);
+    assert(shared_queue != NULL);
+
+    pthread_t producers[PRODUCERS];
+    pthread_t consumers[CONSUMERS];
+    for (uintptr_t i = 0; i < CONSUMERS; i++) {
+        assert(pthread_create(&consumers[i], NULL, consumer_main, NULL) == 0);
+    }
+    for (uintptr_t i = 0; i < PRODUCERS; i++) {
+        assert(pthread_create(&producers[i], NULL, producer_main, (void *) i) == 0);
+    }
+    for (size_t i = 0; i < PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    // Un NULL por consumidor indica el fin
+    for (size_t i = 0; i < CONSUMERS; i++) {
+        bounded_queue_push(shared_queue, NULL);
+    }
+    for (size_t i = 0; i < CONSUMERS; i++) {
+        pthread_join(consumers[i], NULL);
+    }
+
+    for (size_t i = 0; i < PRODUCERS * ITEMS_PER_PRODUCER; i++) {
+        assert(seen[i] == 1);
+    }
+    assert(bounded_queue_size(shared_queue) == 0);
+    bounded_queue_destroy(shared_queue);
+    printf("test_bounded_queue_concurrent passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+
+    test_bounded_queue_fifo();
+    test_bounded_queue_concurrent();
+
+    printf("Todos los tests de bounded_queue pasaron exitosamente.\n");
+    return 0;
+}
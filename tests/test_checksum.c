@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../src/include/checksum.h"
+#include "../src/include/compression.h"
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "../src/include/stego_job.h"
+#include "../src/include/stegolib.h"
+#include "test_utils.c"
+
+#define PAYLOAD_SIZE 300000     // Cinco bloques de 64 KB; entra en LSB4 de lado.bmp
+#define SMALL_CHUNK 1000
+#define RANGE_CHUNK 16384
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define INPUT_PATH "test_checksum_in.bin"
+#define STEGO_PATH "test_checksum.bmp"
+#define OUTPUT_NAME "test_checksum_out"
+
+/**
+ * @brief Payload pseudoaleatorio: no se comprime, así los bloques guardan el archivo tal cual.
+ */
+static uint8_t* random_payload(size_t size) {
+    uint8_t *payload = malloc(size);
+    for (size_t i = 0; i < size; i++) {
+        uint64_t x = (i + 1) * 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        payload[i] = (uint8_t) (x ^ (x >> 31));
+    }
+    return payload;
+}
+
+/**
+ * @brief Paquete dividido en bloques de `chunk_size` bytes con un archivo de `size` bytes del payload.
+ */
+static uint8_t* checksummed_package(const uint8_t *payload, size_t size, size_t chunk_size, size_t *package_size) {
+    uint8_t *package = embed_data_from_buffer(payload, size, ".bin", package_size);
+    assert(package != NULL && checksum_package(&package, package_size, chunk_size));
+    return package;
+}
+
+/**
+ * @brief El CRC32C coincide con el valor de referencia, y la versión por hardware con la portable
+ * para todo largo y alineación.
+ */
+void test_crc32c() {
+    const uint8_t *check = (const uint8_t *) "123456789";
+    assert(crc32c(0, check, 9) == 0xE3069283);
+    assert(crc32c(0, check, 0) == 0);
+    assert(crc32c(crc32c(0, check, 4), check + 4, 5) == 0xE3069283);
+
+    uint8_t *payload = random_payload(1024);
+    for (size_t start = 0; start < 8; start++) {
+        for (size_t length = 0; length < 200; length++) {
+            uint32_t portable = ~crc32c_portable(~0u, payload + start, length);
+            assert(crc32c(0, payload + start, length) == portable);
+        }
+    }
+    assert(crc32c(0, payload, 1024) == ~crc32c_portable(~0u, payload, 1024));
+    free(payload);
+    printf("test_crc32c passed.\n");
+}
+
+/**
+ * @brief Un paquete dividido en bloques se verifica y queda solo con el archivo, con y sin workers.
+ */
+void test_checksum_package() {
+    uint8_t *payload = random_payload(PAYLOAD_SIZE);
+    ThreadPool *pool = thread_pool_create(4, false);
+    assert(pool != NULL);
+    size_t chunk_sizes[] = {0, SMALL_CHUNK};
+    for (size_t c = 0; c < 2; c++) {
+        size_t size = 0;
+        uint8_t *package = checksummed_package(payload, PAYLOAD_SIZE, chunk_sizes[c], &size);
+        size_t chunk_size = 0, file_size = 0;
+        assert(checksum_parse_header(package + sizeof(uint32_t), &chunk_size, &file_size));
+        assert(chunk_size == (c == 0 ? CHECKSUM_CHUNK_SIZE : SMALL_CHUNK) && file_size == PAYLOAD_SIZE);
+        assert(size == sizeof(uint32_t) + checksum_overhead(chunk_size, file_size) + PAYLOAD_SIZE + strlen(".bin") + 1);
+
+        FilePackage *file = new_file_package_from_buffer(package, size);
+        assert(file != NULL && package_is_checksummed(file));
+        ChecksumReport report;
+        assert(verify_file_package(file, c == 0 ? NULL : pool, true, &report));
+        assert(report.chunks == (PAYLOAD_SIZE + chunk_size - 1) / chunk_size && report.checked == report.chunks);
+        assert(report.damaged == 0 && report.first_damaged == SIZE_MAX);
+        assert(file->size == PAYLOAD_SIZE && memcmp(file->data, payload, PAYLOAD_SIZE) == 0);
+        assert(strcmp((char *) file->extension, ".bin") == 0 && !package_is_checksummed(file));
+        free_file_package(file);
+        mem_free(package);
+    }
+
+    // Un archivo menor que un bloque
+    size_t size = 0;
+    uint8_t *package = checksummed_package(payload, 10, 0, &size);
+    FilePackage *file = new_file_package_from_buffer(package, size);
+    assert(file != NULL && verify_file_package(file, pool, true, NULL) && file->size == 10);
+    free_file_package(file);
+    mem_free(package);
+
+    package = embed_data_from_buffer(payload, 10, ".bin", &size);
+    assert(!checksum_package(&package, &size, CHECKSUM_MAX_CHUNK_SIZE + 1));
+    file = new_file_package_from_buffer(package, size);
+    assert(file != NULL && !package_is_checksummed(file) && !verify_file_package(file, NULL, true, NULL));
+    free_file_package(file);
+    mem_free(package);
+    thread_pool_destroy(pool);
+    free(payload);
+    printf("test_checksum_package passed.\n");
+}
+
+/**
+ * @brief Los bloques dañados se detectan todos, o se detiene en el primero, y se informa su posición.
+ */
+void test_damaged_chunks() {
+    uint8_t *payload = random_payload(PAYLOAD_SIZE);
+    ThreadPool *pool = thread_pool_create(4, false);
+    size_t size = 0;
+    uint8_t *package = checksummed_package(payload, PAYLOAD_SIZE, SMALL_CHUNK, &size);
+    size_t file_start = sizeof(uint32_t) + checksum_overhead(SMALL_CHUNK, PAYLOAD_SIZE);
+    size_t damaged[] = {37, 38, 250};
+    for (size_t i = 0; i < 3; i++) {
+        package[file_start + damaged[i] * SMALL_CHUNK + 10] ^= 0x01;
+    }
+
+    ThreadPool *pools[] = {NULL, pool};
+    for (size_t p = 0; p < 2; p++) {
+        ChecksumReport report;
+        FilePackage *file = new_file_package_from_buffer(package, size);
+        assert(!verify_file_package(file, pools[p], false, &report));
+        assert(report.checked == PAYLOAD_SIZE / SMALL_CHUNK && report.damaged == 3);
+        assert(report.first_damaged == 37 * SMALL_CHUNK);
+        free_file_package(file);
+
+        // El primero dañado se encuentra aunque los workers se detengan antes
+        file = new_file_package_from_buffer(package, size);
+        assert(!verify_file_package(file, pools[p], true, &report));
+        assert(report.first_damaged == 37 * SMALL_CHUNK && report.damaged >= 1);
+        assert(p == 1 || (report.checked == 38 && report.damaged == 1));
+        free_file_package(file);
+    }
+
+    // Un paquete truncado no se verifica
+    FilePackage *file = new_file_package_from_buffer(package, size);
+    file->size--;
+    assert(!verify_file_package(file, NULL, false, NULL));
+    free_file_package(file);
+    mem_free(package);
+    thread_pool_destroy(pool);
+    free(payload);
+    printf("test_damaged_chunks passed.\n");
+}
+
+/**
+ * @brief Un rango de un archivo dividido en bloques se lee verificando solo los bloques que toca:
+ * un bloque dañado fuera del rango no impide extraerlo.
+ */
+void test_checksummed_range() {
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4};
+    size_t payload_sizes[] = {100000, PAYLOAD_SIZE};
+    for (size_t a = 0; a < 2; a++) {
+        uint8_t *payload = random_payload(payload_sizes[a]);
+        size_t size = 0;
+        uint8_t *package = checksummed_package(payload, payload_sizes[a], RANGE_CHUNK, &size);
+        // Un byte dañado en el primer bloque
+        package[sizeof(uint32_t) + checksum_overhead(RANGE_CHUNK, payload_sizes[a]) + 10] ^= 0x01;
+        BMPImage *bmp = new_bmp_file(CARRIER);
+        assert(bmp != NULL && embed(bmp, package, size, algorithms[a]));
+        assert(save_bmp_file(STEGO_PATH, bmp) == 0);
+        free_bmp(bmp);
+
+        size_t starts[] = {70000, 3 * RANGE_CHUNK - 100, payload_sizes[a] - 50};
+        for (size_t s = 0; s < 3; s++) {
+            size_t file_size = 0;
+            bmp = new_bmp_file_lazy(STEGO_PATH);
+            FilePackage *file = extract_data_range(bmp, algorithms[a], starts[s], 1000, &file_size);
+            assert(file != NULL && file_size == payload_sizes[a]);
+            size_t length = payload_sizes[a] - starts[s] < 1000 ? payload_sizes[a] - starts[s] : 1000;
+            assert(file->size == length && memcmp(file->data, payload + starts[s], length) == 0);
+            assert(strcmp((char *) file->extension, ".bin") == 0);
+            free_file_package(file);
+            free_bmp(bmp);
+        }
+        bmp = new_bmp_file_lazy(STEGO_PATH);
+        assert(extract_data_range(bmp, algorithms[a], RANGE_CHUNK - 10, 100, NULL) == NULL);
+        assert(extract_data_range(bmp, algorithms[a], payload_sizes[a], 1, NULL) == NULL);
+        free_bmp(bmp);
+        mem_free(package);
+        free(payload);
+    }
+
+    // Comprimido y dividido en bloques: el rango sale del archivo completo, verificado y descomprimido
+    uint8_t *text = malloc(PAYLOAD_SIZE);
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        text[i] = (uint8_t) ('a' + (i / 5) % 26);
+    }
+    size_t size = 0;
+    uint8_t *package = embed_data_from_buffer(text, PAYLOAD_SIZE, ".txt", &size);
+    assert(compress_package(&package, &size, COMPRESSION_DEFLATE) && checksum_package(&package, &size, 0));
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(embed(bmp, package, size, STEG_LSB1));
+    size_t file_size = 0;
+    FilePackage *file = extract_data_range(bmp, STEG_LSB1, 200000, 300, &file_size);
+    assert(file != NULL && file_size == PAYLOAD_SIZE && file->size == 300 && memcmp(file->data, text + 200000, 300) == 0);
+    free_file_package(file);
+    free_bmp(bmp);
+    mem_free(package);
+    free(text);
+    remove(STEGO_PATH);
+    printf("test_checksummed_range passed.\n");
+}
+
+static JobStatus run_test_job(char **argv, int argc) {
+    ProgramOptions options;
+    optind = 1;
+    assert(parse_arguments(argc, argv, &options) == 1);
+    ThreadPool *pool = thread_pool_create(3, false);
+    JobStatus status = run_stego_job(&options, NULL, pool, NULL);
+    thread_pool_destroy(pool);
+    return status;
+}
+
+/**
+ * @brief Los trabajos y la biblioteca ocultan el archivo en bloques y lo verifican al extraer, con
+ * y sin cifrado; un portador dañado falla.
+ */
+void test_checksum_jobs() {
+    uint8_t *payload = random_payload(PAYLOAD_SIZE);
+    FILE *input = fopen(INPUT_PATH, "wb");
+    assert(input != NULL && fwrite(payload, 1, PAYLOAD_SIZE, input) == PAYLOAD_SIZE);
+    fclose(input);
+
+    const char *passwords[] = {NULL, "clave"};
+    for (size_t p = 0; p < 2; p++) {
+        char *embed_argv[] = {"stegobmp", "-embed", "-checksum", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH,
+                              "-steg", "LSB4", "-pass", (char *) passwords[p]};
+        assert(run_test_job(embed_argv, passwords[p] != NULL ? 13 : 11) == JOB_OK);
+        char *extract_argv[] = {"stegobmp", "-extract", "-verify-all", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", "LSB4",
+                                "-pass", (char *) passwords[p]};
+        assert(run_test_job(extract_argv, passwords[p] != NULL ? 11 : 9) == JOB_OK);
+        FILE *output = fopen(OUTPUT_NAME ".bin", "rb");
+        assert(output != NULL);
+        uint8_t *contents = malloc(PAYLOAD_SIZE + 1);
+        assert(fread(contents, 1, PAYLOAD_SIZE + 1, output) == PAYLOAD_SIZE && memcmp(contents, payload, PAYLOAD_SIZE) == 0);
+        fclose(output);
+        free(contents);
+        remove(OUTPUT_NAME ".bin");
+    }
+
+    // Un portador con un bloque dañado
+    size_t size = 0;
+    uint8_t *package = checksummed_package(payload, PAYLOAD_SIZE, 0, &size);
+    package[size - 100] ^= 0x01;
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(embed(bmp, package, size, STEG_LSB4) && save_bmp_file(STEGO_PATH, bmp) == 0);
+    free_bmp(bmp);
+    mem_free(package);
+    char *extract_argv[] = {"stegobmp", "-extract", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", "LSB4"};
+    assert(run_test_job(extract_argv, 8) == JOB_ERROR_STEG);
+    assert(fopen(OUTPUT_NAME ".bin", "rb") == NULL);
+
+    // La biblioteca
+    FILE *file = fopen(CARRIER, "rb");
+    size_t carrier_size = get_file_size(file);
+    uint8_t *carrier = malloc(carrier_size);
+    assert(fread(carrier, 1, carrier_size, file) == carrier_size);
+    fclose(file);
+    StegoOptions options;
+    stego_options_init(&options);
+    options.steg_algorithm = STEG_LSB4;
+    options.checksum = true;
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+    uint8_t *stego = NULL, *data = NULL;
+    size_t stego_size = 0, data_size = 0, file_size = 0;
+    assert(stego_embed_buffer(context, carrier, carrier_size, payload, PAYLOAD_SIZE, ".bin", &stego, &stego_size) == STEGO_OK);
+    assert(stego_extract_buffer(context, stego, stego_size, &data, &data_size, NULL) == STEGO_OK);
+    assert(data_size == PAYLOAD_SIZE && memcmp(data, payload, PAYLOAD_SIZE) == 0);
+    stego_free(context, data);
+    assert(stego_extract_range_buffer(context, stego, stego_size, 131000, 2000, &data, &data_size, &file_size, NULL) == STEGO_OK);
+    assert(file_size == PAYLOAD_SIZE && data_size == 2000 && memcmp(data, payload + 131000, 2000) == 0);
+    stego_free(context, data);
+    stego_free(context, stego);
+    stego_ctx_free(context);
+
+    free(carrier);
+    free(payload);
+    remove(INPUT_PATH);
+    remove(STEGO_PATH);
+    printf("test_checksum_jobs passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+    test_crc32c();
+    test_checksum_package();
+    test_damaged_chunks();
+    test_checksummed_range();
+    test_checksum_jobs();
+    crypto_cleanup();
+    printf("Todos los tests de verificación por bloques pasaron exitosamente.\n");
+    return 0;
+}
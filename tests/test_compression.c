@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../src/include/compression.h"
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "../src/include/stegolib.h"
+#include "test_utils.c"
+
+#define PAYLOAD_SIZE 200000     // Comprimido entra en LSB1 de lado.bmp; sin comprimir, no
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define OUTPUT_NAME "test_compression_out"
+
+/**
+ * @brief Payload de texto repetitivo, fácil de comprimir.
+ */
+static uint8_t* text_payload() {
+    static const char line[] = "La esteganografia oculta un mensaje dentro de otro.\n";
+    uint8_t *payload = malloc(PAYLOAD_SIZE);
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t) line[i % (sizeof(line) - 1)];
+    }
+    return payload;
+}
+
+/**
+ * @brief Compara un archivo con el payload de prueba.
+ */
+static bool matches_payload(const char *path, const uint8_t *payload) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t *contents = malloc(PAYLOAD_SIZE + 1);
+    size_t read = fread(contents, 1, PAYLOAD_SIZE + 1, file);
+    fclose(file);
+    bool same = read == PAYLOAD_SIZE && memcmp(contents, payload, PAYLOAD_SIZE) == 0;
+    free(contents);
+    return same;
+}
+
+/**
+ * @brief Comprime y descomprime un paquete con cada algoritmo disponible, en memoria y a archivo.
+ * Un paquete dañado no se descomprime.
+ */
+void test_compress_package() {
+    uint8_t *payload = text_payload();
+    CompressionAlgorithm algorithms[] = {COMPRESSION_DEFLATE, COMPRESSION_ZSTD};
+    for (size_t a = 0; a < 2; a++) {
+        if (!compression_available(algorithms[a])) {
+            size_t size = 0;
+            uint8_t *package = embed_data_from_buffer(payload, PAYLOAD_SIZE, ".txt", &size);
+            assert(!compress_package(&package, &size, algorithms[a]));
+            mem_free(package);
+            continue;
+        }
+        size_t size = 0;
+        uint8_t *package = embed_data_from_buffer(payload, PAYLOAD_SIZE, ".txt", &size);
+        assert(compress_package(&package, &size, algorithms[a]));
+        assert(size < PAYLOAD_SIZE / 10);
+
+        FilePackage *file = new_file_package_from_buffer(package, size);
+        assert(file != NULL && package_is_compressed(file) && file->compression == algorithms[a]);
+        assert(strcmp((char *) file->extension, ".txt") == 0);
+        assert(create_file_from_compressed_package(OUTPUT_NAME, file) == 1);
+        assert(matches_payload(OUTPUT_NAME ".txt", payload));
+        remove(OUTPUT_NAME ".txt");
+
+        assert(decompress_file_package(file));
+        assert(file->size == PAYLOAD_SIZE && memcmp(file->data, payload, PAYLOAD_SIZE) == 0);
+        assert(!package_is_compressed(file));
+        free_file_package(file);
+
+        // Un byte cambiado en el stream comprimido
+        package[PACKAGE_LARGE_HEADER_SIZE + COMPRESSION_SIZE_FIELD + 5] ^= 0xFF;
+        file = new_file_package_from_buffer(package, size);
+        assert(file != NULL && !decompress_file_package(file));
+        assert(create_file_from_compressed_package(OUTPUT_NAME, file) == -1);
+        assert(fopen(OUTPUT_NAME ".txt", "rb") == NULL);
+        free_file_package(file);
+        mem_free(package);
+    }
+    free(payload);
+    printf("test_compress_package passed.\n");
+}
+
+/**
+ * @brief La compresión la indica el encabezado del paquete, no el contenido de los datos.
+ */
+void test_compression_header() {
+    uint8_t *payload = text_payload();
+    size_t size = 0;
+    uint8_t *package = embed_data_from_buffer(payload, PAYLOAD_SIZE, ".txt", &size);
+    assert(compress_package(&package, &size, COMPRESSION_DEFLATE));
+    uint64_t stored_size = 0;
+    CompressionAlgorithm compression = COMPRESSION_NONE;
+    assert(parse_package_header(package, size, &stored_size, &compression) == PACKAGE_LARGE_HEADER_SIZE);
+    assert(package[PACKAGE_SIZE_FIELD] == PACKAGE_COMPRESSED_VERSION && compression == COMPRESSION_DEFLATE);
+    assert(stored_size == size - PACKAGE_LARGE_HEADER_SIZE - strlen(".txt") - 1);
+    // Quien no sabe descomprimir no acepta el paquete
+    assert(parse_package_header(package, size, &stored_size, NULL) == 0);
+
+    // Los mismos datos en un paquete sin comprimir se extraen tal cual
+    size_t plain_size = 0;
+    uint8_t *plain = embed_data_from_buffer(package + PACKAGE_LARGE_HEADER_SIZE, (size_t) stored_size, ".txt", &plain_size);
+    FilePackage *file = new_file_package_from_buffer(plain, plain_size);
+    assert(file != NULL && !package_is_compressed(file) && !decompress_file_package(file));
+    assert(file->size == stored_size && memcmp(file->data, package + PACKAGE_LARGE_HEADER_SIZE, file->size) == 0);
+    free_file_package(file);
+    mem_free(plain);
+
+    // Un códec desconocido invalida el encabezado
+    package[5] = 42;
+    assert(new_file_package_from_buffer(package, size) == NULL);
+    mem_free(package);
+    free(payload);
+    printf("test_compression_header passed.\n");
+}
+
+/**
+ * @brief Un payload que no se reduce se guarda tal cual.
+ */
+void test_incompressible_package() {
+    uint8_t *payload = malloc(PAYLOAD_SIZE);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        state = state * 1103515245 + 12345;
+        payload[i] = (uint8_t) (state >> 16);
+    }
+    size_t size = 0;
+    uint8_t *package = embed_data_from_buffer(payload, PAYLOAD_SIZE, ".bin", &size);
+    size_t raw_size = size;
+    assert(compress_package(&package, &size, COMPRESSION_DEFLATE));
+    assert(size == raw_size);
+    FilePackage *file = new_file_package_from_buffer(package, size);
+    assert(file != NULL && !package_is_compressed(file));
+    assert(file->size == PAYLOAD_SIZE && memcmp(file->data, payload, PAYLOAD_SIZE) == 0);
+    free_file_package(file);
+    mem_free(package);
+    free(payload);
+    printf("test_incompressible_package passed.\n");
+}
+
+/**
+ * @brief Un paquete comprimido se oculta como cualquier otro. La extracción de un rango devuelve
+ * los bytes del archivo original.
+ */
+void test_compressed_embed() {
+    uint8_t *payload = text_payload();
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(bmp != NULL);
+    size_t size = 0;
+    uint8_t *package = embed_data_from_buffer(payload, PAYLOAD_SIZE, ".txt", &size);
+    assert(size > steg_capacity(bmp, STEG_LSB1));
+    assert(compress_package(&package, &size, COMPRESSION_DEFLATE));
+    assert(embed(bmp, package, size, STEG_LSB1));
+
+    FilePackage *file = extract_data(bmp, STEG_LSB1);
+    assert(file != NULL && package_is_compressed(file));
+    assert(decompress_file_package(file));
+    assert(file->size == PAYLOAD_SIZE && memcmp(file->data, payload, PAYLOAD_SIZE) == 0);
+    free_file_package(file);
+
+    size_t file_size = 0;
+    file = extract_data_range(bmp, STEG_LSB1, 100000, 500, &file_size);
+    assert(file != NULL && file_size == PAYLOAD_SIZE);
+    assert(file->size == 500 && memcmp(file->data, payload + 100000, 500) == 0);
+    assert(strcmp((char *) file->extension, ".txt") == 0);
+    free_file_package(file);
+
+    assert(extract_data_range(bmp, STEG_LSB1, PAYLOAD_SIZE, 1, &file_size) == NULL);
+    mem_free(package);
+    free_bmp(bmp);
+    free(payload);
+    printf("test_compressed_embed passed.\n");
+}
+
+/**
+ * @brief La biblioteca comprime al ocultar y detecta la compresión al extraer, con y sin cifrado.
+ */
+void test_stegolib_compression() {
+    uint8_t *payload = text_payload();
+    FILE *file = fopen(CARRIER, "rb");
+    assert(file != NULL);
+    size_t carrier_size = get_file_size(file);
+    uint8_t *carrier = malloc(carrier_size);
+    assert(fread(carrier, 1, carrier_size, file) == carrier_size);
+    fclose(file);
+
+    const char *passwords[] = {NULL, "clave"};
+    for (size_t p = 0; p < 2; p++) {
+        StegoOptions options;
+        stego_options_init(&options);
+        options.compression = COMPRESSION_DEFLATE;
+        if (passwords[p] != NULL) {
+            options.encryption = ENC_AES256;
+            options.mode = ENC_MODE_GCM;
+            options.password = passwords[p];
+        }
+        StegoContext *context = NULL;
+        assert(stego_ctx_new(&options, &context) == STEGO_OK);
+
+        uint8_t *stego = NULL, *data = NULL;
+        size_t stego_size = 0, data_size = 0, file_size = 0;
+        char extension[STEGO_EXTENSION_SIZE];
+        assert(stego_embed_buffer(context, carrier, carrier_size, payload, PAYLOAD_SIZE, ".txt", &stego, &stego_size) == STEGO_OK);
+        assert(stego_extract_buffer(context, stego, stego_size, &data, &data_size, extension) == STEGO_OK);
+        assert(data_size == PAYLOAD_SIZE && memcmp(data, payload, PAYLOAD_SIZE) == 0);
+        assert(strcmp(extension, ".txt") == 0);
+        stego_free(context, data);
+
+        assert(stego_extract_range_buffer(context, stego, stego_size, 150000, 100000, &data, &data_size, &file_size, extension) == STEGO_OK);
+        assert(file_size == PAYLOAD_SIZE && data_size == PAYLOAD_SIZE - 150000);
+        assert(memcmp(data, payload + 150000, data_size) == 0);
+        stego_free(context, data);
+        stego_free(context, stego);
+        stego_ctx_free(context);
+    }
+
+    StegoOptions options;
+    stego_options_init(&options);
+    options.compression = (CompressionAlgorithm) 42;
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_ERROR_ARGUMENTS);
+
+    free(carrier);
+    free(payload);
+    printf("test_stegolib_compression passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+    test_compress_package();
+    test_compression_header();
+    test_incompressible_package();
+    test_compressed_embed();
+    test_stegolib_compression();
+    crypto_cleanup();
+    printf("Todos los tests de compresión pasaron exitosamente.\n");
+    return 0;
+}
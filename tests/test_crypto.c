@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <openssl/evp.h>
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "test_utils.c"
+
+#define TEST_PASSWORD "margarita"
+
+static const char *test_message = "Mensaje de prueba para el contenedor cifrado de StegoBMP.";
+
+/**
+ * @brief Cifra y descifra un mensaje, devolviendo el texto plano obtenido.
+ */
+static uint8_t* encrypt_decrypt(EncryptionAlgorithm alg, EncryptionMode mode, const char *enc_pass, const char *dec_pass, size_t *decrypted_size) {
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = crypto_encrypt((const uint8_t *) test_message, strlen(test_message), alg, mode, enc_pass, &encrypted_size);
+    assert(encrypted != NULL);
+    assert(encrypted_size > sizeof(uint32_t));
+
+    // El resultado lleva el tamaño al principio, igual que se embebe en la imagen
+    uint8_t *decrypted = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), alg, mode, (const uint8_t *) dec_pass, decrypted_size);
+    free(encrypted);
+    return decrypted;
+}
+
+/**
+ * @brief Test de ida y vuelta para los modos legacy.
+ *
+ * El descifrado legacy no remueve el padding, así que solo se compara el prefijo.
+ */
+void test_legacy_modes_roundtrip() {
+    EncryptionAlgorithm algs[] = {ENC_AES128, ENC_AES192, ENC_AES256, ENC_3DES};
+    EncryptionMode modes[] = {ENC_MODE_ECB, ENC_MODE_CFB, ENC_MODE_OFB, ENC_MODE_CBC, ENC_MODE_CFB1, ENC_MODE_CFB8, ENC_MODE_CFB128, ENC_MODE_CTR};
+
+    for (size_t a = 0; a < sizeof(algs) / sizeof(algs[0]); a++) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            if (algs[a] == ENC_3DES && modes[m] == ENC_MODE_CTR) {
+                continue;
+            }
+            size_t decrypted_size = 0;
+            uint8_t *decrypted = encrypt_decrypt(algs[a], modes[m], TEST_PASSWORD, TEST_PASSWORD, &decrypted_size);
+            assert(decrypted != NULL);
+            assert(decrypted_size >= strlen(test_message));
+            assert(memcmp(decrypted, test_message, strlen(test_message)) == 0);
+            free(decrypted);
+        }
+    }
+    printf("test_legacy_modes_roundtrip passed.\n");
+}
+
+/**
+ * @brief `cfb` debe seguir produciendo exactamente el mismo ciphertext que antes (CFB1 en AES, CFB8 en 3DES).
+ */
+void test_cfb_alias_compatibility() {
+    struct { EncryptionAlgorithm alg; EncryptionMode same; EncryptionMode different; } cases[] = {
+            {ENC_AES128, ENC_MODE_CFB1, ENC_MODE_CFB128},
+            {ENC_AES256, ENC_MODE_CFB1, ENC_MODE_CFB8},
+            {ENC_3DES,   ENC_MODE_CFB8, ENC_MODE_CFB1},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t alias_size = 0, same_size = 0, different_size = 0;
+        uint8_t *alias = crypto_encrypt((const uint8_t *) test_message, strlen(test_message), cases[i].alg, ENC_MODE_CFB, TEST_PASSWORD, &alias_size);
+        uint8_t *same = crypto_encrypt((const uint8_t *) test_message, strlen(test_message), cases[i].alg, cases[i].same, TEST_PASSWORD, &same_size);
+        uint8_t *different = crypto_encrypt((const uint8_t *) test_message, strlen(test_message), cases[i].alg, cases[i].different, TEST_PASSWORD, &different_size);
+        assert(alias != NULL && same != NULL && different != NULL);
+
+        assert(alias_size == same_size && memcmp(alias, same, alias_size) == 0);
+        assert(alias_size != different_size || memcmp(alias, different, alias_size) != 0);
+
+        free(alias);
+        free(same);
+        free(different);
+    }
+    printf("test_cfb_alias_compatibility passed.\n");
+}
+
+/**
+ * @brief El descifrado paralelo de CBC y ECB debe producir exactamente la misma salida que el serial.
+ */
+void test_parallel_block_decrypt() {
+    size_t size = CRYPTO_PARALLEL_MIN_SIZE * 3 + 5;    // Varios segmentos y un último bloque con padding
+    uint8_t *data = malloc(size);
+    assert(data != NULL);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    struct { EncryptionAlgorithm alg; EncryptionMode mode; } cases[] = {
+            {ENC_AES128, ENC_MODE_CBC},
+            {ENC_AES256, ENC_MODE_ECB},
+            {ENC_3DES,   ENC_MODE_CBC},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t encrypted_size = 0;
+        uint8_t *encrypted = crypto_encrypt(data, size, cases[i].alg, cases[i].mode, TEST_PASSWORD, &encrypted_size);
+        assert(encrypted != NULL);
+
+        size_t serial_size = 0, parallel_size = 0;
+        crypto_set_max_threads(1);
+        uint8_t *serial = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), cases[i].alg, cases[i].mode, (const uint8_t *) TEST_PASSWORD, &serial_size);
+        crypto_set_max_threads(4);
+        uint8_t *parallel = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), cases[i].alg, cases[i].mode, (const uint8_t *) TEST_PASSWORD, &parallel_size);
+        crypto_set_max_threads(0);
+
+        assert(serial != NULL && parallel != NULL);
+        assert(serial_size == parallel_size);
+        assert(memcmp(serial, parallel, serial_size) == 0);
+        assert(memcmp(parallel, data, size) == 0);
+
+        free(serial);
+        free(parallel);
+        free(encrypted);
+    }
+
+    free(data);
+    printf("test_parallel_block_decrypt passed.\n");
+}
+
+/**
+ * @brief Cifra en CTR con la clave y el IV legacy (PBKDF2-SHA256 con sal fija), como antes del contenedor.
+ */
+static uint8_t* legacy_ctr_encrypt(const uint8_t *data, size_t size) {
+    unsigned char key_iv[48];
+    unsigned char salt[8] = {0};
+    assert(PKCS5_PBKDF2_HMAC(TEST_PASSWORD, (int) strlen(TEST_PASSWORD), salt, sizeof(salt), CRYPTO_KDF_ITERATIONS, EVP_sha256(), sizeof(key_iv), key_iv) == 1);
+    uint8_t *ciphertext = malloc(size);
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    assert(ciphertext != NULL && ctx != NULL);
+    assert(EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, key_iv, key_iv + 32) == 1);
+    assert(EVP_EncryptUpdate(ctx, ciphertext, &len, data, (int) size) == 1 && (size_t) len == size);
+    EVP_CIPHER_CTX_free(ctx);
+    return ciphertext;
+}
+
+/**
+ * @brief CTR: cada cifrado va en un contenedor con sal e IV propios, el paralelo se descifra igual
+ * que el serial y se puede descifrar cualquier rango de bytes. CTR sin contenedor se rechaza.
+ */
+void test_ctr_parallel_and_range() {
+    size_t size = CRYPTO_PARALLEL_MIN_SIZE * 2 + 13;
+    uint8_t *data = malloc(size);
+    assert(data != NULL);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t) (i * 13 + 1);
+    }
+
+    size_t serial_size = 0, parallel_size = 0;
+    crypto_set_max_threads(1);
+    uint8_t *serial = crypto_encrypt(data, size, ENC_AES256, ENC_MODE_CTR, TEST_PASSWORD, &serial_size);
+    crypto_set_max_threads(3);
+    uint8_t *parallel = crypto_encrypt(data, size, ENC_AES256, ENC_MODE_CTR, TEST_PASSWORD, &parallel_size);
+    assert(serial != NULL && parallel != NULL);
+    assert(parallel_size == serial_size && serial_size > sizeof(uint32_t) + size);
+    const uint8_t *payload = parallel + sizeof(uint32_t);
+    size_t payload_size = parallel_size - sizeof(uint32_t);
+    size_t header_size = payload_size - size;
+    assert(crypto_is_container(payload, payload_size));
+
+    // Misma contraseña y mismos datos, pero otro keystream
+    assert(memcmp(serial + sizeof(uint32_t) + header_size, payload + header_size, size) != 0);
+
+    uint8_t *encrypted[] = {serial, parallel};
+    for (size_t i = 0; i < 2; i++) {
+        size_t decrypted_size = 0;
+        uint8_t *decrypted = crypto_decrypt(encrypted[i] + sizeof(uint32_t), payload_size, ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+        assert(decrypted != NULL && decrypted_size == size);
+        assert(memcmp(decrypted, data, size) == 0);
+        free(decrypted);
+    }
+    assert(crypto_set_max_threads(0) == 3);
+
+    // Rangos alineados y no alineados a bloque, con el offset contado desde el principio del payload
+    uint8_t *legacy = legacy_ctr_encrypt(data, size);
+    size_t ranges[][2] = {{0, 16}, {5, 40}, {CRYPTO_PARALLEL_MIN_SIZE + 7, 1000}, {size - 3, 3}};
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        size_t offset = header_size + ranges[i][0];
+        uint8_t *slice = crypto_decrypt_range(payload, header_size, payload + offset, ranges[i][1], offset, ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD);
+        assert(slice != NULL);
+        assert(memcmp(slice, data + ranges[i][0], ranges[i][1]) == 0);
+        free(slice);
+
+        // Sin encabezado no hay clave ni IV: no se descifra con los legacy
+        assert(crypto_decrypt_range(NULL, 0, legacy + ranges[i][0], ranges[i][1], ranges[i][0], ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD) == NULL);
+    }
+    size_t decrypted_size = 0;
+    assert(crypto_decrypt(legacy, size, ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD, &decrypted_size) == NULL);
+
+    // Un contenedor CTR dañado falla en vez de descifrarse como si no tuviera encabezado
+    uint8_t *damaged = malloc(payload_size);
+    assert(damaged != NULL);
+    memcpy(damaged, payload, payload_size);
+    damaged[CRYPTO_CONTAINER_MAGIC_SIZE] = 0xFF;
+    assert(crypto_decrypt(damaged, payload_size, ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD, &decrypted_size) == NULL);
+    free(damaged);
+
+    // CTR solo está disponible con AES, el acceso por rango solo con CTR y fuera del encabezado
+    size_t encrypted_size = 0;
+    assert(crypto_encrypt(data, 16, ENC_3DES, ENC_MODE_CTR, TEST_PASSWORD, &encrypted_size) == NULL);
+    assert(crypto_decrypt_range(NULL, 0, legacy, 16, 0, ENC_AES256, ENC_MODE_CBC, (const uint8_t *) TEST_PASSWORD) == NULL);
+    assert(crypto_decrypt_range(payload, header_size, payload, 16, 0, ENC_AES256, ENC_MODE_CTR, (const uint8_t *) TEST_PASSWORD) == NULL);
+
+    free(legacy);
+    free(serial);
+    free(parallel);
+    free(data);
+    printf("test_ctr_parallel_and_range passed.\n");
+}
+
+/**
+ * @brief Test de ida y vuelta para AES-GCM y ChaCha20-Poly1305.
+ */
+void test_aead_roundtrip() {
+    struct { EncryptionAlgorithm alg; EncryptionMode mode; } cases[] = {
+            {ENC_AES128, ENC_MODE_GCM},
+            {ENC_AES192, ENC_MODE_GCM},
+            {ENC_AES256, ENC_MODE_GCM},
+            {ENC_CHACHA20, ENC_MODE_NONE},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        assert(crypto_is_aead(cases[i].alg, cases[i].mode));
+
+        size_t decrypted_size = 0;
+        uint8_t *decrypted = encrypt_decrypt(cases[i].alg, cases[i].mode, TEST_PASSWORD, TEST_PASSWORD, &decrypted_size);
+        assert(decrypted != NULL);
+        assert(decrypted_size == strlen(test_message));
+        assert(memcmp(decrypted, test_message, decrypted_size) == 0);
+        free(decrypted);
+    }
+    assert(!crypto_is_aead(ENC_AES128, ENC_MODE_CBC));
+    assert(!crypto_is_aead(ENC_3DES, ENC_MODE_GCM));
+    printf("test_aead_roundtrip passed.\n");
+}
+
+/**
+ * @brief Una contraseña incorrecta debe fallar en la verificación del tag.
+ */
+void test_aead_wrong_password() {
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = encrypt_decrypt(ENC_AES256, ENC_MODE_GCM, TEST_PASSWORD, "otra", &decrypted_size);
+    assert(decrypted == NULL);
+
+    decrypted = encrypt_decrypt(ENC_CHACHA20, ENC_MODE_NONE, TEST_PASSWORD, "otra", &decrypted_size);
+    assert(decrypted == NULL);
+    printf("test_aead_wrong_password passed.\n");
+}
+
+/**
+ * @brief Cualquier byte alterado del encabezado o del ciphertext debe ser detectado.
+ */
+void test_aead_tampered() {
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = crypto_encrypt((const uint8_t *) test_message, strlen(test_message), ENC_AES128, ENC_MODE_GCM, TEST_PASSWORD, &encrypted_size);
+    assert(encrypted != NULL);
+
+    uint8_t *container = encrypted + sizeof(uint32_t);
+    size_t container_size = encrypted_size - sizeof(uint32_t);
+    assert(crypto_is_container(container, container_size));
+
+    // Alterar las iteraciones del KDF y la sal (parte del AAD) y luego el último byte del ciphertext
+    size_t positions[] = {CRYPTO_CONTAINER_MAGIC_SIZE + 8, CRYPTO_CONTAINER_MAGIC_SIZE + 10, container_size - 1};
+    for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+        size_t decrypted_size = 0;
+        container[positions[i]] ^= 0x01;
+        assert(crypto_decrypt(container, container_size, ENC_AES128, ENC_MODE_GCM, (const uint8_t *) TEST_PASSWORD, &decrypted_size) == NULL);
+        container[positions[i]] ^= 0x01;
+    }
+
+    free(encrypted);
+    printf("test_aead_tampered passed.\n");
+}
+
+/**
+ * @brief Las imágenes cifradas con el formato legacy se siguen descifrando igual que antes.
+ */
+void test_legacy_images_still_decrypt() {
+    BMPImage *plain_bmp = new_bmp_file(IMG_BASE_PATH "ladoLSBI.bmp");
+    BMPImage *enc_bmp = new_bmp_file(IMG_BASE_PATH "ladoLSBIaes256ofb.bmp");
+    assert(plain_bmp != NULL && enc_bmp != NULL);
+
+    FilePackage *expected = extract_data(plain_bmp, STEG_LSBI);
+    assert(expected != NULL);
+
+    size_t encrypted_size = 0;
+    uint8_t *encrypted = extract_encrypted_data(enc_bmp, STEG_LSBI, &encrypted_size);
+    assert(encrypted != NULL);
+    assert(!crypto_is_container(encrypted, encrypted_size));
+
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = crypto_decrypt(encrypted, encrypted_size, ENC_AES256, ENC_MODE_OFB, (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+    assert(decrypted != NULL);
+
+    FilePackage *package = new_file_package_from_data(decrypted);
+    assert(package != NULL);
+    assert(package->size == expected->size);
+    assert(memcmp(package->data, expected->data, package->size) == 0);
+    assert(strcmp((char *) package->extension, (char *) expected->extension) == 0);
+
+    free_file_package(package);
+    free_file_package(expected);
+    free(decrypted);
+    free(encrypted);
+    free_bmp(enc_bmp);
+    free_bmp(plain_bmp);
+    printf("test_legacy_images_still_decrypt passed.\n");
+}
+
+/**
+ * @brief Arma un payload legacy AES-128-CBC cuyo texto cifrado es `chosen` seguido del bloque de padding.
+ *
+ * Cada bloque de texto plano es el descifrado del bloque elegido con el XOR del anterior (o del IV legacy).
+ */
+static uint8_t* legacy_cbc_with_ciphertext(const uint8_t *chosen, size_t size, uint8_t **ciphertext) {
+    unsigned char key_iv[32];
+    unsigned char salt[8] = {0};
+    assert(size % 16 == 0);
+    assert(PKCS5_PBKDF2_HMAC(TEST_PASSWORD, (int) strlen(TEST_PASSWORD), salt, sizeof(salt), CRYPTO_KDF_ITERATIONS, EVP_sha256(), sizeof(key_iv), key_iv) == 1);
+    uint8_t *plaintext = malloc(size);
+    *ciphertext = malloc(size + 16);
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    assert(plaintext != NULL && *ciphertext != NULL && ctx != NULL);
+    int len = 0;
+    const uint8_t *previous = key_iv + 16;
+    assert(EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key_iv, NULL) == 1 && EVP_CIPHER_CTX_set_padding(ctx, 0) == 1);
+    for (size_t block = 0; block < size; block += 16) {
+        assert(EVP_DecryptUpdate(ctx, plaintext + block, &len, chosen + block, 16) == 1 && len == 16);
+        for (size_t i = 0; i < 16; i++) {
+            plaintext[block + i] ^= previous[i];
+        }
+        previous = chosen + block;
+    }
+    // El último bloque es el padding PKCS#7 completo, cifrado encadenado al anterior
+    uint8_t padding[16];
+    for (size_t i = 0; i < 16; i++) {
+        padding[i] = (uint8_t) (16 ^ previous[i]);
+    }
+    assert(EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, key_iv, NULL) == 1 && EVP_CIPHER_CTX_set_padding(ctx, 0) == 1);
+    assert(EVP_EncryptUpdate(ctx, *ciphertext + size, &len, padding, 16) == 1 && len == 16);
+    memcpy(*ciphertext, chosen, size);
+    EVP_CIPHER_CTX_free(ctx);
+    return plaintext;
+}
+
+/**
+ * @brief Un payload legacy que empieza como un contenedor no se rechaza: si el encabezado no es
+ * coherente no se toma por contenedor, y si lo es pero no descifra se prueba el formato legacy.
+ */
+void test_legacy_payload_like_container() {
+    // Encabezado v2 con el KDF de un contenedor real, una sal de 15 bytes y un IV de 16
+    size_t container_size = 0;
+    KdfParams kdf = {.algorithm = KDF_PBKDF2_SHA256, .iterations = 1000};
+    uint8_t *container = crypto_encrypt_with_kdf((const uint8_t *) test_message, strlen(test_message), ENC_AES128, ENC_MODE_CBC, TEST_PASSWORD, &kdf, &container_size);
+    assert(container != NULL && crypto_is_container(container + sizeof(uint32_t), container_size - sizeof(uint32_t)));
+    const uint8_t *real = container + sizeof(uint32_t);
+    size_t kdf_end = CRYPTO_CONTAINER_MAGIC_SIZE + 3 + 2 + real[CRYPTO_CONTAINER_MAGIC_SIZE + 4];
+    uint8_t chosen[64];
+    memset(chosen, 0x5A, sizeof(chosen));
+    memcpy(chosen, real, kdf_end);
+    size_t index = kdf_end;
+    chosen[index++] = 15;
+    index += 15;
+    chosen[index++] = 16;
+    index += 16;
+    chosen[index++] = 0;
+    free(container);
+    // Lo que sigue al encabezado no es múltiplo del bloque, así que nunca descifra como contenedor
+    assert(index <= sizeof(chosen) && (sizeof(chosen) + 16 - index) % 16 != 0);
+
+    uint8_t *ciphertext = NULL;
+    uint8_t *plaintext = legacy_cbc_with_ciphertext(chosen, sizeof(chosen), &ciphertext);
+    assert(crypto_is_container(ciphertext, sizeof(chosen) + 16));
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = crypto_decrypt(ciphertext, sizeof(chosen) + 16, ENC_AES128, ENC_MODE_CBC, (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+    assert(decrypted != NULL && decrypted_size >= sizeof(chosen) && memcmp(decrypted, plaintext, sizeof(chosen)) == 0);
+    free(decrypted);
+    free(ciphertext);
+    free(plaintext);
+
+    // Con un algoritmo desconocido el encabezado ya no es coherente y se descifra directamente como legacy
+    chosen[CRYPTO_CONTAINER_MAGIC_SIZE + 1] = 0x7F;
+    plaintext = legacy_cbc_with_ciphertext(chosen, sizeof(chosen), &ciphertext);
+    assert(!crypto_is_container(ciphertext, sizeof(chosen) + 16));
+    decrypted = crypto_decrypt(ciphertext, sizeof(chosen) + 16, ENC_AES128, ENC_MODE_CBC, (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+    assert(decrypted != NULL && decrypted_size >= sizeof(chosen) && memcmp(decrypted, plaintext, sizeof(chosen)) == 0);
+    free(decrypted);
+    free(ciphertext);
+    free(plaintext);
+    printf("test_legacy_payload_like_container passed.\n");
+}
+
+/**
+ * @brief Con un KDF explícito todos los modos usan el contenedor versionado, y la extracción
+ * toma el KDF y sus parámetros del encabezado.
+ */
+void test_kdf_container_roundtrip() {
+    KdfParams kdfs[] = {
+            {.algorithm = KDF_PBKDF2_SHA256, .iterations = 2000},
+            {.algorithm = KDF_PBKDF2_SHA512},
+            {.algorithm = KDF_SCRYPT, .scrypt_n = 1024, .scrypt_r = 8, .scrypt_p = 1},
+    };
+    EncryptionAlgorithm algs[] = {ENC_AES128, ENC_AES256, ENC_3DES, ENC_AES192, ENC_CHACHA20};
+    EncryptionMode modes[] = {ENC_MODE_CBC, ENC_MODE_CTR, ENC_MODE_ECB, ENC_MODE_CFB, ENC_MODE_NONE};
+
+    for (size_t k = 0; k < sizeof(kdfs) / sizeof(kdfs[0]); k++) {
+        if (!crypto_kdf_available(kdfs[k].algorithm)) {
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(algs) / sizeof(algs[0]); i++) {
+            size_t encrypted_size = 0;
+            size_t decrypted_size = 0;
+            uint8_t *encrypted = crypto_encrypt_with_kdf((const uint8_t *) test_message, strlen(test_message), algs[i], modes[i], TEST_PASSWORD, &kdfs[k], &encrypted_size);
+            assert(encrypted != NULL);
+            assert(crypto_is_container(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t)));
+            assert(encrypted[sizeof(uint32_t) + CRYPTO_CONTAINER_MAGIC_SIZE] == CRYPTO_CONTAINER_VERSION);
+            assert(encrypted[sizeof(uint32_t) + CRYPTO_CONTAINER_MAGIC_SIZE + 3] == kdfs[k].algorithm);
+
+            // Los modos legacy dentro del contenedor usan padding, el tamaño es exacto
+            uint8_t *decrypted = crypto_decrypt(encrypted + sizeof(uint32_t), encrypted_size - sizeof(uint32_t), algs[i], modes[i], (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+            assert(decrypted != NULL);
+            assert(decrypted_size == strlen(test_message));
+            assert(memcmp(decrypted, test_message, decrypted_size) == 0);
+            free(decrypted);
+            free(encrypted);
+        }
+    }
+    printf("test_kdf_container_roundtrip passed.\n");
+}
+
+/**
+ * @brief Un contenedor versión 1 (sin parámetros de KDF) se descifra con PBKDF2-SHA256 y las iteraciones por defecto.
+ */
+void test_container_v1_still_decrypts() {
+    uint8_t container[256];
+    size_t index = 0;
+    memcpy(container, CRYPTO_CONTAINER_MAGIC, CRYPTO_CONTAINER_MAGIC_SIZE);
+    index += CRYPTO_CONTAINER_MAGIC_SIZE;
+    container[index++] = CRYPTO_CONTAINER_VERSION_V1;
+    container[index++] = ENC_AES256;
+    container[index++] = ENC_MODE_GCM;
+    container[index++] = CRYPTO_SALT_SIZE;
+    uint8_t *salt = &container[index];
+    memset(salt, 0xA5, CRYPTO_SALT_SIZE);
+    index += CRYPTO_SALT_SIZE;
+    container[index++] = CRYPTO_AEAD_NONCE_SIZE;
+    uint8_t *nonce = &container[index];
+    memset(nonce, 0x5A, CRYPTO_AEAD_NONCE_SIZE);
+    index += CRYPTO_AEAD_NONCE_SIZE;
+    container[index++] = CRYPTO_AEAD_TAG_SIZE;
+    size_t aad_len = index;
+    uint8_t *tag = &container[index];
+    index += CRYPTO_AEAD_TAG_SIZE;
+
+    // Cifrado AES-256-GCM hecho a mano, como lo generaba la versión 1
+    uint8_t key[32];
+    assert(PKCS5_PBKDF2_HMAC(TEST_PASSWORD, strlen(TEST_PASSWORD), salt, CRYPTO_SALT_SIZE, CRYPTO_KDF_ITERATIONS, EVP_sha256(), sizeof(key), key));
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    assert(EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, nonce) == 1);
+    assert(EVP_EncryptUpdate(ctx, NULL, &len, container, (int) aad_len) == 1);
+    assert(EVP_EncryptUpdate(ctx, &container[index], &len, (const uint8_t *) test_message, (int) strlen(test_message)) == 1);
+    assert(EVP_EncryptFinal_ex(ctx, &container[index + len], &len) == 1);
+    assert(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, CRYPTO_AEAD_TAG_SIZE, tag) == 1);
+    EVP_CIPHER_CTX_free(ctx);
+    index += strlen(test_message);
+
+    size_t decrypted_size = 0;
+    uint8_t *decrypted = crypto_decrypt(container, index, ENC_AES256, ENC_MODE_GCM, (const uint8_t *) TEST_PASSWORD, &decrypted_size);
+    assert(decrypted != NULL);
+    assert(decrypted_size == strlen(test_message));
+    assert(memcmp(decrypted, test_message, decrypted_size) == 0);
+    free(decrypted);
+    printf("test_container_v1_still_decrypts passed.\n");
+}
+
+/**
+ * @brief La calibración devuelve parámetros que se pueden usar directamente.
+ */
+void test_kdf_calibrate() {
+    KdfParams kdf;
+    double measured_ms = 0;
+    assert(crypto_kdf_calibrate(KDF_PBKDF2_SHA256, 20.0, &kdf, &measured_ms));
+    assert(kdf.algorithm == KDF_PBKDF2_SHA256);
+    assert(kdf.iterations >= 1000 && kdf.iterations % 1000 == 0);
+    assert(measured_ms > 0);
+    assert(!crypto_kdf_calibrate(KDF_NONE, 20.0, &kdf, &measured_ms));
+    printf("test_kdf_calibrate passed.\n");
+}
+
+/**
+ * @brief Test de reutilización del contexto por thread: operaciones intercaladas de distintos
+ * modos, incluso después de un fallo de autenticación y de crypto_cleanup, dan el mismo resultado.
+ */
+void test_context_reuse() {
+    EncryptionAlgorithm algs[] = {ENC_AES128, ENC_CHACHA20, ENC_3DES, ENC_AES256, ENC_AES192};
+    EncryptionMode modes[] = {ENC_MODE_CBC, ENC_MODE_NONE, ENC_MODE_CFB, ENC_MODE_GCM, ENC_MODE_CTR};
+
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < sizeof(algs) / sizeof(algs[0]); i++) {
+            size_t decrypted_size = 0;
+            uint8_t *decrypted = encrypt_decrypt(algs[i], modes[i], TEST_PASSWORD, TEST_PASSWORD, &decrypted_size);
+            assert(decrypted != NULL);
+            assert(memcmp(decrypted, test_message, strlen(test_message)) == 0);
+            free(decrypted);
+
+            // Un fallo deja el contexto listo para la siguiente operación
+            assert(encrypt_decrypt(ENC_AES128, ENC_MODE_GCM, TEST_PASSWORD, "otra", &decrypted_size) == NULL);
+        }
+        if (round == 1) {
+            crypto_cleanup();
+        }
+    }
+    printf("test_context_reuse passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+
+    test_legacy_modes_roundtrip();
+    test_cfb_alias_compatibility();
+    test_parallel_block_decrypt();
+    test_ctr_parallel_and_range();
+    test_aead_roundtrip();
+    test_aead_wrong_password();
+    test_aead_tampered();
+    test_legacy_images_still_decrypt();
+    test_legacy_payload_like_container();
+    test_context_reuse();
+    test_kdf_container_roundtrip();
+    test_container_v1_still_decrypts();
+    test_kdf_calibrate();
+
+    crypto_cleanup();
+
+    printf("Todos los tests de crypto pasaron exitosamente.\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../src/include/daemon.h"
+#include "../src/include/crypto.h"
+#include "test_utils.c"
+
+#define SOCKET_PATH "test_daemon.sock"
+
+static int daemon_status = 1;
+
+static void *daemon_main(void *arg) {
+    (void) arg;
+    DaemonSettings settings = {2, false};
+    daemon_status = run_daemon(SOCKET_PATH, &settings);
+    return NULL;
+}
+
+/**
+ * @brief Espera a que el daemon acepte conexiones.
+ */
+static void wait_for_daemon() {
+    for (int i = 0; i < 200 && access(SOCKET_PATH, F_OK) != 0; i++) {
+        usleep(10000);
+    }
+    assert(access(SOCKET_PATH, F_OK) == 0);
+}
+
+/**
+ * @brief Lee el archivo completo.
+ */
+static uint8_t* read_whole_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    *size = get_file_size(file);
+    uint8_t *data = malloc(*size + 1);
+    assert(data != NULL);
+    assert(fread(data, 1, *size, file) == *size);
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Compara un archivo con el mensaje original.
+ */
+static bool same_as_message(const char *path) {
+    size_t size_a = 0, size_b = 0;
+    uint8_t *a = read_whole_file(path, &size_a);
+    uint8_t *b = read_whole_file(IMG_BASE_PATH "message.txt", &size_b);
+    bool same = size_a == size_b && memcmp(a, b, size_a) == 0;
+    free(a);
+    free(b);
+    return same;
+}
+
+/**
+ * @brief Trabajos enviados al daemon: embed por ruta relativa, extract pasando el portador como
+ * descriptor, contraseña incorrecta y una petición que no es un trabajo.
+ */
+void test_daemon_jobs() {
+    JobResult result;
+
+    char *embed[] = {"-embed", "-in", IMG_BASE_PATH "message.txt", "-p", IMG_BASE_PATH "lado.bmp",
+                     "-out", "daemon_lsb4.bmp", "-steg", "LSB4", "-a", "aes256", "-m", "cbc", "-pass", "clave"};
+    assert(daemon_submit_job(SOCKET_PATH, sizeof(embed) / sizeof(char *), embed, NULL, &result));
+    assert(result.status == JOB_OK);
+    assert(result.stored_bytes > result.payload_bytes);
+
+    char *extract[] = {"-extract", "-p", "daemon_lsb4.bmp", "-out", "daemon_out", "-steg", "LSB4", "-a", "aes256", "-m", "cbc", "-pass", "clave"};
+    assert(daemon_submit_job(SOCKET_PATH, sizeof(extract) / sizeof(char *), extract, "daemon_lsb4.bmp", &result));
+    assert(result.status == JOB_OK);
+    assert(same_as_message("daemon_out.txt"));
+
+    // La clave legacy de la extracción es la misma que la del embed
+    size_t hits = 0, misses = 0;
+    crypto_key_cache_stats(&hits, &misses);
+    assert(hits >= 1);
+
+    char *wrong[] = {"-extract", "-p", "daemon_lsb4.bmp", "-out", "daemon_bad", "-steg", "LSB4", "-a", "aes256", "-m", "cbc", "-pass", "otra"};
+    assert(daemon_submit_job(SOCKET_PATH, sizeof(wrong) / sizeof(char *), wrong, "daemon_lsb4.bmp", &result));
+    assert(result.status == JOB_ERROR_CRYPTO);
+
+    char *batch[] = {"-batch", "manifiesto.tsv"};
+    assert(daemon_submit_job(SOCKET_PATH, sizeof(batch) / sizeof(char *), batch, NULL, &result));
+    assert(result.status == JOB_ERROR_ARGUMENTS);
+
+    remove("daemon_lsb4.bmp");
+    remove("daemon_out.txt");
+    printf("test_daemon_jobs passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+    remove(SOCKET_PATH);
+
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, daemon_main, NULL) == 0);
+    wait_for_daemon();
+
+    test_daemon_jobs();
+
+    assert(daemon_request_shutdown(SOCKET_PATH));
+    pthread_join(thread, NULL);
+    assert(daemon_status == 0);
+    assert(access(SOCKET_PATH, F_OK) != 0);
+
+    crypto_cleanup();
+    printf("Todos los tests del daemon pasaron exitosamente.\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include "../src/include/crypto.h"
+#include "../src/include/descriptor.h"
+#include "../src/include/stego_bmp.h"
+#include "../src/include/stego_job.h"
+#include "test_utils.c"
+
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define INPUT_PATH "test_descriptor_in.txt"
+#define STEGO_PATH "test_descriptor.bmp"
+#define OUTPUT_NAME "test_descriptor_out"
+#define OUTPUT_PATH OUTPUT_NAME ".txt"
+
+/**
+ * @brief El descriptor se escribe y se lee con todos sus campos; un bit alterado o una imagen sin
+ * descriptor no se aceptan.
+ */
+void test_descriptor_block() {
+    BMPImage *bmp = create_test_bmp(100, 40, 0x55);
+    assert(bmp != NULL);
+    StegoDescriptor descriptor, read;
+    assert(!read_descriptor(bmp, &read));
+
+    memset(&descriptor, 0, sizeof(descriptor));
+    descriptor.steg_algorithm = STEG_LSBI;
+    descriptor.compression = COMPRESSION_DEFLATE;
+    descriptor.checksum = true;
+    descriptor.encryption_algo = ENC_AES256;
+    descriptor.encryption_mode = ENC_MODE_GCM;
+    descriptor.kdf = (KdfParams) {KDF_SCRYPT, 0, 1u << 15, 8, 2};
+    assert(write_descriptor(bmp, &descriptor));
+    assert(read_descriptor(bmp, &read));
+    assert(read.steg_algorithm == STEG_LSBI && read.package_version == 0 && read.compression == COMPRESSION_DEFLATE);
+    assert(read.checksum && read.encryption_algo == ENC_AES256 && read.encryption_mode == ENC_MODE_GCM);
+    assert(read.kdf.algorithm == KDF_SCRYPT && read.kdf.scrypt_n == 1u << 15 && read.kdf.scrypt_r == 8 && read.kdf.scrypt_p == 2);
+
+    // Las 256 componentes entran en la última fila (300 componentes); las demás filas son del payload
+    assert(descriptor_first_row(bmp) == 39);
+    assert(descriptor_payload_capacity(bmp, STEG_LSB4) == 100 * 39 * 3 / 2);
+    size_t offset = 39 * 100 * 3 + 40;
+    Component component = get_component_by_index(bmp, offset);
+    *component.component_ptr ^= 0x01;
+    assert(!read_descriptor(bmp, &read));
+
+    descriptor.kdf.scrypt_n = 1000;
+    assert(!write_descriptor(bmp, &descriptor));
+    free_bmp(bmp);
+
+    // 256 componentes ocupan todas las filas de una imagen de 10 x 8
+    bmp = create_test_bmp(10, 8, 0x55);
+    assert(descriptor_first_row(bmp) == 0 && descriptor_payload_capacity(bmp, STEG_LSB1) == 0);
+    assert(!write_descriptor(bmp, &descriptor));
+    free_bmp(bmp);
+    printf("test_descriptor_block passed.\n");
+}
+
+/**
+ * @brief Un portador con descriptor se extrae sin -steg ni -a/-m, y también como siempre con -steg.
+ */
+void test_described_jobs() {
+    write_test_input(INPUT_PATH, 20000);
+    const char *algorithms[] = {"LSB1", "LSB4", "LSBI"};
+    for (size_t a = 0; a < 3; a++) {
+        for (size_t encrypted = 0; encrypted < 2; encrypted++) {
+            ProgramOptions options;
+            char *embed_argv[] = {"stegobmp", "-embed", "-describe", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH,
+                                  "-steg", (char *) algorithms[a], "-compress", "deflate", "-a", "aes256", "-m", "ofb",
+                                  "-pass", "clave"};
+            assert(parse_test_arguments(&options, encrypted ? 19 : 13, embed_argv) == 1 && options.describe);
+            assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK);
+
+            char *extract_argv[] = {"stegobmp", "-extract", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-pass", "clave"};
+            assert(parse_test_arguments(&options, encrypted ? 8 : 6, extract_argv) == 1);
+            assert(options.steg_algorithm == STEG_NONE && options.encryption_algo == ENC_NONE);
+            assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK && test_output_matches(OUTPUT_PATH, 20000));
+
+            // Un rango sin -steg: cifrado se descifra del portador completo, sin cifrar se leen solo sus filas
+            char *range_argv[] = {"stegobmp", "-extract", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-range", "0:1000", "-pass", "clave"};
+            assert(parse_test_arguments(&options, encrypted ? 10 : 8, range_argv) == 1);
+            assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK && test_output_matches(OUTPUT_PATH, 1000));
+
+            // El trabajo lee el descriptor del portador ya cargado
+            assert(parse_test_arguments(&options, encrypted ? 8 : 6, extract_argv) == 1);
+            BMPImage *bmp = new_bmp_file_lazy(STEGO_PATH);
+            assert(bmp != NULL && descriptor_configure(bmp, &options));
+            assert(options.steg_algorithm == parse_steg_algorithm(algorithms[a]));
+            assert(options.encryption_algo == (encrypted ? ENC_AES256 : ENC_NONE));
+            assert(options.encryption_mode == (encrypted ? ENC_MODE_OFB : ENC_MODE_NONE));
+
+            if (encrypted) {
+                // Sin contraseña no se puede configurar la extracción
+                assert(parse_test_arguments(&options, 6, extract_argv) == 1);
+                assert(!descriptor_configure(bmp, &options));
+                assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+            } else {
+                // El payload queda donde siempre: se extrae con -steg aunque no se lea el descriptor
+                char *legacy_argv[] = {"stegobmp", "-extract", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", (char *) algorithms[a]};
+                assert(parse_test_arguments(&options, 8, legacy_argv) == 1);
+                assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK && test_output_matches(OUTPUT_PATH, 20000));
+            }
+            free_bmp(bmp);
+        }
+    }
+
+    // Sin descriptor, el trabajo pide -steg
+    ProgramOptions options;
+    char *plain_argv[] = {"stegobmp", "-extract", "-p", CARRIER, "-out", OUTPUT_NAME};
+    assert(parse_test_arguments(&options, 6, plain_argv) == 1);
+    assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+    char *stream_argv[] = {"stegobmp", "-embed", "-describe", "-stream", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH,
+                           "-steg", "LSB4"};
+    assert(parse_test_arguments(&options, 12, stream_argv) == 0);
+    remove(STEGO_PATH);
+    printf("test_described_jobs passed.\n");
+}
+
+/**
+ * @brief Un archivo que entra en el portador pero llega a las filas del descriptor no se oculta con -describe.
+ */
+void test_descriptor_capacity() {
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(bmp != NULL);
+    // Paquete: tamaño (4) + archivo + ".txt\0" (5), un byte más de lo que entra antes del descriptor
+    size_t size = descriptor_payload_capacity(bmp, STEG_LSB4) - 9 + 1;
+    assert(size + 9 <= steg_capacity(bmp, STEG_LSB4));
+    free_bmp(bmp);
+    write_test_input(INPUT_PATH, size);
+
+    ProgramOptions options;
+    char *embed_argv[] = {"stegobmp", "-embed", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH, "-steg", "LSB4", "-describe"};
+    assert(parse_test_arguments(&options, 11, embed_argv) == 1);
+    JobResult result;
+    assert(run_stego_job(&options, NULL, NULL, &result) == JOB_ERROR_STEG);
+    assert(parse_test_arguments(&options, 10, embed_argv) == 1);
+    assert(run_stego_job(&options, NULL, NULL, &result) == JOB_OK);
+    remove(STEGO_PATH);
+    printf("test_descriptor_capacity passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+
+    test_descriptor_block();
+    test_described_jobs();
+    test_descriptor_capacity();
+
+    remove(INPUT_PATH);
+    crypto_cleanup();
+    printf("Todos los tests de descriptores pasaron exitosamente.\n");
+    return 0;
+}
@@ -37,7 +37,7 @@ void test_get_file_extension() {
     uint8_t *ext = get_file_extension("example.txt");
     assert(ext != NULL);
     assert(strcmp((char*)ext, ".txt") == 0);
-    free(ext);  // Liberar la memoria asignada
+    mem_free(ext);  // Liberar la memoria asignada
 
     ext = get_file_extension("no_extension");
     assert(ext == NULL);  // Debe retornar NULL si no hay extensión
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../src/include/crypto.h"
+#include "../src/include/stego_bmp.h"
+#include "../src/include/stego_job.h"
+#include "test_utils.c"
+
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define INPUT_PATH "test_peek_in.txt"
+#define STEGO_PATH "test_peek.bmp"
+#define OUTPUT_NAME "test_peek_out"
+#define OUTPUT_PATH OUTPUT_NAME ".txt"
+
+/**
+ * @brief Oculta INPUT_PATH en STEGO_PATH: sin cifrar, cifrado sin -kdf (formato original, sin magic)
+ * o cifrado en el contenedor versionado.
+ */
+static void embed_test_file(const char *algorithm, int encryption) {
+    ProgramOptions options;
+    char *embed_argv[] = {"stegobmp", "-embed", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH,
+                          "-steg", (char *) algorithm, "-a", "aes128", "-m", "cbc", "-pass", "clave",
+                          "-kdf", "pbkdf2", "-kdf-iter", "1000"};
+    int argument_counts[] = {10, 16, 20};
+    assert(parse_test_arguments(&options, argument_counts[encryption], embed_argv) == 1);
+    assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK);
+}
+
+/**
+ * @brief peek_payload lee el tamaño y la extensión sin extraer; con otro algoritmo o sin archivo
+ * oculto no encuentra uno válido.
+ */
+void test_peek_payload() {
+    write_test_input(INPUT_PATH, 3000);
+    embed_test_file("LSB4", 0);
+
+    BMPImage *bmp = new_bmp_file_lazy(STEGO_PATH);
+    assert(bmp != NULL);
+    PayloadPeek peek;
+    assert(peek_payload(bmp, STEG_LSB4, &peek));
+    assert(peek.steg_algorithm == STEG_LSB4 && peek.size == 3000 && peek.has_extension && !peek.encrypted_container);
+    assert(strcmp(peek.extension, ".txt") == 0);
+    assert(!peek_payload(bmp, STEG_LSB1, &peek) || !peek.has_extension);
+    assert(!peek_payload(bmp, STEG_NONE, &peek));
+    free_bmp(bmp);
+
+    // Una imagen dispersa da lo mismo y solo reserva los bloques de las filas leídas
+    int fd = open(STEGO_PATH, O_RDONLY);
+    assert(fd >= 0);
+    bmp = new_bmp_sparse(fd);
+    close(fd);
+    assert(bmp != NULL && bmp_private_bytes(bmp) < bmp->data_size);
+    assert(peek_payload(bmp, STEG_LSB4, &peek));
+    assert(peek.size == 3000 && peek.has_extension && strcmp(peek.extension, ".txt") == 0);
+    assert(bmp_private_bytes(bmp) < bmp->data_size);
+    free_bmp(bmp);
+
+    // Un tamaño más grande que la capacidad se descarta
+    bmp = create_test_bmp(20, 20, 0x01);
+    assert(bmp != NULL);
+    assert(!peek_payload(bmp, STEG_LSB1, &peek));
+    free_bmp(bmp);
+    printf("test_peek_payload passed.\n");
+}
+
+/**
+ * @brief Cada algoritmo se detecta solo, con y sin cifrado, y lo detectado se extrae con -steg auto.
+ */
+void test_detect_algorithm() {
+    const char *algorithms[] = {"LSB1", "LSB4", "LSBI"};
+    write_test_input(INPUT_PATH, 2000);
+    for (size_t a = 0; a < 3; a++) {
+        for (int encryption = 0; encryption < 3; encryption++) {
+            bool encrypted = encryption > 0;
+            embed_test_file(algorithms[a], encryption);
+
+            BMPImage *bmp = new_bmp_file_lazy(STEGO_PATH);
+            PayloadPeek peek;
+            assert(bmp != NULL);
+            assert(detect_steg_algorithm(bmp, encrypted, &peek) == parse_steg_algorithm(algorithms[a]));
+            assert(peek.encrypted_container == (encryption == 2) && peek.size >= 2000);
+            if (encryption == 2) {
+                // -peek sin contraseña reconoce el contenedor cifrado
+                assert(detect_steg_algorithm(bmp, false, NULL) == parse_steg_algorithm(algorithms[a]));
+            }
+            free_bmp(bmp);
+
+            ProgramOptions options;
+            char *extract_argv[] = {"stegobmp", "-extract", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", "auto",
+                                    "-a", "aes128", "-m", "cbc", "-pass", "clave"};
+            // El algoritmo se detecta al correr el trabajo, no al leer los argumentos
+            assert(parse_test_arguments(&options, encrypted ? 14 : 8, extract_argv) == 1 && options.steg_auto);
+            assert(options.steg_algorithm == STEG_NONE);
+            assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_OK && test_output_matches(OUTPUT_PATH, 2000));
+        }
+    }
+
+    // Un portador sin nada oculto no se confunde con uno que sí lo tiene
+    BMPImage *bmp = new_bmp_file_lazy(CARRIER);
+    assert(bmp != NULL && detect_steg_algorithm(bmp, false, NULL) == STEG_NONE);
+    free_bmp(bmp);
+    ProgramOptions options;
+    char *clean_argv[] = {"stegobmp", "-extract", "-p", CARRIER, "-out", OUTPUT_NAME, "-steg", "auto"};
+    assert(parse_test_arguments(&options, 8, clean_argv) == 1);
+    assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+    printf("test_detect_algorithm passed.\n");
+}
+
+/**
+ * @brief -peek no necesita -out; -steg auto solo se admite al extraer de un portador.
+ */
+void test_peek_arguments() {
+    write_test_input(INPUT_PATH, 1000);
+    embed_test_file("LSBI", 0);
+
+    // Leer los argumentos no abre el portador: se detecta al mirarlo
+    ProgramOptions options;
+    char *peek_argv[] = {"stegobmp", "-peek", "-p", STEGO_PATH, "-steg", "LSB1"};
+    assert(parse_test_arguments(&options, 4, peek_argv) == 1);
+    assert(options.mode == MODE_PEEK && options.steg_algorithm == STEG_NONE);
+    assert(parse_test_arguments(&options, 6, peek_argv) == 1 && options.steg_algorithm == STEG_LSB1);
+    char *missing_argv[] = {"stegobmp", "-peek", "-p", "test_peek_missing.bmp"};
+    assert(parse_test_arguments(&options, 4, missing_argv) == 1);
+
+    char *embed_argv[] = {"stegobmp", "-embed", "-in", INPUT_PATH, "-p", CARRIER, "-out", STEGO_PATH, "-steg", "auto"};
+    assert(parse_test_arguments(&options, 10, embed_argv) == 0);
+    char *stream_argv[] = {"stegobmp", "-extract", "-stream", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", "auto"};
+    assert(parse_test_arguments(&options, 9, stream_argv) == 0);
+    remove(STEGO_PATH);
+    printf("test_peek_arguments passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+
+    test_peek_payload();
+    test_detect_algorithm();
+    test_peek_arguments();
+
+    remove(INPUT_PATH);
+    crypto_cleanup();
+    printf("Todos los tests de detección pasaron exitosamente.\n");
+    return 0;
+}
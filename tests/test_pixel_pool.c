@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "../src/include/pixel_pool.h"
+#include "../src/include/logger.h"
+
+#define POOL_THREADS 4
+#define POOL_ROUNDS 200
+
+/**
+ * @brief Los buffers están alineados y uno devuelto se reutiliza para el mismo tamaño.
+ */
+void test_pixel_pool_reuse() {
+    size_t hits = 0, misses = 0, cached = 0;
+    pixel_pool_stats(&hits, &misses, &cached);
+
+    uint8_t *first = pixel_buffer_acquire(640 * 480 * 3);
+    assert(first != NULL);
+    assert((uintptr_t) first % PIXEL_BUFFER_ALIGNMENT == 0);
+    memset(first, 0x5A, 640 * 480 * 3);
+    pixel_buffer_release(first);
+
+    // Un tamaño cercano cae en la misma clase
+    uint8_t *second = pixel_buffer_acquire(640 * 480 * 3 - 100);
+    assert(second == first);
+    size_t new_hits = 0, new_misses = 0;
+    pixel_pool_stats(&new_hits, &new_misses, NULL);
+    assert(new_hits == hits + 1);
+    assert(new_misses == misses + 1);
+
+    uint8_t *small = pixel_buffer_acquire(12);
+    assert(small != NULL && (uintptr_t) small % PIXEL_BUFFER_ALIGNMENT == 0);
+    pixel_buffer_release(small);
+    pixel_buffer_release(second);
+    pixel_pool_trim();
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached == 0);
+    printf("test_pixel_pool_reuse passed.\n");
+}
+
+/**
+ * @brief Los buffers grandes empiezan en un límite de huge page, y uno de un múltiplo de 2 MB no
+ * ocupa una huge page de más.
+ */
+void test_pixel_pool_huge_pages() {
+    size_t size = 3 * PIXEL_HUGE_PAGE_SIZE + 12345;
+    uint8_t *buffer = pixel_buffer_acquire(size);
+    assert(buffer != NULL);
+    assert((uintptr_t) buffer % PIXEL_HUGE_PAGE_SIZE == 0);
+    buffer[0] = 1;
+    buffer[size - 1] = 2;
+    pixel_buffer_release(buffer);
+    pixel_pool_trim();
+
+    size = 3 * PIXEL_HUGE_PAGE_SIZE;
+    buffer = pixel_buffer_acquire(size);
+    assert(buffer != NULL && (uintptr_t) buffer % PIXEL_HUGE_PAGE_SIZE == 0);
+    memset(buffer, 0x7E, size);
+    pixel_buffer_release(buffer);
+    size_t cached = 0;
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached > size && cached < size + PIXEL_HUGE_PAGE_SIZE);
+    pixel_pool_trim();
+    printf("test_pixel_pool_huge_pages passed.\n");
+}
+
+/**
+ * @brief Con límite 0 no se guarda nada.
+ */
+void test_pixel_pool_limit() {
+    pixel_pool_set_limit(0);
+    uint8_t *buffer = pixel_buffer_acquire(4096);
+    pixel_buffer_release(buffer);
+    size_t cached = 1;
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached == 0);
+    pixel_pool_set_limit(PIXEL_POOL_AUTO_LIMIT);
+    printf("test_pixel_pool_limit passed.\n");
+}
+
+/**
+ * @brief Con el límite por defecto se reciclan portadores más grandes que PIXEL_POOL_DEFAULT_LIMIT,
+ * uno por cada imagen procesada a la vez.
+ */
+void test_pixel_pool_large_buffers() {
+    // 500 MB caen en la clase de 512 MB; no se escriben, así que no ocupan memoria física
+    size_t size = (size_t) 500 * 1024 * 1024;
+    pixel_pool_set_workers(2);
+    uint8_t *first = pixel_buffer_acquire(size);
+    uint8_t *second = pixel_buffer_acquire(size);
+    assert(first != NULL && second != NULL);
+    pixel_buffer_release(first);
+    pixel_buffer_release(second);
+    size_t cached = 0;
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached >= 2 * size && cached > PIXEL_POOL_DEFAULT_LIMIT);
+
+    size_t hits = 0, new_hits = 0;
+    pixel_pool_stats(&hits, NULL, NULL);
+    uint8_t *again = pixel_buffer_acquire(size);
+    pixel_pool_stats(&new_hits, NULL, NULL);
+    assert((again == first || again == second) && new_hits == hits + 1);
+    pixel_buffer_release(again);
+
+    // Con un solo worker se guarda uno solo, y un límite explícito manda sobre la carga
+    pixel_pool_set_workers(1);
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached >= size && cached < 2 * size);
+    pixel_pool_set_limit(PIXEL_POOL_DEFAULT_LIMIT);
+    pixel_pool_stats(NULL, NULL, &cached);
+    assert(cached <= PIXEL_POOL_DEFAULT_LIMIT);
+    pixel_pool_set_limit(PIXEL_POOL_AUTO_LIMIT);
+    pixel_pool_trim();
+    printf("test_pixel_pool_large_buffers passed.\n");
+}
+
+static void *acquire_release_thread(void *arg) {
+    size_t id = (size_t) arg;
+    for (size_t i = 0; i < POOL_ROUNDS; i++) {
+        size_t size = 1000 + (i % 4) * 50000;
+        uint8_t *buffer = pixel_buffer_acquire(size);
+        assert(buffer != NULL);
+        memset(buffer, (int) id, size);
+        for (size_t j = 0; j < size; j += 997) {
+            assert(buffer[j] == (uint8_t) id);
+        }
+        pixel_buffer_release(buffer);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Varios hilos comparten el pool sin recibir el mismo buffer a la vez.
+ */
+void test_pixel_pool_threads() {
+    pthread_t threads[POOL_THREADS];
+    for (size_t i = 0; i < POOL_THREADS; i++) {
+        assert(pthread_create(&threads[i], NULL, acquire_release_thread, (void *) (i + 1)) == 0);
+    }
+    for (size_t i = 0; i < POOL_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pixel_pool_trim();
+    printf("test_pixel_pool_threads passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    test_pixel_pool_reuse();
+    test_pixel_pool_huge_pages();
+    test_pixel_pool_limit();
+    test_pixel_pool_large_buffers();
+    test_pixel_pool_threads();
+    printf("Todos los tests del pixel pool pasaron exitosamente.\n");
+    return 0;
+}
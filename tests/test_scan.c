@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/include/arguments.h"
+#include "../src/include/scan.h"
+#include "../src/include/stego_bmp.h"
+#include "test_utils.c"
+
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+#define TREE "test_scan_tree"
+#define INPUT_PATH "test_scan_in.txt"
+#define REPORT_PATH "test_scan_report.tsv"
+
+static void embed_to(const char *path, StegAlgorithm steg_alg) {
+    size_t package_size = 0;
+    uint8_t *package = embed_data_from_file(INPUT_PATH, &package_size);
+    BMPImage *bmp = new_bmp_file(CARRIER);
+    assert(package != NULL && bmp != NULL && embed(bmp, package, package_size, steg_alg));
+    assert(save_bmp_file(path, bmp) == 0);
+    free_bmp(bmp);
+    mem_free(package);
+}
+
+static void copy_prefix(const char *from, const char *to, size_t length) {
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    assert(in != NULL && out != NULL);
+    int c;
+    for (size_t i = 0; i < length && (c = fgetc(in)) != EOF; i++) {
+        fputc(c, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * @brief Árbol con un portador por algoritmo, una imagen limpia, un BMP truncado y un archivo de texto.
+ */
+static void build_tree() {
+    mkdir(TREE, 0755);
+    mkdir(TREE "/a", 0755);
+    mkdir(TREE "/a/b", 0755);
+    write_test_input(INPUT_PATH, 5000);
+    embed_to(TREE "/lsb1.bmp", STEG_LSB1);
+    embed_to(TREE "/a/lsb4.bmp", STEG_LSB4);
+    embed_to(TREE "/a/b/lsbi.bmp", STEG_LSBI);
+    copy_prefix(CARRIER, TREE "/a/clean.bmp", SIZE_MAX);
+    copy_prefix(CARRIER, TREE "/a/b/short.bmp", 10000);
+    copy_prefix(INPUT_PATH, TREE "/notes.txt", SIZE_MAX);
+}
+
+static void remove_tree() {
+    const char *files[] = {TREE "/lsb1.bmp", TREE "/a/lsb4.bmp", TREE "/a/b/lsbi.bmp", TREE "/a/clean.bmp",
+                           TREE "/a/b/short.bmp", TREE "/notes.txt"};
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        remove(files[i]);
+    }
+    rmdir(TREE "/a/b");
+    rmdir(TREE "/a");
+    rmdir(TREE);
+}
+
+static const ScanResult* find_result(const ScanResult *results, size_t count, const char *path) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(results[i].path, path) == 0) {
+            return &results[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief bmp_probe lee solo el encabezado y rechaza sin errores lo que no es un BMP completo.
+ */
+void test_bmp_probe() {
+    BMPImage probe;
+    int fd = open(CARRIER, O_RDONLY);
+    assert(fd >= 0 && bmp_probe(fd, &probe));
+    assert(probe.width == 640 && probe.height == 480 && probe.data == NULL && probe.source_offset == BMP_HEADER_SIZE);
+    close(fd);
+
+    fd = open(TREE "/notes.txt", O_RDONLY);
+    assert(fd >= 0 && !bmp_probe(fd, &probe));
+    close(fd);
+    fd = open(TREE "/a/b/short.bmp", O_RDONLY);
+    assert(fd >= 0 && !bmp_probe(fd, &probe));
+    close(fd);
+    printf("test_bmp_probe passed.\n");
+}
+
+/**
+ * @brief Cada portador se encuentra con su algoritmo y queda antes que los archivos limpios, con y sin pool.
+ */
+void test_scan_directory() {
+    ThreadPool *pool = thread_pool_create(3, false);
+    for (int with_pool = 0; with_pool < 2; with_pool++) {
+        size_t count = 0;
+        ScanSummary summary;
+        ScanResult *results = scan_directory(TREE, with_pool ? pool : NULL, &count, &summary);
+        assert(results != NULL && count == 6);
+        assert(summary.files == 6 && summary.bitmaps == 4 && summary.flagged == 3);
+
+        const char *carriers[] = {TREE "/a/b/lsbi.bmp", TREE "/a/lsb4.bmp", TREE "/lsb1.bmp"};
+        StegAlgorithm algorithms[] = {STEG_LSBI, STEG_LSB4, STEG_LSB1};
+        for (size_t i = 0; i < 3; i++) {
+            // Los reconocidos van primero, ordenados por ruta
+            assert(strcmp(results[i].path, carriers[i]) == 0);
+            assert(results[i].verdict == SCAN_RECOGNIZED && results[i].steg_algorithm == algorithms[i]);
+            assert(results[i].peek.size == 5000 && strcmp(results[i].peek.extension, ".txt") == 0);
+        }
+        assert(find_result(results, count, TREE "/a/clean.bmp")->verdict == SCAN_CLEAN);
+        assert(find_result(results, count, TREE "/a/b/short.bmp")->verdict == SCAN_NOT_BMP);
+        assert(find_result(results, count, TREE "/notes.txt")->verdict == SCAN_NOT_BMP);
+        free_scan_results(results, count);
+    }
+    thread_pool_destroy(pool);
+
+    size_t count = 0;
+    assert(scan_directory("test_scan_missing", NULL, &count, NULL) == NULL);
+    printf("test_scan_directory passed.\n");
+}
+
+/**
+ * @brief El reporte tiene una línea por archivo marcado, en orden, y -scan no pide otros argumentos.
+ */
+void test_scan_report() {
+    ScanSettings settings = {2, false};
+    assert(run_scan(TREE, REPORT_PATH, &settings) == 3);
+    FILE *report = fopen(REPORT_PATH, "r");
+    assert(report != NULL);
+    char line[512];
+    assert(fgets(line, sizeof(line), report) != NULL && line[0] == '#');
+    assert(fgets(line, sizeof(line), report) != NULL);
+    assert(strcmp(line, "recognized\tLSBI\t5000\t.txt\t" TREE "/a/b/lsbi.bmp\n") == 0);
+    assert(fgets(line, sizeof(line), report) != NULL && strncmp(line, "recognized\tLSB4\t", 16) == 0);
+    assert(fgets(line, sizeof(line), report) != NULL && strncmp(line, "recognized\tLSB1\t", 16) == 0);
+    assert(fgets(line, sizeof(line), report) != NULL && line[0] == '#');
+    fclose(report);
+    remove(REPORT_PATH);
+    assert(run_scan("test_scan_missing", REPORT_PATH, &settings) == -1 && access(REPORT_PATH, F_OK) != 0);
+
+    ProgramOptions options;
+    char *argv[] = {"stegobmp", "-scan", TREE, "-jobs", "2"};
+    assert(parse_test_arguments(&options, 5, argv) == 1);
+    assert(options.mode == MODE_SCAN && strcmp(options.scan_directory, TREE) == 0 && options.jobs == 2);
+    printf("test_scan_report passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    build_tree();
+
+    test_bmp_probe();
+    test_scan_directory();
+    test_scan_report();
+
+    remove_tree();
+    remove(INPUT_PATH);
+    printf("Todos los tests de escaneo pasaron exitosamente.\n");
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "../src/include/stego_bmp.h"
 #include "test_utils.c"
 
@@ -211,7 +213,7 @@ void test_extract_bits_generic_overflow() {
  * @brief Test para la función `check_capacity_lsb1`.
  */
 void test_check_capacity_lsb1() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = IMG_WIDTH;
     bmp.height = IMG_HEIGHT;
 
@@ -228,7 +230,7 @@ void test_check_capacity_lsb1() {
  * @brief Test para la función `check_capacity_lsb4`.
  */
 void test_check_capacity_lsb4() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = IMG_WIDTH;
     bmp.height = IMG_HEIGHT;
     bmp.data_size = IMG_WIDTH * IMG_HEIGHT * 3;
@@ -246,7 +248,7 @@ void test_check_capacity_lsb4() {
  * @brief Test para la función `check_capacity_lsbi`.
  */
 void test_check_capacity_lsbi() {
-    BMPImage bmp;
+    BMPImage bmp = {0};
     bmp.width = IMG_WIDTH;
     bmp.height = IMG_HEIGHT;
 
@@ -674,6 +676,330 @@ void test_extract_bits_lsbi_mock_case2() {
 }
 
 
+/**
+ * @brief LSBI: lo que oculta embed lo recupera extract_data también cuando el mapa de patrones no
+ * es nulo, y el mapa queda en el orden de las imágenes de referencia (el patrón 00 primero).
+ */
+void test_lsbi_round_trip() {
+    uint8_t data[3000];
+    uint32_t state = 2463534242u;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = (uint8_t) state;
+    }
+    size_t package_size = 0;
+    uint8_t *package = embed_data_from_buffer(data, sizeof(data), ".bin", &package_size);
+    assert(package != NULL);
+
+    // Una imagen natural, y una con todos los componentes en 0 (patrón 00) y datos casi todos en 1
+    BMPImage *natural = new_bmp_file(IMG_BASE_PATH "lado.bmp");
+    BMPImage *flat = create_test_bmp(200, 200, 0x00);
+    assert(natural != NULL && flat != NULL);
+    memset(data, 0xFF, sizeof(data));
+    size_t ones_size = 0;
+    uint8_t *ones = embed_data_from_buffer(data, sizeof(data), ".bin", &ones_size);
+    assert(ones != NULL);
+
+    BMPImage *images[] = {natural, flat};
+    uint8_t *payloads[] = {package, ones};
+    size_t payload_sizes[] = {package_size, ones_size};
+    for (size_t i = 0; i < 2; i++) {
+        assert(embed(images[i], payloads[i], payload_sizes[i], STEG_LSBI));
+        FilePackage *extracted = extract_data(images[i], STEG_LSBI);
+        assert(extracted != NULL && extracted->size == payload_sizes[i] - sizeof(uint32_t) - strlen(".bin") - 1);
+        assert(memcmp(extracted->data, payloads[i] + sizeof(uint32_t), extracted->size) == 0);
+        assert(strcmp((char *) extracted->extension, ".bin") == 0);
+        free_file_package(extracted);
+    }
+
+    // En la imagen plana solo se invierte el patrón 00: el primer bit del mapa
+    assert((*get_component_by_index(flat, 0).component_ptr & 0x01) == 1);
+    for (size_t component = 1; component < 4; component++) {
+        assert((*get_component_by_index(flat, component).component_ptr & 0x01) == 0);
+    }
+
+    free(ones);
+    free(package);
+    free_bmp(flat);
+    free_bmp(natural);
+    printf("test_lsbi_round_trip passed.\n");
+}
+
+/**
+ * @brief Insertar por rangos (en cualquier orden) produce la misma imagen que embed, y extract_range
+ * recupera cualquier rango. La imagen tiene padding (7 píxeles de ancho).
+ */
+void test_embed_range_matches_embed() {
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4};
+    uint8_t data[24];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 37 + 11);
+    }
+
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        BMPImage *expected = create_test_bmp(7, 12, 0x5A);
+        BMPImage *ranged = create_test_bmp(7, 12, 0x5A);
+        assert(steg_supports_ranges(algorithms[a]));
+        assert(steg_capacity(expected, algorithms[a]) >= sizeof(data));
+
+        assert(embed(expected, data, sizeof(data), algorithms[a]));
+        assert(embed_range(ranged, data, 16, 8, algorithms[a]));
+        assert(embed_range(ranged, data, 0, 5, algorithms[a]));
+        assert(embed_range(ranged, data, 5, 11, algorithms[a]));
+        assert(memcmp(expected->data, ranged->data, expected->data_size) == 0);
+
+        uint8_t buffer[sizeof(data)];
+        assert(extract_range(ranged, 9, 10, buffer, algorithms[a]));
+        assert(memcmp(buffer, data + 9, 10) == 0);
+
+        // Fuera de la capacidad
+        size_t capacity = steg_capacity(ranged, algorithms[a]);
+        assert(!extract_range(ranged, capacity - 1, 2, buffer, algorithms[a]));
+
+        free_bmp(expected);
+        free_bmp(ranged);
+    }
+    assert(!steg_supports_ranges(STEG_LSBI));
+    printf("test_embed_range_matches_embed passed.\n");
+}
+
+/**
+ * @brief Crea una imagen con padding (7 píxeles de ancho) y píxeles distintos entre sí.
+ */
+static BMPImage* create_patterned_bmp(size_t height) {
+    BMPImage *bmp = create_test_bmp(7, height, 0x00);
+    for (size_t i = 0; i < bmp->data_size; i++) {
+        bmp->data[i] = (uint8_t) (i * 13);
+    }
+    return bmp;
+}
+
+/**
+ * @brief Una copia solo copia las filas que toca el embebido, da la misma imagen que una imagen
+ * independiente y al descartar los cambios vuelve a ser igual al original, que nunca se modifica.
+ */
+void test_copy_bmp_copy_on_write() {
+    BMPImage *original = create_patterned_bmp(40);
+    size_t pristine_size = 0;
+    uint8_t *pristine = bmp_to_buffer(original, &pristine_size);
+    uint8_t data[24];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 29 + 3);
+    }
+
+    BMPImage *copy = copy_bmp(original);
+    assert(copy != NULL && copy->shared == original->shared && copy->dirty_row_count == 0);
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4};
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        BMPImage *expected = create_patterned_bmp(40);
+        assert(embed(expected, data, sizeof(data), algorithms[a]));
+        assert(embed(copy, data, sizeof(data), algorithms[a]));
+
+        // 24 bytes ocupan 192 componentes (LSB1) o 48 (LSB4), de 21 por fila
+        size_t components = BYTES_TO_BITS(sizeof(data)) / (algorithms[a] == STEG_LSB1 ? 1 : 4);
+        size_t rows = (components + 20) / 21;
+        assert(copy->dirty_row_count == rows);
+        assert(bmp_diff_rows(copy, expected, NULL) == 0);
+        assert(bmp_diff_rows(copy, original, NULL) > 0 && bmp_diff_rows(copy, original, NULL) <= rows);
+
+        size_t expected_size = 0, copy_size = 0;
+        uint8_t *expected_buffer = bmp_to_buffer(expected, &expected_size);
+        uint8_t *copy_buffer = bmp_to_buffer(copy, &copy_size);
+        assert(copy_size == expected_size && memcmp(copy_buffer, expected_buffer, copy_size) == 0);
+        free(copy_buffer);
+        free(expected_buffer);
+        free_bmp(expected);
+
+        assert(bmp_discard_changes(copy) == rows);
+        copy_buffer = bmp_to_buffer(copy, &copy_size);
+        assert(memcmp(copy_buffer, pristine, pristine_size) == 0);
+        free(copy_buffer);
+    }
+
+    // Por rangos hay que preparar la copia antes de repartir los rangos
+    assert(prepare_embed_range(copy, 0, sizeof(data), STEG_LSB4));
+    size_t prepared = copy->dirty_row_count;
+    assert(embed_range(copy, data, 12, 12, STEG_LSB4));
+    assert(embed_range(copy, data, 0, 12, STEG_LSB4));
+    assert(copy->dirty_row_count == prepared);
+    assert(!bmp_prepare_write(copy, 0, 7 * 40 * 3 + 1));
+
+    // El original no cambió
+    size_t original_size = 0;
+    uint8_t *original_buffer = bmp_to_buffer(original, &original_size);
+    assert(memcmp(original_buffer, pristine, pristine_size) == 0);
+    free(original_buffer);
+    free(pristine);
+    free_bmp(copy);
+    free_bmp(original);
+    printf("test_copy_bmp_copy_on_write passed.\n");
+}
+
+/**
+ * @brief El original también escribe sus propias filas, las copias heredan las filas ya modificadas
+ * y los píxeles compartidos sobreviven al original.
+ */
+void test_copy_bmp_shared_pixels() {
+    BMPImage *original = create_patterned_bmp(10);
+    BMPImage *first = copy_bmp(original);
+    uint8_t *shared_pixel = get_component_by_index(original, 0).component_ptr;
+    assert(shared_pixel == get_component_by_index(first, 0).component_ptr);
+
+    // Escribir en la fila 3 del original no afecta a la copia
+    assert(bmp_prepare_write(original, 3 * 21, 3 * 21 + 1));
+    *get_component_by_index(original, 3 * 21).component_ptr ^= 0xFF;
+    bool changed[10];
+    assert(bmp_diff_rows(original, first, changed) == 1 && changed[3] && !changed[2]);
+
+    // Una copia del original modificado ya tiene esa fila propia
+    BMPImage *second = copy_bmp(original);
+    assert(second->dirty_row_count == 1 && bmp_diff_rows(second, original, NULL) == 0);
+    free_bmp(original);
+
+    assert(bmp_diff_rows(first, second, changed) == 1 && changed[3]);
+    assert(bmp_discard_changes(second) == 1);
+    assert(bmp_diff_rows(first, second, NULL) == 0);
+    free_bmp(first);
+    assert(get_component_by_index(second, 5 * 21 + 4).component_ptr != NULL);
+    free_bmp(second);
+
+    // Imágenes de distinto tamaño no se comparan
+    BMPImage *small = create_patterned_bmp(2);
+    BMPImage *large = create_patterned_bmp(3);
+    assert(bmp_diff_rows(small, large, NULL) == SIZE_MAX);
+    free_bmp(small);
+    free_bmp(large);
+    printf("test_copy_bmp_shared_pixels passed.\n");
+}
+
+/**
+ * @brief Las copias solo reservan bloques para las filas que escriben: N copias que ocultan unos
+ * pocos bytes ocupan unos pocos bloques cada una, no N imágenes, y el original no reserva nada.
+ */
+void test_copy_bmp_private_bytes() {
+    BMPImage *original = create_test_bmp(1000, 1000, 0x40);
+    assert(original != NULL);
+    size_t image_bytes = bmp_private_bytes(original);
+    assert(image_bytes == original->data_size);
+
+    enum { COPIES = 16 };
+    BMPImage *copies[COPIES];
+    uint8_t data[64] = {0x5A};
+    size_t held = 0;
+    for (size_t i = 0; i < COPIES; i++) {
+        copies[i] = copy_bmp(original);
+        assert(copies[i] != NULL && bmp_private_bytes(copies[i]) == 0);
+        // Cada copia escribe en otra parte de la imagen: un bloque propio
+        assert(embed_at_component(copies[i], data, sizeof(data), i * 60 * 3000, STEG_LSB1));
+        assert(copies[i]->dirty_row_count == 1);
+        assert(bmp_private_bytes(copies[i]) > 0 && bmp_private_bytes(copies[i]) <= BMP_PRIVATE_BLOCK_SIZE);
+        held += bmp_private_bytes(copies[i]);
+    }
+    assert(bmp_private_bytes(original) == 0);
+    assert(held <= COPIES * BMP_PRIVATE_BLOCK_SIZE && held < image_bytes);
+
+    // Descartar conserva el bloque para la próxima modificación; una copia de una copia hereda solo sus filas
+    assert(bmp_discard_changes(copies[0]) == 1 && bmp_private_bytes(copies[0]) == bmp_private_bytes(copies[1]));
+    BMPImage *nested = copy_bmp(copies[1]);
+    assert(nested != NULL && bmp_private_bytes(nested) == bmp_private_bytes(copies[1]));
+    assert(bmp_diff_rows(nested, copies[1], NULL) == 0);
+    free_bmp(nested);
+
+    // Escribir toda la imagen reserva a lo sumo una imagen de bloques
+    assert(bmp_prepare_write(copies[2], 0, original->width * original->height * 3));
+    assert(bmp_private_bytes(copies[2]) == original->height * ((original->width * 3 + 3) & ~(size_t) 3));
+
+    free_bmp(original);
+    for (size_t i = 0; i < COPIES; i++) {
+        free_bmp(copies[i]);
+    }
+    printf("test_copy_bmp_private_bytes passed.\n");
+}
+
+/**
+ * @brief extract_data_range devuelve lo mismo que recortar extract_data, en los tres algoritmos, y
+ * con una imagen cargada de forma diferida solo lee las filas del rango.
+ */
+void test_extract_data_range() {
+    const char *paths[] = {IMG_BASE_PATH "ladoLSB1.bmp", IMG_BASE_PATH "ladoLSB4.bmp", IMG_BASE_PATH "ladoLSBI.bmp"};
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4, STEG_LSBI};
+
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        BMPImage *full = new_bmp_file(paths[a]);
+        assert(full != NULL);
+        FilePackage *expected = extract_data(full, algorithms[a]);
+        assert(expected != NULL && expected->size > 100);
+
+        size_t starts[] = {0, 37, expected->size - 20};
+        for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+            BMPImage *lazy = new_bmp_file_lazy(paths[a]);
+            assert(lazy != NULL);
+            size_t file_size = 0;
+            FilePackage *range = extract_data_range(lazy, algorithms[a], starts[i], 50, &file_size);
+            assert(range != NULL && file_size == expected->size);
+            // El último rango se recorta al final del archivo
+            size_t length = expected->size - starts[i] < 50 ? expected->size - starts[i] : 50;
+            assert(range->size == length);
+            assert(memcmp(range->data, expected->data + starts[i], length) == 0);
+            assert(strcmp((char *) range->extension, (char *) expected->extension) == 0);
+
+            size_t loaded = 0;
+            for (size_t row = 0; row < lazy->height; row++) {
+                loaded += lazy->loaded_rows[row];
+            }
+            assert(loaded > 0 && loaded < lazy->height);
+            free_file_package(range);
+            free_bmp(lazy);
+        }
+
+        // También con la imagen completa; fuera del archivo falla
+        FilePackage *range = extract_data_range(full, algorithms[a], 1, 10, NULL);
+        assert(range != NULL && memcmp(range->data, expected->data + 1, 10) == 0);
+        free_file_package(range);
+        assert(extract_data_range(full, algorithms[a], expected->size, 10, NULL) == NULL);
+        assert(extract_data_range(full, algorithms[a], 0, 0, NULL) == NULL);
+
+        free_file_package(expected);
+        free_bmp(full);
+    }
+    assert(new_bmp_file_lazy(IMG_BASE_PATH "no_existe.bmp") == NULL);
+    printf("test_extract_data_range passed.\n");
+}
+
+/**
+ * @brief Un encabezado con un tamaño de datos menor que sus filas se rechaza al leer el archivo completo,
+ * en forma diferida, desde un buffer o al sondearlo, aunque el archivo tenga todas las filas.
+ */
+void test_short_data_size_rejected() {
+    size_t size = 0;
+    BMPImage *source = new_bmp_file(IMG_BASE_PATH "lado.bmp");
+    assert(source != NULL);
+    uint8_t *buffer = bmp_to_buffer(source, &size);
+    free_bmp(source);
+    assert(buffer != NULL);
+    // biSizeImage = 64, little-endian
+    buffer[34] = 64;
+    buffer[35] = buffer[36] = buffer[37] = 0;
+
+    const char *path = "test_short_data_size.bmp";
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL && fwrite(buffer, 1, size, file) == size);
+    fclose(file);
+
+    assert(new_bmp_from_buffer(buffer, size) == NULL);
+    assert(new_bmp_file(path) == NULL);
+    assert(new_bmp_file_lazy(path) == NULL);
+    BMPImage probe;
+    int fd = open(path, O_RDONLY);
+    assert(fd >= 0 && !bmp_probe(fd, &probe));
+    close(fd);
+    remove(path);
+    mem_free(buffer);
+    printf("test_short_data_size_rejected passed.\n");
+}
+
 int main() {
     set_log_level(NONE);
 
@@ -716,6 +1042,14 @@ int main() {
 //    test_extract_bits_lsbi_mock_case1();
 //    test_extract_bits_lsbi_mock_case2();
 
+    test_lsbi_round_trip();
+    test_embed_range_matches_embed();
+    test_copy_bmp_copy_on_write();
+    test_copy_bmp_shared_pixels();
+    test_copy_bmp_private_bytes();
+    test_extract_data_range();
+    test_short_data_size_rejected();
+
     printf("Todos los tests pasaron exitosamente.\n");
     return 0;
 }
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../src/include/crypto.h"
+#include "../src/include/stegolib.h"
+#include "test_utils.c"
+
+#define STEGOLIB_THREADS 4
+
+static uint8_t *carrier = NULL;
+static size_t carrier_size = 0;
+static uint8_t *message = NULL;
+static size_t message_size = 0;
+
+/**
+ * @brief Lee el archivo completo.
+ */
+static uint8_t* read_whole_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    *size = get_file_size(file);
+    uint8_t *data = malloc(*size + 1);
+    assert(data != NULL);
+    assert(fread(data, 1, *size, file) == *size);
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Oculta el mensaje en el portador y lo recupera con el mismo contexto.
+ */
+static void round_trip(const StegoContext *context) {
+    uint8_t *stego = NULL, *data = NULL;
+    size_t stego_size = 0, data_size = 0;
+    char extension[STEGO_EXTENSION_SIZE];
+
+    assert(stego_embed_buffer(context, carrier, carrier_size, message, message_size, ".txt", &stego, &stego_size) == STEGO_OK);
+    assert(stego_size == carrier_size);
+    assert(stego_extract_buffer(context, stego, stego_size, &data, &data_size, extension) == STEGO_OK);
+    assert(data_size == message_size && memcmp(data, message, message_size) == 0);
+    assert(strcmp(extension, ".txt") == 0);
+    stego_free(context, stego);
+    stego_free(context, data);
+}
+
+void test_stegolib_round_trip() {
+    StegoOptions options;
+    stego_options_init(&options);
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+    round_trip(context);
+    stego_ctx_free(context);
+
+    options.steg_algorithm = STEG_LSB4;
+    options.encryption = ENC_AES256;
+    options.mode = ENC_MODE_GCM;
+    options.password = "clave";
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+    round_trip(context);
+    stego_ctx_free(context);
+
+    // Sin modo se usa el default de la línea de comandos
+    options.mode = ENC_MODE_NONE;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+    round_trip(context);
+    stego_ctx_free(context);
+
+    options.encryption = ENC_3DES;
+    options.mode = ENC_MODE_GCM;
+    assert(stego_ctx_new(&options, &context) == STEGO_ERROR_ARGUMENTS);
+    assert(context == NULL);
+
+    // Parámetros de KDF que la extracción rechazaría en el encabezado
+    KdfParams limits[] = {
+            {.algorithm = KDF_PBKDF2_SHA256, .iterations = CRYPTO_KDF_MAX_ITERATIONS + 1},
+            {.algorithm = KDF_SCRYPT, .scrypt_n = (uint64_t) 1 << (CRYPTO_SCRYPT_MAX_LOG_N + 1)},
+            {.algorithm = KDF_SCRYPT, .scrypt_n = 1000},
+            {.algorithm = KDF_SCRYPT, .scrypt_r = 256, .scrypt_p = 256},
+    };
+    options.encryption = ENC_AES256;
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        options.kdf = limits[i];
+        assert(stego_ctx_new(&options, &context) == STEGO_ERROR_ARGUMENTS);
+        assert(context == NULL);
+    }
+    printf("test_stegolib_round_trip passed.\n");
+}
+
+static void *round_trip_thread(void *arg) {
+    for (int i = 0; i < 4; i++) {
+        round_trip((const StegoContext *) arg);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Varios hilos comparten el mismo contexto.
+ */
+void test_stegolib_shared_context() {
+    StegoOptions options;
+    stego_options_init(&options);
+    options.steg_algorithm = STEG_LSB1;
+    options.encryption = ENC_CHACHA20;
+    options.password = "clave";
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+
+    pthread_t threads[STEGOLIB_THREADS];
+    for (int i = 0; i < STEGOLIB_THREADS; i++) {
+        assert(pthread_create(&threads[i], NULL, round_trip_thread, context) == 0);
+    }
+    for (int i = 0; i < STEGOLIB_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    stego_ctx_free(context);
+    printf("test_stegolib_shared_context passed.\n");
+}
+
+typedef struct {
+    size_t messages;
+    LogLevel lowest;
+} LogCapture;
+
+static void capture_log(LogLevel level, const char *text, void *user_data) {
+    LogCapture *capture = user_data;
+    assert(text != NULL);
+    capture->messages++;
+    capture->lowest = level < capture->lowest ? level : capture->lowest;
+}
+
+/**
+ * @brief Errores estructurados, y los mensajes van al handler del contexto sin cambiar el nivel global.
+ */
+void test_stegolib_errors() {
+    LogCapture capture = {0, NONE};
+    StegoOptions options;
+    stego_options_init(&options);
+    options.encryption = ENC_AES128;
+    options.mode = ENC_MODE_CBC;
+    options.password = "clave";
+    options.log_level = ERROR;
+    options.log_handler = capture_log;
+    options.log_user_data = &capture;
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+
+    uint8_t *output = NULL, *data = NULL;
+    size_t output_size = 0, data_size = 0;
+    const uint8_t not_a_bmp[] = "esto no es un BMP";
+    assert(stego_embed_buffer(context, not_a_bmp, sizeof(not_a_bmp), message, message_size, ".txt", &output, &output_size) == STEGO_ERROR_CARRIER);
+    assert(output == NULL);
+    assert(stego_embed_buffer(context, carrier, carrier_size, message, message_size, "txt", &output, &output_size) == STEGO_ERROR_ARGUMENTS);
+
+    size_t small_size = 0;
+    uint8_t *small = read_whole_file(IMG_BASE_PATH "2x2_image.bmp", &small_size);
+    assert(stego_embed_buffer(context, small, small_size, message, message_size, ".txt", &output, &output_size) == STEGO_ERROR_CAPACITY);
+    free(small);
+    assert(capture.messages > 0);
+    assert(capture.lowest >= ERROR);
+    assert(log_level == NONE);
+
+    assert(stego_embed_buffer(context, carrier, carrier_size, message, message_size, ".txt", &output, &output_size) == STEGO_OK);
+    options.password = "otra";
+    StegoContext *wrong = NULL;
+    assert(stego_ctx_new(&options, &wrong) == STEGO_OK);
+    assert(stego_extract_buffer(wrong, output, output_size, &data, &data_size, NULL) == STEGO_ERROR_CRYPTO);
+    assert(data == NULL);
+
+    // Sin contraseña el portador original no tiene un mensaje válido
+    StegoOptions plain;
+    stego_options_init(&plain);
+    StegoContext *unencrypted = NULL;
+    assert(stego_ctx_new(&plain, &unencrypted) == STEGO_OK);
+    assert(stego_extract_buffer(unencrypted, carrier, carrier_size, &data, &data_size, NULL) == STEGO_ERROR_NOT_FOUND);
+
+    stego_free(context, output);
+    stego_ctx_free(unencrypted);
+    stego_ctx_free(wrong);
+    stego_ctx_free(context);
+    printf("test_stegolib_errors passed.\n");
+}
+
+/**
+ * @brief Variantes con descriptores.
+ */
+void test_stegolib_fd() {
+    StegoOptions options;
+    stego_options_init(&options);
+    options.steg_algorithm = STEG_LSB4;
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+
+    int carrier_fd = open(IMG_BASE_PATH "lado.bmp", O_RDONLY);
+    int data_fd = open(IMG_BASE_PATH "message.txt", O_RDONLY);
+    int output_fd = open("stegolib_fd.bmp", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert(carrier_fd >= 0 && data_fd >= 0 && output_fd >= 0);
+    assert(stego_embed_fd(context, carrier_fd, data_fd, ".txt", output_fd) == STEGO_OK);
+    close(carrier_fd);
+    close(data_fd);
+    close(output_fd);
+
+    int stego_fd = open("stegolib_fd.bmp", O_RDONLY);
+    int pipe_fds[2];
+    assert(stego_fd >= 0 && pipe(pipe_fds) == 0);
+    char extension[STEGO_EXTENSION_SIZE];
+    assert(stego_extract_fd(context, stego_fd, pipe_fds[1], extension) == STEGO_OK);
+    close(pipe_fds[1]);
+    close(stego_fd);
+    assert(strcmp(extension, ".txt") == 0);
+
+    uint8_t *recovered = malloc(message_size + 1);
+    size_t got = 0;
+    ssize_t count;
+    while ((count = read(pipe_fds[0], recovered + got, message_size + 1 - got)) > 0) {
+        got += (size_t) count;
+    }
+    close(pipe_fds[0]);
+    assert(got == message_size && memcmp(recovered, message, message_size) == 0);
+    free(recovered);
+
+    assert(stego_extract_fd(context, -1, STDOUT_FILENO, NULL) == STEGO_ERROR_IO);
+    // Sin contexto no se lee ningún descriptor
+    stego_fd = open("stegolib_fd.bmp", O_RDONLY);
+    assert(stego_fd >= 0);
+    assert(stego_extract_fd(NULL, stego_fd, STDOUT_FILENO, NULL) == STEGO_ERROR_ARGUMENTS);
+    assert(stego_embed_fd(NULL, stego_fd, stego_fd, ".txt", STDOUT_FILENO) == STEGO_ERROR_ARGUMENTS);
+    assert(lseek(stego_fd, 0, SEEK_CUR) == 0);
+    close(stego_fd);
+    remove("stegolib_fd.bmp");
+    stego_ctx_free(context);
+    printf("test_stegolib_fd passed.\n");
+}
+
+/**
+ * @brief Extracción de un rango desde un buffer y desde un archivo, con y sin contraseña.
+ */
+void test_stegolib_range() {
+    const char *passwords[] = {NULL, "clave"};
+    for (size_t p = 0; p < 2; p++) {
+        StegoOptions options;
+        stego_options_init(&options);
+        options.steg_algorithm = STEG_LSB1;
+        options.password = passwords[p];
+        StegoContext *context = NULL;
+        assert(stego_ctx_new(&options, &context) == STEGO_OK);
+
+        uint8_t *stego = NULL, *data = NULL;
+        size_t stego_size = 0, data_size = 0, file_size = 0;
+        char extension[STEGO_EXTENSION_SIZE];
+        assert(stego_embed_buffer(context, carrier, carrier_size, message, message_size, ".txt", &stego, &stego_size) == STEGO_OK);
+        assert(stego_extract_range_buffer(context, stego, stego_size, 3, 5, &data, &data_size, &file_size, extension) == STEGO_OK);
+        assert(data_size == 5 && file_size == message_size && memcmp(data, message + 3, 5) == 0);
+        assert(strcmp(extension, ".txt") == 0);
+        stego_free(context, data);
+
+        // El rango se recorta al final; empezar después del final es un error
+        assert(stego_extract_range_buffer(context, stego, stego_size, message_size - 2, 100, &data, &data_size, NULL, NULL) == STEGO_OK);
+        assert(data_size == 2 && memcmp(data, message + message_size - 2, 2) == 0);
+        stego_free(context, data);
+        assert(stego_extract_range_buffer(context, stego, stego_size, message_size, 1, &data, &data_size, NULL, NULL) == STEGO_ERROR_ARGUMENTS);
+        assert(stego_extract_range_buffer(context, stego, stego_size, 0, 0, &data, &data_size, NULL, NULL) == STEGO_ERROR_ARGUMENTS);
+
+        // Desde un archivo, sin mover el offset del descriptor
+        FILE *file = fopen("stegolib_range.bmp", "wb");
+        assert(file != NULL && fwrite(stego, 1, stego_size, file) == stego_size);
+        fclose(file);
+        int stego_fd = open("stegolib_range.bmp", O_RDONLY);
+        int pipe_fds[2];
+        assert(stego_fd >= 0 && pipe(pipe_fds) == 0);
+        assert(stego_extract_range_fd(context, stego_fd, 1, 4, pipe_fds[1], &file_size, extension) == STEGO_OK);
+        close(pipe_fds[1]);
+        uint8_t recovered[8];
+        assert(read(pipe_fds[0], recovered, sizeof(recovered)) == 4 && memcmp(recovered, message + 1, 4) == 0);
+        close(pipe_fds[0]);
+        assert(lseek(stego_fd, 0, SEEK_CUR) == 0);
+        close(stego_fd);
+
+        remove("stegolib_range.bmp");
+        stego_free(context, stego);
+        stego_ctx_free(context);
+    }
+    printf("test_stegolib_range passed.\n");
+}
+
+typedef struct {
+    size_t allocations;
+    size_t live;
+    pthread_mutex_t lock;
+} HookCounter;
+
+static void *counting_malloc(size_t size, void *user_data) {
+    HookCounter *counter = user_data;
+    pthread_mutex_lock(&counter->lock);
+    counter->allocations++;
+    counter->live++;
+    pthread_mutex_unlock(&counter->lock);
+    return malloc(size);
+}
+
+static void counting_free(void *ptr, void *user_data) {
+    HookCounter *counter = user_data;
+    pthread_mutex_lock(&counter->lock);
+    counter->live--;
+    pthread_mutex_unlock(&counter->lock);
+    free(ptr);
+}
+
+/**
+ * @brief Con hooks propios, el contexto, los chunks de la arena y los resultados salen de ellos
+ * y se devuelven todos.
+ */
+void test_stegolib_allocator_hooks() {
+    HookCounter counter = {0, 0, PTHREAD_MUTEX_INITIALIZER};
+    StegoOptions options;
+    stego_options_init(&options);
+    options.steg_algorithm = STEG_LSB4;
+    options.encryption = ENC_AES128;
+    options.mode = ENC_MODE_CTR;
+    options.password = "clave";
+    options.malloc_fn = counting_malloc;
+    StegoContext *context = NULL;
+    assert(stego_ctx_new(&options, &context) == STEGO_ERROR_ARGUMENTS);
+    options.free_fn = counting_free;
+    options.allocator_data = &counter;
+    assert(stego_ctx_new(&options, &context) == STEGO_OK);
+    assert(counter.live == 1);
+
+    round_trip(context);
+    assert(counter.allocations > 1);
+    assert(counter.live == 1);
+
+    stego_ctx_free(context);
+    assert(counter.live == 0);
+    printf("test_stegolib_allocator_hooks passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    carrier = read_whole_file(IMG_BASE_PATH "lado.bmp", &carrier_size);
+    message = read_whole_file(IMG_BASE_PATH "message.txt", &message_size);
+
+    test_stegolib_round_trip();
+    test_stegolib_shared_context();
+    test_stegolib_errors();
+    test_stegolib_fd();
+    test_stegolib_range();
+    test_stegolib_allocator_hooks();
+
+    free(carrier);
+    free(message);
+    printf("Todos los tests de stegolib pasaron exitosamente.\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include "../src/include/stream.h"
+#include "../src/include/stego_bmp.h"
+#include "test_utils.c"
+
+// 1001 píxeles de ancho dejan 3 bytes de padding por fila; 2500 filas son dos ventanas
+#define CARRIER_WIDTH 1001
+#define CARRIER_HEIGHT 2500
+#define CARRIER_PATH "test_stream_carrier.bmp"
+#define STEGO_PATH "test_stream.bmp"
+#define INPUT_PATH "test_stream_in.dat"
+#define OUTPUT_NAME "test_stream_out"
+#define OUTPUT_PATH OUTPUT_NAME ".dat"
+#define TRAILING_BYTES 6
+
+static void store_le32(uint8_t *buffer, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) {
+        buffer[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static uint8_t pattern_byte(size_t position, uint64_t seed) {
+    uint64_t x = (position + seed) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    return (uint8_t) (x ^ (x >> 31));
+}
+
+/**
+ * @brief Escribe un BMP V3 de 24 bits con píxeles pseudoaleatorios.
+ *
+ * @param image_size Valor del campo de tamaño de la imagen (0 está permitido sin compresión). Si no
+ *                   es 0, incluye TRAILING_BYTES bytes de más después de la última fila.
+ */
+static void write_carrier(const char *path, uint32_t image_size) {
+    size_t row_size = (CARRIER_WIDTH * 3 + 3) & ~(size_t) 3;
+    size_t data_size = row_size * CARRIER_HEIGHT + (image_size != 0 ? TRAILING_BYTES : 0);
+    uint8_t header[BMP_HEADER_SIZE] = {'B', 'M'};
+    store_le32(header + 2, (uint32_t) (BMP_HEADER_SIZE + data_size));
+    store_le32(header + 10, BMP_HEADER_SIZE);
+    store_le32(header + 14, 40);
+    store_le32(header + 18, CARRIER_WIDTH);
+    store_le32(header + 22, CARRIER_HEIGHT);
+    header[26] = 1;
+    header[28] = 24;
+    store_le32(header + 34, image_size);
+
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    assert(fwrite(header, 1, BMP_HEADER_SIZE, file) == BMP_HEADER_SIZE);
+    for (size_t i = 0; i < data_size; i++) {
+        fputc(pattern_byte(i, 7), file);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Compara dos archivos fuera de los bytes [from, to).
+ */
+static bool files_match_outside(const char *a, const char *b, size_t from, size_t to) {
+    FILE *file_a = fopen(a, "rb");
+    FILE *file_b = fopen(b, "rb");
+    assert(file_a != NULL && file_b != NULL);
+    bool same = true;
+    size_t position = 0;
+    int c_a, c_b;
+    do {
+        c_a = fgetc(file_a);
+        c_b = fgetc(file_b);
+        same = same && (c_a == c_b || (position >= from && position < to && c_a != EOF && c_b != EOF));
+        position++;
+    } while (c_a != EOF || c_b != EOF);
+    fclose(file_a);
+    fclose(file_b);
+    return same;
+}
+
+/**
+ * @brief Encabezados de 32 y 64 bits: el de 32 bits se usa solo si el tamaño entra y no se pide el grande.
+ */
+void test_package_header() {
+    uint8_t header[PACKAGE_MAX_HEADER_SIZE];
+    uint64_t size = 0;
+    assert(write_package_header(header, 1000, false, COMPRESSION_NONE) == PACKAGE_SIZE_FIELD);
+    assert(parse_package_header(header, sizeof(header), &size, NULL) == PACKAGE_SIZE_FIELD && size == 1000);
+
+    assert(write_package_header(header, 1000, true, COMPRESSION_NONE) == PACKAGE_LARGE_HEADER_SIZE);
+    assert(parse_package_header(header, sizeof(header), &size, NULL) == PACKAGE_LARGE_HEADER_SIZE && size == 1000);
+
+    uint64_t large = (uint64_t) UINT32_MAX + 5;
+    assert(write_package_header(header, large, false, COMPRESSION_NONE) == PACKAGE_LARGE_HEADER_SIZE);
+    assert(header[0] == 0 && header[1] == 0 && header[2] == 0 && header[3] == 0);
+    assert(parse_package_header(header, sizeof(header), &size, NULL) == PACKAGE_LARGE_HEADER_SIZE && size == large);
+
+    // Encabezado incompleto, versión desconocida o tamaño 0
+    assert(parse_package_header(header, PACKAGE_LARGE_HEADER_SIZE - 1, &size, NULL) == 0);
+    header[4] = PACKAGE_COMPRESSED_VERSION + 1;
+    assert(parse_package_header(header, sizeof(header), &size, NULL) == 0);
+    write_package_header(header, 1, true, COMPRESSION_NONE);
+    memset(header + 8, 0, 8);
+    assert(parse_package_header(header, sizeof(header), &size, NULL) == 0);
+    printf("test_package_header passed.\n");
+}
+
+/**
+ * @brief Lo ocultado por ventanas se recupera por ventanas y, con el encabezado de 32 bits, también
+ * con la extracción común. Fuera de las filas el portador no cambia.
+ */
+void test_stream_round_trip() {
+    StegAlgorithm algorithms[] = {STEG_LSB1, STEG_LSB4};
+    size_t sizes[] = {700000, 2500000};
+    uint32_t image_sizes[] = {0, (uint32_t) (((CARRIER_WIDTH * 3 + 3) & ~3) * CARRIER_HEIGHT + TRAILING_BYTES)};
+    size_t row_size = (CARRIER_WIDTH * 3 + 3) & ~(size_t) 3;
+    for (size_t a = 0; a < 2; a++) {
+        for (size_t large = 0; large < 2; large++) {
+            write_carrier(CARRIER_PATH, image_sizes[large]);
+            write_test_input(INPUT_PATH, sizes[a]);
+            uint64_t stored = 0;
+            assert(stream_embed(CARRIER_PATH, INPUT_PATH, STEGO_PATH, algorithms[a], large == 1, &stored));
+            assert(stored == (large ? PACKAGE_LARGE_HEADER_SIZE : PACKAGE_SIZE_FIELD) + sizes[a] + strlen(".dat") + 1);
+            assert(files_match_outside(CARRIER_PATH, STEGO_PATH, BMP_HEADER_SIZE, BMP_HEADER_SIZE + row_size * CARRIER_HEIGHT));
+
+            uint64_t file_size = 0;
+            assert(stream_extract(STEGO_PATH, OUTPUT_NAME, algorithms[a], &file_size));
+            assert(file_size == sizes[a] && test_output_matches(OUTPUT_PATH, sizes[a]));
+
+            BMPImage *bmp = new_bmp_file(STEGO_PATH);
+            assert(bmp != NULL);
+            FilePackage *package = extract_data(bmp, algorithms[a]);
+            if (large) {
+                // El campo de 32 bits vale 0: solo -stream lo lee
+                assert(package == NULL);
+            } else {
+                assert(package != NULL && package->size == sizes[a]);
+                assert(create_file_from_package(OUTPUT_NAME, package) == 1 && test_output_matches(OUTPUT_PATH, sizes[a]));
+                free_file_package(package);
+            }
+            free_bmp(bmp);
+        }
+    }
+    remove(STEGO_PATH);
+    printf("test_stream_round_trip passed.\n");
+}
+
+/**
+ * @brief Lo ocultado con embed se extrae por ventanas.
+ */
+void test_stream_extracts_regular_embed() {
+    write_carrier(CARRIER_PATH, 0);
+    write_test_input(INPUT_PATH, 600000);
+    size_t package_size = 0;
+    uint8_t *package = embed_data_from_file(INPUT_PATH, &package_size);
+    BMPImage *bmp = new_bmp_file(CARRIER_PATH);
+    assert(package != NULL && bmp != NULL && embed(bmp, package, package_size, STEG_LSB1));
+    assert(save_bmp_file(STEGO_PATH, bmp) == 0);
+
+    uint64_t file_size = 0;
+    assert(stream_extract(STEGO_PATH, OUTPUT_NAME, STEG_LSB1, &file_size));
+    assert(file_size == 600000 && test_output_matches(OUTPUT_PATH, 600000));
+
+    // Sin archivo oculto no se deja una salida a medias
+    assert(!stream_extract(CARRIER_PATH, OUTPUT_NAME, STEG_LSB4, NULL) && access(OUTPUT_PATH, F_OK) != 0);
+
+    free_bmp(bmp);
+    mem_free(package);
+    remove(STEGO_PATH);
+    printf("test_stream_extracts_regular_embed passed.\n");
+}
+
+/**
+ * @brief Un archivo que no entra no crea la salida; LSBI no se admite.
+ */
+void test_stream_errors() {
+    write_carrier(CARRIER_PATH, 0);
+    write_test_input(INPUT_PATH, CARRIER_WIDTH * CARRIER_HEIGHT * 3 / 8);
+    assert(!stream_embed(CARRIER_PATH, INPUT_PATH, STEGO_PATH, STEG_LSB1, false, NULL));
+    assert(access(STEGO_PATH, F_OK) != 0);
+
+    write_test_input(INPUT_PATH, 1000);
+    assert(!stream_embed(CARRIER_PATH, INPUT_PATH, STEGO_PATH, STEG_LSBI, false, NULL));
+    assert(!stream_embed(CARRIER_PATH, "test_stream_missing.dat", STEGO_PATH, STEG_LSB4, false, NULL));
+    assert(!stream_extract("test_stream_missing.bmp", OUTPUT_NAME, STEG_LSB4, NULL));
+    printf("test_stream_errors passed.\n");
+}
+
+/**
+ * @brief -stream pasa por run_streamed_job y no se combina con lo que necesita el archivo en memoria.
+ */
+void test_streamed_job() {
+    write_carrier(CARRIER_PATH, 0);
+    write_test_input(INPUT_PATH, 300000);
+    ProgramOptions options;
+    char *embed_argv[] = {"stegobmp", "-embed", "-stream", "-in", INPUT_PATH, "-p", CARRIER_PATH, "-out", STEGO_PATH,
+                          "-steg", "LSB4", "-pass", "clave"};
+    assert(parse_test_arguments(&options, 13, embed_argv) == 0);
+    embed_argv[10] = "LSBI";
+    assert(parse_test_arguments(&options, 11, embed_argv) == 0);
+    embed_argv[10] = "LSB4";
+    assert(parse_test_arguments(&options, 11, embed_argv) == 1 && options.stream);
+    assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+    JobResult result;
+    assert(run_streamed_job(&options, &result) == JOB_OK && result.stored_bytes > 300000);
+
+    char *extract_argv[] = {"stegobmp", "-extract", "-stream", "-p", STEGO_PATH, "-out", OUTPUT_NAME, "-steg", "LSB4"};
+    assert(parse_test_arguments(&options, 9, extract_argv) == 1);
+    assert(run_streamed_job(&options, &result) == JOB_OK && result.payload_bytes == 300000);
+    assert(test_output_matches(OUTPUT_PATH, 300000));
+    remove(STEGO_PATH);
+    printf("test_streamed_job passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+
+    test_package_header();
+    test_stream_round_trip();
+    test_stream_extracts_regular_embed();
+    test_stream_errors();
+    test_streamed_job();
+
+    remove(CARRIER_PATH);
+    remove(INPUT_PATH);
+    printf("Todos los tests de streaming pasaron exitosamente.\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../src/include/stripe.h"
+#include "../src/include/crypto.h"
+#include "test_utils.c"
+
+#define PAYLOAD_PATH "test_stripe_payload.bin"
+#define PAYLOAD_SIZE 250000     // Más que la capacidad LSB1 de dos portadores de 640x480
+#define CARRIER IMG_BASE_PATH "lado.bmp"
+
+/**
+ * @brief Compara un archivo con el payload de prueba.
+ */
+static bool matches_payload(const char *path, const uint8_t *payload) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t *contents = malloc(PAYLOAD_SIZE + 1);
+    size_t read = fread(contents, 1, PAYLOAD_SIZE + 1, file);
+    fclose(file);
+    bool same = read == PAYLOAD_SIZE && memcmp(contents, payload, PAYLOAD_SIZE) == 0;
+    free(contents);
+    return same;
+}
+
+/**
+ * @brief El reparto es proporcional a la capacidad, cubre todo el stream y respeta cada capacidad.
+ */
+void test_stripe_plan() {
+    size_t capacities[] = {100, 300, 50};
+    size_t lengths[3];
+    assert(stripe_plan(capacities, 3, 450, lengths));
+    assert(lengths[0] == 100 && lengths[1] == 300 && lengths[2] == 50);
+
+    assert(stripe_plan(capacities, 3, 91, lengths));
+    assert(lengths[0] + lengths[1] + lengths[2] == 91);
+    assert(lengths[1] >= 2 * lengths[0] && lengths[1] >= 2 * lengths[2]);
+
+    assert(!stripe_plan(capacities, 3, 451, lengths));
+    assert(!stripe_plan(capacities, 0, 1, lengths));
+    printf("test_stripe_plan passed.\n");
+}
+
+/**
+ * @brief Un archivo que no entra en un portador se reparte entre tres y se recupera con los
+ * portadores en otro orden, con y sin cifrado. Faltando un portador la extracción falla.
+ */
+void test_stripe_round_trip() {
+    uint8_t *payload = malloc(PAYLOAD_SIZE);
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t) (i * 7 + i / 251);
+    }
+    FILE *file = fopen(PAYLOAD_PATH, "wb");
+    assert(file != NULL && fwrite(payload, 1, PAYLOAD_SIZE, file) == PAYLOAD_SIZE);
+    fclose(file);
+
+    const char *passwords[] = {NULL, "clave"};
+    for (size_t p = 0; p < 2; p++) {
+        ProgramOptions options;
+        char *embed_argv[] = {"stegobmp", "-embed", "-stripe", "-in", PAYLOAD_PATH, "-p", CARRIER "," CARRIER "," CARRIER,
+                              "-out", "stripe_0.bmp,stripe_1.bmp,stripe_2.bmp", "-steg", "LSB1", "-a", "aes256", "-m", "cbc",
+                              "-pass", (char *) passwords[p]};
+        assert(parse_test_arguments(&options, passwords[p] != NULL ? 17 : 11, embed_argv) == 1);
+        assert(options.stripe);
+        JobResult result;
+        assert(run_striped_job(&options, &result) == JOB_OK);
+        assert(result.status == JOB_OK && result.stored_bytes > PAYLOAD_SIZE);
+
+        char *extract_argv[] = {"stegobmp", "-extract", "-stripe", "-p", "stripe_2.bmp,stripe_0.bmp,stripe_1.bmp",
+                                "-out", "stripe_out", "-steg", "LSB1", "-a", "aes256", "-m", "cbc", "-pass", (char *) passwords[p]};
+        assert(parse_test_arguments(&options, passwords[p] != NULL ? 15 : 9, extract_argv) == 1);
+        assert(run_striped_job(&options, &result) == JOB_OK);
+        assert(matches_payload("stripe_out.bin", payload));
+        remove("stripe_out.bin");
+
+        char *partial_argv[] = {"stegobmp", "-extract", "-stripe", "-p", "stripe_0.bmp,stripe_1.bmp", "-out", "stripe_out", "-steg", "LSB1"};
+        assert(parse_test_arguments(&options, 9, partial_argv) == 1);
+        assert(run_striped_job(&options, NULL) == JOB_ERROR_STEG);
+    }
+
+    // Dos portadores no alcanzan
+    ProgramOptions options;
+    char *small_argv[] = {"stegobmp", "-embed", "-stripe", "-in", PAYLOAD_PATH, "-p", CARRIER "," CARRIER,
+                          "-out", "stripe_0.bmp,stripe_1.bmp", "-steg", "LSB1"};
+    assert(parse_test_arguments(&options, 11, small_argv) == 1);
+    assert(run_striped_job(&options, NULL) == JOB_ERROR_STEG);
+
+    // Una salida por portador
+    char *outputs_argv[] = {"stegobmp", "-embed", "-stripe", "-in", PAYLOAD_PATH, "-p", CARRIER "," CARRIER,
+                            "-out", "stripe_0.bmp", "-steg", "LSB4"};
+    assert(parse_test_arguments(&options, 11, outputs_argv) == 1);
+    assert(run_striped_job(&options, NULL) == JOB_ERROR_ARGUMENTS);
+    assert(run_stego_job(&options, NULL, NULL, NULL) == JOB_ERROR_ARGUMENTS);
+
+    remove("stripe_0.bmp");
+    remove("stripe_1.bmp");
+    remove("stripe_2.bmp");
+    remove(PAYLOAD_PATH);
+    free(payload);
+    printf("test_stripe_round_trip passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+    crypto_init();
+    test_stripe_plan();
+    test_stripe_round_trip();
+    crypto_cleanup();
+    printf("Todos los tests de stripe pasaron exitosamente.\n");
+    return 0;
+}
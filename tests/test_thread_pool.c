@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../src/include/thread_pool.h"
+#include "../src/include/logger.h"
+
+#define TASK_COUNT 1000
+#define PARENT_COUNT 16
+#define CHILD_COUNT 32
+
+static pthread_mutex_t counter_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t counter = 0;
+
+static void increment_task(void *arg) {
+    size_t *slot = arg;
+    (*slot)++;
+    pthread_mutex_lock(&counter_lock);
+    counter++;
+    pthread_mutex_unlock(&counter_lock);
+}
+
+typedef struct {
+    ThreadPool *pool;
+    size_t children[CHILD_COUNT];
+} Parent;
+
+/**
+ * @brief Divide el trabajo en subtareas y espera por ellas desde el worker.
+ */
+static void parent_task(void *arg) {
+    Parent *parent = arg;
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t i = 0; i < CHILD_COUNT; i++) {
+        assert(thread_pool_submit(parent->pool, THREAD_POOL_ANY_WORKER, &group, increment_task, &parent->children[i]));
+    }
+    thread_pool_wait(parent->pool, &group);
+    for (size_t i = 0; i < CHILD_COUNT; i++) {
+        assert(parent->children[i] == 1);
+    }
+}
+
+static void sleep_task(void *arg) {
+    (void) arg;
+    usleep(1000);
+}
+
+/**
+ * @brief Todas las tareas se ejecutan exactamente una vez.
+ */
+void test_pool_runs_every_task() {
+    ThreadPool *pool = thread_pool_create(4, false);
+    assert(pool != NULL);
+    assert(thread_pool_size(pool) == 4);
+    assert(thread_pool_current_worker(pool) == THREAD_POOL_ANY_WORKER);
+
+    size_t *slots = calloc(TASK_COUNT, sizeof(size_t));
+    assert(slots != NULL);
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    counter = 0;
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        assert(thread_pool_submit(pool, THREAD_POOL_ANY_WORKER, &group, increment_task, &slots[i]));
+    }
+    thread_pool_wait(pool, &group);
+
+    assert(counter == TASK_COUNT);
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        assert(slots[i] == 1);
+    }
+    free(slots);
+    thread_pool_destroy(pool);
+    printf("test_pool_runs_every_task passed.\n");
+}
+
+/**
+ * @brief Más tareas que esperan subtareas que workers: esperar dentro de un worker no bloquea el pool.
+ */
+void test_pool_nested_wait() {
+    ThreadPool *pool = thread_pool_create(2, false);
+    assert(pool != NULL);
+
+    Parent *parents = calloc(PARENT_COUNT, sizeof(Parent));
+    assert(parents != NULL);
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    counter = 0;
+    for (size_t i = 0; i < PARENT_COUNT; i++) {
+        parents[i].pool = pool;
+        assert(thread_pool_submit(pool, 0, &group, parent_task, &parents[i]));
+    }
+    thread_pool_wait(pool, &group);
+
+    assert(counter == PARENT_COUNT * CHILD_COUNT);
+    free(parents);
+    thread_pool_destroy(pool);
+    printf("test_pool_nested_wait passed.\n");
+}
+
+/**
+ * @brief Las tareas encoladas en un solo worker son robadas por los demás.
+ */
+void test_pool_work_stealing() {
+    ThreadPool *pool = thread_pool_create(4, true);
+    assert(pool != NULL);
+
+    TaskGroup group = THREAD_POOL_GROUP_INIT;
+    for (size_t i = 0; i < 64; i++) {
+        assert(thread_pool_submit(pool, 0, &group, sleep_task, NULL));
+    }
+    thread_pool_wait(pool, &group);
+
+    ThreadPoolWorkerStats stats[4];
+    thread_pool_stats(pool, stats);
+    size_t executed = 0;
+    size_t stolen = 0;
+    for (size_t i = 0; i < 4; i++) {
+        executed += stats[i].executed;
+        stolen += stats[i].stolen;
+    }
+    assert(executed == 64);
+    assert(stolen > 0);
+    assert(stolen == executed - stats[0].executed);
+    thread_pool_destroy(pool);
+    printf("test_pool_work_stealing passed.\n");
+}
+
+int main() {
+    set_log_level(NONE);
+
+    test_pool_runs_every_task();
+    test_pool_nested_wait();
+    test_pool_work_stealing();
+
+    printf("Todos los tests pasaron exitosamente.\n");
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
+#include "arguments.h"
 #include "bmp_image.h"
 #include "logger.h"
 
@@ -20,7 +22,7 @@ BMPImage* create_test_bmp(size_t width, size_t height, unsigned char fill_color)
         return NULL;
     }
 
-    BMPImage *bmp = (BMPImage *)malloc(sizeof(BMPImage));
+    BMPImage *bmp = (BMPImage *)calloc(1, sizeof(BMPImage));
     if (bmp == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para BMPImage en create_test_bmp.")
         return NULL;
@@ -33,7 +35,7 @@ BMPImage* create_test_bmp(size_t width, size_t height, unsigned char fill_color)
     size_t row_size = (width * 3 + 3) & ~3; // Multiplo de 4
     bmp->data_size = row_size * height;
 
-    bmp->data = (unsigned char *)malloc(bmp->data_size);
+    bmp->data = pixel_buffer_acquire(bmp->data_size);
     if (bmp->data == NULL) {
         LOG(ERROR, "No se pudo asignar memoria para los datos de píxeles en create_test_bmp.")
         free(bmp);
@@ -118,3 +120,45 @@ void print_data(const unsigned char *data, size_t data_size) {
     }
     printf("\n");
 }
+
+/**
+ * @brief Escribe en `path` un archivo de prueba de `size` bytes: letras que cambian cada 7 bytes.
+ */
+void write_test_input(const char *path, size_t size) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    for (size_t i = 0; i < size; i++) {
+        fputc('a' + (int) (i / 7 % 26), file);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Indica si `path` tiene los `size` bytes que escribe write_test_input, y lo borra.
+ */
+bool test_output_matches(const char *path, size_t size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    bool same = true;
+    size_t position = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        same = same && c == 'a' + (int) (position / 7 % 26);
+        position++;
+    }
+    fclose(file);
+    remove(path);
+    return same && position == size;
+}
+
+/**
+ * @brief Parsea una línea de comando de prueba desde el principio.
+ *
+ * @return int Lo que devuelve parse_arguments.
+ */
+int parse_test_arguments(ProgramOptions *options, int argc, char **argv) {
+    optind = 1;
+    return parse_arguments(argc, argv, options);
+}